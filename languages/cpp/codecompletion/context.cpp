@@ -54,6 +54,7 @@
 
 #include "cppdebughelper.h"
 #include "missingincludeitem.h"
+#include "lookaheadindex.h"
 #include "implementationhelperitem.h"
 #include <qtfunctiondeclaration.h>
 #include <templateparameterdeclaration.h>
@@ -439,7 +440,9 @@ CodeCompletionContext( KDevelop::DUContextPointer context, const QString& text,
     m_pointerConversionsBeforeMatching( 0 ),
     m_onlyShow( ShowAll ),
     m_expressionIsTypePrefix( false ),
-    m_doAccessFiltering( DO_ACCESS_FILTERING )
+    m_doAccessFiltering( DO_ACCESS_FILTERING ),
+    m_stageListener( 0 ),
+    m_abort( 0 )
 {
   if ( doIncludeCompletion() )
     return;
@@ -1316,6 +1319,28 @@ QList< KSharedPtr< KDevelop::CompletionTreeElement > > CodeCompletionContext::un
   return m_storedUngroupedItems;
 }
 
+void CodeCompletionContext::setStageListener(StageListener* listener) {
+  m_stageListener = listener;
+}
+
+CodeCompletionContext::Ptr CodeCompletionContext::snapshot() const {
+  CodeCompletionContext* ret = new CodeCompletionContext(*this);
+  ret->m_stageListener = 0;
+  ret->m_abort = 0;
+  ret->m_lookaheadMatchesCache.clear();
+  return Ptr(ret);
+}
+
+bool CodeCompletionContext::isAborted() const {
+  return m_abort && *m_abort;
+}
+
+void CodeCompletionContext::finishPhase(CompletionPhase phase, const QList<CompletionTreeItemPointer>& items) {
+  const qint64 elapsed = m_phaseTimer.restart();
+  if(m_stageListener && !isAborted())
+    m_stageListener->phaseFinished(phase, elapsed, items, this);
+}
+
 QList<CompletionTreeItemPointer> CodeCompletionContext::memberAccessCompletionItems( const bool& shouldAbort )
 {
   QList<CompletionTreeItemPointer> items;
@@ -1724,35 +1749,46 @@ QList<IndexedType> CodeCompletionContext::matchTypes()
 }
 
 QList<DeclAccessPair> CodeCompletionContext::containedDeclarationsForLookahead(Declaration* container, TopDUContext* top,
-                                                                               bool isPointer) const
+                                                                               bool isPointer, const QList<IndexedType>& matchTypes,
+                                                                               const IndexedType& excludedType) const
 {
-  static const IndexedIdentifier arrowOpIdentifier(Identifier("operator->"));
   QList<DeclAccessPair> ret;
   if (!container || !container->internalContext())
     return ret;
 
-  Declaration *arrowOperator = 0;
-  QVector<Declaration*> declarations = container->internalContext()->localDeclarations(top);
-  foreach(Declaration *decl, declarations)
-  {
-    if (decl->isTypeAlias() || decl->isForwardDeclaration() || decl->type<EnumerationType>())
-      continue; //Skip declarations that are not accessed via ./->
-
-    if (!isPointer && decl->indexedIdentifier() == arrowOpIdentifier)
-      arrowOperator = decl;
+  const LookaheadIndex::MembersPointer members = LookaheadIndex::self().members(container, top);
 
-    if (!filterDeclaration(dynamic_cast<ClassMemberDeclaration*>(decl))) {
-      continue;
+  Cpp::TypeConversion conv(top);
+  for (QHash<IndexedType, QVector<IndexedDeclaration> >::const_iterator it = members->byType.constBegin();
+       it != members->byType.constEnd(); ++it)
+  {
+    bool match = false;
+    foreach (const IndexedType& matchType, matchTypes) {
+      //Don't lookahead if the current type is a (precise) match
+      //Cheaper than checking if it converts, and probably good enough
+      if (matchType == excludedType)
+        continue;
+      if (conv.implicitConversion(it.key(), matchType)) {
+        match = true;
+        break;
+      }
     }
+    if (!match)
+      continue;
 
-    if (Cpp::effectiveType(decl)) {
+    foreach (const IndexedDeclaration& member, *it) {
+      Declaration* decl = member.data();
+      if (!decl || !filterDeclaration(dynamic_cast<ClassMemberDeclaration*>(decl)))
+        continue;
       ret << DeclAccessPair(decl, isPointer);
     }
   }
+
   //If we found an "->", try to treat it as a smart pointer
-  if (arrowOperator) {
+  Declaration* arrowOperator = members->arrowOperator.data();
+  if (!isPointer && arrowOperator) {
     ret += containedDeclarationsForLookahead( containerDeclForType(Cpp::effectiveType(arrowOperator), top, isPointer),
-                                              top, true );
+                                              top, true, matchTypes, excludedType );
   }
   return ret;
 }
@@ -1774,33 +1810,7 @@ QList<DeclAccessPair> CodeCompletionContext::getLookaheadMatches(Declaration* fo
     return cacheIt.value();
   }
 
-  /// FIXME: use QVector + std::remove_if
-  ret = containedDeclarationsForLookahead(container, top, typeIsPointer);
-
-  QList<DeclAccessPair>::iterator it = ret.begin();
-  Cpp::TypeConversion conv(top);
-  while (it != ret.end()) {
-    bool match = false;
-    const IndexedType& declEffectiveType = Cpp::effectiveType(it->first)->indexed();
-    Q_ASSERT(declEffectiveType);
-
-    foreach (const IndexedType& matchType, matchTypes) {
-      //Don't lookahead if the current type is a (precise) match
-      //Cheaper than checking if it converts, and probably good enough
-      if (matchType == forDecl->indexedType())
-        continue;
-      if (conv.implicitConversion(declEffectiveType, matchType)) {
-        match = true;
-        break;
-      }
-    }
-
-    if (!match) {
-      it = ret.erase(it);
-    } else {
-      ++it;
-    }
-  }
+  ret = containedDeclarationsForLookahead(container, top, typeIsPointer, matchTypes, forDecl->indexedType());
 
   // Could use hideOverloadedDeclarations theoretically here, but it would do very
   // little since we don't have the real declaration depth
@@ -1850,6 +1860,8 @@ QList<DeclarationDepthPair> CodeCompletionContext::namespaceItems(DUContext* duC
       ids += ownNamespaceScope.left(a);
 
   foreach(const QualifiedIdentifier &id, ids) {
+    if (isAborted())
+      return decls;
     QList<Declaration*> importedContextDecls = duContext->findDeclarations( id );
     foreach(Declaration* contextDecl, importedContextDecls) {
       if(contextDecl->kind() != Declaration::Namespace || !contextDecl->internalContext())
@@ -1870,7 +1882,21 @@ QList<DeclarationDepthPair> CodeCompletionContext::namespaceItems(DUContext* duC
   return decls;
 }
 
-QList< CompletionTreeItemPointer > CodeCompletionContext::standardAccessCompletionItems() {
+QList<DeclarationDepthPair> CodeCompletionContext::localDeclarations() const {
+  QList<DeclarationDepthPair> decls;
+  const CursorInRevision position = m_duContext->type() == DUContext::Class ? m_duContext->range().end : m_position;
+  int depth = 0;
+  //Stop at namespaces, their content can be as large as the global scope
+  for(DUContext* context = m_duContext.data(); context && context->parentContext() && context->type() != DUContext::Namespace;
+      context = context->parentContext(), ++depth)
+  {
+    foreach(const DeclarationDepthPair& decl, context->allDeclarations(position, m_duContext->topContext(), false))
+      decls << qMakePair(decl.first, decl.second + depth);
+  }
+  return decls;
+}
+
+QList< CompletionTreeItemPointer > CodeCompletionContext::standardAccessCompletionItems(bool localOnly, const QList<CompletionTreeItemPointer>& localItems) {
   QList<CompletionTreeItemPointer> items;
   LOCKDUCHAIN; if (!m_duContext) return items;
   //Normal case: Show all visible declarations
@@ -1881,14 +1907,23 @@ QList< CompletionTreeItemPointer > CodeCompletionContext::standardAccessCompleti
     if (func->abstractType() && (func->abstractType()->modifiers() & AbstractType::ConstModifier))
       typeIsConst = true;
   }
-  QList<DeclarationDepthPair> decls = m_duContext->allDeclarations(m_duContext->type() == DUContext::Class ? m_duContext->range().end : m_position, m_duContext->topContext());
-  decls += namespaceItems(m_duContext.data(), m_position, true);
+  QList<DeclarationDepthPair> decls;
+  if(localOnly) {
+    decls = localDeclarations();
+  }else{
+    decls = m_duContext->allDeclarations(m_duContext->type() == DUContext::Class ? m_duContext->range().end : m_position, m_duContext->topContext());
+    if(isAborted())
+      return items;
+    decls += namespaceItems(m_duContext.data(), m_position, true);
+  }
 
   QList<DeclarationDepthPair> oldDecls = decls;
   decls.clear();
   
   //Remove pure function-definitions before doing overload-resolution, so they don't hide their own declarations.
-  foreach( const DeclarationDepthPair& decl, oldDecls )
+  foreach( const DeclarationDepthPair& decl, oldDecls ) {
+    if(isAborted())
+      return items;
     if(!dynamic_cast<FunctionDefinition*>(decl.first) || !static_cast<FunctionDefinition*>(decl.first)->hasDeclaration()) {
       if(decl.first->kind() == Declaration::Namespace) {
         QualifiedIdentifier id = decl.first->qualifiedIdentifier();
@@ -1902,10 +1937,22 @@ QList< CompletionTreeItemPointer > CodeCompletionContext::standardAccessCompleti
         decls << decl;
       }
     }
+  }
     
   decls = Cpp::hideOverloadedDeclarations(decls, typeIsConst);
 
+  QHash<Declaration*, CompletionTreeItemPointer> reusable;
+  foreach( const CompletionTreeItemPointer& item, localItems )
+    reusable.insert(item->declaration().data(), item);
+
   foreach( const DeclarationDepthPair& decl, decls ) {
+    if(isAborted())
+      return items;
+    QHash<Declaration*, CompletionTreeItemPointer>::const_iterator local = reusable.constFind(decl.first);
+    if(local != reusable.constEnd() && (*local)->inheritanceDepth() == decl.second) {
+      items << *local;
+      continue;
+    }
     NormalDeclarationCompletionItem* item = new NormalDeclarationCompletionItem(DeclarationPointer(decl.first), KDevelop::CodeCompletionContext::Ptr(this), decl.second );
 
     if( m_onlyShow == ShowIntegralConstants && !isIntegralConstant(decl.first, false) )
@@ -1993,11 +2040,15 @@ QList<CompletionTreeItemPointer> CodeCompletionContext::completionItems(bool& sh
     if(!m_valid)
       return items;
 
+    PushValue<const bool*> abort(m_abort, &shouldAbort);
+    m_phaseTimer.start();
+
     // Call parent context before adding our items because if parent is CaseAccess, this call
     // will make it compute its expression type (which we need in standardAccessCompletionItems())
     if(shouldAddParentItems(fullCompletion))
       items = parentContext()->completionItems( shouldAbort, fullCompletion );
 
+    bool standardAccess = false;
     switch(m_accessType) {
       case MemberAccess:
       case ArrowMemberAccess:
@@ -2033,15 +2084,24 @@ QList<CompletionTreeItemPointer> CodeCompletionContext::completionItems(bool& sh
       default:
         if(depth() == 0 && (m_onlyShow == ShowAll || m_onlyShow == ShowTypes || m_onlyShow == ShowIntegralConstants))
         {
-          items += standardAccessCompletionItems();
-#ifndef TEST_COMPLETION
-          eventuallyAddGroup(i18n("Not Included"), 700, missingIncludeCompletionItems(m_followingText + ':', {}, {}, m_duContext));
-#endif
-          addCPPBuiltin();
+          standardAccess = true;
+          QList<CompletionTreeItemPointer> localItems;
+          if(m_stageListener) {
+            //The declarations of the surrounding contexts are cheap to compute, so they can be shown while the global ones are collected
+            localItems = standardAccessCompletionItems(true);
+            finishPhase(LocalItemsPhase, items + localItems);
+          }
+          if(shouldAbort)
+            return items;
+          items += standardAccessCompletionItems(false, localItems);
         }
         break;
     }
 
+    if(shouldAbort)
+      return items;
+    finishPhase(standardAccess ? GlobalItemsPhase : MemberItemsPhase, items);
+
     LOCKDUCHAIN; if (!m_duContext) return items;
     if (m_accessType == MemberAccess ||
         m_accessType == ArrowMemberAccess ||
@@ -2049,6 +2109,22 @@ QList<CompletionTreeItemPointer> CodeCompletionContext::completionItems(bool& sh
         m_accessType == NoMemberAccess)
       addLookaheadMatches(items);
 
+    if(shouldAbort)
+      return items;
+    finishPhase(LookaheadPhase, items);
+
+    if(standardAccess) {
+#ifndef TEST_COMPLETION
+      lock.unlock();
+      eventuallyAddGroup(i18n("Not Included"), 700, missingIncludeCompletionItems(m_followingText + ':', {}, {}, m_duContext));
+      lock.lock();
+      if(!m_duContext || shouldAbort)
+        return items;
+#endif
+      finishPhase(MissingIncludePhase, items);
+      addCPPBuiltin();
+    }
+
     if (parentContext()) {
       foreach(const IndexedType &matchType, parentContext()->matchTypes()) {
         addSpecialItemsForArgumentType(matchType.abstractType());
@@ -2063,6 +2139,8 @@ QList<CompletionTreeItemPointer> CodeCompletionContext::completionItems(bool& sh
         addImplementationHelpers();
     }
 
+    finishPhase(HelperItemsPhase, items);
+
     return items;
 }
 
@@ -2077,6 +2155,8 @@ void CodeCompletionContext::addLookaheadMatches(const QList<CompletionTreeItemPo
 
   QList<CompletionTreeItemPointer> lookaheadMatches;
   foreach( const CompletionTreeItemPointer &item, items ) {
+    if (isAborted())
+      break;
     Declaration* decl = item->declaration().data();
     if (!decl)
       continue;
@@ -2118,6 +2198,8 @@ QList<CompletionTreeItemPointer> CodeCompletionContext::getImplementationHelpers
 QList<CompletionTreeItemPointer> CodeCompletionContext::getImplementationHelpersInternal(const QualifiedIdentifier& minimumScope, DUContext* context)
 {
   QList<CompletionTreeItemPointer> ret;
+  if (isAborted())
+    return ret;
 
   foreach(Declaration* decl, context->localDeclarations()) {
     if (decl->range().isEmpty() || decl->isDefinition() || FunctionDefinition::definition(decl)) {
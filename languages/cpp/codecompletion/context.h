@@ -19,6 +19,7 @@
 #ifndef CODECOMPLETIONCONTEXT_H
 #define CODECOMPLETIONCONTEXT_H
 
+#include <QElapsedTimer>
 #include <ksharedptr.h>
 #include <language/duchain/duchainpointer.h>
 #include "../cppduchain/typeconversion.h"
@@ -66,6 +67,36 @@ namespace Cpp {
 
       typedef KSharedPtr<CodeCompletionContext> Ptr;
 
+      ///The phases of completionItems(), in the order they are computed
+      enum CompletionPhase {
+        MemberItemsPhase,   /// Items of member-access, argument-hint, include and other special completions
+        LocalItemsPhase,    /// Declarations of the surrounding function- and class-contexts
+        GlobalItemsPhase,   /// All visible declarations, including those of the global scope
+        LookaheadPhase,
+        MissingIncludePhase,
+        HelperItemsPhase,   /// Builtin, overridable and implementation-helper items
+        PhaseCount
+      };
+
+      ///Is notified whenever a phase of completionItems() has finished, so the results can be shown in stages
+      class StageListener {
+        public:
+          virtual ~StageListener() {
+          }
+          ///@param items All items computed so far. The groups computed so far are available through ungroupedElements().
+          ///@param elapsedMilliseconds The time spent in this phase
+          ///The DUChain may be locked when this is called.
+          virtual void phaseFinished(CompletionPhase phase, qint64 elapsedMilliseconds,
+                                     const QList<CompletionTreeItemPointer>& items, CodeCompletionContext* context) = 0;
+      };
+
+      ///The listener is only notified about the phases of this context, not of its parent-contexts
+      void setStageListener(StageListener* listener);
+
+      ///A copy of this context that can be shown while completionItems() continues on this one.
+      ///It is not notified about phases, and its groups are the ones computed so far.
+      Ptr snapshot() const;
+
       typedef OverloadResolutionFunction Function;
 
       typedef QList<Function> FunctionList;
@@ -248,7 +279,13 @@ namespace Cpp {
       QList<CompletionTreeItemPointer> includeListAccessCompletionItems(const bool& shouldAbort);
       QList<CompletionTreeItemPointer> signalSlotAccessCompletionItems();
       ///Computes the completion-items for the case that no special kind of access is used(just a list of all suitable items is needed)
-      QList<CompletionTreeItemPointer> standardAccessCompletionItems();
+      ///@param localOnly Whether only the declarations of the surrounding function- and class-contexts should be listed
+      ///If @p localOnly is true, only the declarations of the surrounding function and class contexts are returned.
+      ///Otherwise, the items in @p localItems are re-used for the local declarations that are still visible.
+      QList<CompletionTreeItemPointer> standardAccessCompletionItems(bool localOnly = false,
+                                                                     const QList<CompletionTreeItemPointer>& localItems = QList<CompletionTreeItemPointer>());
+      ///*DUChain must be locked*
+      QList<DeclarationDepthPair> localDeclarations() const;
       QList<CompletionTreeItemPointer> getImplementationHelpers();
       QList<CompletionTreeItemPointer> getImplementationHelpersInternal(const QualifiedIdentifier& minimumScope, DUContext* context);
 
@@ -256,11 +293,13 @@ namespace Cpp {
       ///@returns the list of matching declarations and whether or not you need the arrow operator (->) to access them
       QList<DeclAccessPair> getLookaheadMatches(Declaration* forDecl, const QList<IndexedType>& matchTypes) const;
       void addLookaheadMatches(const QList<CompletionTreeItemPointer> items);
-      ///For a given @param container, find members which may potentially be used for lookahead matching
+      ///For a given @param container, find members whose type converts to one of @param matchTypes, using the LookaheadIndex
       ///@param isPointer specifies whether the container should be accessed with operator->
+      ///@param excludedType Match-type that is skipped, because it is the type of the container-instance itself
       ///@returns a list of declarations paired with whether or not they use "operator->"
       ///Note that a non-pointer container may declare an operator-> (ie, smart pointer)
-      QList<DeclAccessPair> containedDeclarationsForLookahead(Declaration* decl, TopDUContext* top, bool isPointer) const;
+      QList<DeclAccessPair> containedDeclarationsForLookahead(Declaration* decl, TopDUContext* top, bool isPointer,
+                                                              const QList<IndexedType>& matchTypes, const IndexedType& excludedType) const;
 
       ///*DUChain must be locked*
       bool  filterDeclaration(Declaration* decl, DUContext* declarationContext = 0, bool dynamic = true) const;
@@ -271,6 +310,11 @@ namespace Cpp {
       /// The actual replacement is delayed into the foreground thread.
       void replaceCurrentAccess(const QString& oldAccess, const QString& newAccess);
 
+      ///Whether the computation of the completion-items has been aborted
+      bool isAborted() const;
+      ///Reports the end of @p phase to the stage-listener, and starts timing the next one
+      void finishPhase(CompletionPhase phase, const QList<CompletionTreeItemPointer>& items);
+
       ///Creates the group and adds it to m_storedUngroupedItems if items is not empty
       void eventuallyAddGroup(QString name, int priority, QList< KSharedPtr< KDevelop::CompletionTreeItem > > items);
       
@@ -354,6 +398,11 @@ namespace Cpp {
       /// with the same type accessible from the current scope
       mutable QHash<Declaration*, QList<DeclAccessPair> > m_lookaheadMatchesCache;
 
+      StageListener* m_stageListener;
+      QElapsedTimer m_phaseTimer;
+      ///The abort-flag given to completionItems(), while it is running
+      const bool* m_abort;
+
       friend class ImplementationHelperItem;
   };
 }
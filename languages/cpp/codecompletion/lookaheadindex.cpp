@@ -0,0 +1,109 @@
+/*
+ * KDevelop C++ Code Completion Support
+ *
+ * Copyright 2014 KDevelop developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "lookaheadindex.h"
+
+#include <language/duchain/declaration.h>
+#include <language/duchain/ducontext.h>
+#include <language/duchain/topducontext.h>
+#include <language/duchain/types/enumerationtype.h>
+
+#include "../cppduchain/typeconversion.h"
+#include "helpers.h"
+
+using namespace KDevelop;
+
+namespace Cpp {
+
+LookaheadIndex& LookaheadIndex::self()
+{
+  static LookaheadIndex index;
+  return index;
+}
+
+LookaheadIndex::LookaheadIndex()
+{
+}
+
+LookaheadIndex::MembersPointer LookaheadIndex::build(Declaration* container, const TopDUContext* top)
+{
+  static const IndexedIdentifier arrowOpIdentifier(Identifier("operator->"));
+
+  QSharedPointer<Members> ret(new Members);
+  foreach(Declaration* decl, container->internalContext()->localDeclarations(top)) {
+    if (decl->isTypeAlias() || decl->isForwardDeclaration() || decl->type<EnumerationType>())
+      continue; //Skip declarations that are not accessed via ./->
+
+    if (decl->indexedIdentifier() == arrowOpIdentifier)
+      ret->arrowOperator = IndexedDeclaration(decl);
+
+    AbstractType::Ptr type = Cpp::effectiveType(decl);
+    if (type)
+      ret->byType[type->indexed()].append(IndexedDeclaration(decl));
+  }
+  return ret;
+}
+
+LookaheadIndex::MembersPointer LookaheadIndex::members(Declaration* container, const TopDUContext* top)
+{
+  const Key key(IndexedDeclaration(container), top ? top->ownIndex() : 0);
+  const uint generation = TypeConversionCache::self().generation();
+  {
+    QMutexLocker lock(&m_mutex);
+    QHash<Key, Entry>::const_iterator it = m_entries.constFind(key);
+    if (it != m_entries.constEnd() && it->generation == generation) {
+      ++m_statistics.hits;
+      return it->members;
+    }
+  }
+
+  //Built without holding the lock, concurrent builds of the same class produce the same result
+  Entry entry;
+  entry.members = build(container, top);
+  entry.generation = generation;
+
+  QMutexLocker lock(&m_mutex);
+  ++m_statistics.builds;
+  if (!m_entries.contains(key) && m_entries.size() >= MaxEntries) {
+    //Completion usually asks for the members of the same few classes, a dropped one is built again on its next use
+    m_entries.erase(m_entries.begin());
+    ++m_statistics.evictions;
+  }
+  m_entries.insert(key, entry);
+  return entry.members;
+}
+
+void LookaheadIndex::clear()
+{
+  QMutexLocker lock(&m_mutex);
+  m_entries.clear();
+  m_statistics = Statistics();
+}
+
+LookaheadIndex::Statistics LookaheadIndex::statistics() const
+{
+  QMutexLocker lock(&m_mutex);
+  Statistics ret = m_statistics;
+  ret.entries = m_entries.size();
+  return ret;
+}
+
+}
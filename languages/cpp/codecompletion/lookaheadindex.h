@@ -0,0 +1,102 @@
+/*
+ * KDevelop C++ Code Completion Support
+ *
+ * Copyright 2014 KDevelop developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef LOOKAHEADINDEX_H
+#define LOOKAHEADINDEX_H
+
+#include <QHash>
+#include <QMutex>
+#include <QPair>
+#include <QSharedPointer>
+#include <QVector>
+
+#include <language/duchain/indexeddeclaration.h>
+#include <language/duchain/types/indexedtype.h>
+
+namespace KDevelop {
+  class Declaration;
+  class TopDUContext;
+}
+
+namespace Cpp {
+
+/**
+ * Indexes the members of classes by their effective type, so lookahead-completion only has to check
+ * each distinct member type for a match, instead of scanning every member of every visible class.
+ *
+ * The index of a class is built the first time it is needed from a top-context, because the visible
+ * members depend on it, and re-used by all following completions in that top-context until the
+ * TypeConversionCache generation changes, which happens whenever an existing top-context is updated.
+ *
+ * All functions are thread-safe. The DUChain must be read-locked.
+ * */
+class LookaheadIndex
+{
+  public:
+    enum {
+      MaxEntries = 4096
+    };
+
+    struct Members {
+      ///The members that can be accessed with "." or "->", by their effective type
+      QHash<KDevelop::IndexedType, QVector<KDevelop::IndexedDeclaration> > byType;
+      ///The "operator->" of the class, if it has one
+      KDevelop::IndexedDeclaration arrowOperator;
+    };
+    typedef QSharedPointer<const Members> MembersPointer;
+
+    struct Statistics {
+      Statistics() : hits(0), builds(0), evictions(0), entries(0) {
+      }
+      uint hits;
+      uint builds;
+      uint evictions;
+      uint entries;
+    };
+
+    static LookaheadIndex& self();
+
+    ///Returns the index of the members of @p container as seen from @p top. The container must have an internal context.
+    MembersPointer members(KDevelop::Declaration* container, const KDevelop::TopDUContext* top);
+
+    void clear();
+
+    Statistics statistics() const;
+
+  private:
+    LookaheadIndex();
+    static MembersPointer build(KDevelop::Declaration* container, const KDevelop::TopDUContext* top);
+
+    ///The container, and the index of the top-context the members were built for
+    typedef QPair<KDevelop::IndexedDeclaration, uint> Key;
+    struct Entry {
+      MembersPointer members;
+      uint generation;
+    };
+
+    mutable QMutex m_mutex;
+    QHash<Key, Entry> m_entries;
+    Statistics m_statistics;
+};
+
+}
+
+#endif // LOOKAHEADINDEX_H
@@ -36,6 +36,7 @@
 #include "../cppduchain/typeutils.h"
 #include "../cppduchain/templateparameterdeclaration.h"
 #include "../cppduchain/expressionevaluationresult.h"
+#include "../cppduchain/includesymbolindex.h"
 
 #include "../cpputils.h"
 
@@ -150,7 +151,10 @@ QList<KDevelop::CompletionTreeItemPointer> itemsForFile(const QString& displayTe
   if(isSource(file))
     return ret;
 
-  const Path canonicalFile(QFileInfo(file).canonicalFilePath());
+  QString canonicalPath = IncludeSymbolIndex::self().canonicalPath(IndexedString(file));
+  if(canonicalPath.isEmpty())
+    canonicalPath = QFileInfo(file).canonicalFilePath();
+  const Path canonicalFile(canonicalPath);
 
   foreach(const Path& includePath, includePaths) {
     QString relative = includePath.relativePath( canonicalFile );
@@ -192,11 +196,11 @@ QStringList candidateIncludeFiles(Declaration* decl) {
 
   bool inBlacklistDir = isBlacklistedInclude(decl->url().toUrl());
   
-  foreach(KDevelop::ParsingEnvironmentFilePointer ptr, decl->topContext()->parsingEnvironmentFile()->importers()) {
-    if(ptr->imports().count() == 1 || inBlacklistDir) {
+  if(inBlacklistDir) {
+    //Any empty file that includes this one may serve as forwarder, even if it includes other files as well
+    foreach(KDevelop::ParsingEnvironmentFilePointer ptr, decl->topContext()->parsingEnvironmentFile()->importers()) {
       if(isBlacklistedInclude(ptr->url().toUrl()))
         continue;
-      //This file is a forwader, add it to the list
 
       //Forwarders must be completely empty
       if(ptr->topContext()->localDeclarations().count())
@@ -205,6 +209,18 @@ QStringList candidateIncludeFiles(Declaration* decl) {
       QString file(ptr->url().toUrl().toLocalFile());
       ret << file;
     }
+  }else{
+    //Files that only include this one are forwarders, like "QString" for "qstring.h"
+    foreach(const IndexedString& forwarder, IncludeSymbolIndex::self().forwarders(decl->url())) {
+      if(isBlacklistedInclude(forwarder.toUrl()))
+        continue;
+      //The index is only updated when files are parsed, so it may still contain deleted files
+      if(!QFileInfo(forwarder.str()).exists()) {
+        IncludeSymbolIndex::self().remove(forwarder);
+        continue;
+      }
+      ret << forwarder.toUrl().toLocalFile();
+    }
   }
   
   if(!inBlacklistDir)
@@ -213,6 +229,40 @@ QStringList candidateIncludeFiles(Declaration* decl) {
   return ret;
 }
 
+/**
+ * Try to find include candidates in the IncludeSymbolIndex, based solely on the string of the unknown id @p id
+ *
+ * Example: We have 'QState' in our source file, it is unknown
+ * This method then returns all indexed files named 'QState', or declaring 'QState' in the global scope,
+ * that are not yet imported by @p source
+ *
+ * @note DUChain must be locked
+ */
+QStringList candidateIncludeFilesFromIndex(const TopDUContext* source, const QualifiedIdentifier& id)
+{
+  QStringList result;
+  QSet<IndexedString> files = IncludeSymbolIndex::self().files(IndexedString(id.toString())).toSet();
+  if(id.count() == 1)
+    files += IncludeSymbolIndex::self().files(id.last().identifier()).toSet();
+
+  foreach (const IndexedString& file, files) {
+    if (isBlacklistedInclude(file.toUrl()))
+      continue;
+    // the index is only updated when files are parsed, so it may still contain deleted files
+    if (!QFileInfo(file.str()).exists()) {
+      IncludeSymbolIndex::self().remove(file);
+      continue;
+    }
+    TopDUContext* top = DUChainUtils::standardContextForUrl(file.toUrl());
+    // if this file was already parsed, and we don't find a declaration for id => discard
+    if (top && (top->findDeclarations(id).isEmpty() || source->imports(top, CursorInRevision::invalid()))) {
+      continue;
+    }
+    result << file.toUrl().toLocalFile();
+  }
+  return result;
+}
+
 /**
  * Try to find include candidates based solely on the string of the unknown id @p id
  *
@@ -397,6 +447,13 @@ QList<KDevelop::CompletionTreeItemPointer> missingIncludeCompletionItems(const Q
     }
   }
 
+  auto candidateFiles = candidateIncludeFilesFromIndex(context->topContext(), identifier);
+  kDebug() << "candidates from the include symbol index:" << candidateFiles;
+  for (const QString& file : candidateFiles) {
+    ret += itemsForFile(displayTextPrefix, file, includePaths, currentPath, IndexedDeclaration(), argumentHintDepth, directives);
+  }
+  const QSet<QString> indexedCandidates = candidateFiles.toSet();
+
   lock.unlock();
   // NOTE: this will acquire the foreground lock and thus we must not hold the duchain lock here
   const QList<IncludeItem> includeItems = CppUtils::allFilesInIncludePath(currentUrl.toLocalFile(), false, QString());
@@ -405,9 +462,12 @@ QList<KDevelop::CompletionTreeItemPointer> missingIncludeCompletionItems(const Q
   if (!context)
     return ret;
 
-  auto candidateFiles = candidateIncludeFilesFromNameMatcher(includeItems, identifier);
+  // files that were never parsed are missing from the index
+  candidateFiles = candidateIncludeFilesFromNameMatcher(includeItems, identifier);
   kDebug() << "candidates from name matching:" << candidateFiles;
   for (const QString& file : candidateFiles) {
+    if (indexedCandidates.contains(file))
+      continue;
     ret += itemsForFile(displayTextPrefix, file, includePaths, currentPath, IndexedDeclaration(), argumentHintDepth, directives);
   }
 
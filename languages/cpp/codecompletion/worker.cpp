@@ -24,6 +24,8 @@
 
 #include "context.h"
 
+#include <QMutex>
+
 #include <kdebug.h>
 
 #include <language/duchain/duchain.h>
@@ -33,15 +35,67 @@
 
 using namespace KDevelop;
 
+namespace {
+QMutex statisticsMutex;
+Cpp::CodeCompletionWorker::Statistics globalStatistics;
+}
+
 namespace Cpp {
 
 CodeCompletionWorker::CodeCompletionWorker(CodeCompletionModel* model)
   : KDevelop::CodeCompletionWorker(model)
+  , m_firstItemsTime(-1)
 {
+  for(int a = 0; a < CodeCompletionContext::PhaseCount; ++a)
+    m_phaseTimes[a] = -1;
 }
 KDevelop::CodeCompletionContext* CodeCompletionWorker::createCompletionContext(KDevelop::DUContextPointer context, const QString &contextText, const QString &followingText, const KDevelop::CursorInRevision& position) const
 {
-  return new Cpp::CodeCompletionContext( context, contextText, followingText, position );
+  Cpp::CodeCompletionContext* ret = new Cpp::CodeCompletionContext( context, contextText, followingText, position );
+  //The context is only used within computeCompletions(), where the worker receives its stages
+  ret->setStageListener(const_cast<CodeCompletionWorker*>(this));
+  return ret;
+}
+
+CodeCompletionWorker::Statistics CodeCompletionWorker::statistics()
+{
+  QMutexLocker lock(&statisticsMutex);
+  return globalStatistics;
+}
+
+void CodeCompletionWorker::phaseFinished(CodeCompletionContext::CompletionPhase phase, qint64 elapsedMilliseconds,
+                                         const QList<CompletionTreeItemPointer>& items, CodeCompletionContext* context)
+{
+  m_phaseTimes[phase] = elapsedMilliseconds;
+
+  //The last phases are cheap, their results are published together with the final list
+  if(phase > CodeCompletionContext::LookaheadPhase || items.isEmpty() || aborting())
+    return;
+
+  if(m_firstItemsTime == -1)
+    m_firstItemsTime = m_completionTimer.elapsed();
+
+  {
+    //The published items compute their match-quality from the parent-context in the foreground thread,
+    //so its match-types are cached now instead of by a later phase while they are shown
+    DUChainReadLocker lock(DUChain::lock());
+    if(context->parentContext())
+      context->parentContext()->matchTypes();
+  }
+
+  //completionItems() continues on the context, so the foreground gets a copy that is not changed anymore
+  KDevelop::CodeCompletionContext::Ptr contextPtr(context->snapshot().data());
+  QList<KSharedPtr<CompletionTreeElement> > tree = computeGroups(items, contextPtr);
+  if(aborting())
+    return;
+  tree += contextPtr->ungroupedElements();
+
+  {
+    QMutexLocker lock(&statisticsMutex);
+    ++globalStatistics.publishedStages;
+  }
+
+  emit foundDeclarations(tree, contextPtr);
 }
 
 void CodeCompletionWorker::updateContextRange(KTextEditor::Range& contextRange, KTextEditor::View*, DUContextPointer context) const
@@ -75,7 +129,32 @@ void CodeCompletionWorker::computeCompletions(KDevelop::DUContextPointer context
   
   Cpp::TypeConversionCacheEnabler enableConversionCache;
 
+  m_completionTimer.start();
+  m_firstItemsTime = -1;
+  for(int a = 0; a < CodeCompletionContext::PhaseCount; ++a)
+    m_phaseTimes[a] = -1;
+
   KDevelop::CodeCompletionWorker::computeCompletions(context, position, followingText, contextRange, contextText);
+
+  if(aborting())
+    return;
+
+  const qint64 total = m_completionTimer.elapsed();
+  if(m_firstItemsTime == -1)
+    m_firstItemsTime = total;
+
+  QMutexLocker lock(&statisticsMutex);
+  ++globalStatistics.completions;
+  globalStatistics.firstItemsTotalMilliseconds += m_firstItemsTime;
+  globalStatistics.firstItemsMaxMilliseconds = qMax(globalStatistics.firstItemsMaxMilliseconds, m_firstItemsTime);
+  for(int a = 0; a < CodeCompletionContext::PhaseCount; ++a) {
+    if(m_phaseTimes[a] == -1)
+      continue;
+    PhaseStatistics& phase(globalStatistics.phases[a]);
+    ++phase.runs;
+    phase.totalMilliseconds += m_phaseTimes[a];
+    phase.maxMilliseconds = qMax(phase.maxMilliseconds, m_phaseTimes[a]);
+  }
 }
 
 }
@@ -23,13 +23,20 @@
 #ifndef KDEVCPPCODECOMPLETIONWORKER_H
 #define KDEVCPPCODECOMPLETIONWORKER_H
 
+#include <QElapsedTimer>
+
 #include <language/codecompletion/codecompletionworker.h>
 
 #include "model.h"
+#include "context.h"
 
 namespace Cpp {
 
-class CodeCompletionWorker : public KDevelop::CodeCompletionWorker
+/**
+ * Computes the completion-items in the background. The items are shown in stages while they are computed:
+ * the local or member items first, then all visible items, then the lookahead-matches.
+ * */
+class CodeCompletionWorker : public KDevelop::CodeCompletionWorker, public CodeCompletionContext::StageListener
 {
   Q_OBJECT
 
@@ -38,10 +45,42 @@ class CodeCompletionWorker : public KDevelop::CodeCompletionWorker
     
     CodeCompletionModel* model() const;
 
+    struct PhaseStatistics {
+      PhaseStatistics() : runs(0), totalMilliseconds(0), maxMilliseconds(0) {
+      }
+      uint runs;
+      qint64 totalMilliseconds;
+      qint64 maxMilliseconds;
+    };
+
+    struct Statistics {
+      Statistics() : completions(0), publishedStages(0), firstItemsTotalMilliseconds(0), firstItemsMaxMilliseconds(0) {
+      }
+      uint completions;
+      ///Intermediate item-lists that were shown before a completion was finished
+      uint publishedStages;
+      ///Time from the start of a completion until its first items were available
+      qint64 firstItemsTotalMilliseconds;
+      qint64 firstItemsMaxMilliseconds;
+      PhaseStatistics phases[CodeCompletionContext::PhaseCount];
+    };
+
+    ///Statistics of all completions computed by all workers
+    static Statistics statistics();
+
+    virtual void phaseFinished(CodeCompletionContext::CompletionPhase phase, qint64 elapsedMilliseconds,
+                               const QList<KDevelop::CompletionTreeItemPointer>& items, CodeCompletionContext* context);
+
   protected:
     virtual void computeCompletions(KDevelop::DUContextPointer context, const KTextEditor::Cursor& position, QString followingText, const KTextEditor::Range& _contextRange, const QString& _contextText);
     virtual KDevelop::CodeCompletionContext* createCompletionContext(KDevelop::DUContextPointer context, const QString &contextText, const QString &followingText, const KDevelop::CursorInRevision &position) const;
     virtual void updateContextRange(KTextEditor::Range& contextRange, KTextEditor::View* view, KDevelop::DUContextPointer context) const;
+
+  private:
+    QElapsedTimer m_completionTimer;
+    ///Time until the first items of the current completion were available, or -1
+    qint64 m_firstItemsTime;
+    qint64 m_phaseTimes[CodeCompletionContext::PhaseCount];
 };
 
 }
@@ -24,7 +24,7 @@
 
 void ChangeImplementor::replaceToken(std::size_t token, int newToken)
 {
-  const Token& t = m_session->token_stream->token( token );
+  const Token t = m_session->token_stream->token( token );
   rpp::Anchor a = m_session->positionAt( token );
   KDevelop::RangeInRevision tokenRange(a, t.size);
 
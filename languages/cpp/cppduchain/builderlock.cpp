@@ -0,0 +1,239 @@
+/*
+ * This file is part of KDevelop
+ *
+ * Copyright 2014 KDevelop developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "builderlock.h"
+
+#include <QtCore/QMutex>
+#include <QtCore/QThreadStorage>
+
+#include <language/duchain/duchain.h>
+
+using namespace KDevelop;
+
+namespace Cpp {
+
+namespace {
+bool enabled = true;
+
+QMutex statisticsMutex;
+BuilderLock::Statistics globalStatistics;
+
+struct CurrentBatch {
+  CurrentBatch() : batch(0) {
+  }
+  BuilderLock* batch;
+};
+
+QThreadStorage<CurrentBatch*> currentBatch;
+
+CurrentBatch& currentBatchLocal()
+{
+  if(!currentBatch.localData())
+    currentBatch.setLocalData(new CurrentBatch());
+  return *currentBatch.localData();
+}
+
+quint64 nanoseconds(const QElapsedTimer& timer)
+{
+#if QT_VERSION >= 0x040800
+  return timer.nsecsElapsed();
+#else
+  return timer.elapsed() * 1000000;
+#endif
+}
+}
+
+BuilderLock::Statistics BuilderLock::statistics()
+{
+  QMutexLocker lock(&statisticsMutex);
+  return globalStatistics;
+}
+
+void BuilderLock::resetStatistics()
+{
+  QMutexLocker lock(&statisticsMutex);
+  globalStatistics = Statistics();
+}
+
+void BuilderLock::setEnabled(bool enable)
+{
+  enabled = enable;
+}
+
+bool BuilderLock::isEnabled()
+{
+  return enabled;
+}
+
+BuilderLock* BuilderLock::current()
+{
+  return currentBatchLocal().batch;
+}
+
+BuilderLock::BuilderLock()
+  : m_active(false)
+  , m_holdsLock(false)
+  , m_writeSections(0)
+  , m_nodes(0)
+{
+  CurrentBatch& current = currentBatchLocal();
+  if(!enabled || current.batch || DUChain::lock()->currentThreadHasReadLock() || DUChain::lock()->currentThreadHasWriteLock())
+    return;
+
+  m_active = true;
+  current.batch = this;
+  QMutexLocker lock(&statisticsMutex);
+  ++globalStatistics.batches;
+}
+
+BuilderLock::~BuilderLock()
+{
+  if(!m_active)
+    return;
+
+  Q_ASSERT(m_writeSections == 0);
+  if(m_holdsLock)
+    release();
+  currentBatchLocal().batch = 0;
+}
+
+void BuilderLock::yield()
+{
+  if(!m_holdsLock || m_writeSections)
+    return;
+
+  //Reading the clock for every node would cost more than the locking saves
+  if(++m_nodes < NodesPerCheck)
+    return;
+  m_nodes = 0;
+
+  if(m_held.elapsed() >= MaxHoldTime)
+    release();
+}
+
+bool BuilderLock::isActive() const
+{
+  return m_active;
+}
+
+bool BuilderLock::holdsLock() const
+{
+  return m_holdsLock;
+}
+
+void BuilderLock::beginWrite()
+{
+  if(!m_holdsLock)
+    acquire();
+  ++m_writeSections;
+}
+
+void BuilderLock::endWrite()
+{
+  Q_ASSERT(m_writeSections > 0);
+  --m_writeSections;
+}
+
+void BuilderLock::beginRead()
+{
+  if(m_holdsLock && !m_writeSections)
+    release();
+}
+
+void BuilderLock::acquire()
+{
+  QElapsedTimer waited;
+  waited.start();
+  DUChain::lock()->lockForWrite();
+  m_held.start();
+  m_holdsLock = true;
+  m_nodes = 0;
+
+  QMutexLocker lock(&statisticsMutex);
+  ++globalStatistics.acquisitions;
+  globalStatistics.waitedNanoseconds += nanoseconds(waited);
+}
+
+void BuilderLock::release()
+{
+  const quint64 held = nanoseconds(m_held);
+  DUChain::lock()->releaseWriteLock();
+  m_holdsLock = false;
+
+  QMutexLocker lock(&statisticsMutex);
+  globalStatistics.heldNanoseconds += held;
+  globalStatistics.maxHeldNanoseconds = qMax(globalStatistics.maxHeldNanoseconds, held);
+}
+
+BuilderWriteLocker::BuilderWriteLocker()
+  : m_batch(BuilderLock::current())
+  , m_locked(false)
+{
+  lock();
+}
+
+BuilderWriteLocker::~BuilderWriteLocker()
+{
+  unlock();
+}
+
+void BuilderWriteLocker::lock()
+{
+  if(m_locked)
+    return;
+
+  if(m_batch)
+    m_batch->beginWrite();
+  else
+    DUChain::lock()->lockForWrite();
+  m_locked = true;
+}
+
+void BuilderWriteLocker::unlock()
+{
+  if(!m_locked)
+    return;
+
+  if(m_batch)
+    m_batch->endWrite();
+  else
+    DUChain::lock()->releaseWriteLock();
+  m_locked = false;
+}
+
+bool BuilderWriteLocker::locked() const
+{
+  return m_locked;
+}
+
+BuilderLockRelease::BuilderLockRelease()
+{
+  if(BuilderLock* batch = BuilderLock::current())
+    batch->beginRead();
+}
+
+BuilderReadLocker::BuilderReadLocker()
+  : BuilderLockRelease()
+  , DUChainReadLocker(DUChain::lock())
+{
+}
+
+}
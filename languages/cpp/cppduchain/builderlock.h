@@ -0,0 +1,149 @@
+/*
+ * This file is part of KDevelop
+ *
+ * Copyright 2014 KDevelop developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef CPP_BUILDERLOCK_H
+#define CPP_BUILDERLOCK_H
+
+#include <QtCore/QElapsedTimer>
+
+#include <language/duchain/duchainlock.h>
+
+#include "cppduchainexport.h"
+
+namespace Cpp {
+
+/**
+ * Batches the du-chain write-lock over the locked sections of a builder while it walks the AST of a top-context.
+ *
+ * The write-lock taken by a BuilderWriteLocker is kept after the section ends, so consecutive write-sections
+ * take the global lock only once. It is released as soon as a lookup starts in a BuilderReadLocker, so
+ * lookups and expression evaluation run under a shared read-lock like without batches, and other parse-threads
+ * can do their lookups in parallel. While the AST is walked, yield() releases the lock once it was held for
+ * MaxHoldTime milliseconds, so readers like the highlighting or code-completion wait at most about that long.
+ *
+ * The batch is registered for the current thread while it exists, the lockers find it through current().
+ * */
+class KDEVCPPDUCHAIN_EXPORT BuilderLock
+{
+public:
+  enum {
+    ///Maximum time in milliseconds the write-lock is kept between two write-sections
+    MaxHoldTime = 5,
+    ///Number of yield() calls between two checks of the time the lock was held
+    NodesPerCheck = 32
+  };
+
+  struct Statistics {
+    Statistics() : batches(0), acquisitions(0), heldNanoseconds(0), maxHeldNanoseconds(0), waitedNanoseconds(0) {
+    }
+    quint64 batches;
+    ///Acquisitions of the write-lock by batches
+    quint64 acquisitions;
+    quint64 heldNanoseconds;
+    ///Longest time a batch held the lock at once
+    quint64 maxHeldNanoseconds;
+    ///Time spent waiting for the write-lock
+    quint64 waitedNanoseconds;
+  };
+
+  static Statistics statistics();
+  static void resetStatistics();
+
+  ///While disabled, the builders lock at the granularity of their locked sections
+  static void setEnabled(bool enabled);
+  static bool isEnabled();
+
+  ///The batch of the current thread, or zero
+  static BuilderLock* current();
+
+  ///Starts a batch for the current thread. Does nothing if batches are disabled, the current thread
+  ///already has a batch, or it holds a du-chain lock.
+  BuilderLock();
+  ///Ends the batch, and releases the write-lock if it is held
+  ~BuilderLock();
+
+  ///To be called for every visited node. Releases the write-lock if no write-section is open,
+  ///and it was held for MaxHoldTime milliseconds.
+  void yield();
+
+  ///Whether this batch is registered for the current thread
+  bool isActive() const;
+  ///Whether this batch currently holds the write-lock
+  bool holdsLock() const;
+
+private:
+  Q_DISABLE_COPY(BuilderLock)
+  friend class BuilderWriteLocker;
+  friend class BuilderLockRelease;
+  void beginWrite();
+  void endWrite();
+  ///Releases the write-lock before a lookup, if no write-section is open
+  void beginRead();
+  void acquire();
+  void release();
+
+  QElapsedTimer m_held;
+  bool m_active;
+  bool m_holdsLock;
+  int m_writeSections;
+  int m_nodes;
+};
+
+/**
+ * Locks the du-chain for writing like DUChainWriteLocker. Within a batch of the current thread,
+ * the write-lock is kept by the batch when the section ends.
+ * */
+class KDEVCPPDUCHAIN_EXPORT BuilderWriteLocker
+{
+public:
+  BuilderWriteLocker();
+  ~BuilderWriteLocker();
+
+  void lock();
+  void unlock();
+  bool locked() const;
+
+private:
+  Q_DISABLE_COPY(BuilderWriteLocker)
+  BuilderLock* m_batch;
+  bool m_locked;
+};
+
+///Ends the write-lock a batch holds between its write-sections, before the read-lock is taken
+class BuilderLockRelease
+{
+public:
+  BuilderLockRelease();
+};
+
+/**
+ * Locks the du-chain for reading like DUChainReadLocker. A write-lock the batch of the current thread
+ * keeps between its write-sections is released first, so the lookup doesn't block other threads.
+ * */
+class KDEVCPPDUCHAIN_EXPORT BuilderReadLocker : private BuilderLockRelease, public KDevelop::DUChainReadLocker
+{
+public:
+  BuilderReadLocker();
+};
+
+}
+
+#endif // CPP_BUILDERLOCK_H
@@ -34,6 +34,8 @@
 #include <language/duchain/dumpchain.h>
 #include "environmentmanager.h"
 #include "expressionvisitor.h"
+#include "typeconversion.h"
+#include "builderlock.h"
 
 #include "cppdebughelper.h"
 #include "debugbuilders.h"
@@ -104,6 +106,7 @@ ContextBuilder::ContextBuilder (ParseSession* session)
   , m_currentInitializer(0)
   , m_currentCondition(0)
   , m_mapAst(false)
+  , m_builderLock(0)
 {
 }
 
@@ -123,7 +126,7 @@ void ContextBuilder::setComputeEmpty(bool empty)
 
 
 void ContextBuilder::createUserProblem(AST* node, QString text) {
-    DUChainWriteLocker lock(DUChain::lock());
+    Cpp::BuilderWriteLocker lock;
     KDevelop::ProblemPointer problem(new KDevelop::Problem);
     problem->setDescription(text);
     problem->setSource(KDevelop::ProblemData::DUChainBuilder);
@@ -132,7 +135,7 @@ void ContextBuilder::createUserProblem(AST* node, QString text) {
 }
 
 void ContextBuilder::addBaseType( KDevelop::BaseClassInstance base, BaseSpecifierAST *node ) {
-  DUChainWriteLocker lock(DUChain::lock());
+  Cpp::BuilderWriteLocker lock;
 
   addImportedContexts(); //Make sure the template-contexts are imported first, before any parent-class contexts.
 
@@ -220,7 +223,7 @@ QPair<DUContext*, QualifiedIdentifier> ContextBuilder::findPrefixContext(const Q
   DUContext* import = 0;
 
   {
-    DUChainReadLocker lock(DUChain::lock());
+    Cpp::BuilderReadLocker lock;
 
     QualifiedIdentifier currentScopeId = currentContext()->scopeIdentifier(true);
 
@@ -257,7 +260,7 @@ void ContextBuilder::openPrefixContext(AST* ast, const QualifiedIdentifier& id,
   DUContext* import = prefix.first;
   
   if(import) {
-    DUChainWriteLocker lock(DUChain::lock());
+    Cpp::BuilderWriteLocker lock;
     addImportedParentContextSafely(currentContext(), import);
   }
 }
@@ -302,7 +305,7 @@ KDevelop::TopDUContext* ContextBuilder::buildProxyContextFromContent(Cpp::Enviro
 
   TopDUContext* topLevelContext = 0;
   {
-    DUChainWriteLocker lock(DUChain::lock());
+    Cpp::BuilderWriteLocker lock;
     topLevelContext = updateContext.data();
 
     CppDUContext<TopDUContext>* cppContext = 0;
@@ -324,6 +327,8 @@ KDevelop::TopDUContext* ContextBuilder::buildProxyContextFromContent(Cpp::Enviro
       cppContext = static_cast<CppDUContext<TopDUContext>* >(topLevelContext);
 
       DUChain::self()->addDocumentChain(topLevelContext);
+      //The index may have belonged to a deleted top-context before
+      Cpp::TypeConversionCache::self().topContextCreated(topLevelContext->ownIndex());
       
       topLevelContext->updateImportsCache(); //Mark that we will use a cached import-structure
     }
@@ -346,7 +351,7 @@ ReferencedTopDUContext ContextBuilder::buildContexts(Cpp::EnvironmentFilePointer
   setCompilingContexts(true);
 
   {
-    DUChainWriteLocker lock(DUChain::lock());
+    Cpp::BuilderWriteLocker lock;
     if(updateContext && (updateContext->parsingEnvironmentFile() && updateContext->parsingEnvironmentFile()->isProxyContext())) {
       kDebug(9007) << "updating a context " << file->url().str() << " from a proxy-context to a content-context";
       updateContext->parsingEnvironmentFile()->setIsProxyContext(false);
@@ -355,7 +360,7 @@ ReferencedTopDUContext ContextBuilder::buildContexts(Cpp::EnvironmentFilePointer
   
   ReferencedTopDUContext topLevelContext;
   {
-    DUChainWriteLocker lock(DUChain::lock());
+    Cpp::BuilderWriteLocker lock;
     topLevelContext = updateContext;
 
     RangeInRevision topRange = RangeInRevision(CursorInRevision(0,0), CursorInRevision(INT_MAX, INT_MAX));
@@ -363,6 +368,8 @@ ReferencedTopDUContext ContextBuilder::buildContexts(Cpp::EnvironmentFilePointer
     if (topLevelContext) {
       kDebug(9007) << "ContextBuilder::buildContexts: recompiling";
       setRecompiling(true);
+      //Cached type-conversions may depend on the declarations that are changed now
+      Cpp::TypeConversionCache::self().increaseGeneration();
       DUChain::self()->updateContextEnvironment( topLevelContext, const_cast<Cpp::EnvironmentFile*>(file.data() ) );
       topLevelContext->setRange(topRange);
     } else {
@@ -376,6 +383,8 @@ ReferencedTopDUContext ContextBuilder::buildContexts(Cpp::EnvironmentFilePointer
       topLevelContext->setType(DUContext::Global);
       topLevelContext->setFlags((TopDUContext::Flags)(TopDUContext::UpdatingContext | topLevelContext->flags()));
       DUChain::self()->addDocumentChain(topLevelContext);
+      //The index may have belonged to a deleted top-context before
+      Cpp::TypeConversionCache::self().topContextCreated(topLevelContext->ownIndex());
     
       topLevelContext->updateImportsCache(); //Mark that we will use a cached import-structure
     }
@@ -405,7 +414,7 @@ ReferencedTopDUContext ContextBuilder::buildContexts(Cpp::EnvironmentFilePointer
   }
 
   {
-    DUChainReadLocker lock(DUChain::lock());
+    Cpp::BuilderReadLocker lock;
     //If we're debugging the current file, dump its preprocessed contents and the AST
     ifDebugFile( IndexedString(file->identity().url().str()), { kDebug() << stringFromContents(editor()->parseSession()->contentsVector()); Cpp::DumpChain dump; dump.dump(node, editor()->parseSession()); } );
   }
@@ -413,16 +422,19 @@ ReferencedTopDUContext ContextBuilder::buildContexts(Cpp::EnvironmentFilePointer
   if(m_computeEmpty)
   {
     //Empty the top-context, in case we're updating
-    DUChainWriteLocker lock(DUChain::lock());
+    Cpp::BuilderWriteLocker lock;
     topLevelContext->cleanIfNotEncountered(QSet<DUChainBase*>());
   }else{
     Q_ASSERT(node);
     node->ducontext = topLevelContext;
+    //Keep the write-lock over consecutive write-sections, instead of taking it in each of them
+    Cpp::BuilderLock batch;
+    PushValue<Cpp::BuilderLock*> pushBatch(m_builderLock, &batch);
     supportBuild(node);
   }
 
   {
-    DUChainReadLocker lock(DUChain::lock());
+    Cpp::BuilderReadLocker lock;
 
     kDebug(9007) << "built top-level context with" << topLevelContext->localDeclarations().size() << "declarations and" << topLevelContext->importedParentContexts().size() << "included files";
     //If we're debugging the current file, dump the du-chain and the smart ranges
@@ -437,7 +449,7 @@ ReferencedTopDUContext ContextBuilder::buildContexts(Cpp::EnvironmentFilePointer
   setCompilingContexts(false);
 
   if (!m_importedParentContexts.isEmpty()) {
-    DUChainReadLocker lock(DUChain::lock());
+    Cpp::BuilderReadLocker lock;
     kWarning() << file->url().str() << "Previous parameter declaration context didn't get used??" ;
 //    KDevelop::DumpChain dump;
 //    dump.dump(topLevelContext);
@@ -445,16 +457,29 @@ ReferencedTopDUContext ContextBuilder::buildContexts(Cpp::EnvironmentFilePointer
   }
 
 
-  DUChainWriteLocker lock(DUChain::lock());
+  Cpp::BuilderWriteLocker lock;
   topLevelContext->squeeze();
+
+  if(recompiling()) {
+    //Also drop the conversions that were computed while the context was partially updated.
+    //This happens under the write-lock after the last change, so no reader can see the context in between.
+    Cpp::TypeConversionCache::self().increaseGeneration();
+  }
   return topLevelContext;
 }
 
+void ContextBuilder::visit(AST* node)
+{
+  if (m_builderLock)
+    m_builderLock->yield();
+  DefaultVisitor::visit(node);
+}
+
 void ContextBuilder::visitNamespace (NamespaceAST *node)
 {
   QualifiedIdentifier identifier;
   if (compilingContexts()) {
-    DUChainReadLocker lock(DUChain::lock());
+    Cpp::BuilderReadLocker lock;
 
     if (node->namespace_name)
       identifier.push(QualifiedIdentifier(editor()->tokenToString(node->namespace_name)));
@@ -484,7 +509,7 @@ void ContextBuilder::visitEnumSpecifier(EnumSpecifierAST* node)
   openContext(node, DUContext::Enum, node->isClass ? node->name : 0 );
 
   if (!node->isClass) {
-    DUChainWriteLocker lock(DUChain::lock());
+    Cpp::BuilderWriteLocker lock;
     currentContext()->setPropagateDeclarations(true);
   }
 
@@ -519,7 +544,7 @@ void ContextBuilder::visitClassSpecifier (ClassSpecifierAST *node)
 
     if ((kind == Token_union || id.isEmpty())) {
       //It's an unnamed union context, or an unnamed struct, propagate the declarations to the parent
-      DUChainWriteLocker lock(DUChain::lock());
+      Cpp::BuilderWriteLocker lock;
         
       if(kind == Token_enum || kind == Token_union || m_typeSpecifierWithoutInitDeclarators == node->start_token) {
         ///@todo Mark unions in the duchain in some way, instead of just representing them as a class
@@ -555,7 +580,7 @@ void ContextBuilder::visitFunctionDefinition (FunctionDefinitionAST *node)
     if (functionName.count() >= 2) {
       
       // This is a class function definition
-      DUChainReadLocker lock(DUChain::lock());
+      Cpp::BuilderReadLocker lock;
       QualifiedIdentifier currentScope = currentContext()->scopeIdentifier(true);
       QualifiedIdentifier className = currentScope + functionName;
       className.pop();
@@ -630,7 +655,7 @@ DUContext* ContextBuilder::openContextInternal(const KDevelop::RangeInRevision&
   DUContext* ret = ContextBuilderBase::openContextInternal(range, type, identifier);
 
   {
-    DUChainWriteLocker lock(DUChain::lock());
+    Cpp::BuilderWriteLocker lock;
     static_cast<CppDUContext<DUContext>*>(ret)->deleteAllInstantiations();
   }
   
@@ -778,7 +803,7 @@ void ContextBuilder::visitExpressionOrDeclarationStatement(ExpressionOrDeclarati
   
   DUContext::ContextType type;
   {
-    DUChainReadLocker lock(DUChain::lock());
+    Cpp::BuilderReadLocker lock;
     type = currentContext()->type();
   }
 
@@ -794,7 +819,7 @@ void ContextBuilder::visitExpressionOrDeclarationStatement(ExpressionOrDeclarati
     case DUContext::Function:
     case DUContext::Other:
       if (compilingContexts()) {
-        DUChainReadLocker lock(DUChain::lock());
+        Cpp::BuilderReadLocker lock;
 /*        VerifyExpressionVisitor iv(editor()->parseSession());
 
         node->expression->ducontext = currentContext();
@@ -960,7 +985,7 @@ void ContextBuilder::visitDeclarator(DeclaratorAST *node) {
 void ContextBuilder::addImportedContexts()
 {
   if (compilingContexts() && !m_importedParentContexts.isEmpty()) {
-    DUChainWriteLocker lock(DUChain::lock());
+    Cpp::BuilderWriteLocker lock;
 
     foreach (const DUContext::Import& imported, m_importedParentContexts)
       if(DUContext* imp = imported.context(topContext()))
@@ -1097,7 +1122,7 @@ void ContextBuilder::visitCatchStatement(CatchStatementAST *node)
     DUContext* secondParentContext = openContext(node->condition, DUContext::Other);
     
     {
-      DUChainReadLocker lock(DUChain::lock());
+      Cpp::BuilderReadLocker lock;
       contextsToImport.append(DUContext::Import(secondParentContext, 0));
     }
 
@@ -1145,7 +1170,7 @@ bool ContextBuilder::createContextIfNeeded(AST* node, DUContext* importedParentC
 {
   QVector<DUContext::Import> imports;
   {
-    DUChainReadLocker lock(DUChain::lock());
+    Cpp::BuilderReadLocker lock;
     imports << DUContext::Import(importedParentContext, 0);
   }
   
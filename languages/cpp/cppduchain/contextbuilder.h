@@ -51,6 +51,10 @@ class ParseSession;
 
 namespace KTextEditor { class Range; }
 
+namespace Cpp {
+  class BuilderLock;
+}
+
 namespace Cpp {
   class EnvironmentFile;
   typedef KSharedPtr<EnvironmentFile> EnvironmentFilePointer;
@@ -139,6 +143,8 @@ protected:
   virtual RangeInRevision editorFindRange( AST* fromRange, AST* toRange );
   virtual RangeInRevision editorFindRangeForContext( AST* fromRange, AST* toRange );
   virtual DUContext* newContext(const RangeInRevision& range);
+  ///Lets other threads take the du-chain lock if the current batch has held it long enough
+  virtual void visit(AST* node);
   
   /**
    * Compile an identifier for the specified NameAST \a id.
@@ -253,6 +259,9 @@ protected:
   
   /// AST - DUChain/Uses mapping variables
   bool m_mapAst;
+
+  ///The batch that keeps the du-chain write-lock between the write-sections while the AST is visited, or zero
+  Cpp::BuilderLock* m_builderLock;
 };
 
 #endif // CONTEXTBUILDER_H
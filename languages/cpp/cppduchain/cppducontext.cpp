@@ -27,8 +27,6 @@
 
 namespace Cpp {
 
-QMutex cppDuContextInstantiationsMutex(QMutex::Recursive);
-
 typedef CppDUContext<TopDUContext> CppTopDUContext;
 REGISTER_DUCHAIN_ITEM_WITH_DATA(CppTopDUContext, TopDUContextData);
 
@@ -66,11 +66,11 @@ While construction:
 #include "cpptypes.h"
 #include "templatedeclaration.h"
 #include "cppdebughelper.h"
+#include "instantiationlocks.h"
 
 using namespace KDevelop;
 
 namespace Cpp {
-extern QMutex cppDuContextInstantiationsMutex;
 
     ///This class breaks up the logic of searching a declaration in C++, so QualifiedIdentifiers as well as AST-based lookup mechanisms can be used for searching
     class FindDeclaration {
@@ -454,19 +454,23 @@ class CppDUContext : public BaseContext {
     }
     
     virtual void visit(DUChainVisitor& visitor) {
-      QMutexLocker l(&cppDuContextInstantiationsMutex);
-      foreach(CppDUContext<BaseContext>* ctx, m_instatiations)
+      //The instantiations may share the lock of this context, so it must not be held while visiting them
+      foreach(CppDUContext<BaseContext>* ctx, currentInstantiations())
         ctx->visit(visitor);
       
       BaseContext::visit(visitor);
     }
     
     virtual void deleteUses() {
-      QMutexLocker l(&cppDuContextInstantiationsMutex);
-      foreach(CppDUContext<BaseContext>* ctx, m_instatiations)
+      foreach(CppDUContext<BaseContext>* ctx, currentInstantiations())
         ctx->deleteUses();
       BaseContext::deleteUses();
     }
+
+    QList<CppDUContext<BaseContext>*> currentInstantiations() const {
+      InstantiationLocker l(this);
+      return m_instatiations.values();
+    }
     
     virtual bool foundEnough( const DUContext::DeclarationList& decls, DUContext::SearchFlags flags ) const
     {
@@ -492,49 +496,51 @@ class CppDUContext : public BaseContext {
         setInstantiatedFrom(context->m_instantiatedFrom, templateArguments);
         return;
       }
-      QMutexLocker l(&cppDuContextInstantiationsMutex);
-      
       if( m_instantiatedFrom ) {
+        InstantiationLocker l(m_instantiatedFrom);
         Q_ASSERT(m_instantiatedFrom->m_instatiations[m_instantiatedWith] == this);
         m_instantiatedFrom->m_instatiations.remove( m_instantiatedWith );
       }
       
       m_instantiatedWith = templateArguments.indexed();
-      if(context) {
-        //Change the identifier so it contains the template-parameters
-        QualifiedIdentifier totalId = this->localScopeIdentifier();
-        KDevelop::Identifier id;
-        if( !totalId.isEmpty() ) {
-          id = totalId.last();
-          totalId.pop();
-        }
-        
-        id.clearTemplateIdentifiers();
-        FOREACH_FUNCTION(const IndexedType& arg, templateArguments.templateParameters) {
-          AbstractType::Ptr type(arg.abstractType());
-          IdentifiedType* identified = dynamic_cast<IdentifiedType*>(type.unsafeData());
-          if(identified)
-            id.appendTemplateIdentifier( IndexedTypeIdentifier(identified->qualifiedIdentifier()) );
-          else if(type)
-            id.appendTemplateIdentifier( IndexedTypeIdentifier(type->toString(), true) );
-          else
-            id.appendTemplateIdentifier( IndexedTypeIdentifier("no type") );
-        }
+      if(!context) {
+        m_instantiatedFrom = 0;
+        return;
+      }
 
-        totalId.push(id);
-        
-        this->setLocalScopeIdentifier(totalId);
+      //Lock only the new owner, so other threads see the instantiation and its registration at the same time
+      InstantiationLocker l(context);
+      //Change the identifier so it contains the template-parameters
+      QualifiedIdentifier totalId = this->localScopeIdentifier();
+      KDevelop::Identifier id;
+      if( !totalId.isEmpty() ) {
+        id = totalId.last();
+        totalId.pop();
+      }
+      
+      id.clearTemplateIdentifiers();
+      FOREACH_FUNCTION(const IndexedType& arg, templateArguments.templateParameters) {
+        AbstractType::Ptr type(arg.abstractType());
+        IdentifiedType* identified = dynamic_cast<IdentifiedType*>(type.unsafeData());
+        if(identified)
+          id.appendTemplateIdentifier( IndexedTypeIdentifier(identified->qualifiedIdentifier()) );
+        else if(type)
+          id.appendTemplateIdentifier( IndexedTypeIdentifier(type->toString(), true) );
+        else
+          id.appendTemplateIdentifier( IndexedTypeIdentifier("no type") );
       }
+
+      totalId.push(id);
+      
+      this->setLocalScopeIdentifier(totalId);
       
       m_instantiatedFrom = context;
       Q_ASSERT(m_instantiatedFrom != this);
-      if(m_instantiatedFrom) {
-        if(!m_instantiatedFrom->m_instatiations.contains(m_instantiatedWith)) {
-          m_instantiatedFrom->m_instatiations.insert( m_instantiatedWith, this );
-        }else{
-          kDebug(9007) << "created orphaned instantiation for" << context->m_instatiations[m_instantiatedWith]->scopeIdentifier(true).toString();
-          m_instantiatedFrom = 0;
-        }
+      if(!m_instantiatedFrom->m_instatiations.contains(m_instantiatedWith)) {
+        m_instantiatedFrom->m_instatiations.insert( m_instantiatedWith, this );
+      }else{
+        kDebug(9007) << "created orphaned instantiation for" << context->m_instatiations[m_instantiatedWith]->scopeIdentifier(true).toString();
+        m_instantiatedFrom = 0;
       }
     }
     
@@ -612,6 +618,7 @@ class CppDUContext : public BaseContext {
         return m_instantiatedFrom->instantiate(info, source);
       
       {
+        InstantiationLocker l(this);
         typename QHash<IndexedInstantiationInformation, CppDUContext<BaseContext>* >::const_iterator it = m_instatiations.constFind(info.indexed());
         if(it != m_instatiations.constEnd())
           return *it;
@@ -652,7 +659,7 @@ class CppDUContext : public BaseContext {
     void deleteAllInstantiations() {
       //Specializations will be destroyed the same time this is destroyed
       CppDUContext<BaseContext>* oldFirst = 0;
-      QMutexLocker l(&cppDuContextInstantiationsMutex);
+      InstantiationLocker l(this);
       while(!m_instatiations.isEmpty()) {
         CppDUContext<BaseContext>* first = 0;
         first = *m_instatiations.begin();
@@ -742,7 +749,7 @@ class CppDUContext : public BaseContext {
 
     CppDUContext<BaseContext>* m_instantiatedFrom;
 
-    ///Every access to m_instatiations must be serialized through instatiationsMutex, because they may be written without a write-lock
+    ///Every access to m_instatiations must be serialized through InstantiationLocker(this), because they may be written without a write-lock
     QHash<IndexedInstantiationInformation, CppDUContext<BaseContext>* > m_instatiations;
     IndexedInstantiationInformation m_instantiatedWith;
 };
@@ -41,7 +41,7 @@ CursorInRevision CppEditorIntegrator::findPosition( std::size_t token, Edge edge
     return CursorInRevision();
     }
   
-  const Token& t = m_session->token_stream->token(token);
+  const Token t = m_session->token_stream->token(token);
   return findPosition(t, edge);
 }
 
@@ -75,8 +75,8 @@ RangeInRevision CppEditorIntegrator::findRangeForContext( size_t start_token, si
     kDebug() << "Searching position of invalid token";
     return RangeInRevision();
   }
-  const Token& tStart = m_session->token_stream->token(start_token);
-  const Token& tEnd = m_session->token_stream->token(end_token-1);
+  const Token tStart = m_session->token_stream->token(start_token);
+  const Token tEnd = m_session->token_stream->token(end_token-1);
 
   rpp::Anchor start = m_session->positionAt(tStart.position, true);
   rpp::Anchor end = m_session->positionAt(tEnd.position, true);
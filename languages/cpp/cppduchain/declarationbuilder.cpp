@@ -61,6 +61,7 @@
 
 #include "overloadresolutionhelper.h"
 #include "expressionparser.h"
+#include "builderlock.h"
 
 using namespace KTextEditor;
 using namespace KDevelop;
@@ -116,7 +117,7 @@ void DeclarationBuilder::visitTemplateParameter(TemplateParameterAST * ast) {
     else
       decl = openDeclaration<TemplateParameterDeclaration>(ast->parameter_declaration->declarator ? ast->parameter_declaration->declarator->id : 0, ast, Identifier(), false, !ast->parameter_declaration->declarator);
 
-    DUChainWriteLocker lock(DUChain::lock());
+    Cpp::BuilderWriteLocker lock;
     AbstractType::Ptr type = lastType();
     if( type.cast<CppTemplateParameterType>() ) {
       type.cast<CppTemplateParameterType>()->setDeclaration(decl);
@@ -211,7 +212,7 @@ void DeclarationBuilder::visitInitDeclarator(InitDeclaratorAST *node)
     parameter_is_initializer = true;
   }else if(!m_inFunctionDefinition && node->declarator && node->declarator->parameter_declaration_clause && node->declarator->id) {
     //Decide whether the parameter-declaration clause is valid
-    DUChainWriteLocker lock(DUChain::lock());
+    Cpp::BuilderWriteLocker lock;
     CursorInRevision pos = editor()->findPosition(node->start_token, CppEditorIntegrator::FrontEdge);
     
     QualifiedIdentifier id;
@@ -268,7 +269,7 @@ void DeclarationBuilder::handleRangeBasedFor(ExpressionAST* container, ForRangeD
     AbstractType::Ptr listType;
 
     {
-      DUChainReadLocker lock;
+      Cpp::BuilderReadLocker lock;
       container->ducontext = currentContext();
       Cpp::ExpressionParser parser;
       Cpp::ExpressionEvaluationResult res = parser.evaluateType( container, editor()->parseSession() );
@@ -277,7 +278,7 @@ void DeclarationBuilder::handleRangeBasedFor(ExpressionAST* container, ForRangeD
 
     if (!listType) {
       // invalid type
-      DUChainWriteLocker lock;
+      Cpp::BuilderWriteLocker lock;
       m_lastDeclaration->setAbstractType(AbstractType::Ptr(0));
       return;
     }
@@ -290,7 +291,7 @@ void DeclarationBuilder::handleRangeBasedFor(ExpressionAST* container, ForRangeD
       elementType = array->elementType();
     } else {
       // case b: look for begin(listType) function using ADL
-      DUChainReadLocker lock;
+      Cpp::BuilderReadLocker lock;
       OverloadResolutionHelper helper = OverloadResolutionHelper( DUContextPointer(currentContext()), TopDUContextPointer(topContext()) );
       helper.setKnownParameters(OverloadResolver::ParameterList(listType, false));
       // first try begin in current context
@@ -318,7 +319,7 @@ void DeclarationBuilder::handleRangeBasedFor(ExpressionAST* container, ForRangeD
     }
 
     // step 2: set last type, but keep const&
-    DUChainWriteLocker lock;
+    Cpp::BuilderWriteLocker lock;
     if (elementType) {
       AbstractType::Ptr type = m_lastDeclaration->abstractType();
       elementType->setModifiers(type->modifiers());
@@ -427,12 +428,12 @@ void DeclarationBuilder::visitDeclarator (DeclaratorAST* node)
       editor()->parseSession()->mapAstDuChain(m_mappedNodes.top(), KDevelop::DeclarationPointer(decl));
 
     if (m_functionFlag == DeleteFunction) {
-      DUChainWriteLocker lock(DUChain::lock());
+      Cpp::BuilderWriteLocker lock;
       decl->setExplicitlyDeleted(true);
     }
 
     if( !m_functionDefinedStack.isEmpty() ) {
-        DUChainWriteLocker lock(DUChain::lock());
+        Cpp::BuilderWriteLocker lock;
         // don't overwrite isDefinition if that was already set (see openFunctionDeclaration)
         decl->setDeclarationIsDefinition( (bool)m_functionDefinedStack.top() );
     }
@@ -461,7 +462,7 @@ void DeclarationBuilder::visitDeclarator (DeclaratorAST* node)
   if (node->parameter_declaration_clause && !isFuncPtr) {
     if (!m_functionDefinedStack.isEmpty() && m_functionDefinedStack.top() && node->id) {
 
-      DUChainWriteLocker lock(DUChain::lock());
+      Cpp::BuilderWriteLocker lock;
       //We have to search for the fully qualified identifier, so we always get the correct class
       QualifiedIdentifier id = currentContext()->scopeIdentifier(false);
       QualifiedIdentifier id2;
@@ -561,7 +562,7 @@ TemplateDeclaration* DeclarationBuilder::findSpecializedFrom(Declaration* specia
 template<class T>
 T* DeclarationBuilder::openDeclaration(NameAST* name, AST* rangeNode, const Identifier& customName, bool collapseRangeAtStart, bool collapseRangeAtEnd)
 {
-  DUChainWriteLocker lock(DUChain::lock());
+  Cpp::BuilderWriteLocker lock;
 
   KDevelop::DUContext* templateCtx = hasTemplateContext(m_importedParentContexts + currentContext()->importedParentContexts(), topContext()).context(topContext());
 
@@ -716,7 +717,7 @@ ClassDeclaration* DeclarationBuilder::openClassDefinition(NameAST* name, AST* ra
   }
 
   ClassDeclaration* ret = openDeclaration<ClassDeclaration>(name, range, id, collapseRange);
-  DUChainWriteLocker lock(DUChain::lock());
+  Cpp::BuilderWriteLocker lock;
   ret->setDeclarationIsDefinition(true);
   ret->clearBaseClasses();
   
@@ -737,7 +738,7 @@ Declaration* DeclarationBuilder::openDefinition(NameAST* name, AST* rangeNode, b
   if(m_mapAst && !m_mappedNodes.empty())
     editor()->parseSession()->mapAstDuChain(m_mappedNodes.top(), KDevelop::DeclarationPointer(ret));
 
-  DUChainWriteLocker lock(DUChain::lock());
+  Cpp::BuilderWriteLocker lock;
   ret->setDeclarationIsDefinition(true);
   return ret;
 }
@@ -746,7 +747,7 @@ Declaration* DeclarationBuilder::openNormalDeclaration(NameAST* name, AST* range
   if(currentContext()->type() == DUContext::Class) {
     ClassMemberDeclaration* mem = openDeclaration<ClassMemberDeclaration>(name, rangeNode, customName, collapseRange);
 
-    DUChainWriteLocker lock(DUChain::lock());
+    Cpp::BuilderWriteLocker lock;
     mem->setAccessPolicy(currentAccessPolicy());
     return mem;
   } else if(currentContext()->type() == DUContext::Template) {
@@ -769,7 +770,7 @@ Declaration* DeclarationBuilder::openFunctionDeclaration(NameAST* name, AST* ran
    }
 
   if(currentContext()->type() == DUContext::Class) {
-    DUChainWriteLocker lock;
+    Cpp::BuilderWriteLocker lock;
     ClassFunctionDeclaration* fun = 0;
     if(!m_collectQtFunctionSignature) {
       fun = openDeclaration<ClassFunctionDeclaration>(name, rangeNode, localId);
@@ -790,7 +791,7 @@ Declaration* DeclarationBuilder::openFunctionDeclaration(NameAST* name, AST* ran
   } else if(m_inFunctionDefinition && (currentContext()->type() == DUContext::Namespace || currentContext()->type() == DUContext::Global)) {
     //May be a definition
      FunctionDefinition* ret = openDeclaration<FunctionDefinition>(name, rangeNode, localId);
-     DUChainWriteLocker lock(DUChain::lock());
+     Cpp::BuilderWriteLocker lock;
      ret->setDeclaration(0);
      return ret;
   }else{
@@ -800,7 +801,7 @@ Declaration* DeclarationBuilder::openFunctionDeclaration(NameAST* name, AST* ran
 
 void DeclarationBuilder::classTypeOpened(AbstractType::Ptr type) {
   //We override this so we can get the class-declaration into a usable state(with filled type) earlier
-    DUChainWriteLocker lock(DUChain::lock());
+    Cpp::BuilderWriteLocker lock;
 
     IdentifiedType* idType = dynamic_cast<IdentifiedType*>(type.unsafeData());
 
@@ -813,7 +814,7 @@ void DeclarationBuilder::classTypeOpened(AbstractType::Ptr type) {
 void DeclarationBuilder::closeDeclaration(bool forceInstance)
 {
   {
-    DUChainWriteLocker lock(DUChain::lock());
+    Cpp::BuilderWriteLocker lock;
       
     if (lastType()) {
 
@@ -870,7 +871,7 @@ void DeclarationBuilder::closeDeclaration(bool forceInstance)
       eventuallyAssignInternalContext();
   }
 
-  ifDebugCurrentFile( DUChainReadLocker lock(DUChain::lock()); kDebug() << "closing declaration" << currentDeclaration()->toString() << "type" << (currentDeclaration()->abstractType() ? currentDeclaration()->abstractType()->toString() : QString("notype")) << "last:" << (lastType() ? lastType()->toString() : QString("(notype)")); )
+  ifDebugCurrentFile( Cpp::BuilderReadLocker lock; kDebug() << "closing declaration" << currentDeclaration()->toString() << "type" << (currentDeclaration()->abstractType() ? currentDeclaration()->abstractType()->toString() : QString("notype")) << "last:" << (lastType() ? lastType()->toString() : QString("(notype)")); )
 
   m_lastDeclaration = m_declarationStack.pop();
 }
@@ -999,14 +1000,14 @@ void DeclarationBuilder::visitEnumerator(EnumeratorAST* node)
   EnumeratorType::Ptr enumeratorType = lastType().cast<EnumeratorType>();
 
   if(ClassMemberDeclaration* classMember = dynamic_cast<ClassMemberDeclaration*>(currentDeclaration())) {
-    DUChainWriteLocker lock(DUChain::lock());
+    Cpp::BuilderWriteLocker lock;
     classMember->setStatic(true);
   }
 
   closeDeclaration(true);
 
   if(enumeratorType) { ///@todo Move this into closeDeclaration in a logical way
-    DUChainWriteLocker lock(DUChain::lock());
+    Cpp::BuilderWriteLocker lock;
     enumeratorType->setDeclaration(decl);
     decl->setAbstractType(enumeratorType.cast<AbstractType>());
   }else if(!lastType().cast<DelayedType>()){ //If it's in a template, it may be DelayedType
@@ -1018,7 +1019,7 @@ void DeclarationBuilder::visitEnumerator(EnumeratorAST* node)
 void DeclarationBuilder::classContextOpened(ClassSpecifierAST* /*node*/, DUContext* context) {
   
   //We need to set this early, so we can do correct search while building
-  DUChainWriteLocker lock(DUChain::lock());
+  Cpp::BuilderWriteLocker lock;
   currentDeclaration()->setInternalContext(context);
 }
 
@@ -1039,7 +1040,7 @@ void DeclarationBuilder::visitNamespace(NamespaceAST* ast) {
       range.end = range.start;
     }
 
-    DUChainWriteLocker lock(DUChain::lock());
+    Cpp::BuilderWriteLocker lock;
 
     Declaration * declaration = openDeclarationReal<Declaration>(0, 0, id, false, false, &range);
     
@@ -1052,7 +1053,7 @@ void DeclarationBuilder::visitNamespace(NamespaceAST* ast) {
   
   QualifiedIdentifier qid;
   {
-    DUChainWriteLocker lock(DUChain::lock());
+    Cpp::BuilderWriteLocker lock;
     currentDeclaration()->setKind(KDevelop::Declaration::Namespace);
     qid = currentDeclaration()->qualifiedIdentifier();
     clearLastType();
@@ -1063,7 +1064,7 @@ void DeclarationBuilder::visitNamespace(NamespaceAST* ast) {
   // i.e. compare to visitUsingDirective()
   if( ast->inlined && compilingContexts() ) {
     RangeInRevision aliasRange(range.end + CursorInRevision(0, 1), 0);
-    DUChainWriteLocker lock;
+    Cpp::BuilderWriteLocker lock;
     NamespaceAliasDeclaration* decl = openDeclarationReal<NamespaceAliasDeclaration>(0, 0, globalImportIdentifier(), false, false,
                                                                                      &aliasRange);
     decl->setImportIdentifier( qid );
@@ -1142,7 +1143,7 @@ void DeclarationBuilder::visitClassSpecifier(ClassSpecifierAST *node)
 
   if( node->name ) {
     ///Copy template default-parameters from the forward-declaration to the real declaration if possible
-    DUChainWriteLocker lock(DUChain::lock());
+    Cpp::BuilderWriteLocker lock;
     copyTemplateDefaultsFromForward(id.last(), pos);
   }
 
@@ -1163,7 +1164,7 @@ void DeclarationBuilder::visitBaseSpecifier(BaseSpecifierAST *node) {
 
   BaseClassInstance instance;
   {
-    DUChainWriteLocker lock(DUChain::lock());
+    Cpp::BuilderWriteLocker lock;
     ClassDeclaration* currentClass = dynamic_cast<ClassDeclaration*>(currentDeclaration());
     if(currentClass) {
 
@@ -1249,7 +1250,7 @@ void DeclarationBuilder::visitUsing(UsingAST * node)
   ///@todo only use the last name component as range
   AliasDeclaration* decl = openDeclaration<AliasDeclaration>(0, node->name ? (AST*)node->name : (AST*)node, id.last());
   {
-    DUChainWriteLocker lock(DUChain::lock());
+    Cpp::BuilderWriteLocker lock;
 
     CursorInRevision pos = editor()->findPosition(node->start_token, CppEditorIntegrator::FrontEdge);
     QList<Declaration*> declarations = currentContext()->findDeclarations(id, pos);
@@ -1274,7 +1275,7 @@ void DeclarationBuilder::visitUsingDirective(UsingDirectiveAST * node)
 
   if( compilingContexts() ) {
     RangeInRevision range = editor()->findRange(node->start_token);
-    DUChainWriteLocker lock(DUChain::lock());
+    Cpp::BuilderWriteLocker lock;
     NamespaceAliasDeclaration* decl = openDeclarationReal<NamespaceAliasDeclaration>(0, 0, globalImportIdentifier(), false, false, &range);
     {
       QualifiedIdentifier id;
@@ -1309,7 +1310,7 @@ void DeclarationBuilder::visitNamespaceAliasDefinition(NamespaceAliasDefinitionA
   DeclarationBuilderBase::visitNamespaceAliasDefinition(node);
 
   {
-    DUChainReadLocker lock(DUChain::lock());
+    Cpp::BuilderReadLocker lock;
     if( currentContext()->type() != DUContext::Namespace && currentContext()->type() != DUContext::Global ) {
       ///@todo report problem
       kDebug(9007) << "Namespace-alias used in non-global scope";
@@ -1318,7 +1319,7 @@ void DeclarationBuilder::visitNamespaceAliasDefinition(NamespaceAliasDefinitionA
 
   if( compilingContexts() ) {
     RangeInRevision range = editor()->findRange(node->namespace_name);
-    DUChainWriteLocker lock(DUChain::lock());
+    Cpp::BuilderWriteLocker lock;
     NamespaceAliasDeclaration* decl = openDeclarationReal<NamespaceAliasDeclaration>(0, 0, Identifier(editor()->parseSession()->token_stream->symbol(node->namespace_name)), false, false, &range);
     {
       QualifiedIdentifier id;
@@ -1367,7 +1368,7 @@ void DeclarationBuilder::visitElaboratedTypeSpecifier(ElaboratedTypeSpecifierAST
       CursorInRevision pos = editor()->findPosition(node->start_token, CppEditorIntegrator::FrontEdge);
 
       {
-        DUChainReadLocker lock(DUChain::lock());
+        Cpp::BuilderReadLocker lock;
 
         declarations = currentContext()->findDeclarations( id, pos);
 
@@ -1403,7 +1404,7 @@ void DeclarationBuilder::visitElaboratedTypeSpecifier(ElaboratedTypeSpecifierAST
           //Open the global context, so it is currentContext() and we can insert the forward-declaration there
           DUContext* globalCtx;
           {
-            DUChainReadLocker lock(DUChain::lock());
+            Cpp::BuilderReadLocker lock;
             globalCtx = currentContext();
             while(globalCtx && globalCtx->type() != DUContext::Global && globalCtx->type() != DUContext::Namespace)
               globalCtx = globalCtx->parentContext();
@@ -1428,7 +1429,7 @@ void DeclarationBuilder::visitElaboratedTypeSpecifier(ElaboratedTypeSpecifierAST
   DeclarationBuilderBase::visitElaboratedTypeSpecifier(node);
 
   if (openedDeclaration) {
-/*    DUChainWriteLocker lock(DUChain::lock());
+/*    Cpp::BuilderWriteLocker lock;
     //Resolve forward-declarations that are declared after the real type was already declared
     Q_ASSERT(dynamic_cast<ForwardDeclaration*>(currentDeclaration()));
     IdentifiedType* idType = dynamic_cast<IdentifiedType*>(lastType().data());
@@ -1568,7 +1569,7 @@ void DeclarationBuilder::visitParameterDeclaration(ParameterDeclarationAST* node
   if( function ) {
     
     if( node->expression ) {
-      DUChainWriteLocker lock(DUChain::lock());
+      Cpp::BuilderWriteLocker lock;
       //Fill default-parameters
       QString defaultParam = stringFromSessionTokens( editor()->parseSession(), node->expression->start_token, node->expression->end_token ).trimmed();
 
@@ -1595,7 +1596,7 @@ void DeclarationBuilder::applyStorageSpecifiers()
 {
   if (!m_storageSpecifiers.isEmpty() && m_storageSpecifiers.top() != 0)
     if (ClassMemberDeclaration* member = dynamic_cast<ClassMemberDeclaration*>(currentDeclaration())) {
-      DUChainWriteLocker lock(DUChain::lock());
+      Cpp::BuilderWriteLocker lock;
 
       member->setStorageSpecifiers(m_storageSpecifiers.top());
     }
@@ -1633,7 +1634,7 @@ void DeclarationBuilder::inheritVirtualSpecifierFromOverridden(ClassFunctionDecl
 
 void DeclarationBuilder::applyFunctionSpecifiers()
 {
-  DUChainWriteLocker lock(DUChain::lock());
+  Cpp::BuilderWriteLocker lock;
   AbstractFunctionDeclaration* function = dynamic_cast<AbstractFunctionDeclaration*>(currentDeclaration());
   if(!function)
     return;
@@ -1651,7 +1652,7 @@ void DeclarationBuilder::applyFunctionSpecifiers()
 bool DeclarationBuilder::checkParameterDeclarationClause(ParameterDeclarationClauseAST* clause)
 {
     {
-      DUChainReadLocker lock(DUChain::lock());
+      Cpp::BuilderReadLocker lock;
       if(currentContext()->type() == DUContext::Other) //Cannot declare a function in a code-context
         return false; ///@todo create warning/error
     }
@@ -1731,7 +1732,7 @@ bool DeclarationBuilder::checkParameterDeclarationClause(ParameterDeclarationCla
 void DeclarationBuilder::eventuallyAssignInternalContext()
 {
   if (TypeBuilder::lastContext()) {
-    DUChainWriteLocker lock(DUChain::lock());
+    Cpp::BuilderWriteLocker lock;
 
     if( dynamic_cast<ClassFunctionDeclaration*>(currentDeclaration()) )
       Q_ASSERT( !static_cast<ClassFunctionDeclaration*>(currentDeclaration())->isConstructor() || currentDeclaration()->context()->type() == DUContext::Class );
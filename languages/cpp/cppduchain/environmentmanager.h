@@ -285,6 +285,9 @@ class KDEVCPPDUCHAIN_EXPORT EnvironmentFile : public KDevelop::ParsingEnvironmen
     uint identityOffset() const;
     
     virtual bool matchEnvironment(const KDevelop::ParsingEnvironment* environment) const;
+
+    ///Whether @p environment contains exactly the macros this file used from outside, regardless of the matching-level
+    bool matchMacros(const CppPreprocessEnvironment* environment) const;
     
     virtual bool needsUpdate(const KDevelop::ParsingEnvironment* environment = 0) const;
     
@@ -42,6 +42,7 @@
 #include "missingdeclarationproblem.h"
 #include "dumpchain.h"
 #include "ptrtomembertype.h"
+#include "builderlock.h"
 
 //If this is enabled and a type is not found, it is searched again with verbose debug output.
 //#define DEBUG_RESOLUTION_PROBLEMS
@@ -87,7 +88,7 @@ const int maxExpressionVisitorProblems = 400;
  * appropriate expression to compute the type/value later on.
  * */
 
-#define LOCKDUCHAIN     DUChainReadLocker lock(DUChain::lock())
+#define LOCKDUCHAIN     Cpp::BuilderReadLocker lock
 #define MUST_HAVE(X) if(!X) { problem( node, "no " # X ); return; }
 
 namespace Cpp {
@@ -138,7 +139,7 @@ void ExpressionVisitor::visitIndependentNodes(const ListNode<_Tp> *nodes)
   while (it != end);
 }
 
-const Token& ExpressionVisitor::tokenFromIndex( int index ) {
+Token ExpressionVisitor::tokenFromIndex( int index ) {
   return m_session->token_stream->token(index);
 }
 
@@ -586,7 +587,7 @@ void ExpressionVisitor::findMember( AST* node, AbstractType::Ptr base, const Ide
 
   void ExpressionVisitor::visitExpressionToken(uint tokenIndex, AST* node)
   {
-    const Token& token(tokenFromIndex(tokenIndex));
+    const Token token(tokenFromIndex(tokenIndex));
 
     if (token.kind == Token_number_literal) {
       QString num = m_session->token_stream->symbolString(token);
@@ -185,7 +185,7 @@ public:
     }
     
 protected:
-  const Token& tokenFromIndex( int index );
+  Token tokenFromIndex( int index );
     
 private:
     ///Fills m_parameters from the given argument-expression
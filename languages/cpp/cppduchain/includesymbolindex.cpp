@@ -0,0 +1,286 @@
+/* This file is part of KDevelop
+   Copyright 2014 KDevelop developers
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2 as published by the Free Software Foundation.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "includesymbolindex.h"
+
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSet>
+
+#include <language/duchain/repositories/itemrepository.h>
+#include <language/duchain/appendedlist.h>
+#include <language/duchain/topducontext.h>
+#include <language/duchain/declaration.h>
+#include <language/duchain/aliasdeclaration.h>
+#include <language/duchain/namespacealiasdeclaration.h>
+
+using namespace KDevelop;
+using namespace Cpp;
+
+DEFINE_LIST_MEMBER_HASH(IncludeSymbolIndexItem, m_identifiers, IndexedString)
+
+struct IncludeSymbolIndexItem {
+
+    IncludeSymbolIndexItem() {
+      initializeAppendedLists(true);
+    }
+    IncludeSymbolIndexItem(const IncludeSymbolIndexItem& rhs, bool dynamic)
+      : m_url(rhs.m_url)
+      , m_canonicalPath(rhs.m_canonicalPath)
+      , m_forwardedTo(rhs.m_forwardedTo)
+    {
+      initializeAppendedLists(dynamic);
+      copyListsFrom(rhs);
+    }
+    ~IncludeSymbolIndexItem() {
+      freeAppendedLists();
+    }
+
+    bool persistent() const {
+      return true;
+    }
+
+    ///There is only one entry per file, so only the url is compared
+    bool operator==(const IncludeSymbolIndexItem& rhs) const {
+      return m_url == rhs.m_url;
+    }
+
+    uint hash() const {
+      return m_url.hash();
+    }
+
+    uint itemSize() const {
+      return dynamicSize();
+    }
+
+    uint classSize() const {
+      return sizeof(*this);
+    }
+
+    IndexedString m_url;
+    IndexedString m_canonicalPath;
+    ///The only file included by this one, if it is a forwarding header
+    IndexedString m_forwardedTo;
+
+    START_APPENDED_LISTS(IncludeSymbolIndexItem);
+    APPENDED_LIST_FIRST(IncludeSymbolIndexItem, IndexedString, m_identifiers);
+    END_APPENDED_LISTS(IncludeSymbolIndexItem, m_identifiers);
+  private:
+    IncludeSymbolIndexItem& operator=(const IncludeSymbolIndexItem&);
+};
+
+typedef AppendedListItemRequest<IncludeSymbolIndexItem, 1024 * 4> IncludeSymbolIndexRequest;
+
+typedef KDevelop::ItemRepository<IncludeSymbolIndexItem, IncludeSymbolIndexRequest> IncludeSymbolIndexRepository;
+
+static IncludeSymbolIndexRepository& includeSymbolIndexRepository()
+{
+  static IncludeSymbolIndexRepository repo("include symbol index repository");
+  return repo;
+}
+
+namespace {
+
+void collectIdentifiers(const DUContext* context, QSet<IndexedString>& identifiers)
+{
+  foreach(Declaration* decl, context->localDeclarations()) {
+    if(decl->isForwardDeclaration() || decl->kind() == Declaration::Namespace)
+      continue;
+    if(dynamic_cast<AliasDeclaration*>(decl) || dynamic_cast<NamespaceAliasDeclaration*>(decl))
+      continue;
+    const IndexedString identifier = decl->identifier().identifier();
+    if(!identifier.isEmpty())
+      identifiers.insert(identifier);
+  }
+
+  foreach(DUContext* child, context->childContexts())
+    if(child->type() == DUContext::Namespace)
+      collectIdentifiers(child, identifiers);
+}
+
+struct IndexLoader {
+  IndexLoader(QHash<IndexedString, IncludeSymbolIndex::File>& _files) : files(_files) {
+  }
+  bool operator()(const IncludeSymbolIndexItem* item) {
+    IncludeSymbolIndex::File& file(files[item->m_url]);
+    file.canonicalPath = item->m_canonicalPath.str();
+    file.forwardedTo = item->m_forwardedTo;
+    FOREACH_FUNCTION(const IndexedString& identifier, item->m_identifiers)
+      file.identifiers.append(identifier);
+    return true;
+  }
+  QHash<IndexedString, IncludeSymbolIndex::File>& files;
+};
+
+}
+
+IncludeSymbolIndex& IncludeSymbolIndex::self()
+{
+  static IncludeSymbolIndex index;
+  return index;
+}
+
+IncludeSymbolIndex::IncludeSymbolIndex()
+  : m_loaded(false)
+{
+  includeSymbolIndexRepository();
+}
+
+void IncludeSymbolIndex::load() const
+{
+  if(m_loaded)
+    return;
+  m_loaded = true;
+
+  QHash<IndexedString, File> files;
+  IndexLoader loader(files);
+  {
+    QMutexLocker lock(includeSymbolIndexRepository().mutex());
+    includeSymbolIndexRepository().visitAllItems(loader);
+  }
+
+  for(QHash<IndexedString, File>::const_iterator it = files.constBegin(); it != files.constEnd(); ++it)
+    insert(it.key(), *it);
+}
+
+void IncludeSymbolIndex::insert(const IndexedString& url, const File& file) const
+{
+  m_files.insert(url, file);
+  foreach(const IndexedString& identifier, file.identifiers)
+    m_identifiers[identifier].append(url);
+  if(!file.forwardedTo.isEmpty())
+    m_forwarders[file.forwardedTo].append(url);
+}
+
+void IncludeSymbolIndex::erase(const IndexedString& url) const
+{
+  QHash<IndexedString, File>::iterator it = m_files.find(url);
+  if(it == m_files.end())
+    return;
+
+  foreach(const IndexedString& identifier, it->identifiers) {
+    QHash<IndexedString, QVector<IndexedString> >::iterator files = m_identifiers.find(identifier);
+    if(files == m_identifiers.end())
+      continue;
+    files->remove(files->indexOf(url));
+    if(files->isEmpty())
+      m_identifiers.erase(files);
+  }
+
+  if(!it->forwardedTo.isEmpty()) {
+    QHash<IndexedString, QVector<IndexedString> >::iterator forwarders = m_forwarders.find(it->forwardedTo);
+    if(forwarders != m_forwarders.end()) {
+      forwarders->remove(forwarders->indexOf(url));
+      if(forwarders->isEmpty())
+        m_forwarders.erase(forwarders);
+    }
+  }
+
+  m_files.erase(it);
+}
+
+void IncludeSymbolIndex::update(const TopDUContext* top)
+{
+  const IndexedString url = top->url();
+
+  QSet<IndexedString> identifiers;
+  collectIdentifiers(top, identifiers);
+  const QFileInfo info(url.str());
+  identifiers.insert(IndexedString(info.fileName()));
+
+  File file;
+  file.canonicalPath = info.canonicalFilePath();
+  foreach(const IndexedString& identifier, identifiers)
+    file.identifiers.append(identifier);
+
+  if(top->localDeclarations().isEmpty() && top->importedParentContexts().size() == 1) {
+    DUContext* included = top->importedParentContexts().first().context(0);
+    if(included)
+      file.forwardedTo = included->url();
+  }
+
+  IncludeSymbolIndexItem item;
+  item.m_url = url;
+  item.m_canonicalPath = IndexedString(file.canonicalPath);
+  item.m_forwardedTo = file.forwardedTo;
+  foreach(const IndexedString& identifier, file.identifiers)
+    item.m_identifiersList().append(identifier);
+
+  QMutexLocker lock(&m_mutex);
+  load();
+  erase(url);
+  insert(url, file);
+  ++m_statistics.updates;
+
+  QMutexLocker repositoryLock(includeSymbolIndexRepository().mutex());
+  uint index = includeSymbolIndexRepository().findIndex(item);
+  if(index)
+    includeSymbolIndexRepository().deleteItem(index);
+  includeSymbolIndexRepository().index(item);
+}
+
+void IncludeSymbolIndex::remove(const IndexedString& url)
+{
+  QMutexLocker lock(&m_mutex);
+  load();
+  erase(url);
+
+  IncludeSymbolIndexItem request;
+  request.m_url = url;
+
+  QMutexLocker repositoryLock(includeSymbolIndexRepository().mutex());
+  uint index = includeSymbolIndexRepository().findIndex(request);
+  if(index)
+    includeSymbolIndexRepository().deleteItem(index);
+}
+
+QList<IndexedString> IncludeSymbolIndex::files(const IndexedString& identifier) const
+{
+  QMutexLocker lock(&m_mutex);
+  load();
+  ++m_statistics.lookups;
+  QHash<IndexedString, QVector<IndexedString> >::const_iterator it = m_identifiers.constFind(identifier);
+  if(it == m_identifiers.constEnd())
+    return QList<IndexedString>();
+  ++m_statistics.hits;
+  return it->toList();
+}
+
+QList<IndexedString> IncludeSymbolIndex::forwarders(const IndexedString& file) const
+{
+  QMutexLocker lock(&m_mutex);
+  load();
+  return m_forwarders.value(file).toList();
+}
+
+QString IncludeSymbolIndex::canonicalPath(const IndexedString& file) const
+{
+  QMutexLocker lock(&m_mutex);
+  load();
+  QHash<IndexedString, File>::const_iterator it = m_files.constFind(file);
+  return it == m_files.constEnd() ? QString() : it->canonicalPath;
+}
+
+IncludeSymbolIndex::Statistics IncludeSymbolIndex::statistics() const
+{
+  QMutexLocker lock(&m_mutex);
+  Statistics ret = m_statistics;
+  ret.files = m_files.size();
+  ret.identifiers = m_identifiers.size();
+  return ret;
+}
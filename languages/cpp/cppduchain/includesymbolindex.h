@@ -0,0 +1,110 @@
+/* This file is part of KDevelop
+   Copyright 2014 KDevelop developers
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2 as published by the Free Software Foundation.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef INCLUDESYMBOLINDEX_H
+#define INCLUDESYMBOLINDEX_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+#include <language/duchain/indexedstring.h>
+
+#include "cppduchainexport.h"
+
+namespace KDevelop {
+class TopDUContext;
+}
+
+namespace Cpp {
+
+/**
+ * Maps unqualified identifiers to the files that declare them, so missing-include
+ * suggestions can be computed without walking importers or scanning the include-paths.
+ *
+ * Every file is indexed with the identifiers of all declarations in its global and namespace
+ * scopes, and with its own file-name, so forwarding headers like "QString" are found as well.
+ * Files that contain no declarations and include exactly one other file are remembered as
+ * forwarders of that file. The canonical path of every file is computed while indexing.
+ *
+ * The index is updated by the parse-jobs, and stored in an item repository together with
+ * the DUChain. The lookup-tables are built from the repository on first use.
+ *
+ * All functions are thread-safe.
+ * */
+class KDEVCPPDUCHAIN_EXPORT IncludeSymbolIndex {
+  public:
+    static IncludeSymbolIndex& self();
+
+    ///Re-indexes the file of @p top, replacing everything that was indexed for it before.
+    ///The DUChain must be read-locked.
+    void update(const KDevelop::TopDUContext* top);
+
+    void remove(const KDevelop::IndexedString& url);
+
+    ///Files that declare @p identifier in the global or a namespace scope, or that are named @p identifier
+    QList<KDevelop::IndexedString> files(const KDevelop::IndexedString& identifier) const;
+
+    ///Files that contain nothing but an include-directive for @p file
+    QList<KDevelop::IndexedString> forwarders(const KDevelop::IndexedString& file) const;
+
+    ///The canonical path of @p file computed while it was indexed, or an empty string if it is not indexed
+    QString canonicalPath(const KDevelop::IndexedString& file) const;
+
+    struct Statistics {
+      Statistics() : lookups(0), hits(0), updates(0), files(0), identifiers(0) {
+      }
+      uint lookups;
+      ///Lookups that found at least one file
+      uint hits;
+      uint updates;
+      uint files;
+      uint identifiers;
+    };
+    Statistics statistics() const;
+
+    ///Everything that is indexed for one file
+    struct File {
+      QVector<KDevelop::IndexedString> identifiers;
+      KDevelop::IndexedString forwardedTo;
+      QString canonicalPath;
+    };
+
+  private:
+    IncludeSymbolIndex();
+    Q_DISABLE_COPY(IncludeSymbolIndex)
+
+    ///Builds the lookup-tables from the repository if that did not happen yet. m_mutex must be locked.
+    void load() const;
+    ///m_mutex must be locked
+    void insert(const KDevelop::IndexedString& url, const File& file) const;
+    void erase(const KDevelop::IndexedString& url) const;
+
+    mutable QMutex m_mutex;
+    mutable bool m_loaded;
+    mutable QHash<KDevelop::IndexedString, File> m_files;
+    mutable QHash<KDevelop::IndexedString, QVector<KDevelop::IndexedString> > m_identifiers;
+    mutable QHash<KDevelop::IndexedString, QVector<KDevelop::IndexedString> > m_forwarders;
+    mutable Statistics m_statistics;
+};
+
+}
+
+#endif // INCLUDESYMBOLINDEX_H
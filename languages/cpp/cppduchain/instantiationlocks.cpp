@@ -0,0 +1,109 @@
+/*
+ * This file is part of KDevelop
+ *
+ * Copyright 2014 KDevelop developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "instantiationlocks.h"
+
+#include <QtCore/QElapsedTimer>
+
+namespace Cpp {
+
+namespace {
+struct Shard {
+  Shard() : mutex(QMutex::Recursive) {
+  }
+  QMutex mutex;
+  ///Only changed while the mutex is held
+  InstantiationLocks::Statistics statistics;
+};
+
+Shard* shards() {
+  static Shard shards[InstantiationLocks::Shards];
+  return shards;
+}
+}
+
+InstantiationLocks::Statistics InstantiationLocks::statistics()
+{
+  Statistics ret;
+  for(int a = 0; a < Shards; ++a) {
+    QMutexLocker lock(&shards()[a].mutex);
+    const Statistics& s(shards()[a].statistics);
+    ret.locks += s.locks;
+    ret.contended += s.contended;
+    ret.waitedNanoseconds += s.waitedNanoseconds;
+  }
+  return ret;
+}
+
+void InstantiationLocks::resetStatistics()
+{
+  for(int a = 0; a < Shards; ++a) {
+    QMutexLocker lock(&shards()[a].mutex);
+    shards()[a].statistics = Statistics();
+  }
+}
+
+InstantiationLocker::InstantiationLocker(const void* owner)
+  : m_locked(false)
+{
+  //The lowest bits of heap addresses are always the same
+  quintptr address = reinterpret_cast<quintptr>(owner) >> 4;
+  m_shard = (address ^ (address >> 8)) % InstantiationLocks::Shards;
+  relock();
+}
+
+InstantiationLocker::~InstantiationLocker()
+{
+  unlock();
+}
+
+void InstantiationLocker::unlock()
+{
+  if(m_locked) {
+    shards()[m_shard].mutex.unlock();
+    m_locked = false;
+  }
+}
+
+void InstantiationLocker::relock()
+{
+  if(m_locked)
+    return;
+
+  Shard& shard(shards()[m_shard]);
+  if(shard.mutex.tryLock()) {
+    ++shard.statistics.locks;
+  } else {
+    QElapsedTimer timer;
+    timer.start();
+    shard.mutex.lock();
+    ++shard.statistics.locks;
+    ++shard.statistics.contended;
+#if QT_VERSION >= 0x040800
+    shard.statistics.waitedNanoseconds += timer.nsecsElapsed();
+#else
+    shard.statistics.waitedNanoseconds += timer.elapsed() * 1000000;
+#endif
+  }
+  m_locked = true;
+}
+
+}
@@ -0,0 +1,80 @@
+/*
+ * This file is part of KDevelop
+ *
+ * Copyright 2014 KDevelop developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef CPP_INSTANTIATIONLOCKS_H
+#define CPP_INSTANTIATIONLOCKS_H
+
+#include <QtCore/QMutex>
+
+#include "cppduchainexport.h"
+
+namespace Cpp {
+
+/**
+ * Serializes the accesses to the instantiation-hashes of template-declarations and template-contexts.
+ *
+ * The instantiations of one declaration or context are always protected by the same mutex, which is
+ * chosen from a fixed set of shards by the address of the declaration or context. So threads that
+ * instantiate different templates rarely wait for each other.
+ *
+ * The mutexes are recursive. Never lock the instantiations of two owners at the same time, since
+ * they may share their mutex in any order.
+ * */
+class KDEVCPPDUCHAIN_EXPORT InstantiationLocks
+{
+public:
+  enum {
+    Shards = 64
+  };
+
+  struct Statistics {
+    Statistics() : locks(0), contended(0), waitedNanoseconds(0) {
+    }
+    quint64 locks;
+    ///Locks that had to wait for another thread
+    quint64 contended;
+    quint64 waitedNanoseconds;
+  };
+
+  ///Summed statistics of all shards
+  static Statistics statistics();
+  static void resetStatistics();
+};
+
+///Locks the instantiations of @p owner as long as it exists, and records the time spent waiting for the lock
+class KDEVCPPDUCHAIN_EXPORT InstantiationLocker
+{
+public:
+  explicit InstantiationLocker(const void* owner);
+  ~InstantiationLocker();
+
+  void unlock();
+  void relock();
+
+private:
+  Q_DISABLE_COPY(InstantiationLocker)
+  int m_shard;
+  bool m_locked;
+};
+
+}
+
+#endif // CPP_INSTANTIATIONLOCKS_H
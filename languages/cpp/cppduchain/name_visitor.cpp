@@ -28,11 +28,12 @@
 #include "tokens.h"
 #include "expressionparser.h"
 #include "expressionvisitor.h"
+#include "builderlock.h"
 #include <language/duchain/duchainlock.h>
 
 #include <QtCore/qdebug.h>
 
-#define LOCKDUCHAIN     DUChainReadLocker lock(DUChain::lock())
+#define LOCKDUCHAIN     Cpp::BuilderReadLocker lock
 
 using namespace KDevelop;
 using namespace Cpp;
@@ -43,6 +43,119 @@ const bool allowADL = true;
 #define ifDebugOverloadResolution(x)
 // #define ifDebugOverloadResolution(x) x
 
+namespace {
+enum CachedResolutionKind {
+  ResolveList = 1,
+  ResolveListOffsetted,
+  ResolveListViable
+};
+
+void appendDeclaration( QVector<uint>& data, const IndexedDeclaration& declaration )
+{
+  data << declaration.topContextIndex() << declaration.localIndex();
+}
+
+void appendParameters( QVector<uint>& data, const OverloadResolver::ParameterList& params )
+{
+  data << params.parameters.size();
+  foreach( const OverloadResolver::Parameter& param, params.parameters ) {
+    data << ( param.type ? param.type->indexed().index() : 0 ) << param.lValue;
+    appendDeclaration( data, param.declaration );
+  }
+}
+}
+
+namespace Cpp {
+struct OverloadResolutionCache::Key {
+  Key() : hash(0) {
+  }
+  ///The kind of resolution, its flags, the top-context, the parameters and the candidates
+  QVector<uint> data;
+  uint hash;
+
+  bool operator==( const Key& rhs ) const {
+    return hash == rhs.hash && data == rhs.data;
+  }
+
+  void computeHash() {
+    hash = 0;
+    for ( int a = 0; a < data.size(); ++a )
+      hash = hash * 31 + data[a];
+  }
+};
+
+uint qHash( const OverloadResolutionCache::Key& key ) {
+  return key.hash;
+}
+
+struct OverloadResolutionCache::Result {
+  Result() : found(false), worstConversionRank(0), generation(0) {
+  }
+  ///For resolveList(..)
+  IndexedDeclaration declaration;
+  bool found;
+  ///For resolveListOffsetted(..) and resolveListViable(..)
+  QList<ViableFunction> viableFunctions;
+  uint worstConversionRank;
+  uint generation;
+
+  ///Whether all declarations in the result still exist. The du-chain must be locked.
+  bool isAlive() const {
+    if ( found && !declaration.data() )
+      return false;
+    foreach( const ViableFunction& viable, viableFunctions )
+      if ( !viable.declaration() )
+        return false;
+    return true;
+  }
+};
+
+///Rejects cached results whose declarations were deleted. The du-chain must be locked.
+struct OverloadResolutionCache::IsAlive {
+  bool operator()( const Result& result ) const {
+    return result.isAlive();
+  }
+};
+}
+
+OverloadResolutionCache::OverloadResolutionCache()
+  : m_entries( new Entries )
+{
+}
+
+OverloadResolutionCache::~OverloadResolutionCache()
+{
+  delete m_entries;
+}
+
+OverloadResolutionCache& OverloadResolutionCache::self()
+{
+  static OverloadResolutionCache cache;
+  return cache;
+}
+
+bool OverloadResolutionCache::find( const Key& key, Result& result, uint& generation )
+{
+  //The results depend on the same du-chain state as the type-conversions
+  generation = TypeConversionCache::self().generation();
+  return m_entries->find( key, result, generation, IsAlive() );
+}
+
+void OverloadResolutionCache::insert( const Key& key, const Result& result, uint generation )
+{
+  m_entries->insert( key, result, generation );
+}
+
+void OverloadResolutionCache::clear()
+{
+  m_entries->clear();
+}
+
+OverloadResolutionCache::Statistics OverloadResolutionCache::statistics() const
+{
+  return m_entries->statistics();
+}
+
 OverloadResolver::OverloadResolver( DUContextPointer context, TopDUContextPointer topContext, Constness constness, bool forceIsInstance )
 : m_context( context )
 , m_topContext( topContext )
@@ -180,11 +293,49 @@ void OverloadResolver::expandDeclarations( const QList<QPair<OverloadResolver::P
   }
 }
 
+OverloadResolutionCache::Key OverloadResolver::cacheKey( uint kind, const ParameterList& params, const QList<Declaration*>& declarations, uint flags ) const
+{
+  OverloadResolutionCache::Key key;
+  key.data << kind << ( flags | ( m_forceIsInstance ? 8 : 0 ) ) << m_constness << m_topContext->ownIndex();
+  appendParameters( key.data, params );
+  key.data << declarations.size();
+  foreach( Declaration* decl, declarations )
+    appendDeclaration( key.data, IndexedDeclaration( decl ) );
+  key.computeHash();
+  return key;
+}
+
+OverloadResolutionCache::Key OverloadResolver::cacheKey( uint kind, const ParameterList& params, const QList<QPair<OverloadResolver::ParameterList, Declaration*> >& declarations, uint flags ) const
+{
+  OverloadResolutionCache::Key key;
+  key.data << kind << ( flags | ( m_forceIsInstance ? 8 : 0 ) ) << m_constness << m_topContext->ownIndex();
+  appendParameters( key.data, params );
+  key.data << declarations.size();
+  for ( QList<QPair<OverloadResolver::ParameterList, Declaration*> >::const_iterator it = declarations.constBegin(); it != declarations.constEnd(); ++it ) {
+    appendDeclaration( key.data, IndexedDeclaration( it->second ) );
+    appendParameters( key.data, it->first );
+  }
+  key.computeHash();
+  return key;
+}
+
 Declaration* OverloadResolver::resolveList( const ParameterList& params, const QList<Declaration*>& declarations, bool noUserDefinedConversion )
 {
   if ( !m_context || !m_topContext )
     return 0;
 
+  OverloadResolutionCache* cache = TypeConversion::isCacheEnabled() ? &OverloadResolutionCache::self() : 0;
+  OverloadResolutionCache::Key key;
+  uint cacheGeneration = 0;
+  if ( cache ) {
+    key = cacheKey( ResolveList, params, declarations, noUserDefinedConversion ? 1 : 0 );
+    OverloadResolutionCache::Result cached;
+    if ( cache->find( key, cached, cacheGeneration ) ) {
+      m_worstConversionRank = cached.worstConversionRank;
+      return cached.found ? cached.declaration.data() : 0;
+    }
+  }
+
   ///Iso c++ draft 13.3.3
   m_worstConversionRank = ExactMatch;
 
@@ -214,11 +365,17 @@ Declaration* OverloadResolver::resolveList( const ParameterList& params, const Q
     }
   }
 
-  if ( bestViableFunction.isViable() )
-    return bestViableFunction.declaration().data();
-  else {
-    return 0;
+  Declaration* ret = bestViableFunction.isViable() ? bestViableFunction.declaration().data() : 0;
+
+  if ( cache ) {
+    OverloadResolutionCache::Result result;
+    result.found = ret;
+    result.declaration = IndexedDeclaration( ret );
+    result.worstConversionRank = m_worstConversionRank;
+    cache->insert( key, result, cacheGeneration );
   }
+
+  return ret;
 }
 
 QList< ViableFunction > OverloadResolver::resolveListOffsetted( const ParameterList& params, const QList<QPair<OverloadResolver::ParameterList, Declaration*> >& declarations, bool partial )
@@ -226,6 +383,18 @@ QList< ViableFunction > OverloadResolver::resolveListOffsetted( const ParameterL
   if ( !m_context || !m_topContext )
     return QList<ViableFunction>();
 
+  OverloadResolutionCache* cache = TypeConversion::isCacheEnabled() ? &OverloadResolutionCache::self() : 0;
+  OverloadResolutionCache::Key key;
+  uint cacheGeneration = 0;
+  if ( cache ) {
+    key = cacheKey( ResolveListOffsetted, params, declarations, partial ? 1 : 0 );
+    OverloadResolutionCache::Result cached;
+    if ( cache->find( key, cached, cacheGeneration ) ) {
+      m_worstConversionRank = cached.worstConversionRank;
+      return cached.viableFunctions;
+    }
+  }
+
   ///Iso c++ draft 13.3.3
   m_worstConversionRank = ExactMatch;
 
@@ -257,6 +426,13 @@ QList< ViableFunction > OverloadResolver::resolveListOffsetted( const ParameterL
 
   qSort( viableFunctions );
 
+  if ( cache ) {
+    OverloadResolutionCache::Result result;
+    result.viableFunctions = viableFunctions;
+    result.worstConversionRank = m_worstConversionRank;
+    cache->insert( key, result, cacheGeneration );
+  }
+
   return viableFunctions;
 }
 
@@ -266,6 +442,19 @@ ViableFunction OverloadResolver::resolveListViable( const ParameterList& params,
     return ViableFunction();
 
   ifDebugOverloadResolution(qDebug() << "resolveListViable" << params; )
+
+  OverloadResolutionCache* cache = TypeConversion::isCacheEnabled() ? &OverloadResolutionCache::self() : 0;
+  OverloadResolutionCache::Key key;
+  uint cacheGeneration = 0;
+  if ( cache ) {
+    key = cacheKey( ResolveListViable, params, declarations, partial ? 1 : 0 );
+    OverloadResolutionCache::Result cached;
+    if ( cache->find( key, cached, cacheGeneration ) ) {
+      m_worstConversionRank = cached.worstConversionRank;
+      return cached.viableFunctions.isEmpty() ? ViableFunction( m_topContext.data() ) : cached.viableFunctions.first();
+    }
+  }
+
   ///Iso c++ draft 13.3.3
   m_worstConversionRank = ExactMatch;
 
@@ -297,6 +486,14 @@ ViableFunction OverloadResolver::resolveListViable( const ParameterList& params,
     }
   }
 
+  if ( cache ) {
+    OverloadResolutionCache::Result result;
+    if ( bestViableFunction.declaration() )
+      result.viableFunctions << bestViableFunction;
+    result.worstConversionRank = m_worstConversionRank;
+    cache->insert( key, result, cacheGeneration );
+  }
+
   return bestViableFunction;
 }
 
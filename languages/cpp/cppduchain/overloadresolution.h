@@ -23,6 +23,7 @@
 #include <language/duchain/duchainpointer.h>
 #include <QList>
 #include "cppduchainexport.h"
+#include "shardedcache.h"
 #include <language/duchain/identifier.h>
 
 namespace KDevelop {
@@ -34,6 +35,48 @@ namespace Cpp {
 using namespace KDevelop;
   class ViableFunction;
 
+/**
+ * Results of overload-resolutions, shared by all threads that enabled caching with TypeConversion::startCache().
+ *
+ * A result is identified by the candidate declarations, the types of the arguments, the constness and the top-context.
+ * Repeated calls like "qDebug() << x" can so be resolved with a single lookup. The results are invalidated together
+ * with the TypeConversionCache, whenever an existing top-context is updated.
+ * */
+class KDEVCPPDUCHAIN_EXPORT OverloadResolutionCache
+{
+  public:
+    enum {
+      Shards = 16,
+      MaxEntriesPerShard = 4096
+    };
+
+    ///Lookups that find a result with deleted declarations count as outdated
+    typedef ShardedCacheStatistics Statistics;
+
+    static OverloadResolutionCache& self();
+
+    void clear();
+
+    Statistics statistics() const;
+
+  private:
+    OverloadResolutionCache();
+    ~OverloadResolutionCache();
+    struct Key;
+    struct Result;
+    struct IsAlive;
+    typedef ShardedCache<Key, Result, Shards, MaxEntriesPerShard> Entries;
+
+    ///@p generation is set to the generation of the type-conversions the lookup was done in,
+    ///it must be given to insert() when the result is computed after a failed lookup
+    bool find(const Key& key, Result& result, uint& generation);
+    void insert(const Key& key, const Result& result, uint generation);
+
+    Entries* m_entries;
+    friend class OverloadResolver;
+    friend uint qHash(const Key& key);
+};
+
 /**
  * Models overloaded function resolution
  * The du-chain must be locked for the whole lifetime of this object.
@@ -206,6 +249,10 @@ class KDEVCPPDUCHAIN_EXPORT OverloadResolver {
     uint matchParameterTypes(AbstractType::Ptr argumentType, const IndexedTypeIdentifier& parameterType, QMap<IndexedString, AbstractType::Ptr>& instantiatedTypes, bool keepValue) const;
     uint matchParameterTypes(AbstractType::Ptr argumentType, const Identifier& parameterType, QMap<IndexedString, AbstractType::Ptr>& instantiatedTypes, bool keepValue) const;
 
+    ///Identifies a resolution in the OverloadResolutionCache
+    OverloadResolutionCache::Key cacheKey( uint kind, const ParameterList& params, const QList<Declaration*>& declarations, uint flags ) const;
+    OverloadResolutionCache::Key cacheKey( uint kind, const ParameterList& params, const QList<QPair<OverloadResolver::ParameterList, Declaration*> >& declarations, uint flags ) const;
+
     DUContextPointer m_context;
     TopDUContextPointer m_topContext;
     uint m_worstConversionRank;
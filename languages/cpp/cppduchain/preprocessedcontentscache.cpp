@@ -0,0 +1,278 @@
+/* This file is part of KDevelop
+   Copyright 2014 KDevelop developers
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2 as published by the Free Software Foundation.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "preprocessedcontentscache.h"
+
+#include <QMutexLocker>
+
+#include <language/duchain/repositories/itemrepository.h>
+#include <language/duchain/appendedlist.h>
+#include <language/duchain/indexedstring.h>
+#include <language/duchain/duchain.h>
+#include <language/duchain/topducontext.h>
+#include <language/duchain/parsingenvironment.h>
+
+#include "environmentmanager.h"
+#include "cpppreprocessenvironment.h"
+#include "contextbuilder.h"
+#include "parser/rpp/pp-location.h"
+
+using namespace KDevelop;
+
+namespace Cpp {
+
+///All members are 32 bits wide, so the item is stored without padding and with the same layout everywhere
+struct CachedAnchor {
+  quint32 offset;
+  qint32 line, column;
+  qint32 expansionLine, expansionColumn;
+  quint32 collapsed;
+};
+
+///A file that was included, identified by its top-context and the revision it had when it was included
+struct CachedInclude {
+  IndexedString url;
+  quint32 topContext;
+  qint32 line;
+  quint32 modificationTime;
+  qint32 revision;
+};
+
+DEFINE_LIST_MEMBER_HASH(PreprocessedContentsItem, m_contents, IndexedString)
+DEFINE_LIST_MEMBER_HASH(PreprocessedContentsItem, m_anchors, CachedAnchor)
+DEFINE_LIST_MEMBER_HASH(PreprocessedContentsItem, m_includes, CachedInclude)
+DEFINE_LIST_MEMBER_HASH(PreprocessedContentsItem, m_includePaths, IndexedString)
+
+struct PreprocessedContentsItem {
+
+    PreprocessedContentsItem() {
+      initializeAppendedLists(true);
+      m_contentHash = 0;
+      m_contentSize = 0;
+      m_usedMacros = 0;
+      m_definedMacros = 0;
+      m_headerSectionBranchingHash = 0;
+    }
+    PreprocessedContentsItem(const PreprocessedContentsItem& rhs, bool dynamic)
+      : m_url(rhs.m_url)
+      , m_contentHash(rhs.m_contentHash)
+      , m_contentSize(rhs.m_contentSize)
+      , m_usedMacros(rhs.m_usedMacros)
+      , m_definedMacros(rhs.m_definedMacros)
+      , m_headerSectionBranchingHash(rhs.m_headerSectionBranchingHash)
+    {
+      initializeAppendedLists(dynamic);
+      copyListsFrom(rhs);
+    }
+    ~PreprocessedContentsItem() {
+      freeAppendedLists();
+    }
+
+    bool persistent() const {
+      return true;
+    }
+
+    ///There is only one entry per document, so only the url is compared
+    bool operator==(const PreprocessedContentsItem& rhs) const {
+      return m_url == rhs.m_url;
+    }
+
+    uint hash() const {
+      return m_url.hash();
+    }
+
+    uint itemSize() const {
+      return dynamicSize();
+    }
+
+    uint classSize() const {
+      return sizeof(*this);
+    }
+
+    IndexedString m_url;
+    uint m_contentHash;
+    int m_contentSize;
+    //Set-indices of the used and defined macro-sets of the environment-file
+    uint m_usedMacros;
+    uint m_definedMacros;
+    uint m_headerSectionBranchingHash;
+
+    START_APPENDED_LISTS(PreprocessedContentsItem);
+    APPENDED_LIST_FIRST(PreprocessedContentsItem, IndexedString, m_contents);
+    APPENDED_LIST(PreprocessedContentsItem, CachedAnchor, m_anchors, m_contents);
+    APPENDED_LIST(PreprocessedContentsItem, CachedInclude, m_includes, m_anchors);
+    APPENDED_LIST(PreprocessedContentsItem, IndexedString, m_includePaths, m_includes);
+    END_APPENDED_LISTS(PreprocessedContentsItem, m_includePaths);
+  private:
+    PreprocessedContentsItem& operator=(const PreprocessedContentsItem&);
+};
+
+typedef AppendedListItemRequest<PreprocessedContentsItem, 1024 * 4> PreprocessedContentsRequest;
+
+typedef KDevelop::ItemRepository<PreprocessedContentsItem, PreprocessedContentsRequest> PreprocessedContentsRepository;
+
+static PreprocessedContentsRepository& preprocessedContentsRepository()
+{
+  static PreprocessedContentsRepository repo("preprocessed contents repository");
+  return repo;
+}
+
+static bool sameIncludePaths(const PreprocessedContentsItem& item, const QList<IndexedString>& includePaths)
+{
+  if(item.m_includePathsSize() != (uint)includePaths.size())
+    return false;
+  for(uint a = 0; a < item.m_includePathsSize(); ++a) {
+    if(item.m_includePaths()[a] != includePaths[a])
+      return false;
+  }
+  return true;
+}
+
+PreprocessedContentsCache& PreprocessedContentsCache::self()
+{
+  static PreprocessedContentsCache cache;
+  return cache;
+}
+
+PreprocessedContentsCache::PreprocessedContentsCache()
+{
+  preprocessedContentsRepository();
+}
+
+rpp::LocationTable* PreprocessedContentsCache::load(const IndexedString& url, const EnvironmentFile& environmentFile,
+                                                    const CppPreprocessEnvironment& environment, const QList<IndexedString>& includePaths,
+                                                    const QByteArray& contents, PreprocessedContents& result,
+                                                    IncludeFileList& includedFiles, uint& headerSectionBranchingHash)
+{
+  PreprocessedContentsItem request;
+  request.m_url = url;
+
+  QMutexLocker lock(preprocessedContentsRepository().mutex());
+
+  uint index = preprocessedContentsRepository().findIndex(request);
+  if(!index)
+    return 0;
+
+  const PreprocessedContentsItem* item = preprocessedContentsRepository().itemFromIndex(index);
+
+  if(item->m_contentSize != contents.size() || item->m_contentHash != qHash(contents)
+     || item->m_usedMacros != environmentFile.usedMacros().set().setIndex()
+     || item->m_definedMacros != environmentFile.definedMacros().set().setIndex()
+     || !sameIncludePaths(*item, includePaths))
+  {
+    return 0;
+  }
+
+  //The environment-file was matched according to the matching-level, which may ignore the macros completely
+  if(!environmentFile.matchMacros(&environment))
+    return 0;
+
+  IncludeFileList included;
+  FOREACH_FUNCTION(const CachedInclude& include, item->m_includes) {
+    TopDUContext* context = DUChain::self()->chainForIndex(include.topContext);
+    //The index may have been re-used for another context, or the file may have been parsed again
+    if(!context || context->url() != include.url || !context->parsingEnvironmentFile())
+      return 0;
+    const ModificationRevision revision = context->parsingEnvironmentFile()->modificationRevision();
+    if(revision.modificationTime != include.modificationTime || revision.revision != include.revision)
+      return 0;
+    included << LineContextPair(context, include.line);
+  }
+
+  result.resize(item->m_contentsSize());
+  for(uint a = 0; a < item->m_contentsSize(); ++a)
+    result[a] = item->m_contents()[a].index();
+
+  headerSectionBranchingHash = item->m_headerSectionBranchingHash;
+  includedFiles = included;
+
+  rpp::LocationTable* table = new rpp::LocationTable;
+  FOREACH_FUNCTION(const CachedAnchor& anchor, item->m_anchors) {
+    table->anchor(anchor.offset, rpp::Anchor(anchor.line, anchor.column, anchor.collapsed,
+                                             CursorInRevision(anchor.expansionLine, anchor.expansionColumn)), &result);
+  }
+
+  return table;
+}
+
+void PreprocessedContentsCache::store(const IndexedString& url, const EnvironmentFile& environmentFile,
+                                      const QList<IndexedString>& includePaths, const QByteArray& contents,
+                                      const PreprocessedContents& result, const rpp::LocationTable& table,
+                                      const IncludeFileList& includedFiles, uint headerSectionBranchingHash)
+{
+  PreprocessedContentsItem item;
+  item.m_url = url;
+  item.m_contentHash = qHash(contents);
+  item.m_contentSize = contents.size();
+  item.m_usedMacros = environmentFile.usedMacros().set().setIndex();
+  item.m_definedMacros = environmentFile.definedMacros().set().setIndex();
+  item.m_headerSectionBranchingHash = headerSectionBranchingHash;
+
+  foreach(uint index, result)
+    item.m_contentsList().append(IndexedString::fromIndex(index));
+
+  const rpp::LocationTable::OffsetTable& anchors = table.anchors();
+  for(rpp::LocationTable::OffsetTable::const_iterator it = anchors.constBegin(); it != anchors.constEnd(); ++it) {
+    CachedAnchor anchor;
+    anchor.offset = it.key();
+    anchor.line = it->line;
+    anchor.column = it->column;
+    anchor.collapsed = it->collapsed;
+    anchor.expansionLine = it->macroExpansion.line;
+    anchor.expansionColumn = it->macroExpansion.column;
+    item.m_anchorsList().append(anchor);
+  }
+
+  foreach(const LineContextPair& included, includedFiles) {
+    if(!included.context || !included.context->parsingEnvironmentFile())
+      return;
+    const ModificationRevision revision = included.context->parsingEnvironmentFile()->modificationRevision();
+    CachedInclude include;
+    include.url = included.context->url();
+    include.topContext = included.context->ownIndex();
+    include.line = included.sourceLine;
+    include.modificationTime = revision.modificationTime;
+    include.revision = revision.revision;
+    item.m_includesList().append(include);
+  }
+
+  foreach(const IndexedString& path, includePaths)
+    item.m_includePathsList().append(path);
+
+  QMutexLocker lock(preprocessedContentsRepository().mutex());
+
+  uint index = preprocessedContentsRepository().findIndex(item);
+  if(index)
+    preprocessedContentsRepository().deleteItem(index);
+
+  preprocessedContentsRepository().index(item);
+}
+
+void PreprocessedContentsCache::remove(const IndexedString& url)
+{
+  PreprocessedContentsItem request;
+  request.m_url = url;
+
+  QMutexLocker lock(preprocessedContentsRepository().mutex());
+
+  uint index = preprocessedContentsRepository().findIndex(request);
+  if(index)
+    preprocessedContentsRepository().deleteItem(index);
+}
+
+}
@@ -0,0 +1,112 @@
+/* This file is part of KDevelop
+   Copyright 2014 KDevelop developers
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2 as published by the Free Software Foundation.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef PREPROCESSEDCONTENTSCACHE_H
+#define PREPROCESSEDCONTENTSCACHE_H
+
+#include <QVector>
+#include <QByteArray>
+#include <QList>
+
+#include "cppduchainexport.h"
+
+typedef QVector<unsigned int> PreprocessedContents;
+
+namespace KDevelop {
+class IndexedString;
+}
+
+namespace rpp {
+class LocationTable;
+}
+
+struct LineContextPair;
+class CppPreprocessEnvironment;
+
+namespace Cpp {
+
+class EnvironmentFile;
+
+/**
+ * Persistent cache of preprocessed file contents, stored in an item repository together with the DUChain,
+ * so it survives across sessions.
+ *
+ * For each document the token stream that came out of the preprocessor is stored together with its
+ * location table and the files it included. An entry is keyed by the hash of the raw file contents, by the
+ * identity of the EnvironmentFile that was created while preprocessing it, and by the include-paths.
+ *
+ * When a file needs to be re-parsed, the stored token stream can be used instead of preprocessing it again if
+ * - the contents didn't change,
+ * - the environment contains exactly the macros the file used from outside, regardless of the matching-level,
+ * - the include-paths are the same,
+ * - the included files were not parsed again since.
+ * The side-effects on the environment are then taken from the EnvironmentFile, and the included files
+ * are imported just like they were back then. Files that produced problems are not cached.
+ *
+ * Only one entry is kept per document.
+ *
+ * All functions are thread-safe. The DUChain must be at least read-locked, since the EnvironmentFile
+ * and the included contexts are accessed.
+ * */
+class KDEVCPPDUCHAIN_EXPORT PreprocessedContentsCache {
+  public:
+    static PreprocessedContentsCache& self();
+
+    /**
+     * Retrieves the cached preprocessed version of @p url.
+     *
+     * @param environmentFile The environment-file of the last time @p url was preprocessed, that will be used
+     *                        to reproduce the side-effects of preprocessing.
+     * @param environment The environment the file is preprocessed in
+     * @param includePaths The include-paths the file is preprocessed with
+     * @param contents The raw contents of the file
+     * @param result Will be filled with the preprocessed contents
+     * @param includedFiles Will be filled with the files that were included, whose contexts still exist.
+     *                      The caller must make sure they are still up to date.
+     * @param headerSectionBranchingHash Will be filled with the branching-hash the preprocessor had
+     *                                   when the header-section ended, see rpp::pp::branchingHash()
+     * @return A newly created location-table for @p result, or zero if there was no matching cache-entry.
+     *         The caller takes ownership.
+     * */
+    rpp::LocationTable* load(const KDevelop::IndexedString& url, const EnvironmentFile& environmentFile,
+                             const CppPreprocessEnvironment& environment, const QList<KDevelop::IndexedString>& includePaths,
+                             const QByteArray& contents, PreprocessedContents& result,
+                             QList<LineContextPair>& includedFiles, uint& headerSectionBranchingHash);
+
+    /**
+     * Stores the preprocessed version of @p url, replacing any previously stored version.
+     *
+     * @param environmentFile The complete environment-file that was created while preprocessing.
+     * @param includedFiles The files that were included while preprocessing, in the order they were included.
+     * */
+    void store(const KDevelop::IndexedString& url, const EnvironmentFile& environmentFile,
+               const QList<KDevelop::IndexedString>& includePaths, const QByteArray& contents,
+               const PreprocessedContents& result, const rpp::LocationTable& table,
+               const QList<LineContextPair>& includedFiles, uint headerSectionBranchingHash);
+
+    ///Removes the cached version of @p url, if there is one. Used when the file could not be read any more.
+    void remove(const KDevelop::IndexedString& url);
+
+  private:
+    PreprocessedContentsCache();
+    Q_DISABLE_COPY(PreprocessedContentsCache)
+};
+
+}
+
+#endif // PREPROCESSEDCONTENTSCACHE_H
@@ -0,0 +1,157 @@
+/*
+ * This file is part of KDevelop
+ *
+ * Copyright 2014 KDevelop developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef CPP_SHARDEDCACHE_H
+#define CPP_SHARDEDCACHE_H
+
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+
+namespace Cpp {
+
+struct ShardedCacheStatistics {
+  ShardedCacheStatistics() : hits(0), misses(0), outdated(0), insertions(0), evictions(0), entries(0) {
+  }
+  uint hits;
+  uint misses;
+  ///Lookups that found a result of an earlier generation, or one that was rejected otherwise
+  uint outdated;
+  uint insertions;
+  uint evictions;
+  uint entries;
+};
+
+/**
+ * The storage of the result-caches that are shared by the parse-threads.
+ *
+ * The entries are split into @p Shards shards with separate locks, so concurrent threads rarely wait for each other.
+ * Each value is stored together with the generation it was computed in, and only found by lookups of the same
+ * generation. A full shard evicts the entry that comes first in its hash-order, which is cheaper than tracking
+ * the age of the entries, and good enough since each shard holds @p MaxEntriesPerShard of them.
+ *
+ * @p Value needs a public member "uint generation", and qHash() must be defined for @p Key.
+ * */
+template<class Key, class Value, int Shards, int MaxEntriesPerShard>
+class ShardedCache
+{
+  public:
+    typedef ShardedCacheStatistics Statistics;
+
+    ShardedCache() : m_shards(new Shard[Shards]) {
+    }
+
+    ~ShardedCache() {
+      delete[] m_shards;
+    }
+
+    ///Finds the value for @p key that was computed in @p generation. @p isValid is called on it
+    ///while the shard is locked, and can reject it like a value of an earlier generation.
+    template<class Validator>
+    bool find(const Key& key, Value& value, uint generation, const Validator& isValid) {
+      Shard& s(shard(key));
+      QMutexLocker lock(&s.mutex);
+      typename QHash<Key, Value>::const_iterator it = s.entries.constFind(key);
+      if(it == s.entries.constEnd()) {
+        ++s.statistics.misses;
+        return false;
+      }
+      if(it->generation != generation || !isValid(*it)) {
+        ++s.statistics.outdated;
+        return false;
+      }
+      ++s.statistics.hits;
+      value = *it;
+      return true;
+    }
+
+    bool find(const Key& key, Value& value, uint generation) {
+      return find(key, value, generation, AlwaysValid());
+    }
+
+    ///Stores @p value as computed in @p generation, which must be the generation of the lookup that failed
+    ///before computing it, so results that were computed while the generation was increased are never found
+    void insert(const Key& key, const Value& value, uint generation) {
+      Value stored(value);
+      stored.generation = generation;
+      Shard& s(shard(key));
+      QMutexLocker lock(&s.mutex);
+      typename QHash<Key, Value>::iterator it = s.entries.find(key);
+      if(it != s.entries.end()) {
+        *it = stored;
+      } else {
+        if(s.entries.size() >= MaxEntriesPerShard) {
+          s.entries.erase(s.entries.begin());
+          ++s.statistics.evictions;
+        }
+        s.entries.insert(key, stored);
+      }
+      ++s.statistics.insertions;
+    }
+
+    void clear() {
+      for(int a = 0; a < Shards; ++a) {
+        QMutexLocker lock(&m_shards[a].mutex);
+        m_shards[a].entries.clear();
+        m_shards[a].statistics = Statistics();
+      }
+    }
+
+    Statistics statistics() const {
+      Statistics ret;
+      for(int a = 0; a < Shards; ++a) {
+        QMutexLocker lock(&m_shards[a].mutex);
+        const Statistics& s(m_shards[a].statistics);
+        ret.hits += s.hits;
+        ret.misses += s.misses;
+        ret.outdated += s.outdated;
+        ret.insertions += s.insertions;
+        ret.evictions += s.evictions;
+        ret.entries += m_shards[a].entries.size();
+      }
+      return ret;
+    }
+
+  private:
+    struct AlwaysValid {
+      bool operator()(const Value&) const {
+        return true;
+      }
+    };
+
+    struct Shard {
+      mutable QMutex mutex;
+      QHash<Key, Value> entries;
+      Statistics statistics;
+    };
+
+    Shard& shard(const Key& key) const {
+      const uint hash = qHash(key);
+      return m_shards[(hash ^ (hash >> 16)) % Shards];
+    }
+
+    Shard* m_shards;
+    Q_DISABLE_COPY(ShardedCache)
+};
+
+}
+
+#endif
@@ -19,6 +19,7 @@
 
 
 #include "templatedeclaration.h"
+#include "instantiationlocks.h"
 
 #include <QThreadStorage>
 #include <kglobal.h>
@@ -58,7 +59,6 @@ REGISTER_TEMPLATE_DECLARATION(FunctionDefinition)
 REGISTER_TEMPLATE_DECLARATION(AliasDeclaration)
 REGISTER_TEMPLATE_DECLARATION(ForwardDeclaration)
 
-QMutex TemplateDeclaration::instantiationsMutex(QMutex::Recursive);
 
 typedef CppDUContext<KDevelop::DUContext> StandardCppDUContext;
 
@@ -367,6 +367,7 @@ TemplateDeclaration::~TemplateDeclaration()
   {
     ///Unregister at the declaration this one is instantiated from
     if( m_instantiatedFrom ) {
+      InstantiationLocker l(m_instantiatedFrom);
       InstantiationsHash::iterator it = m_instantiatedFrom->m_instantiations.find(m_instantiatedWith);
       if( it != m_instantiatedFrom->m_instantiations.end() ) {
         Q_ASSERT(*it == this);
@@ -411,7 +412,7 @@ void TemplateDeclaration::setSpecializedFrom(TemplateDeclaration* other) {
 }
 
 void TemplateDeclaration::reserveInstantiation(const IndexedInstantiationInformation& info) {
-  QMutexLocker l(&instantiationsMutex);
+  InstantiationLocker l(this);
 
   Q_ASSERT(m_instantiations.find(info) == m_instantiations.end());
   m_instantiations.insert(info, 0);
@@ -457,27 +458,30 @@ void TemplateDeclaration::setInstantiatedFrom(TemplateDeclaration* from, const I
   Q_ASSERT(from != this);
   //Change the identifier so it contains the template-parameters
 
-  QMutexLocker l(&instantiationsMutex);
   if( m_instantiatedFrom ) {
+    InstantiationLocker l(m_instantiatedFrom);
     InstantiationsHash::iterator it = m_instantiatedFrom->m_instantiations.find(m_instantiatedWith);
     if( it != m_instantiatedFrom->m_instantiations.end() && *it == this )
       m_instantiatedFrom->m_instantiations.erase(it);
 
     m_instantiatedFrom = 0;
   }
-  m_instantiatedFrom = from;
   m_instantiatedWith = instantiatedWith.indexed();
+  if(!from)
+    return;
+
+  //Lock only the new owner, so other threads see the instantiation and its registration at the same time
+  InstantiationLocker l(from);
+  m_instantiatedFrom = from;
   //Only one instantiation is allowed
-  if(from) {
-    //Either it must be reserved, or not exist yet
-    Q_ASSERT(from->m_instantiations.find(instantiatedWith.indexed()) == from->m_instantiations.end() || (*from->m_instantiations.find(instantiatedWith.indexed())) == 0);
-    from->m_instantiations.insert(m_instantiatedWith, this);
-    Q_ASSERT(from->m_instantiations.contains(m_instantiatedWith));
-  }
+  //Either it must be reserved, or not exist yet
+  Q_ASSERT(from->m_instantiations.find(m_instantiatedWith) == from->m_instantiations.end() || (*from->m_instantiations.find(m_instantiatedWith)) == 0);
+  from->m_instantiations.insert(m_instantiatedWith, this);
+  Q_ASSERT(from->m_instantiations.contains(m_instantiatedWith));
 }
 
 bool TemplateDeclaration::isInstantiatedFrom(const TemplateDeclaration* other) const {
-    QMutexLocker l(&instantiationsMutex);
+    InstantiationLocker l(other);
 
     InstantiationsHash::const_iterator it = other->m_instantiations.find(m_instantiatedWith);
     if( it != other->m_instantiations.end() && (*it) == this )
@@ -746,7 +750,7 @@ void TemplateDeclaration::deleteAllInstantiations()
 
   InstantiationsHash instantiations;
   {
-    QMutexLocker l(&instantiationsMutex);
+    InstantiationLocker l(this);
     instantiations = m_instantiations;
     m_defaultParameterInstantiations.clear();
     m_instantiations.clear();
@@ -958,7 +962,7 @@ Declaration* TemplateDeclaration::instantiate( const InstantiationInformation& _
     return dynamic_cast<TemplateDeclaration*>(specializedFrom().declaration())->instantiate(templateArguments, source);
 
   {
-    QMutexLocker l(&instantiationsMutex);
+    InstantiationLocker l(this);
     {
       DefaultParameterInstantiationHash::const_iterator it = m_defaultParameterInstantiations.constFind(templateArguments.indexed());
       if(it != m_defaultParameterInstantiations.constEnd())
@@ -1055,7 +1059,7 @@ Declaration* TemplateDeclaration::instantiate( const InstantiationInformation& _
     }
     
     if(!(templateArguments == _templateArguments)) {
-      QMutexLocker l(&instantiationsMutex);
+      InstantiationLocker l(this);
       m_defaultParameterInstantiations[_templateArguments.indexed()] = templateArguments.indexed();
     }
   }
@@ -1064,7 +1068,7 @@ Declaration* TemplateDeclaration::instantiate( const InstantiationInformation& _
     //Now we have the final template-parameters. Once again check whether we have already instantiated this,
     //and if not, reserve the instantiation so we cannot crash later on
     ///@todo When the same declaration is instantuated multiple times, this sucks because one is returned invalid
-    QMutexLocker l(&instantiationsMutex);
+    InstantiationLocker l(this);
     InstantiationsHash::const_iterator it;
     it = m_instantiations.constFind( templateArguments.indexed() );
     if( it != m_instantiations.constEnd() ) {
@@ -1159,7 +1163,7 @@ IndexedInstantiationInformation TemplateDeclaration::instantiatedWith() const {
 }
 
 TemplateDeclaration::InstantiationsHash TemplateDeclaration::instantiations() const {
-    QMutexLocker l(&instantiationsMutex);
+    InstantiationLocker l(this);
     return m_instantiations;
 }
 
@@ -142,8 +142,7 @@ namespace Cpp {
 
       IndexedInstantiationInformation m_instantiatedWith;
       
-      static QMutex instantiationsMutex;
-      ///Every access to m_instantiations must be serialized through instantiationsMutex!
+      ///Every access to m_instantiations and m_defaultParameterInstantiations must be serialized through InstantiationLocker(this)!
       typedef QHash<IndexedInstantiationInformation, IndexedInstantiationInformation> DefaultParameterInstantiationHash;
       DefaultParameterInstantiationHash m_defaultParameterInstantiations;
       InstantiationsHash m_instantiations; ///Every declaration nested within a template declaration knows all its instantiations.
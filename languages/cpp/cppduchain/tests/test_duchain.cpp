@@ -32,9 +32,14 @@
 #include "sourcemanipulation.h"
 #include "ptrtomembertype.h"
 #include "overloadresolution.h"
+#include "instantiationlocks.h"
+#include "includesymbolindex.h"
+#include "builderlock.h"
 
 #include "rpp/chartools.h"
 #include "rpp/pp-engine.h"
+#include "parser.h"
+#include "parsesession.h"
 #include "rpp/preprocessor.h"
 
 #include <language/duchain/duchain.h>
@@ -59,6 +64,14 @@
 
 #include <typeinfo>
 
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QRunnable>
+#include <QThreadPool>
+
 #include <tests/testhelpers.h>
 #include <tests/testcore.h>
 
@@ -70,6 +83,120 @@ using namespace Utils;
 
 QTEST_MAIN(TestDUChain)
 
+namespace {
+
+///Templates in the style of the STL, and the item-types they are instantiated with by all units
+QByteArray instantiationHeader(int items)
+{
+  QByteArray ret =
+    "namespace std {\n"
+    "template<class T> struct less { bool operator()(const T& a, const T& b) const; };\n"
+    "template<class T> struct allocator { typedef T value_type; typedef T* pointer; typedef T& reference; };\n"
+    "template<class T1, class T2> struct pair { typedef T1 first_type; typedef T2 second_type; T1 first; T2 second; };\n"
+    "template<class T, class A = allocator<T> > class vector { public: typedef typename A::pointer iterator; typedef typename A::reference reference;\n"
+    "  reference operator[](int i); reference front(); iterator begin(); };\n"
+    "template<class K, class V, class C = less<K> > class map { public: typedef pair<const K, V> value_type; typedef value_type* iterator;\n"
+    "  V& operator[](const K& key); iterator find(const K& key); };\n"
+    "}\n";
+  for (int item = 0; item < items; ++item)
+    ret += QString("struct Item%1 { int value; };\n").arg(item).toUtf8();
+  return ret;
+}
+
+///A template-heavy translation-unit that includes instantiationHeader(). All units instantiate the same
+///containers of the header, so the parse-threads compete for the same instantiations.
+QByteArray instantiationUnit(int unit, int functions)
+{
+  QByteArray ret;
+  for (int f = 0; f < functions; ++f) {
+    ret += QString(
+      "void use%1_%2() {\n"
+      "  std::vector<Item%2> items; items[0].value = 1; items.front().value = 2;\n"
+      "  std::map<int, std::vector<Item%2> > byKey; byKey[1].front().value = 3;\n"
+      "  std::map<int, std::vector<Item%2> >::iterator it = byKey.find(1); it->second.front().value = 4;\n"
+      "  std::vector<std::pair<Item%2, std::map<int, Item%2> > > nested; nested[0].first.value = 5; nested[0].second[2].value = 6;\n"
+      "}\n").arg(unit).arg(f).toUtf8();
+  }
+  return ret;
+}
+
+///Builds the declarations and uses of @p contents importing @p header, like a parse-job does
+TopDUContext* buildInstantiationUnit(const QByteArray& contents, TopDUContext* header)
+{
+  static QAtomicInt unitNumber(0);
+  const IndexedString url(QString("/internal/instantiation%1").arg(unitNumber.fetchAndAddRelaxed(1)));
+
+  ParseSession::Ptr session(new ParseSession());
+  rpp::Preprocessor preprocessor;
+  rpp::pp pp(&preprocessor);
+  session->setContentsAndGenerateLocationTable(pp.processFile(url.str(), contents));
+
+  Control control;
+  Parser parser(&control);
+  TranslationUnitAST* ast = parser.parse(session.data());
+  ast->session = session.data();
+
+  IncludeFileList includes;
+  if (header)
+    includes << LineContextPair(header, 0);
+
+  DeclarationBuilder declarationBuilder(session.data());
+  Cpp::EnvironmentFilePointer file(new Cpp::EnvironmentFile(url, 0));
+  TopDUContext* top = declarationBuilder.buildDeclarations(file, ast, &includes);
+  UseBuilder useBuilder(session.data());
+  useBuilder.buildUses(ast);
+  return top;
+}
+
+class InstantiationParseRunnable : public QRunnable
+{
+public:
+  InstantiationParseRunnable(const QByteArray& contents, TopDUContext* header, QList<TopDUContext*>* tops, QMutex* mutex)
+    : m_contents(contents), m_header(header), m_tops(tops), m_mutex(mutex)
+  {}
+
+  virtual void run()
+  {
+    TopDUContext* top = buildInstantiationUnit(m_contents, m_header);
+    QMutexLocker lock(m_mutex);
+    m_tops->append(top);
+  }
+
+private:
+  QByteArray m_contents;
+  TopDUContext* m_header;
+  QList<TopDUContext*>* m_tops;
+  QMutex* m_mutex;
+};
+
+QList<TopDUContext*> parseInParallel(const QList<QByteArray>& units, TopDUContext* header, int threads)
+{
+  QList<TopDUContext*> tops;
+  QMutex mutex;
+  QThreadPool pool;
+  pool.setMaxThreadCount(threads);
+  foreach (const QByteArray& unit, units)
+    pool.start(new InstantiationParseRunnable(unit, header, &tops, &mutex));
+  pool.waitForDone();
+  return tops;
+}
+
+///Counts the uses of the members named "value" of @p header in @p context and its children
+int headerValueUses(DUContext* context, TopDUContext* header)
+{
+  int ret = 0;
+  for (int a = 0; a < context->usesCount(); ++a) {
+    Declaration* used = context->uses()[a].usedDeclaration(context->topContext());
+    if (used && used->topContext() == header && used->identifier() == Identifier("value"))
+      ++ret;
+  }
+  foreach (DUContext* child, context->childContexts())
+    ret += headerValueUses(child, header);
+  return ret;
+}
+
+}
+
 #define TEST_FILE_PARSE_ONLY if (testFileParseOnly) QSKIP("Skip", SkipSingle);
 TestDUChain::TestDUChain()
 {
@@ -4773,6 +4900,234 @@ void TestDUChain::testTemplateParameters() {
 
 }
 
+void TestDUChain::testParallelInstantiation()
+{
+  TopDUContext* header = buildInstantiationUnit(instantiationHeader(3), 0);
+  QList<QByteArray> units;
+  for (int unit = 0; unit < 8; ++unit)
+    units << instantiationUnit(unit, 3);
+
+  InstantiationLocks::resetStatistics();
+  QList<TopDUContext*> tops = parseInParallel(units, header, 4);
+  QCOMPARE(tops.size(), units.size());
+
+  DUChainWriteLocker lock(DUChain::lock());
+  //The members of the shared items are used through the shared instantiations in every unit alike
+  //Each function of instantiationUnit() uses "value" six times
+  foreach (TopDUContext* top, tops) {
+    QCOMPARE(headerValueUses(top, header), 3 * 6);
+    release(top);
+  }
+  release(header);
+  QVERIFY(InstantiationLocks::statistics().locks > 0);
+}
+
+void TestDUChain::benchParallelInstantiation_data()
+{
+  QTest::addColumn<int>("threads");
+  QTest::newRow("1 thread") << 1;
+  QTest::newRow("2 threads") << 2;
+  QTest::newRow("4 threads") << 4;
+  QTest::newRow("8 threads") << 8;
+}
+
+void TestDUChain::benchParallelInstantiation()
+{
+  QFETCH(int, threads);
+
+  //All units instantiate the same templates of one header, like translation-units that include the same STL headers.
+  //A preprocessed real-world file given in KDEV_INSTANTIATION_BENCHMARK_FILE is parsed by all units instead.
+  TopDUContext* header = 0;
+  QList<QByteArray> units;
+  const QByteArray corpus = qgetenv("KDEV_INSTANTIATION_BENCHMARK_FILE");
+  if (!corpus.isEmpty()) {
+    QFile file(QString::fromLocal8Bit(corpus));
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QByteArray contents = file.readAll();
+    for (int unit = 0; unit < 16; ++unit)
+      units << contents;
+  } else {
+    header = buildInstantiationUnit(instantiationHeader(20), 0);
+    for (int unit = 0; unit < 32; ++unit)
+      units << instantiationUnit(unit, 20);
+  }
+
+  InstantiationLocks::resetStatistics();
+  QElapsedTimer timer;
+  timer.start();
+  int runs = 0;
+  QBENCHMARK {
+    QList<TopDUContext*> tops = parseInParallel(units, header, threads);
+    ++runs;
+    DUChainWriteLocker lock(DUChain::lock());
+    foreach (TopDUContext* top, tops)
+      release(top);
+  }
+
+  const InstantiationLocks::Statistics statistics = InstantiationLocks::statistics();
+  qDebug() << threads << "threads:" << double(timer.elapsed()) / runs << "ms per run," << statistics.locks / runs << "instantiation-locks,"
+           << statistics.contended / runs << "contended, waited" << double(statistics.waitedNanoseconds) / runs / 1000000 << "ms";
+
+  if (header) {
+    DUChainWriteLocker lock(DUChain::lock());
+    release(header);
+  }
+}
+
+void TestDUChain::testIncludeSymbolIndex()
+{
+  TopDUContext* header = parse("class A {}; class Forward; namespace N { void f(); struct S; } typedef int Int;", DumpNone);
+  TopDUContext* forwarder = parse("", DumpNone);
+
+  DUChainWriteLocker lock;
+  forwarder->addImportedParentContext(header);
+
+  IncludeSymbolIndex& index = IncludeSymbolIndex::self();
+  const IncludeSymbolIndex::Statistics before = index.statistics();
+  index.update(header);
+  index.update(forwarder);
+  QCOMPARE(index.statistics().updates - before.updates, 2u);
+
+  QVERIFY(index.files(IndexedString("A")).contains(header->url()));
+  QVERIFY(index.files(IndexedString("f")).contains(header->url()));
+  QVERIFY(index.files(IndexedString("Int")).contains(header->url()));
+  //Forward-declarations and namespaces are not indexed
+  QVERIFY(!index.files(IndexedString("Forward")).contains(header->url()));
+  QVERIFY(!index.files(IndexedString("S")).contains(header->url()));
+  QVERIFY(!index.files(IndexedString("N")).contains(header->url()));
+  //Files are also found by their name
+  QVERIFY(index.files(IndexedString(QFileInfo(forwarder->url().str()).fileName())).contains(forwarder->url()));
+
+  QCOMPARE(index.forwarders(header->url()), QList<IndexedString>() << forwarder->url());
+  QVERIFY(index.forwarders(forwarder->url()).isEmpty());
+
+  //Files that are not forwarders anymore are dropped on the next update
+  forwarder->clearImportedParentContexts();
+  index.update(forwarder);
+  QVERIFY(index.forwarders(header->url()).isEmpty());
+
+  index.remove(header->url());
+  index.remove(forwarder->url());
+  QVERIFY(!index.files(IndexedString("A")).contains(header->url()));
+  QVERIFY(index.canonicalPath(header->url()).isEmpty());
+
+  release(header);
+  release(forwarder);
+}
+
+void TestDUChain::testBuilderLock()
+{
+  QByteArray code("struct A { int a; }; namespace N { struct B : A { void f(); }; } void N::B::f() { a = 1; }");
+
+  BuilderLock::resetStatistics();
+  TopDUContext* top = parse(code, DumpNone);
+  //One batch for the declarations, the use-builder writes its uses once per context anyway
+  BuilderLock::Statistics statistics = BuilderLock::statistics();
+  QCOMPARE(statistics.batches, 1ull);
+  QVERIFY(statistics.acquisitions >= statistics.batches);
+  QVERIFY(statistics.maxHeldNanoseconds <= statistics.heldNanoseconds);
+  QVERIFY(!DUChain::lock()->currentThreadHasWriteLock());
+  QVERIFY(!BuilderLock::current());
+  {
+    DUChainReadLocker lock;
+    QCOMPARE(top->findDeclarations(QualifiedIdentifier("A::a")).first()->uses().size(), 1);
+  }
+  release(top);
+
+  //The same result is built without batches
+  BuilderLock::setEnabled(false);
+  BuilderLock::resetStatistics();
+  top = parse(code, DumpNone);
+  QCOMPARE(BuilderLock::statistics().batches, 0ull);
+  {
+    DUChainReadLocker lock;
+    QCOMPARE(top->findDeclarations(QualifiedIdentifier("A::a")).first()->uses().size(), 1);
+  }
+  release(top);
+  BuilderLock::setEnabled(true);
+
+  {
+    BuilderLock batch;
+    QVERIFY(batch.isActive());
+    QCOMPARE(BuilderLock::current(), &batch);
+    QVERIFY(!batch.holdsLock());
+
+    //The write-lock is kept after the write-section, and lookups within it don't release it
+    {
+      BuilderWriteLocker lock;
+      BuilderReadLocker readLock;
+      QVERIFY(batch.holdsLock());
+    }
+    QVERIFY(batch.holdsLock());
+    QVERIFY(DUChain::lock()->currentThreadHasWriteLock());
+
+    //Lookups outside of write-sections run under a read-lock only
+    {
+      BuilderReadLocker lock;
+      QVERIFY(!batch.holdsLock());
+      QVERIFY(!DUChain::lock()->currentThreadHasWriteLock());
+    }
+
+    //The lock is given up at a yield-point once it was held long enough
+    {
+      BuilderWriteLocker lock;
+    }
+    QTest::qSleep(BuilderLock::MaxHoldTime + 1);
+    for (int a = 0; a < BuilderLock::NodesPerCheck; ++a)
+      batch.yield();
+    QVERIFY(!batch.holdsLock());
+    QVERIFY(!DUChain::lock()->currentThreadHasWriteLock());
+
+    //Only one batch is registered per thread
+    BuilderLock nested;
+    QVERIFY(!nested.isActive());
+    QCOMPARE(BuilderLock::current(), &batch);
+  }
+  QVERIFY(!BuilderLock::current());
+
+  //No batch is made while the thread holds a read-lock
+  {
+    DUChainReadLocker lock;
+    BuilderLock batch;
+    QVERIFY(!batch.isActive());
+  }
+}
+
+void TestDUChain::benchBuilderLock_data()
+{
+  QTest::addColumn<bool>("batches");
+  QTest::addColumn<int>("threads");
+  QTest::newRow("1 thread, without batches") << false << 1;
+  QTest::newRow("1 thread, with batches") << true << 1;
+  QTest::newRow("4 threads, without batches") << false << 4;
+  QTest::newRow("4 threads, with batches") << true << 4;
+  QTest::newRow("8 threads, without batches") << false << 8;
+  QTest::newRow("8 threads, with batches") << true << 8;
+}
+
+void TestDUChain::benchBuilderLock()
+{
+  QFETCH(bool, batches);
+  QFETCH(int, threads);
+
+  TopDUContext* header = buildInstantiationUnit(instantiationHeader(20), 0);
+  QList<QByteArray> units;
+  for (int unit = 0; unit < 32; ++unit)
+    units << instantiationUnit(unit, 20);
+
+  BuilderLock::setEnabled(batches);
+  QBENCHMARK {
+    QList<TopDUContext*> tops = parseInParallel(units, header, threads);
+    DUChainWriteLocker lock(DUChain::lock());
+    foreach (TopDUContext* top, tops)
+      release(top);
+  }
+  BuilderLock::setEnabled(true);
+
+  DUChainWriteLocker lock(DUChain::lock());
+  release(header);
+}
+
 void TestDUChain::testTemplateDefaultParameters() {
   QByteArray method("struct S {} ; namespace std { template<class T> class Template1 { }; } template<class _TT, typename TT2 = std::Template1<_TT> > class Template2 { typedef TT2 T1; };");
 
@@ -145,6 +145,13 @@ private slots:
   void testTemplateRecursiveInstantiation();
   void testTemplateInternalSearch();
   void testTemplateImplicitInstantiations();
+  void testParallelInstantiation();
+  void benchParallelInstantiation_data();
+  void benchParallelInstantiation();
+  void testIncludeSymbolIndex();
+  void testBuilderLock();
+  void benchBuilderLock_data();
+  void benchBuilderLock();
   void testAssignedContexts();
   void testTryCatch();
   void testEnum();
@@ -41,6 +41,7 @@
 #include "expressionvisitor.h"
 #include "expressionparser.h"
 #include "typeconversion.h"
+#include "overloadresolution.h"
 
 #include <tests/autotestshell.h>
 #include <tests/testcore.h>
@@ -827,6 +828,122 @@ void TestExpressionParser::testTypeConversionWithTypedefs() {
   release(c);
 }
 
+void TestExpressionParser::testTypeConversionCache() {
+  TEST_FILE_PARSE_ONLY
+
+  QByteArray test = "struct Base {}; struct Derived : public Base {}; struct Conv { Conv(int); }; Base b; Derived d; Derived* dp; Base* bp; Conv c; int i;";
+  DUContext* top = parse( test, DumpNone );
+  DUChainWriteLocker lock(DUChain::lock());
+
+  QCOMPARE(top->localDeclarations().count(), 9);
+  QList<QPair<IndexedType, IndexedType> > conversions;
+  conversions << qMakePair(top->localDeclarations()[4]->indexedType(), top->localDeclarations()[3]->indexedType()); // d -> b
+  conversions << qMakePair(top->localDeclarations()[3]->indexedType(), top->localDeclarations()[4]->indexedType()); // b -> d
+  conversions << qMakePair(top->localDeclarations()[5]->indexedType(), top->localDeclarations()[6]->indexedType()); // dp -> bp
+  conversions << qMakePair(top->localDeclarations()[6]->indexedType(), top->localDeclarations()[5]->indexedType()); // bp -> dp
+  conversions << qMakePair(top->localDeclarations()[8]->indexedType(), top->localDeclarations()[7]->indexedType()); // i -> c
+
+  QList<QPair<uint, int> > expected;
+  typedef QPair<IndexedType, IndexedType> Conversion;
+  foreach(const Conversion& conversion, conversions) {
+    TypeConversion tc(top->topContext());
+    const uint result = tc.implicitConversion(conversion.first, conversion.second);
+    expected << qMakePair(result, tc.baseConversionLevels());
+  }
+  QVERIFY(expected[0].first);
+  QVERIFY(!expected[1].first);
+  QVERIFY(expected[2].first);
+  QVERIFY(!expected[3].first);
+  QVERIFY(expected[4].first);
+
+  TypeConversionCache& cache = TypeConversionCache::self();
+  cache.clear();
+  TypeConversionCacheEnabler enableCache;
+  for(int round = 0; round < 3; ++round) {
+    if(round == 2) {
+      //Results of earlier generations are not used anymore
+      cache.increaseGeneration();
+    }
+    const TypeConversionCache::Statistics before = cache.statistics();
+    for(int a = 0; a < conversions.size(); ++a) {
+      TypeConversion tc(top->topContext());
+      QCOMPARE(tc.implicitConversion(conversions[a].first, conversions[a].second), expected[a].first);
+      QCOMPARE(tc.baseConversionLevels(), expected[a].second);
+    }
+    const TypeConversionCache::Statistics after = cache.statistics();
+    if(round == 1) {
+      QCOMPARE(after.hits - before.hits, uint(conversions.size()));
+      QCOMPARE(after.misses, before.misses);
+    } else if(round == 2) {
+      QVERIFY(after.outdated - before.outdated >= uint(conversions.size()));
+    }
+  }
+
+  //Only a new top-context that re-uses an index results were cached for invalidates them
+  const uint generation = cache.generation();
+  cache.topContextCreated(top->topContext()->ownIndex() + 1000);
+  QCOMPARE(cache.generation(), generation);
+  cache.topContextCreated(top->topContext()->ownIndex());
+  QVERIFY(cache.generation() != generation);
+
+  release(top);
+}
+
+void TestExpressionParser::testOverloadResolutionCache() {
+  TEST_FILE_PARSE_ONLY
+
+  QByteArray test = "struct Base {}; struct Derived : public Base {}; void f(int); void f(Base); void f(Derived*); Derived d; Derived* dp; int i;";
+  DUContext* top = parse( test, DumpNone );
+  DUChainWriteLocker lock(DUChain::lock());
+
+  QCOMPARE(top->localDeclarations().count(), 8);
+  QList<Declaration*> candidates;
+  candidates << top->localDeclarations()[2] << top->localDeclarations()[3] << top->localDeclarations()[4];
+  QList<QPair<OverloadResolver::ParameterList, Declaration*> > offsettedCandidates;
+  foreach(Declaration* candidate, candidates)
+    offsettedCandidates << qMakePair(OverloadResolver::ParameterList(), candidate);
+  QList<OverloadResolver::ParameterList> calls;
+  calls << OverloadResolver::ParameterList(top->localDeclarations()[5]->abstractType(), true); // f(d)
+  calls << OverloadResolver::ParameterList(top->localDeclarations()[6]->abstractType(), true); // f(dp)
+  calls << OverloadResolver::ParameterList(top->localDeclarations()[7]->abstractType(), true); // f(i)
+
+  QList<QPair<Declaration*, uint> > expected;
+  foreach(const OverloadResolver::ParameterList& call, calls) {
+    OverloadResolver resolver(DUContextPointer(top), TopDUContextPointer(top->topContext()));
+    Declaration* found = resolver.resolveList(call, candidates);
+    expected << qMakePair(found, resolver.worstConversionRank());
+  }
+  QCOMPARE(expected[0].first, top->localDeclarations()[3]);
+  QCOMPARE(expected[1].first, top->localDeclarations()[4]);
+  QCOMPARE(expected[2].first, top->localDeclarations()[2]);
+
+  OverloadResolutionCache& cache = OverloadResolutionCache::self();
+  cache.clear();
+  TypeConversionCacheEnabler enableCache;
+  for(int round = 0; round < 3; ++round) {
+    if(round == 2) {
+      //Results are invalidated together with the type-conversions
+      TypeConversionCache::self().increaseGeneration();
+    }
+    const OverloadResolutionCache::Statistics before = cache.statistics();
+    for(int a = 0; a < calls.size(); ++a) {
+      OverloadResolver resolver(DUContextPointer(top), TopDUContextPointer(top->topContext()));
+      QCOMPARE(resolver.resolveList(calls[a], candidates), expected[a].first);
+      QCOMPARE(resolver.worstConversionRank(), expected[a].second);
+      QCOMPARE(resolver.resolveListViable(calls[a], offsettedCandidates).declaration().data(), expected[a].first);
+    }
+    const OverloadResolutionCache::Statistics after = cache.statistics();
+    if(round == 1) {
+      QCOMPARE(after.hits - before.hits, uint(calls.size() * 2));
+      QCOMPARE(after.misses, before.misses);
+    } else if(round == 2) {
+      QCOMPARE(after.outdated - before.outdated, uint(calls.size() * 2));
+    }
+  }
+
+  release(top);
+}
+
 void TestExpressionParser::testTypeConversion() {
   TEST_FILE_PARSE_ONLY
 
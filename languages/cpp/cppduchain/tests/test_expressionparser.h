@@ -59,6 +59,8 @@ private slots:
   void testTypeConversion();
   void testTypeConversion2();
   void testTypeConversionWithTypedefs();
+  void testTypeConversionCache();
+  void testOverloadResolutionCache();
   void testSmartPointer();
   void testCasts();
   void testEnum();
@@ -24,6 +24,17 @@
 
 #include <environmentmanager.h>
 #include <cpputils.h>
+#include <cpppreprocessenvironment.h>
+#include <preprocessedcontentscache.h>
+#include <contextbuilder.h>
+
+#include "rpp/chartools.h"
+#include "rpp/pp-location.h"
+
+#include <language/duchain/duchain.h>
+#include <language/duchain/duchainlock.h>
+
+#include <QScopedPointer>
 
 #include <qtest_kde.h>
 
@@ -48,6 +59,75 @@ void TestEnvironment::cleanupTestCase()
   TestCore::shutdown();
 }
 
+void TestEnvironment::testPreprocessedContentsCache()
+{
+  DUChainWriteLocker lock(DUChain::lock());
+
+  const IndexedString url(QLatin1String("/preprocessedcontentscache/test.h"));
+  const QByteArray contents("int x = VALUE;\n");
+  const QList<IndexedString> includePaths = QList<IndexedString>() << IndexedString(QLatin1String("/usr/include"));
+
+  //The file was preprocessed with VALUE defined as 1
+  rpp::pp_macro* value = new rpp::pp_macro(IndexedString("VALUE"));
+  value->setDefinitionText("1");
+  EnvironmentFile environmentFile(url, 0);
+  environmentFile.usingMacro(*value);
+  CppPreprocessEnvironment environment((EnvironmentFilePointer()));
+  environment.setMacro(value);
+
+  const PreprocessedContents preprocessed = tokenizeFromByteArray("int x = 1;\n");
+  rpp::LocationTable table;
+  table.anchor(0, rpp::Anchor(0, 0), &preprocessed);
+  PreprocessedContentsCache::self().store(url, environmentFile, includePaths, contents, preprocessed, table,
+                                          IncludeFileList(), 0);
+
+  PreprocessedContents result;
+  IncludeFileList includedFiles;
+  uint branchingHash = 1;
+
+  //Hit
+  QScopedPointer<rpp::LocationTable> cached(PreprocessedContentsCache::self().load(url, environmentFile, environment, includePaths,
+                                                                                   contents, result, includedFiles, branchingHash));
+  QVERIFY(cached);
+  QCOMPARE(result, preprocessed);
+  QVERIFY(includedFiles.isEmpty());
+  QCOMPARE(branchingHash, 0u);
+
+  //Miss after the define changed, even though the same environment-file is given
+  rpp::pp_macro* changedValue = new rpp::pp_macro(IndexedString("VALUE"));
+  changedValue->setDefinitionText("2");
+  CppPreprocessEnvironment changedEnvironment((EnvironmentFilePointer()));
+  changedEnvironment.setMacro(changedValue);
+  cached.reset(PreprocessedContentsCache::self().load(url, environmentFile, changedEnvironment, includePaths,
+                                                      contents, result, includedFiles, branchingHash));
+  QVERIFY(!cached);
+
+  //Miss after the define was removed
+  CppPreprocessEnvironment emptyEnvironment((EnvironmentFilePointer()));
+  cached.reset(PreprocessedContentsCache::self().load(url, environmentFile, emptyEnvironment, includePaths,
+                                                      contents, result, includedFiles, branchingHash));
+  QVERIFY(!cached);
+
+  //Miss after the file was edited
+  cached.reset(PreprocessedContentsCache::self().load(url, environmentFile, environment, includePaths,
+                                                      QByteArray("int x = VALUE + 1;\n"), result, includedFiles, branchingHash));
+  QVERIFY(!cached);
+
+  //Miss after the include-paths changed
+  cached.reset(PreprocessedContentsCache::self().load(url, environmentFile, environment, QList<IndexedString>(),
+                                                      contents, result, includedFiles, branchingHash));
+  QVERIFY(!cached);
+
+  //Still a hit with the original state, and a miss once removed
+  cached.reset(PreprocessedContentsCache::self().load(url, environmentFile, environment, includePaths,
+                                                      contents, result, includedFiles, branchingHash));
+  QVERIFY(cached);
+  PreprocessedContentsCache::self().remove(url);
+  cached.reset(PreprocessedContentsCache::self().load(url, environmentFile, environment, includePaths,
+                                                      contents, result, includedFiles, branchingHash));
+  QVERIFY(!cached);
+}
+
 void TestEnvironment::benchMerge()
 {
   QFETCH(int, macros);
@@ -33,6 +33,8 @@ private slots:
   void initTestCase();
   void cleanupTestCase();
 
+  void testPreprocessedContentsCache();
+
   void benchMerge();
   void benchMerge_data();
 };
@@ -27,6 +27,7 @@
 #include "typebuilder.h"
 #include "parser/rpp/chartools.h"
 #include "ptrtomembertype.h"
+#include "builderlock.h"
 
 #include <language/duchain/duchainlock.h>
 
@@ -34,7 +35,7 @@ using namespace Cpp;
 
 #include <QtCore/QString>
 
-#define LOCKDUCHAIN     DUChainReadLocker lock(DUChain::lock())
+#define LOCKDUCHAIN     Cpp::BuilderReadLocker lock
 
 
 TypeASTVisitor::TypeASTVisitor(ParseSession* session, Cpp::ExpressionVisitor* visitor, const KDevelop::DUContext* context, const KDevelop::TopDUContext* source, const KDevelop::DUContext* localVisibilityContext, bool debug)
@@ -26,6 +26,8 @@
 #include <language/duchain/duchainlock.h>
 #include <language/duchain/duchain.h>
 #include <qthread.h>
+#include <QSet>
+#include <QThreadStorage>
 #include <language/duchain/classfunctiondeclaration.h>
 #include <language/duchain/types/typeutils.h>
 
@@ -37,59 +39,128 @@ using namespace TypeUtils;
 #define ifDebug(x)
 // #define ifDebug(x) x
 
-struct ImplicitConversionParams {
+namespace {
+enum CachedConversionKind {
+  ImplicitConversion,
+  StandardConversion,
+  UserDefinedConversion
+};
+
+///Set while the current thread uses the shared cache
+QThreadStorage<bool*> threadUsesCache;
+}
+
+namespace Cpp {
+struct TypeConversionCache::Key {
+  Key(uint _kind, const IndexedType& _from, const IndexedType& _to, const TopDUContext* topContext, uint _flags)
+    : kind(_kind), from(_from), to(_to), topContext(topContext ? topContext->ownIndex() : 0), flags(_flags) {
+  }
+  uint kind;
   IndexedType from, to;
-  bool fromLValue, noUserDefinedConversion;
-  
-  bool operator==(const ImplicitConversionParams& rhs) const {
-    return from == rhs.from && to == rhs.to && fromLValue == rhs.fromLValue && noUserDefinedConversion == rhs.noUserDefinedConversion;
+  uint topContext;
+  uint flags;
+
+  bool operator==(const Key& rhs) const {
+    return kind == rhs.kind && from == rhs.from && to == rhs.to && topContext == rhs.topContext && flags == rhs.flags;
   }
 };
 
-uint qHash(const ImplicitConversionParams& params) {
-  return (params.from.hash() * 36109 + params.to.hash()) * (params.fromLValue ? 111 : 53) * (params.noUserDefinedConversion ? 317293 : 1);
+uint qHash(const TypeConversionCache::Key& key) {
+  return ((key.from.hash() * 36109 + key.to.hash()) * 53 + key.topContext) * 317293 + key.flags * 11 + key.kind;
 }
 
-namespace Cpp {
-class TypeConversionCache
-{
-public:
+struct TypeConversionCache::Value {
+  Value(int _result = 0, int _baseConversionLevels = 0) : result(_result), baseConversionLevels(_baseConversionLevels), generation(0) {
+  }
+  int result;
+  ///The base-conversion levels that were added while computing the result
+  int baseConversionLevels;
+  uint generation;
+};
 
-    QHash<ImplicitConversionParams, int> m_implicitConversionResults;
-/*    QHash<QPair<IndexedType, IndexedType>, uint> m_standardConversionResults;
-    QHash<QPair<IndexedType, IndexedType>, uint> m_userDefinedConversionResults;*/
-//     QHash<QPair<IndexedType, IndexedType>, bool> m_isPublicBaseCache;
+struct TypeConversionCache::TopContexts {
+  QMutex mutex;
+  QSet<uint> indices;
 };
 }
 
-QHash<Qt::HANDLE, TypeConversionCache*> typeConversionCaches;
-QMutex typeConversionCacheMutex;
+TypeConversionCache::TypeConversionCache()
+  : m_entries(new Entries)
+  , m_topContexts(new TopContexts[Shards])
+  , m_generation(1)
+{
+}
+
+TypeConversionCache::~TypeConversionCache() {
+  delete[] m_topContexts;
+  delete m_entries;
+}
+
+TypeConversionCache& TypeConversionCache::self() {
+  static TypeConversionCache cache;
+  return cache;
+}
+
+bool TypeConversionCache::find(const Key& key, Value& value, uint& currentGeneration) {
+  currentGeneration = generation();
+  return m_entries->find(key, value, currentGeneration);
+}
+
+void TypeConversionCache::insert(const Key& key, const Value& value, uint generation) {
+  m_entries->insert(key, value, generation);
+  TopContexts& topContexts(m_topContexts[key.topContext % Shards]);
+  QMutexLocker lock(&topContexts.mutex);
+  topContexts.indices.insert(key.topContext);
+}
+
+void TypeConversionCache::increaseGeneration() {
+  m_generation.ref();
+}
+
+uint TypeConversionCache::generation() const {
+  return (uint)(int)m_generation;
+}
+
+void TypeConversionCache::topContextCreated(uint topContextIndex) {
+  TopContexts& topContexts(m_topContexts[topContextIndex % Shards]);
+  QMutexLocker lock(&topContexts.mutex);
+  if(topContexts.indices.contains(topContextIndex)) {
+    lock.unlock();
+    increaseGeneration();
+  }
+}
+
+void TypeConversionCache::clear() {
+  m_entries->clear();
+  for(int a = 0; a < Shards; ++a) {
+    QMutexLocker lock(&m_topContexts[a].mutex);
+    m_topContexts[a].indices.clear();
+  }
+}
+
+TypeConversionCache::Statistics TypeConversionCache::statistics() const {
+  return m_entries->statistics();
+}
 
 void TypeConversion::startCache() {
-  QMutexLocker lock(&typeConversionCacheMutex);
-  if(!typeConversionCaches.contains(QThread::currentThreadId()))
-    typeConversionCaches[QThread::currentThreadId()] = new TypeConversionCache;
+  if(!threadUsesCache.hasLocalData())
+    threadUsesCache.setLocalData(new bool(true));
 }
 
 void TypeConversion::stopCache() {
-  QMutexLocker lock(&typeConversionCacheMutex);
-  if(typeConversionCaches.contains(QThread::currentThreadId())) {
-    delete typeConversionCaches[QThread::currentThreadId()];
-    typeConversionCaches.remove(QThread::currentThreadId());
-  }
+  if(threadUsesCache.hasLocalData())
+    threadUsesCache.setLocalData(0);
+}
+
+bool TypeConversion::isCacheEnabled() {
+  return threadUsesCache.hasLocalData();
 }
 
 TypeConversion::TypeConversion(const TopDUContext* topContext)
   : m_baseConversionLevels(0)
   , m_topContext(topContext)
+  , m_cache(threadUsesCache.hasLocalData() ? &TypeConversionCache::self() : 0)
 {
-
-  QMutexLocker lock(&typeConversionCacheMutex);
-  QHash<Qt::HANDLE, TypeConversionCache*>::iterator it = typeConversionCaches.find(QThread::currentThreadId());
-  if(it != typeConversionCaches.end())
-    m_cache = *it;
-  else
-    m_cache = 0;
 }
 
 
@@ -133,16 +204,15 @@ uint TypeConversion::implicitConversion( const IndexedType& _from, const Indexed
 
   int conv = 0;
   
-  ImplicitConversionParams params;
-  params.from = _from;
-  params.to = _to;
-  params.fromLValue = fromLValue;
-  params.noUserDefinedConversion = noUserDefinedConversion;
+  const TypeConversionCache::Key key(ImplicitConversion, _from, _to, m_topContext, (fromLValue ? 1 : 0) | (noUserDefinedConversion ? 2 : 0));
   
+  uint cacheGeneration = 0;
   if(m_cache) {
-    QHash<ImplicitConversionParams, int>::const_iterator it = m_cache->m_implicitConversionResults.constFind(params);
-    if(it != m_cache->m_implicitConversionResults.constEnd())
-      return *it;
+    TypeConversionCache::Value cached;
+    if(m_cache->find(key, cached, cacheGeneration)) {
+      m_baseConversionLevels = cached.baseConversionLevels;
+      return cached.result;
+    }
   }
   
   AbstractType::Ptr to = unAliasedType(_to.abstractType());
@@ -198,7 +268,7 @@ uint TypeConversion::implicitConversion( const IndexedType& _from, const Indexed
 
       //We cannot directly create a reference, but maybe there is a user-defined conversion that creates a compatible reference, as in iso c++ 13.3.3.1.4.1
       if( !noUserDefinedConversion ) {
-        if( int rank = userDefinedConversion( from, to, fromLValue, true ) ) {
+        if( int rank = cachedUserDefinedConversion( from, to, fromLValue, true ) ) {
           conv = rank + ConversionRankOffset;
           goto ready;
         }
@@ -216,14 +286,14 @@ uint TypeConversion::implicitConversion( const IndexedType& _from, const Indexed
 
       //This is very simplified, see iso c++ draft 13.3.3.1
 
-      if( (tempConv = standardConversion(from,to)) ) {
+      if( (tempConv = cachedStandardConversion(from,to)) ) {
         tempConv += 2*ConversionRankOffset;
         if( tempConv > conv )
           conv = tempConv;
       }
 
       if( !noUserDefinedConversion ) {
-        if( (tempConv = userDefinedConversion(from, to, fromLValue)) ) {
+        if( (tempConv = cachedUserDefinedConversion(from, to, fromLValue)) ) {
           tempConv += ConversionRankOffset;
           if( tempConv > conv )
             conv = tempConv;
@@ -238,7 +308,7 @@ uint TypeConversion::implicitConversion( const IndexedType& _from, const Indexed
   ready:
   
   if(m_cache)
-    m_cache->m_implicitConversionResults.insert(params, conv);
+    m_cache->insert(key, TypeConversionCache::Value(conv, m_baseConversionLevels), cacheGeneration);
   
   return conv;
 }
@@ -247,6 +317,43 @@ int TypeConversion::baseConversionLevels() const {
   return m_baseConversionLevels;
 }
 
+ConversionRank TypeConversion::cachedStandardConversion( const AbstractType::Ptr& from, const AbstractType::Ptr& to ) {
+  if(!m_cache || !from || !to)
+    return standardConversion(from, to);
+
+  const TypeConversionCache::Key key(StandardConversion, from->indexed(), to->indexed(), m_topContext, 0);
+  TypeConversionCache::Value cached;
+  uint cacheGeneration;
+  if(m_cache->find(key, cached, cacheGeneration)) {
+    m_baseConversionLevels += cached.baseConversionLevels;
+    return (ConversionRank)cached.result;
+  }
+
+  const int levels = m_baseConversionLevels;
+  ConversionRank rank = standardConversion(from, to);
+  m_cache->insert(key, TypeConversionCache::Value(rank, m_baseConversionLevels - levels), cacheGeneration);
+  return rank;
+}
+
+ConversionRank TypeConversion::cachedUserDefinedConversion( const AbstractType::Ptr& from, const AbstractType::Ptr& to, bool fromLValue, bool secondConversionIsIdentity ) {
+  if(!m_cache || !from || !to)
+    return userDefinedConversion(from, to, fromLValue, secondConversionIsIdentity);
+
+  const TypeConversionCache::Key key(UserDefinedConversion, from->indexed(), to->indexed(), m_topContext,
+                                     (fromLValue ? 1 : 0) | (secondConversionIsIdentity ? 2 : 0));
+  TypeConversionCache::Value cached;
+  uint cacheGeneration;
+  if(m_cache->find(key, cached, cacheGeneration)) {
+    m_baseConversionLevels += cached.baseConversionLevels;
+    return (ConversionRank)cached.result;
+  }
+
+  const int levels = m_baseConversionLevels;
+  ConversionRank rank = userDefinedConversion(from, to, fromLValue, secondConversionIsIdentity);
+  m_cache->insert(key, TypeConversionCache::Value(rank, m_baseConversionLevels - levels), cacheGeneration);
+  return rank;
+}
+
 ///Helper for standardConversion(..) that makes sure that when one category is taken out of the possible ones, the earlier are taken out too, because categories must be checked in order.
   int removeCategories( int categories, ConversionCategories remove ) {
     for( int a = 1; a <= remove; a*=2 ) {
@@ -556,7 +663,7 @@ ConversionRank TypeConversion::userDefinedConversion( AbstractType::Ptr from, Ab
       {
         if(isAccessible(it.value())) {
           AbstractType::Ptr convertedType( it.key()->returnType() );
-          ConversionRank rank = standardConversion( convertedType, to );
+          ConversionRank rank = cachedStandardConversion( convertedType, to );
 
           if( rank != NoMatch && (!secondConversionIsIdentity || rank == ExactMatch) )
           {
@@ -25,6 +25,10 @@
 #include <language/duchain/classmemberdeclaration.h>
 #include <language/duchain/types/pointertype.h>
 
+#include <QtCore/QAtomicInt>
+
+#include "shardedcache.h"
+
 namespace KDevelop {
   class IndexedType;
   class TopDUContext;
@@ -33,7 +37,64 @@ namespace KDevelop {
 namespace Cpp {
 using namespace KDevelop;
 
-  class TypeConversionCache;
+/**
+ * Results of type-conversions, shared by all threads that enabled caching with TypeConversion::startCache().
+ *
+ * Results are identified by the converted types and the top-context they were computed in, because forward-declarations
+ * are resolved through it. Since the results depend on the declarations in the du-chain, all of them are invalidated
+ * by increasing the generation whenever an existing top-context is updated, or a new one re-uses the index of a
+ * deleted one.
+ *
+ * The results are kept in a ShardedCache, so concurrent threads rarely wait for each other.
+ * */
+class KDEVCPPDUCHAIN_EXPORT TypeConversionCache
+{
+  public:
+    enum {
+      Shards = 16,
+      MaxEntriesPerShard = 8192
+    };
+
+    typedef ShardedCacheStatistics Statistics;
+
+    static TypeConversionCache& self();
+
+    ///Invalidates all cached results
+    void increaseGeneration();
+    uint generation() const;
+
+    /**
+     * Must be called when a new top-context was created. Results are identified by the index of their
+     * top-context, and the index of a deleted top-context may be re-used, so all results are invalidated
+     * if results were cached for @p topContextIndex before.
+     * */
+    void topContextCreated(uint topContextIndex);
+
+    void clear();
+
+    Statistics statistics() const;
+
+  private:
+    TypeConversionCache();
+    ~TypeConversionCache();
+    struct Key;
+    struct Value;
+    struct TopContexts;
+    typedef ShardedCache<Key, Value, Shards, MaxEntriesPerShard> Entries;
+
+    ///@p generation is set to the generation the lookup was done in, it must be given to insert()
+    ///when the result is computed after a failed lookup, so results computed while the generation
+    ///was increased are never valid
+    bool find(const Key& key, Value& value, uint& generation);
+    void insert(const Key& key, const Value& value, uint generation);
+
+    Entries* m_entries;
+    ///The top-contexts results were inserted for, including evicted ones, split by their index
+    TopContexts* m_topContexts;
+    QAtomicInt m_generation;
+    friend class TypeConversion;
+    friend uint qHash(const Key& key);
+};
 
   enum ConversionCategories {
     LValueTransformationCategory = 1,
@@ -89,10 +150,15 @@ class KDEVCPPDUCHAIN_EXPORT TypeConversion {
     int baseConversionLevels() const;
 
     /**
-     * Start/Stop type-conversion caching for the current thread. Prefer TypeConversionEnabler over calling these directly.
+     * Start/Stop using the shared TypeConversionCache in the current thread. Prefer TypeConversionEnabler over calling these directly.
+     *
+     * Caching should only be enabled while no du-chain that is used is being built.
      */
     static void startCache();
     static void stopCache();
+
+    ///Whether the current thread uses the shared caches, which are also used for overload-resolution
+    static bool isCacheEnabled();
     
   protected:
     /**
@@ -115,6 +181,12 @@ class KDEVCPPDUCHAIN_EXPORT TypeConversion {
      */
     ConversionRank userDefinedConversion( AbstractType::Ptr from, AbstractType::Ptr to, bool fromLValue, bool secondConversionIsIdentity = false );
 
+    ///standardConversion(..) with the default categories, using the cache if it is enabled
+    ConversionRank cachedStandardConversion( const AbstractType::Ptr& from, const AbstractType::Ptr& to );
+
+    ///userDefinedConversion(..), using the cache if it is enabled
+    ConversionRank cachedUserDefinedConversion( const AbstractType::Ptr& from, const AbstractType::Ptr& to, bool fromLValue, bool secondConversionIsIdentity = false );
+
     ConversionRank pointerConversion( PointerType::Ptr from, PointerType::Ptr to );
 
     ///iso c++ draft 13.3.3.1.3
@@ -138,8 +210,7 @@ class KDEVCPPDUCHAIN_EXPORT TypeConversion {
     friend class TypeConversionCacheEnabler;
 };
 
-///Use this to temporaily enable type-conversion caching
-///@warning The duchain must not be locked while construction and destruction of this object!
+///Use this to temporaily enable type-conversion caching in the current thread
 class TypeConversionCacheEnabler {
 public:
 
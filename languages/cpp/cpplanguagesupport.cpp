@@ -93,11 +93,14 @@
 
 #include "includepathresolver.h"
 #include "setuphelpers.h"
+#include "includegraphscheduler.h"
 #include "quickopen.h"
 #include "cppdebughelper.h"
 #include "codegen/simplerefactoring.h"
 #include "codegen/cppclasshelper.h"
 #include "includepathcomputer.h"
+#include "includepathsnapshot.h"
+#include "headersectioncache.h"
 
 //#include <valgrind/callgrind.h>
 
@@ -213,6 +216,8 @@ CppLanguageSupport::CppLanguageSupport( QObject* parent, const QVariantList& /*a
     CppUtils::standardMacros();
 
     m_quickOpenDataProvider = new IncludeFileDataProvider();
+    m_headerSectionCache = new HeaderSectionCache;
+    m_includeGraphScheduler = new IncludeGraphScheduler(this);
 
     IQuickOpen* quickOpen = core()->pluginController()->extensionForPlugin<IQuickOpen>("org.kdevelop.IQuickOpen");
 
@@ -230,6 +235,15 @@ CppLanguageSupport::CppLanguageSupport( QObject* parent, const QVariantList& /*a
     foreach(QString mimeType, m_mimeTypes){
         KDevelop::IBuddyDocumentFinder::addFinder(mimeType,this);
     }
+
+    connect(core()->projectController(), SIGNAL(projectOpened(KDevelop::IProject*)),
+            this, SLOT(projectOpened(KDevelop::IProject*)));
+    connect(core(), SIGNAL(aboutToShutdown()), this, SLOT(aboutToShutdown()));
+
+    //Lets the parse-jobs get their include-paths without waiting for the foreground thread
+    IncludePathSnapshots* includePathSnapshots = new IncludePathSnapshots(this);
+    foreach(IProject* project, core()->projectController()->projects())
+      includePathSnapshots->update(project->fileSet());
 }
 
 void CppLanguageSupport::createActionsForMainWindow (Sublime::MainWindow* /*window*/, QString& _xmlFile, KActionCollection& actions)
@@ -424,6 +438,11 @@ CppLanguageSupport::~CppLanguageSupport()
 
     delete m_quickOpenDataProvider;
 
+    {
+      DUChainWriteLocker lock(DUChain::lock());
+      delete m_headerSectionCache;
+    }
+
     // Remove any documents waiting to be parsed from the background parser.
     core()->languageController()->backgroundParser()->clear(this);
 
@@ -440,6 +459,23 @@ CppLanguageSupport* CppLanguageSupport::self() {
     return m_self;
 }
 
+HeaderSectionCache* CppLanguageSupport::headerSectionCache() const
+{
+    return m_headerSectionCache;
+}
+
+void CppLanguageSupport::setHeaderSectionSnapshotsEnabled(bool enabled)
+{
+    m_headerSectionCache->setEnabled(enabled);
+}
+
+void CppLanguageSupport::aboutToShutdown()
+{
+    //The snapshots hold environment-files, which must not outlive the DUChain
+    DUChainWriteLocker lock(DUChain::lock());
+    m_headerSectionCache->clear();
+}
+
 KDevelop::ParseJob *CppLanguageSupport::createParseJob( const IndexedString &url )
 {
     CPPParseJob *job = new CPPParseJob(url, this);
@@ -471,10 +507,31 @@ ICreateClassHelper* CppLanguageSupport::createClassHelper() const
 }
 
 
+void CppLanguageSupport::projectOpened(KDevelop::IProject* project)
+{
+  m_openedProjects << QPointer<KDevelop::IProject>(project);
+  //The project files are queued for parsing after the project was opened, so wait until that happened
+  QTimer::singleShot(0, this, SLOT(prioritizeOpenedProjects()));
+}
+
+void CppLanguageSupport::prioritizeOpenedProjects()
+{
+  QSet<IndexedString> files;
+  foreach(const QPointer<KDevelop::IProject>& project, m_openedProjects) {
+    if(project)
+      files += project->fileSet();
+  }
+  m_openedProjects.clear();
+
+  m_includeGraphScheduler->prioritize(files);
+}
+
 void CppLanguageSupport::findIncludePathsForJob(CPPParseJob* job)
 {
   IncludePathComputer* comp = new IncludePathComputer(job->document().str());
   comp->computeForeground();
+  if(IncludePathSnapshots::self())
+    IncludePathSnapshots::self()->insert(job->document(), comp->foregroundResult());
   job->gotIncludePaths(comp);
 }
 
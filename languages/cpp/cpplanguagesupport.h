@@ -32,6 +32,7 @@
 #include <QThread>
 #include <QTimer>
 #include <QMutex>
+#include <QPointer>
 
 namespace rpp {
 class pp_macro;
@@ -40,12 +41,15 @@ class pp_macro;
 class CppHighlighting;
 class CPPParseJob;
 class IncludeFileDataProvider;
+class HeaderSectionCache;
+class IncludeGraphScheduler;
 class SimpleRefactoring;
 
 namespace KDevelop {
   class ICodeHighlighting;
   class SimpleRange;
   class CodeCompletion;
+  class IProject;
 }
 namespace Cpp {
   class StaticCodeAssistant;
@@ -109,6 +113,9 @@ public:
     
     static CppLanguageSupport* self();
 
+    ///The snapshots of header-sections that are re-used while preprocessing, see PreprocessJob
+    HeaderSectionCache* headerSectionCache() const;
+
     virtual QString indentationSample() const {
       return "class C{\n class D {\n void c() {\n int m;\n }\n }\n};\n";
     }
@@ -142,6 +149,16 @@ public slots:
     ///UI:
     void switchDefinitionDeclaration();
 
+    ///Allows comparing the parse-performance with and without header-section snapshots
+    void setHeaderSectionSnapshotsEnabled(bool enabled);
+
+private slots:
+    void projectOpened(KDevelop::IProject* project);
+    ///Orders the queued files of the recently opened projects by their include-graph
+    void prioritizeOpenedProjects();
+    ///Releases everything that refers to the DUChain, before it is shut down
+    void aboutToShutdown();
+
 private:
 
     //Returns the identifier and its range under the cursor as first return-value, and the tail behind it as the second
@@ -165,6 +182,10 @@ private:
     KDevelop::CodeCompletion *m_cc;
 
     IncludeFileDataProvider* m_quickOpenDataProvider;
+    HeaderSectionCache* m_headerSectionCache;
+
+    QList<QPointer<KDevelop::IProject> > m_openedProjects;
+    IncludeGraphScheduler* m_includeGraphScheduler;
     
     const QStringList m_mimeTypes;
 };
@@ -26,6 +26,7 @@
 #include "cpplanguagesupport.h"
 #include "cpphighlighting.h"
 #include "includepathcomputer.h"
+#include "includepathsnapshot.h"
 
 #include "parser/parser.h"
 #include "parser/control.h"
@@ -38,6 +39,8 @@
 #include <QByteArray>
 #include <QReadWriteLock>
 #include <QReadLocker>
+#include <QMutex>
+#include <QSharedPointer>
 
 #include <KDebug>
 #include <KLocale>
@@ -48,6 +51,7 @@
 #include "cppduchain/cppeditorintegrator.h"
 #include "cppduchain/declarationbuilder.h"
 #include "cppduchain/usebuilder.h"
+#include "cppduchain/includesymbolindex.h"
 #include "preprocessjob.h"
 #include "environmentmanager.h"
 
@@ -86,6 +90,49 @@ bool importsContext(const QVector<DUContext::Import>& contexts, const DUContext*
   return false;
 }
 
+namespace {
+/**
+ * Keeps the lexed contents of the documents that were recently parsed while open in the editor,
+ * so the next revision can be lexed incrementally.
+ * */
+class LexedContentsCache {
+  public:
+    enum {
+      MaxDocuments = 16
+    };
+
+    ///Removes the lexed contents of @p url from the cache, so they can be used exclusively.
+    ///If there are none, returns empty ones.
+    QSharedPointer<LexedContents> take(const IndexedString& url) {
+      QMutexLocker lock(&m_mutex);
+      for(int a = 0; a < m_documents.size(); ++a) {
+        if(m_documents[a].first == url)
+          return m_documents.takeAt(a).second;
+      }
+      return QSharedPointer<LexedContents>(new LexedContents);
+    }
+
+    void insert(const IndexedString& url, const QSharedPointer<LexedContents>& lexed) {
+      if(lexed->isEmpty())
+        return;
+      QMutexLocker lock(&m_mutex);
+      m_documents.prepend(qMakePair(url, lexed));
+      while(m_documents.size() > MaxDocuments)
+        m_documents.removeLast();
+    }
+
+  private:
+    QMutex m_mutex;
+    //Most recently parsed documents are in the front
+    QList<QPair<IndexedString, QSharedPointer<LexedContents> > > m_documents;
+};
+
+LexedContentsCache& lexedContentsCache() {
+  static LexedContentsCache cache;
+  return cache;
+}
+}
+
 QList<IndexedString> convertFromPaths(const Path::List& paths) {
   QList<IndexedString> ret;
   ret.reserve(paths.size());
@@ -245,18 +292,26 @@ const QList<IndexedString>& CPPParseJob::indexedIncludePaths() const {
     if( masterJob() == this ) {
         if( !m_includePathsComputed ) {
             Q_ASSERT(!DUChain::lock()->currentThreadHasReadLock() && !DUChain::lock()->currentThreadHasWriteLock());
-            m_waitForIncludePathsMutex.lock();
-            qRegisterMetaType<CPPParseJob*>("CPPParseJob*");
-            QMetaObject::invokeMethod(cpp(), "findIncludePathsForJob", Qt::QueuedConnection, Q_ARG(CPPParseJob*, const_cast<CPPParseJob*>(this)));
-            //Will be woken once the include-paths are computed
-            while(!m_waitForIncludePaths.wait(&m_waitForIncludePathsMutex, 1000))
-            {
-              if(ICore::self()->shuttingDown())
+            IncludePathComputer::ForegroundResult foreground;
+            if( IncludePathSnapshots::self() && IncludePathSnapshots::self()->lookup(document(), foreground) ) {
+              //The foreground part is known already, so there is no need to wait for the foreground thread
+              IncludePathComputer* comp = new IncludePathComputer(document().str());
+              comp->setForegroundResult(foreground);
+              m_includePathsComputed = comp;
+            } else {
+              m_waitForIncludePathsMutex.lock();
+              qRegisterMetaType<CPPParseJob*>("CPPParseJob*");
+              QMetaObject::invokeMethod(cpp(), "findIncludePathsForJob", Qt::QueuedConnection, Q_ARG(CPPParseJob*, const_cast<CPPParseJob*>(this)));
+              //Will be woken once the include-paths are computed
+              while(!m_waitForIncludePaths.wait(&m_waitForIncludePathsMutex, 1000))
               {
-                return m_includePaths;
+                if(ICore::self()->shuttingDown())
+                {
+                  return m_includePaths;
+                }
               }
+              m_waitForIncludePathsMutex.unlock();
             }
-            m_waitForIncludePathsMutex.unlock();
             Q_ASSERT(m_includePathsComputed);
             m_includePathsComputed->computeBackground();
             m_includePathUrls = m_includePathsComputed->result();
@@ -565,10 +620,27 @@ void CPPInternalParseJob::run()
       Parser parser(&control);
       parser.setLanguageFeatures(parentJob()->languageFeatures());
 
+      //The declaration-builder does not go into function bodies when only the visible declarations are computed,
+      //so they do not need to be parsed. They are built once the file is opened, or uses are requested.
+      //Syntax-errors within the bodies are only reported from then on.
+      const bool onlyComputeVisible = newFeatures == TopDUContext::VisibleDeclarationsAndContexts
+                                   || newFeatures == TopDUContext::SimplifiedVisibleDeclarationsAndContexts;
+      parser.setSkipFunctionBodies(onlyComputeVisible && !keepAST);
+
       if(newFeatures != TopDUContext::Empty)
       {
+        //While a document is edited, only the changed part of it is lexed again
+        QSharedPointer<LexedContents> lexedContents;
+        if(isOpenInEditor) {
+          lexedContents = lexedContentsCache().take(parentJob()->document());
+          parser.setLexedContents(lexedContents.data());
+        }
+
         ast = parser.parse( parentJob()->parseSession().data() );
 
+        if(lexedContents)
+          lexedContentsCache().insert(parentJob()->document(), lexedContents);
+
         //This will be set to true if the duchain data should be left untouched
         if((ast->hadMissingCompoundTokens || control.hasProblem(KDevelop::ProblemData::Lexer)) && updatingContentContext) {
           //Make sure we don't update into a completely invalid state where everything is invalidated temporarily.
@@ -751,6 +823,13 @@ void CPPInternalParseJob::run()
           contentContext->clearAst();
       }
 
+      //Keeps the missing-include suggestions up to date
+      if(!doNotChangeDUChain) {
+        DUChainReadLocker l(DUChain::lock());
+        if(contentContext)
+          Cpp::IncludeSymbolIndex::self().update(contentContext);
+      }
+
       if (parentJob()->abortRequested())
         return /*parentJob()->abortJob()*/;
 
@@ -21,6 +21,8 @@
 #include "setuphelpers.h"
 #include "parser/rpp/preprocessor.h"
 #include "includepathcomputer.h"
+#include "includepathsnapshot.h"
+#include "includedirectorycache.h"
 
 #include <interfaces/icore.h>
 #include <interfaces/iprojectcontroller.h>
@@ -36,7 +38,7 @@
 
 #include <project/projectmodel.h>
 
-#include <QDirIterator>
+#include <QFileInfo>
 #include <QThread>
 #include <QCoreApplication>
 
@@ -204,11 +206,11 @@ QPair<Path, Path> findInclude(const Path::List& includePaths, const Path& localP
         kDebug(9007) << "skipping path" << skipPath;
 #endif
 
+    IncludeDirectoryCache& directories = IncludeDirectoryCache::self();
+
     if (includeName.startsWith('/')) {
-        QFileInfo info(includeName);
-        if (info.exists() && info.isReadable() && info.isFile()) {
-            //kDebug(9007) << "found include file:" << info.absoluteFilePath();
-            ret.first = Path(info.canonicalFilePath());
+        if (directories.entryType(Path(includeName)) == IncludeDirectoryCache::File) {
+            ret.first = Path(QFileInfo(includeName).canonicalFilePath());
             ret.second = Path("/");
             return ret;
         }
@@ -216,8 +218,7 @@ QPair<Path, Path> findInclude(const Path::List& includePaths, const Path& localP
 
     if (includeType == rpp::Preprocessor::IncludeLocal && localPath != skipPath) {
         Path check(localPath, includeName);
-        QFileInfo info(check.toLocalFile());
-        if (info.exists() && info.isReadable() && info.isFile()) {
+        if (directories.entryType(check) == IncludeDirectoryCache::File) {
             //kDebug(9007) << "found include file:" << info.absoluteFilePath();
             ret.first = check;
             ret.second = localPath;
@@ -238,9 +239,7 @@ restart:
         }
 
         Path check(path, includeName);
-        QFileInfo info(check.toLocalFile());
-
-        if (info.exists() && info.isReadable() && info.isFile()) {
+        if (directories.entryType(check) == IncludeDirectoryCache::File) {
             //kDebug(9007) << "found include file:" << info.absoluteFilePath();
             ret.first = check;
             ret.second = path;
@@ -305,21 +304,28 @@ bool needsUpdate(const Cpp::EnvironmentFilePointer& file, const Path& localPath,
  *
  * This must be properly fixed when we port the MissingInclude feature to clang. There, the
  * include paths must be queried in the foreground thread, before invoking code completion.
+ *
+ * It is only used for files that are not in the IncludePathSnapshots yet.
  */
 class IncludePathForegroundComputer : public DoInForeground
 {
 public:
-    IncludePathForegroundComputer(IncludePathComputer* includePathComputer)
+    IncludePathForegroundComputer(IncludePathComputer* includePathComputer, const IndexedString& source)
       : m_includePathComputer(includePathComputer)
+      , m_source(source)
     {}
 
 private:
     void doInternal() override final
     {
       m_includePathComputer->computeForeground();
+      if (IncludePathSnapshots::self()) {
+        IncludePathSnapshots::self()->insert(m_source, m_includePathComputer->foregroundResult());
+      }
     }
 
     IncludePathComputer* m_includePathComputer;
+    IndexedString m_source;
 };
 
 Path::List findIncludePaths(const QString& source)
@@ -328,8 +334,13 @@ Path::List findIncludePaths(const QString& source)
            (!DUChain::lock()->currentThreadHasReadLock() && !DUChain::lock()->currentThreadHasWriteLock()));
 
   IncludePathComputer comp(source);
-  IncludePathForegroundComputer foreground(&comp);
-  foreground.doIt();
+  IncludePathComputer::ForegroundResult result;
+  if (IncludePathSnapshots::self() && IncludePathSnapshots::self()->lookup(IndexedString(source), result)) {
+    comp.setForegroundResult(result);
+  } else {
+    IncludePathForegroundComputer foreground(&comp, IndexedString(source));
+    foreground.doIt();
+  }
   comp.computeBackground();
   return comp.result();
 }
@@ -359,15 +370,10 @@ QList<KDevelop::IncludeItem> allFilesInIncludePath(const QString& source, bool l
     }
 
     paths = makeListUnique<QString>(paths);
-    int pathNumber = 0;
 
-    QSet<QString> hadIncludePaths;
+    QStringList searchPaths;
     foreach(const QString& path, paths)
     {
-        if(hadIncludePaths.contains(path)) {
-          continue;
-        }
-        hadIncludePaths.insert(path);
         QString searchPath = path;
         if (!addPath.isEmpty() && !addPath.startsWith('/')) {
           if (!searchPath.endsWith('/')) {
@@ -375,21 +381,48 @@ QList<KDevelop::IncludeItem> allFilesInIncludePath(const QString& source, bool l
           }
           searchPath += addPath;
         }
+        searchPaths << searchPath;
+    }
+    //List the directories that are not cached yet in parallel, instead of one after the other below
+    IncludeDirectoryCache::self().prefetch(searchPaths);
+
+    static const QSet<QString> headerSuffixes = headerExtensions().toSet();
+    static const QSet<QString> sourceSuffixes = sourceExtensions().toSet();
+
+    int pathNumber = 0;
+
+    QSet<QString> hadIncludePaths;
+    for(int a = 0; a < paths.size(); ++a)
+    {
+        const QString& path = paths[a];
+        if(hadIncludePaths.contains(path)) {
+          continue;
+        }
+        hadIncludePaths.insert(path);
+        const QString& searchPath = searchPaths[a];
 
-        QDirIterator dirContent(searchPath);
+        //Only the directory is resolved on the file-system, its contents come from the listing cache
+        const IncludeDirectoryCache::Listing dirContent = IncludeDirectoryCache::self().listing(searchPath);
+        if (dirContent.isEmpty()) {
+          ++pathNumber;
+          continue;
+        }
+        const QString canonicalSearchPath = IncludeDirectoryCache::self().canonicalPath(searchPath);
 
-        while(dirContent.hasNext()) {
-             dirContent.next();
+        for(IncludeDirectoryCache::Listing::const_iterator it = dirContent.constBegin(); it != dirContent.constEnd(); ++it) {
             KDevelop::IncludeItem item;
-            item.name = dirContent.fileName();
+            item.name = it.key();
 
             if(item.name.startsWith('.') || item.name.endsWith("~")) //This filters out ".", "..", and hidden files, and backups
               continue;
-            QString suffix = dirContent.fileInfo().suffix();
-            if(!dirContent.fileInfo().suffix().isEmpty() && !headerExtensions().contains(suffix) && (!allowSourceFiles || !sourceExtensions().contains(suffix)))
-              continue;
+            const int dot = item.name.lastIndexOf('.');
+            if(dot != -1) {
+              const QString suffix = item.name.mid(dot + 1);
+              if(!suffix.isEmpty() && !headerSuffixes.contains(suffix) && (!allowSourceFiles || !sourceSuffixes.contains(suffix)))
+                continue;
+            }
             
-            QString fullPath = dirContent.fileInfo().canonicalFilePath();
+            QString fullPath = canonicalSearchPath + '/' + item.name;
             if (hadIncludePaths.contains(fullPath)) {
               continue;
             } else {
@@ -402,7 +435,7 @@ QList<KDevelop::IncludeItem> allFilesInIncludePath(const QString& source, bool l
               item.basePath = searchPath;
             }
             
-            item.isDirectory = dirContent.fileInfo().isDir();
+            item.isDirectory = it.value();
             item.pathNumber = pathNumber;
 
             ret << item;
@@ -0,0 +1,149 @@
+/*
+* This file is part of KDevelop
+*
+* Copyright 2014 KDevelop developers
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Library General Public License as
+* published by the Free Software Foundation; either version 2 of the
+* License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public
+* License along with this program; if not, write to the
+* Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#include "headersectioncache.h"
+
+#include <QMutexLocker>
+
+#include <language/duchain/topducontext.h>
+#include <language/duchain/parsingenvironment.h>
+
+#include "cppduchain/cpppreprocessenvironment.h"
+
+using namespace KDevelop;
+
+///Resolves the included top-contexts of @p snapshot, returns false if one of them doesn't exist any more
+static bool resolveIncludedFiles(const HeaderSectionSnapshot& snapshot, IncludeFileList& includedFiles)
+{
+  includedFiles.clear();
+  foreach(const HeaderSectionSnapshot::Include& include, snapshot.includedFiles) {
+    TopDUContext* context = include.context.data();
+    if(!context || context->url() != include.url || !context->parsingEnvironmentFile()
+       || !(context->parsingEnvironmentFile()->modificationRevision() == include.revision))
+    {
+      return false;
+    }
+    includedFiles << LineContextPair(context, include.sourceLine);
+  }
+  return true;
+}
+
+HeaderSectionCache::HeaderSectionCache()
+  : m_enabled(true)
+{
+}
+
+HeaderSectionCache::~HeaderSectionCache()
+{
+  clear();
+}
+
+HeaderSectionSnapshotPointer HeaderSectionCache::find(const IndexedString& localPath,
+                                                      const QList<IndexedString>& includePaths,
+                                                      const QByteArray& contents, const CppPreprocessEnvironment& environment,
+                                                      IncludeFileList& includedFiles)
+{
+  QMutexLocker lock(&m_mutex);
+
+  if(!m_enabled)
+    return HeaderSectionSnapshotPointer();
+
+  int best = -1;
+  for(int a = 0; a < m_snapshots.size(); ) {
+    const HeaderSectionSnapshotPointer& snapshot(m_snapshots[a]);
+    if(snapshot->localPath != localPath || snapshot->includePaths != includePaths
+       || (best != -1 && m_snapshots[best]->headerText.size() >= snapshot->headerText.size())
+       || !contents.startsWith(snapshot->headerText)
+       || !snapshot->environmentFile->matchMacros(&environment))
+    {
+      ++a;
+      continue;
+    }
+
+    IncludeFileList resolved;
+    if(!resolveIncludedFiles(*snapshot, resolved)) {
+      //An included top-context was deleted, so the snapshot can never be used again
+      m_snapshots.removeAt(a);
+      continue;
+    }
+    includedFiles = resolved;
+    best = a;
+    ++a;
+  }
+
+  if(best == -1) {
+    includedFiles.clear();
+    return HeaderSectionSnapshotPointer();
+  }
+
+  m_snapshots.move(best, 0);
+  return m_snapshots.first();
+}
+
+void HeaderSectionCache::insert(const HeaderSectionSnapshotPointer& snapshot)
+{
+  QMutexLocker lock(&m_mutex);
+
+  if(!m_enabled)
+    return;
+
+  const uint usedMacros = snapshot->environmentFile->usedMacros().set().setIndex();
+  for(int a = 0; a < m_snapshots.size(); ++a) {
+    if(m_snapshots[a]->headerText == snapshot->headerText && m_snapshots[a]->localPath == snapshot->localPath
+       && m_snapshots[a]->includePaths == snapshot->includePaths
+       && m_snapshots[a]->environmentFile->usedMacros().set().setIndex() == usedMacros)
+    {
+      m_snapshots.removeAt(a);
+      break;
+    }
+  }
+
+  m_snapshots.prepend(snapshot);
+
+  while(m_snapshots.size() > MaxSnapshots)
+    m_snapshots.removeLast();
+}
+
+void HeaderSectionCache::remove(const HeaderSectionSnapshotPointer& snapshot)
+{
+  QMutexLocker lock(&m_mutex);
+  m_snapshots.removeAll(snapshot);
+}
+
+void HeaderSectionCache::clear()
+{
+  QMutexLocker lock(&m_mutex);
+  m_snapshots.clear();
+}
+
+void HeaderSectionCache::setEnabled(bool enabled)
+{
+  QMutexLocker lock(&m_mutex);
+  m_enabled = enabled;
+  if(!enabled)
+    m_snapshots.clear();
+}
+
+bool HeaderSectionCache::isEnabled() const
+{
+  QMutexLocker lock(&m_mutex);
+  return m_enabled;
+}
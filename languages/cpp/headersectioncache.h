@@ -0,0 +1,127 @@
+/*
+* This file is part of KDevelop
+*
+* Copyright 2014 KDevelop developers
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Library General Public License as
+* published by the Free Software Foundation; either version 2 of the
+* License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public
+* License along with this program; if not, write to the
+* Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*/
+
+#ifndef HEADERSECTIONCACHE_H
+#define HEADERSECTIONCACHE_H
+
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+
+#include <ksharedptr.h>
+
+#include <language/duchain/indexedstring.h>
+#include <language/duchain/indexedtopducontext.h>
+#include <language/duchain/modificationrevision.h>
+
+#include "cppduchain/contextbuilder.h"
+#include "cppduchain/environmentmanager.h"
+
+class CppPreprocessEnvironment;
+
+/**
+ * A snapshot of the state the preprocessor had at the end of the header-section of a file,
+ * see "Simplified matching" in environmentmanager.h.
+ *
+ * It can be used as ready-made starting point for every file that starts with exactly the same
+ * header-section, similar to a precompiled header: The included top-contexts are imported directly,
+ * and the macros are merged from the environment-file, so only the content-section is processed.
+ * */
+struct HeaderSectionSnapshot : public KShared {
+  ///A top-context that was included in the header-section. It is not referenced, so it can be unloaded or deleted.
+  struct Include {
+    KDevelop::IndexedTopDUContext context;
+    ///Url and revision of the context when it was included, to recognize a context-index that was re-used
+    KDevelop::IndexedString url;
+    KDevelop::ModificationRevision revision;
+    int sourceLine;
+  };
+
+  ///The raw text of the header-section, up to the first significant content
+  QByteArray headerText;
+  ///Directory of the file the snapshot was created from, used for resolving local includes
+  KDevelop::IndexedString localPath;
+  QList<KDevelop::IndexedString> includePaths;
+  ///Environment-information collected in the header-section. It is not part of the DUChain.
+  Cpp::EnvironmentFilePointer environmentFile;
+  ///The top-contexts included in the header-section, in the order they were included
+  QList<Include> includedFiles;
+};
+
+typedef KSharedPtr<HeaderSectionSnapshot> HeaderSectionSnapshotPointer;
+
+/**
+ * Keeps the most recently used header-section snapshots in memory.
+ *
+ * Owned by CppLanguageSupport, which clears it before the DUChain is shut down.
+ * All functions are thread-safe.
+ * */
+class HeaderSectionCache {
+  public:
+    HeaderSectionCache();
+    ~HeaderSectionCache();
+
+    /**
+     * Returns the snapshot with the longest header-text that @p contents starts with, which was created
+     * with the macros @p environment contains, or zero if there is none.
+     *
+     * Snapshots whose included top-contexts were deleted in the meantime are removed from the cache.
+     *
+     * @param includedFiles Will be filled with the top-contexts included by the returned snapshot.
+     *                      The caller must verify that they are still up to date.
+     * @warning The DUChain must be read-locked
+     * */
+    HeaderSectionSnapshotPointer find(const KDevelop::IndexedString& localPath, const QList<KDevelop::IndexedString>& includePaths,
+                                      const QByteArray& contents, const CppPreprocessEnvironment& environment,
+                                      IncludeFileList& includedFiles);
+
+    /**
+     * Adds the given snapshot, eventually replacing one with the same header-text that depends on the same macros.
+     * Snapshots of the same header-text for different macros, for example of different targets, are kept separately.
+     * @warning The DUChain must be read-locked
+     * */
+    void insert(const HeaderSectionSnapshotPointer& snapshot);
+
+    ///Removes the given snapshot, for example because it was found to be invalid
+    void remove(const HeaderSectionSnapshotPointer& snapshot);
+
+    ///Removes all snapshots
+    void clear();
+
+    ///When disabled, find() returns no snapshots. Used to compare the performance with and without snapshots.
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+
+    enum {
+      ///Maximum number of snapshots that are kept around
+      MaxSnapshots = 64
+    };
+
+  private:
+    Q_DISABLE_COPY(HeaderSectionCache)
+
+    mutable QMutex m_mutex;
+    //Most recently used snapshots are in the front
+    QList<HeaderSectionSnapshotPointer> m_snapshots;
+    bool m_enabled;
+};
+
+#endif // HEADERSECTIONCACHE_H
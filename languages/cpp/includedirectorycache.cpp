@@ -0,0 +1,318 @@
+/*
+ * This file is part of KDevelop
+ *
+ * Copyright 2014 KDevelop developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "includedirectorycache.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QSet>
+#include <QtConcurrentMap>
+
+#include <KDirWatch>
+
+using namespace KDevelop;
+
+/**
+ * Watches listed directories for changes, and drops their listings from the cache when they change.
+ *
+ * Lives in the foreground thread, as KDirWatch does. Directories are added through queued calls,
+ * so the watcher can be used from the parse-threads.
+ * */
+class IncludeDirectoryWatcher : public QObject
+{
+  Q_OBJECT
+public:
+  static IncludeDirectoryWatcher& self()
+  {
+    static IncludeDirectoryWatcher watcher;
+    return watcher;
+  }
+
+  ///Starts watching @p directory. Can be called from any thread.
+  void watch(const QString& directory)
+  {
+    QMetaObject::invokeMethod(this, "addDirectory", Qt::QueuedConnection, Q_ARG(QString, directory));
+  }
+
+private slots:
+  void addDirectory(const QString& directory)
+  {
+    if (!m_watch) {
+      m_watch = new KDirWatch(this);
+      connect(m_watch, SIGNAL(dirty(QString)), SLOT(changed(QString)));
+      connect(m_watch, SIGNAL(created(QString)), SLOT(changed(QString)));
+      connect(m_watch, SIGNAL(deleted(QString)), SLOT(changed(QString)));
+    }
+    if (!m_watched.contains(directory)) {
+      if (m_watched.size() >= IncludeDirectoryCache::MaxWatchedDirectories) {
+        return;
+      }
+      m_watched.insert(directory);
+      m_watch->addDir(directory);
+    }
+    //Changes made between the listing and now have not been reported, so the modification-time is compared once more
+    IncludeDirectoryCache::self().setWatched(directory, QFileInfo(directory).lastModified());
+  }
+
+  void changed(const QString& path)
+  {
+    IncludeDirectoryCache::self().invalidate(path);
+  }
+
+private:
+  IncludeDirectoryWatcher()
+    : m_watch(0)
+  {
+    moveToThread(QCoreApplication::instance()->thread());
+  }
+
+  KDirWatch* m_watch;
+  QSet<QString> m_watched;
+};
+
+namespace {
+void prefetchDirectory(const QString& directory)
+{
+  IncludeDirectoryCache::self().listing(directory);
+}
+}
+
+IncludeDirectoryCache::IncludeDirectoryCache()
+  : m_enabled(true)
+{
+}
+
+IncludeDirectoryCache& IncludeDirectoryCache::self()
+{
+  static IncludeDirectoryCache cache;
+  return cache;
+}
+
+IncludeDirectoryCache::EntryType IncludeDirectoryCache::entryType(const Path& path)
+{
+  if (!m_enabled || !path.isLocalFile()) {
+    {
+      QMutexLocker lock(&m_mutex);
+      ++m_statistics.lookups;
+      ++m_statistics.fileSystemAccesses;
+    }
+    QFileInfo info(path.toLocalFile());
+    if (!info.exists()) {
+      return Missing;
+    }
+    if (info.isDir()) {
+      return Directory;
+    }
+    return info.isFile() && info.isReadable() ? File : Missing;
+  }
+
+  {
+    QMutexLocker lock(&m_mutex);
+    ++m_statistics.lookups;
+  }
+  const QString directory = path.parent().toLocalFile();
+  const QString name = path.lastPathSegment();
+  Listing entries = cachedListing(directory);
+  Listing::const_iterator it = entries.constFind(name);
+  if (it == entries.constEnd()) {
+    bool settled = true;
+    {
+      QMutexLocker lock(&m_mutex);
+      QHash<QString, CachedDirectory>::const_iterator dir = m_directories.constFind(directory);
+      if (dir != m_directories.constEnd()) {
+        settled = dir->settled;
+      }
+    }
+    if (settled) {
+      return Missing;
+    }
+    //The file may have been created without changing the modification-time
+    entries = cachedListing(directory, true);
+    it = entries.constFind(name);
+    if (it == entries.constEnd()) {
+      return Missing;
+    }
+  }
+  return *it ? Directory : File;
+}
+
+IncludeDirectoryCache::Listing IncludeDirectoryCache::listing(const QString& directory)
+{
+  if (!m_enabled) {
+    CachedDirectory read = readDirectory(QDir::cleanPath(directory));
+    return read.entries;
+  }
+  return cachedListing(QDir::cleanPath(directory));
+}
+
+IncludeDirectoryCache::Listing IncludeDirectoryCache::cachedListing(const QString& directory, bool forceUpdate)
+{
+  QDateTime cachedModified;
+  {
+    QMutexLocker lock(&m_mutex);
+    QHash<QString, CachedDirectory>::const_iterator it = m_directories.constFind(directory);
+    if (it != m_directories.constEnd() && !forceUpdate) {
+      if (it->watched || it->checked.elapsed() < RecheckInterval) {
+        ++m_statistics.hits;
+        return it->entries;
+      }
+      if (it->settled) {
+        cachedModified = it->modified;
+      }
+    }
+  }
+
+  if (cachedModified.isValid()) {
+    //Don't hold the lock while accessing the file-system
+    const QDateTime modified = QFileInfo(directory).lastModified();
+    QMutexLocker lock(&m_mutex);
+    ++m_statistics.fileSystemAccesses;
+    QHash<QString, CachedDirectory>::iterator it = m_directories.find(directory);
+    if (modified == cachedModified && it != m_directories.end()) {
+      ++m_statistics.hits;
+      it->checked.restart();
+      return it->entries;
+    }
+  }
+
+  const CachedDirectory read = readDirectory(directory);
+  {
+    QMutexLocker lock(&m_mutex);
+    m_directories.insert(directory, read);
+  }
+  if (read.modified.isValid() && QCoreApplication::instance()) {
+    IncludeDirectoryWatcher::self().watch(directory);
+  }
+  return read.entries;
+}
+
+void IncludeDirectoryCache::prefetch(const QStringList& directories)
+{
+  if (!m_enabled) {
+    return;
+  }
+
+  QStringList missing;
+  {
+    QMutexLocker lock(&m_mutex);
+    foreach (const QString& directory, directories) {
+      const QString cleaned = QDir::cleanPath(directory);
+      if (!m_directories.contains(cleaned)) {
+        missing << cleaned;
+      }
+    }
+  }
+  if (!missing.isEmpty()) {
+    QtConcurrent::blockingMap(missing, prefetchDirectory);
+  }
+}
+
+QString IncludeDirectoryCache::canonicalPath(const QString& directory)
+{
+  const QString cleaned = QDir::cleanPath(directory);
+  if (m_enabled) {
+    QMutexLocker lock(&m_mutex);
+    QHash<QString, CachedDirectory>::const_iterator it = m_directories.constFind(cleaned);
+    if (it != m_directories.constEnd()) {
+      return it->canonicalPath;
+    }
+  }
+  return QFileInfo(cleaned).canonicalFilePath();
+}
+
+void IncludeDirectoryCache::setWatched(const QString& directory, const QDateTime& modified)
+{
+  QMutexLocker lock(&m_mutex);
+  QHash<QString, CachedDirectory>::iterator it = m_directories.find(directory);
+  if (it == m_directories.end()) {
+    return;
+  }
+  if (it->modified != modified) {
+    m_directories.erase(it);
+  } else if (it->settled) {
+    it->watched = true;
+  }
+}
+
+IncludeDirectoryCache::CachedDirectory IncludeDirectoryCache::readDirectory(const QString& directory)
+{
+  CachedDirectory ret;
+  ret.modified = QFileInfo(directory).lastModified();
+  ret.checked.start();
+  if (ret.modified.isValid()) {
+    ret.canonicalPath = QFileInfo(directory).canonicalFilePath();
+    QDir dir(directory);
+    foreach (const QString& file, dir.entryList(QDir::Files | QDir::Readable | QDir::Hidden)) {
+      ret.entries.insert(file, false);
+    }
+    foreach (const QString& subDirectory, dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::Hidden)) {
+      ret.entries.insert(subDirectory, true);
+    }
+    ret.settled = ret.modified.secsTo(QDateTime::currentDateTime()) > 1;
+  } else {
+    //A directory that is created later gets a valid modification-time
+    ret.settled = true;
+  }
+
+  QMutexLocker lock(&m_mutex);
+  ++m_statistics.listings;
+  ++m_statistics.fileSystemAccesses;
+  return ret;
+}
+
+void IncludeDirectoryCache::invalidate(const QString& directory)
+{
+  QMutexLocker lock(&m_mutex);
+  m_directories.remove(QDir::cleanPath(directory));
+}
+
+void IncludeDirectoryCache::clear()
+{
+  QMutexLocker lock(&m_mutex);
+  m_directories.clear();
+  m_statistics = Statistics();
+}
+
+void IncludeDirectoryCache::setEnabled(bool enabled)
+{
+  m_enabled = enabled;
+}
+
+bool IncludeDirectoryCache::isEnabled() const
+{
+  return m_enabled;
+}
+
+IncludeDirectoryCache::Statistics IncludeDirectoryCache::statistics() const
+{
+  QMutexLocker lock(&m_mutex);
+  Statistics ret = m_statistics;
+  ret.directories = m_directories.size();
+  foreach (const CachedDirectory& directory, m_directories) {
+    if (directory.watched) {
+      ++ret.watchedDirectories;
+    }
+  }
+  return ret;
+}
+
+#include "includedirectorycache.moc"
@@ -0,0 +1,129 @@
+/*
+ * This file is part of KDevelop
+ *
+ * Copyright 2014 KDevelop developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDEDIRECTORYCACHE_H
+#define INCLUDEDIRECTORYCACHE_H
+
+#include <QHash>
+#include <QMutex>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QString>
+#include <QStringList>
+
+#include <util/path.h>
+
+/**
+ * Caches the listings of include-directories, so include-directives can be resolved without
+ * probing every include-path on the file-system. The cache is shared by all parse-threads.
+ *
+ * A listing is re-used as long as the modification-time of its directory does not change,
+ * which is checked at most once every RecheckInterval milliseconds. Listed directories are
+ * also watched for changes, and the listings of watched directories are re-used without
+ * checking the file-system at all until a change is reported.
+ * */
+class IncludeDirectoryCache
+{
+public:
+  enum {
+    ///Minimum time in milliseconds between two checks of the same directory
+    RecheckInterval = 1000,
+    ///Maximum count of directories that are watched for changes
+    MaxWatchedDirectories = 1024
+  };
+
+  enum EntryType {
+    Missing,
+    File,
+    Directory
+  };
+
+  ///Maps the names of all readable files and sub-directories to whether they are directories
+  typedef QHash<QString, bool> Listing;
+
+  static IncludeDirectoryCache& self();
+
+  ///Returns what @p path points to. Can be called from any thread.
+  EntryType entryType(const KDevelop::Path& path);
+
+  ///Returns the listing of @p directory, which is empty if it does not exist
+  Listing listing(const QString& directory);
+
+  ///Lists all @p directories that are not cached yet in parallel
+  void prefetch(const QStringList& directories);
+
+  ///Returns the canonical path of @p directory, as determined when it was listed
+  QString canonicalPath(const QString& directory);
+
+  ///Drops the cached listing of @p directory
+  void invalidate(const QString& directory);
+  void clear();
+
+  ///While disabled, every lookup goes to the file-system
+  void setEnabled(bool enabled);
+  bool isEnabled() const;
+
+  struct Statistics
+  {
+    Statistics() : lookups(0), hits(0), listings(0), fileSystemAccesses(0), directories(0), watchedDirectories(0) {}
+    uint lookups;
+    ///Lookups answered from a cached listing
+    uint hits;
+    uint listings;
+    ///Listings, modification-time checks, and uncached lookups
+    uint fileSystemAccesses;
+    uint directories;
+    uint watchedDirectories;
+  };
+  Statistics statistics() const;
+
+private:
+  friend class IncludeDirectoryWatcher;
+  IncludeDirectoryCache();
+
+  struct CachedDirectory
+  {
+    CachedDirectory() : settled(false), watched(false) {}
+    Listing entries;
+    QString canonicalPath;
+    QDateTime modified;
+    QElapsedTimer checked;
+    ///Whether the directory was not modified shortly before it was listed.
+    ///The modification-time has only a resolution of seconds, so later changes
+    ///to unsettled directories may go unnoticed.
+    bool settled;
+    ///Whether changes of the directory are reported by the IncludeDirectoryWatcher
+    bool watched;
+  };
+
+  ///Returns the up-to-date listing of @p directory, which has to be cleaned
+  Listing cachedListing(const QString& directory, bool forceUpdate = false);
+  CachedDirectory readDirectory(const QString& directory);
+  ///Called by the watcher once @p directory is watched. @p modified is its modification-time at that point.
+  void setWatched(const QString& directory, const QDateTime& modified);
+
+  mutable QMutex m_mutex;
+  QHash<QString, CachedDirectory> m_directories;
+  Statistics m_statistics;
+  bool m_enabled;
+};
+
+#endif // INCLUDEDIRECTORYCACHE_H
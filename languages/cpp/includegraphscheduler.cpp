@@ -0,0 +1,174 @@
+/*
+ * This file is part of KDevelop
+ *
+ * Copyright 2014 KDevelop developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "includegraphscheduler.h"
+
+#include <QStack>
+#include <QtConcurrentRun>
+
+#include <kdebug.h>
+
+#include <interfaces/icore.h>
+#include <interfaces/ilanguagecontroller.h>
+#include <language/backgroundparser/backgroundparser.h>
+#include <language/duchain/duchain.h>
+#include <language/duchain/duchainlock.h>
+#include <language/duchain/parsingenvironment.h>
+#include <language/duchain/topducontext.h>
+
+using namespace KDevelop;
+
+namespace {
+///Collects the files included by @p file in any of its parsed versions
+QSet<IndexedString> includedFiles(const IndexedString& file)
+{
+  //Locked per file, so parse-jobs waiting for the write-lock get in between
+  DUChainReadLocker lock;
+  QSet<IndexedString> ret;
+  foreach(const ParsingEnvironmentFilePointer& version, DUChain::self()->allEnvironmentFiles(file)) {
+    foreach(const ParsingEnvironmentFilePointer& import, version->imports()) {
+      if(import && import->url() != file)
+        ret.insert(import->url());
+    }
+  }
+  return ret;
+}
+}
+
+IncludeGraphScheduler::IncludeGraphScheduler(QObject* parent)
+  : QObject(parent)
+{
+  connect(&m_watcher, SIGNAL(finished()), this, SLOT(heightsComputed()));
+}
+
+IncludeGraphScheduler::~IncludeGraphScheduler()
+{
+  //The computation only takes short read-locks, so it can't block the foreground thread
+  m_watcher.waitForFinished();
+}
+
+QHash<IndexedString, int> IncludeGraphScheduler::heights(const QSet<IndexedString>& files)
+{
+  QHash<IndexedString, int> heights;
+  //Files that are currently on the stack, so recursive includes are detected
+  QSet<IndexedString> visiting;
+
+  struct Frame {
+    IndexedString file;
+    QList<IndexedString> includes;
+    int nextInclude;
+    int height;
+  };
+
+  //Iterative depth-first search, since include-chains can be long
+  foreach(const IndexedString& root, files) {
+    if(heights.contains(root))
+      continue;
+
+    QStack<Frame> stack;
+    Frame rootFrame = { root, includedFiles(root).toList(), 0, 0 };
+    stack.push(rootFrame);
+    visiting.insert(root);
+
+    while(!stack.isEmpty()) {
+      Frame& frame = stack.top();
+      if(frame.nextInclude < frame.includes.size()) {
+        const IndexedString include = frame.includes[frame.nextInclude++];
+        QHash<IndexedString, int>::const_iterator known = heights.constFind(include);
+        if(known != heights.constEnd()) {
+          frame.height = qMax(frame.height, *known + 1);
+        } else if(!visiting.contains(include)) {
+          Frame includeFrame = { include, includedFiles(include).toList(), 0, 0 };
+          visiting.insert(include);
+          stack.push(includeFrame);
+        }
+        continue;
+      }
+
+      const IndexedString file = frame.file;
+      const int height = frame.height;
+      heights.insert(file, height);
+      visiting.remove(file);
+      stack.pop();
+      if(!stack.isEmpty())
+        stack.top().height = qMax(stack.top().height, height + 1);
+    }
+  }
+
+  return heights;
+}
+
+void IncludeGraphScheduler::prioritize(const QSet<IndexedString>& files)
+{
+  BackgroundParser* parser = ICore::self()->languageController()->backgroundParser();
+
+  foreach(const IndexedString& file, files) {
+    if(parser->isQueued(file))
+      m_pending.insert(file);
+  }
+
+  if(!m_watcher.isRunning())
+    startComputing();
+}
+
+void IncludeGraphScheduler::startComputing()
+{
+  m_computing = m_pending;
+  m_pending.clear();
+
+  if(m_computing.isEmpty()) {
+    emit prioritized();
+    return;
+  }
+
+  m_watcher.setFuture(QtConcurrent::run(&IncludeGraphScheduler::heights, m_computing));
+}
+
+void IncludeGraphScheduler::heightsComputed()
+{
+  const QHash<IndexedString, int> fileHeights = m_watcher.result();
+  BackgroundParser* parser = ICore::self()->languageController()->backgroundParser();
+
+  int maxHeight = 0;
+  foreach(int height, fileHeights)
+    maxHeight = qMax(maxHeight, height);
+
+  //When the height is 0 everywhere, nothing is known about the include-structure, probably the project was never parsed before
+  if(maxHeight > 0) {
+    kDebug(9007) << "ordering" << m_computing.size() << "queued files by their include-graph, maximum height:" << maxHeight;
+
+    //The background-parser uses the best priority that was given for a document, so the files with the
+    //lowest height get a priority better than the one used for the initial parse, and all others stay in between.
+    //No features are requested, so the ones the file was queued with stay the same.
+    foreach(const IndexedString& file, m_computing) {
+      //Files that were parsed in the meantime must not be queued again
+      if(!parser->isQueued(file))
+        continue;
+      const int priority = BackgroundParser::InitialParsePriority - maxHeight + fileHeights.value(file);
+      parser->addDocument(file, TopDUContext::Empty, priority);
+    }
+  }
+
+  m_computing.clear();
+  startComputing();
+}
+
+#include "includegraphscheduler.moc"
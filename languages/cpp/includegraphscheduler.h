@@ -0,0 +1,86 @@
+/*
+ * This file is part of KDevelop
+ *
+ * Copyright 2014 KDevelop developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDEGRAPHSCHEDULER_H
+#define INCLUDEGRAPHSCHEDULER_H
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QFutureWatcher>
+
+#include <language/duchain/indexedstring.h>
+
+/**
+ * Orders the background-parsing of a set of files by their include-graph, as it is known from
+ * the DUChain of the previous session.
+ *
+ * Every file that is parsed on its own includes its headers through parseForeground(), so when the
+ * .cpp files are parsed first, each parse-thread descends into the same headers, and they are parsed
+ * multiple times or wait for each other. When instead the files that include nothing are parsed first,
+ * followed by the files that include only those, and so on, the parse-threads can work independently,
+ * and the later files find their includes already up to date in the DUChain.
+ * */
+class IncludeGraphScheduler : public QObject {
+  Q_OBJECT
+  public:
+    explicit IncludeGraphScheduler(QObject* parent = 0);
+    ~IncludeGraphScheduler();
+
+    /**
+     * Computes the height of each file in the include-graph: Files that include nothing have height 0,
+     * all other files have a height that is one more than the maximum height of the files they include.
+     * Files that include each other recursively are cut at the point where the recursion is found.
+     *
+     * The DUChain is read-locked separately for each file, so parse-jobs that need the write-lock
+     * are not blocked for the whole computation.
+     * */
+    static QHash<KDevelop::IndexedString, int> heights(const QSet<KDevelop::IndexedString>& files);
+
+    /**
+     * Gives each of the given files that is queued in the background-parser a priority according to its
+     * height, so that files with a lower height are parsed first. The features the files are parsed with
+     * are not changed.
+     *
+     * The heights are computed in a background-thread, since all environment-files of the files need to
+     * be loaded. The priorities are given once prioritized() is emitted, to the files that are still queued.
+     *
+     * Must be called from the foreground thread.
+     * */
+    void prioritize(const QSet<KDevelop::IndexedString>& files);
+
+  signals:
+    ///Emitted when the files given to prioritize() were prioritized
+    void prioritized();
+
+  private slots:
+    void heightsComputed();
+
+  private:
+    void startComputing();
+
+    QFutureWatcher<QHash<KDevelop::IndexedString, int> > m_watcher;
+    //Queued files whose heights are being computed, and the ones given while that was still running
+    QSet<KDevelop::IndexedString> m_computing;
+    QSet<KDevelop::IndexedString> m_pending;
+};
+
+#endif // INCLUDEGRAPHSCHEDULER_H
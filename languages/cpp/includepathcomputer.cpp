@@ -137,6 +137,36 @@ void IncludePathComputer::computeForeground()
   }
 }
 
+void IncludePathComputer::setForegroundResult(const ForegroundResult& result)
+{
+  m_source = result.source;
+  m_ret.clear();
+  m_hasPath.clear();
+  foreach (const Path& path, result.paths) {
+    addInclude(path);
+  }
+  m_defines = result.defines;
+  m_effectiveBuildDirectory = result.effectiveBuildDirectory;
+  m_buildDirectory = result.buildDirectory;
+  m_projectDirectory = result.projectDirectory;
+  m_projectName = result.projectName;
+  m_gotPathsFromManager = result.gotPathsFromManager;
+}
+
+IncludePathComputer::ForegroundResult IncludePathComputer::foregroundResult() const
+{
+  ForegroundResult result;
+  result.source = m_source;
+  result.paths = m_ret;
+  result.defines = m_defines;
+  result.effectiveBuildDirectory = m_effectiveBuildDirectory;
+  result.buildDirectory = m_buildDirectory;
+  result.projectDirectory = m_projectDirectory;
+  result.projectName = m_projectName;
+  result.gotPathsFromManager = m_gotPathsFromManager;
+  return result;
+}
+
 void IncludePathComputer::computeBackground()
 {
   if (m_ready) {
@@ -24,9 +24,28 @@
 class IncludePathComputer
 {
 public:
+  ///Everything computeForeground() takes from the project model and the build manager
+  struct ForegroundResult
+  {
+    ForegroundResult() : gotPathsFromManager(false) {}
+
+    QString source;
+    KDevelop::Path::List paths;
+    QHash<QString,QString> defines;
+    KDevelop::Path effectiveBuildDirectory;
+    KDevelop::Path buildDirectory;
+    KDevelop::Path projectDirectory;
+    QString projectName;
+    bool gotPathsFromManager;
+  };
+
   IncludePathComputer(const QString& file);
   ///Must be called in the foreground thread, before calling computeBackground().
   void computeForeground();
+  ///Can be called from any thread instead of computeForeground(), with a result that was computed before
+  void setForegroundResult(const ForegroundResult& result);
+  ///Returns the state after computeForeground(), so it can be re-used for the same file
+  ForegroundResult foregroundResult() const;
   ///Can be called from within background thread, but does not have to. May lock for a long time.
   void computeBackground();
 
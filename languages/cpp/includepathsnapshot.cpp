@@ -0,0 +1,295 @@
+/*
+ * This file is part of KDevelop
+ *
+ * Copyright 2014 KDevelop developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "includepathsnapshot.h"
+
+#include <QCoreApplication>
+#include <QMetaObject>
+#include <QMutexLocker>
+#include <QThread>
+#include <QTimer>
+
+#include <kdebug.h>
+
+#include <interfaces/icore.h>
+#include <interfaces/iplugin.h>
+#include <interfaces/iproject.h>
+#include <interfaces/iprojectcontroller.h>
+#include <project/projectmodel.h>
+
+using namespace KDevelop;
+
+namespace {
+IncludePathSnapshots* s_self = 0;
+}
+
+IncludePathSnapshots::IncludePathSnapshots(QObject* parent)
+  : QObject(parent)
+  , m_current(new IncludePathSnapshot)
+  , m_changedProjectsTimer(new QTimer(this))
+  , m_stepScheduled(false)
+{
+  Q_ASSERT(QThread::currentThread() == qApp->thread());
+  Q_ASSERT(!s_self);
+  s_self = this;
+
+  //The build managers add and remove many items at once, so wait until that settled
+  m_changedProjectsTimer->setSingleShot(true);
+  m_changedProjectsTimer->setInterval(500);
+  connect(m_changedProjectsTimer, SIGNAL(timeout()), SLOT(updateChangedProjects()));
+
+  IProjectController* projectController = ICore::self()->projectController();
+  connect(projectController, SIGNAL(projectOpened(KDevelop::IProject*)),
+          SLOT(projectChanged(KDevelop::IProject*)));
+  connect(projectController, SIGNAL(projectConfigurationChanged(KDevelop::IProject*)),
+          SLOT(projectChanged(KDevelop::IProject*)));
+  connect(projectController, SIGNAL(projectClosed(KDevelop::IProject*)),
+          SLOT(projectClosed(KDevelop::IProject*)));
+  connect(projectController->projectModel(), SIGNAL(rowsInserted(QModelIndex,int,int)),
+          SLOT(itemsChanged(QModelIndex)));
+  connect(projectController->projectModel(), SIGNAL(rowsRemoved(QModelIndex,int,int)),
+          SLOT(itemsChanged(QModelIndex)));
+}
+
+IncludePathSnapshots::~IncludePathSnapshots()
+{
+  s_self = 0;
+}
+
+IncludePathSnapshots* IncludePathSnapshots::self()
+{
+  return s_self;
+}
+
+QSharedPointer<const IncludePathSnapshot> IncludePathSnapshots::current() const
+{
+  //Only the reference is taken under the lock, the snapshot is read without it
+  QMutexLocker lock(&m_currentMutex);
+  return m_current;
+}
+
+bool IncludePathSnapshots::lookup(const IndexedString& file, IncludePathComputer::ForegroundResult& result) const
+{
+  m_lookups.ref();
+  const QSharedPointer<const IncludePathSnapshot> snapshot = current();
+  QHash<IndexedString, IncludePathComputer::ForegroundResult>::const_iterator it = snapshot->files.constFind(file);
+  if (it == snapshot->files.constEnd()) {
+    return false;
+  }
+  result = *it;
+  m_hits.ref();
+  return true;
+}
+
+uint IncludePathSnapshots::version() const
+{
+  return current()->version;
+}
+
+IncludePathSnapshots::Statistics IncludePathSnapshots::statistics() const
+{
+  Statistics ret;
+  ret.lookups = m_lookups;
+  ret.hits = m_hits;
+  const QSharedPointer<const IncludePathSnapshot> snapshot = current();
+  ret.version = snapshot->version;
+  ret.files = snapshot->files.size();
+  return ret;
+}
+
+void IncludePathSnapshots::update(const QSet<IndexedString>& files)
+{
+  Q_ASSERT(QThread::currentThread() == qApp->thread());
+
+  //m_current is only replaced in the foreground thread, so it can be read here without locking
+  const IncludePathSnapshot* current = m_current.data();
+  foreach (const IndexedString& file, files) {
+    if (current->files.contains(file) || m_pending.contains(file) || m_queued.contains(file)) {
+      continue;
+    }
+    m_queue << file;
+    m_queued.insert(file);
+  }
+  scheduleStep();
+}
+
+void IncludePathSnapshots::insert(const IndexedString& file, const IncludePathComputer::ForegroundResult& result)
+{
+  Q_ASSERT(QThread::currentThread() == qApp->thread());
+
+  m_pending.insert(file, result);
+  m_removed.remove(file);
+  //Published with the next step, so many results computed in a row are published together
+  scheduleStep();
+}
+
+void IncludePathSnapshots::invalidate(const QSet<IndexedString>& files)
+{
+  Q_ASSERT(QThread::currentThread() == qApp->thread());
+
+  foreach (const IndexedString& file, files) {
+    m_pending.remove(file);
+    m_removed.insert(file);
+    if (!m_queued.contains(file)) {
+      m_queue << file;
+      m_queued.insert(file);
+    }
+  }
+  //Outdated results must not be used anymore, even if computing the new ones takes a while
+  publish();
+  scheduleStep();
+}
+
+void IncludePathSnapshots::flush()
+{
+  Q_ASSERT(QThread::currentThread() == qApp->thread());
+
+  while (!m_queue.isEmpty()) {
+    computeStep();
+  }
+  publish();
+}
+
+void IncludePathSnapshots::scheduleStep()
+{
+  if (!m_stepScheduled) {
+    m_stepScheduled = true;
+    QTimer::singleShot(0, this, SLOT(computeStep()));
+  }
+}
+
+void IncludePathSnapshots::computeStep()
+{
+  m_stepScheduled = false;
+
+  for (int a = 0; a < FilesPerStep && !m_queue.isEmpty(); ++a) {
+    const IndexedString file = m_queue.takeFirst();
+    m_queued.remove(file);
+
+    IncludePathComputer computer(file.str());
+    computer.computeForeground();
+    m_pending.insert(file, computer.foregroundResult());
+    m_removed.remove(file);
+  }
+
+  publish();
+
+  if (!m_queue.isEmpty()) {
+    scheduleStep();
+  }
+}
+
+void IncludePathSnapshots::publish()
+{
+  if (m_pending.isEmpty() && m_removed.isEmpty()) {
+    return;
+  }
+
+  //The new snapshot is built without holding the lock, only the reference is swapped under it
+  const IncludePathSnapshot* current = m_current.data();
+  IncludePathSnapshot* snapshot = new IncludePathSnapshot(current->version + 1);
+  snapshot->files = current->files;
+  foreach (const IndexedString& file, m_removed) {
+    snapshot->files.remove(file);
+  }
+  for (QHash<IndexedString, IncludePathComputer::ForegroundResult>::const_iterator it = m_pending.constBegin();
+       it != m_pending.constEnd(); ++it) {
+    snapshot->files.insert(it.key(), it.value());
+  }
+  m_pending.clear();
+  m_removed.clear();
+
+  QSharedPointer<const IncludePathSnapshot> retired;
+  {
+    QMutexLocker lock(&m_currentMutex);
+    retired = m_current;
+    m_current = QSharedPointer<const IncludePathSnapshot>(snapshot);
+  }
+  //The retired snapshot is deleted here, or by its last reader
+}
+
+void IncludePathSnapshots::projectChanged(IProject* project)
+{
+  //Build managers that know when the includes or defines of their items change tell so through this signal
+  QObject* manager = project->managerPlugin();
+  if (manager && manager->metaObject()->indexOfSignal("includesAndDefinesChanged(KDevelop::ProjectBaseItem*)") != -1) {
+    connect(manager, SIGNAL(includesAndDefinesChanged(KDevelop::ProjectBaseItem*)),
+            SLOT(includesAndDefinesChanged(KDevelop::ProjectBaseItem*)), Qt::UniqueConnection);
+  }
+
+  if (!m_changedProjects.contains(project)) {
+    m_changedProjects << QPointer<IProject>(project);
+  }
+  m_changedProjectsTimer->start();
+}
+
+void IncludePathSnapshots::itemsChanged(const QModelIndex& parent)
+{
+  ProjectBaseItem* item = ICore::self()->projectController()->projectModel()->itemFromIndex(parent);
+  if (item && item->project()) {
+    projectChanged(item->project());
+  }
+}
+
+void IncludePathSnapshots::includesAndDefinesChanged(ProjectBaseItem* item)
+{
+  if (item && item->project()) {
+    projectChanged(item->project());
+  }
+}
+
+void IncludePathSnapshots::updateChangedProjects()
+{
+  QSet<IndexedString> files;
+  foreach (const QPointer<IProject>& project, m_changedProjects) {
+    if (project) {
+      files += project->fileSet();
+    }
+  }
+  m_changedProjects.clear();
+
+  kDebug(9007) << "re-computing the include-paths of" << files.size() << "project files";
+  invalidate(files);
+}
+
+void IncludePathSnapshots::projectClosed(IProject* project)
+{
+  //The files are now outside of any project, so their results are computed again when they are needed
+  const QString name = project->name();
+  const IncludePathSnapshot* current = m_current.data();
+  for (QHash<IndexedString, IncludePathComputer::ForegroundResult>::const_iterator it = current->files.constBegin();
+       it != current->files.constEnd(); ++it) {
+    if (it->projectName == name) {
+      m_removed.insert(it.key());
+    }
+  }
+  for (QHash<IndexedString, IncludePathComputer::ForegroundResult>::iterator it = m_pending.begin(); it != m_pending.end(); ) {
+    if (it->projectName == name) {
+      it = m_pending.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  m_changedProjects.removeAll(QPointer<IProject>(project));
+  publish();
+}
+
+#include "includepathsnapshot.moc"
@@ -0,0 +1,140 @@
+/*
+ * This file is part of KDevelop
+ *
+ * Copyright 2014 KDevelop developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDEPATHSNAPSHOT_H
+#define INCLUDEPATHSNAPSHOT_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QPointer>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QSharedPointer>
+
+#include <language/duchain/indexedstring.h>
+
+#include "includepathcomputer.h"
+
+class QModelIndex;
+class QTimer;
+
+namespace KDevelop {
+class IProject;
+class ProjectBaseItem;
+}
+
+///An immutable set of foreground include-path results, see IncludePathSnapshots
+struct IncludePathSnapshot
+{
+  IncludePathSnapshot(uint _version = 0) : version(_version) {}
+
+  uint version;
+  QHash<KDevelop::IndexedString, IncludePathComputer::ForegroundResult> files;
+};
+
+/**
+ * Publishes the results of IncludePathComputer::computeForeground() for all project files, so
+ * parse-jobs and code-completion can compute include-paths without waiting for the foreground thread.
+ *
+ * The results are computed in the foreground thread in small steps, and published as a new immutable
+ * snapshot with an increased version. Background threads only lock to take a reference to the current
+ * snapshot, and read it without locking.
+ * The results of a project are re-computed when it is opened, when its configuration changes, when the
+ * build manager changes its items, and when the build manager reports changed includes or defines
+ * through a signal includesAndDefinesChanged(KDevelop::ProjectBaseItem*).
+ * */
+class IncludePathSnapshots : public QObject
+{
+  Q_OBJECT
+public:
+  enum {
+    ///Number of files computed in one step of the foreground thread
+    FilesPerStep = 100
+  };
+
+  ///Must be created in the foreground thread. Only one instance may exist at a time.
+  explicit IncludePathSnapshots(QObject* parent = 0);
+  ~IncludePathSnapshots();
+
+  ///Returns the current instance, or zero
+  static IncludePathSnapshots* self();
+
+  ///Fills @p result with the foreground result for @p file, if the current snapshot contains one.
+  ///Can be called from any thread, and never blocks.
+  bool lookup(const KDevelop::IndexedString& file, IncludePathComputer::ForegroundResult& result) const;
+
+  ///Version of the current snapshot, increased with every change
+  uint version() const;
+
+  ///Queues @p files to be computed in the foreground thread
+  void update(const QSet<KDevelop::IndexedString>& files);
+
+  ///Adds a result that has been computed anyway in the foreground thread
+  void insert(const KDevelop::IndexedString& file, const IncludePathComputer::ForegroundResult& result);
+
+  ///Removes the results of @p files, and computes them again
+  void invalidate(const QSet<KDevelop::IndexedString>& files);
+
+  ///Computes all queued files right away, and publishes them
+  void flush();
+
+  struct Statistics
+  {
+    Statistics() : lookups(0), hits(0), version(0), files(0) {}
+    uint lookups;
+    uint hits;
+    uint version;
+    uint files;
+  };
+  Statistics statistics() const;
+
+private slots:
+  void projectChanged(KDevelop::IProject* project);
+  void projectClosed(KDevelop::IProject* project);
+  void itemsChanged(const QModelIndex& parent);
+  void includesAndDefinesChanged(KDevelop::ProjectBaseItem* item);
+  void updateChangedProjects();
+  void computeStep();
+
+private:
+  void scheduleStep();
+  ///Publishes the pending changes as new snapshot
+  void publish();
+  QSharedPointer<const IncludePathSnapshot> current() const;
+
+  ///Only guards m_current itself, the snapshots are immutable
+  mutable QMutex m_currentMutex;
+  QSharedPointer<const IncludePathSnapshot> m_current;
+  mutable QAtomicInt m_lookups;
+  mutable QAtomicInt m_hits;
+
+  //Only used in the foreground thread
+  QHash<KDevelop::IndexedString, IncludePathComputer::ForegroundResult> m_pending;
+  QSet<KDevelop::IndexedString> m_removed;
+  QList<KDevelop::IndexedString> m_queue;
+  QSet<KDevelop::IndexedString> m_queued;
+  QList<QPointer<KDevelop::IProject> > m_changedProjects;
+  QTimer* m_changedProjectsTimer;
+  bool m_stepScheduled;
+};
+
+#endif // INCLUDEPATHSNAPSHOT_H
@@ -49,7 +49,7 @@ QString CodeGenerator::output()
 void CodeGenerator::outputToken(uint tokenPosition)
 {
   if (tokenPosition) {
-    const Token& t = m_session->token_stream->token(tokenPosition);
+    const Token t = m_session->token_stream->token(tokenPosition);
     m_output << m_session->token_stream->symbolString(t);
 
     /* if (t.kind == Token_identifier || t.kind == Token_string_literal || t.kind == Token_number_literal || t.kind == Token_char_literal)
@@ -67,7 +67,7 @@ void CommentFormatter::extractToDos( uint token, const ParseSession* session, Co
   if( !token )
     return;
   
-  const Token& commentToken( (*session->token_stream)[token] );
+  const Token commentToken( session->token_stream->token(token) );
   
   if( !containsToDo(session->contents() + commentToken.position, session->contents() + commentToken.position + commentToken.size) )
     return; // Most common code path: No todos
@@ -128,7 +128,7 @@ QByteArray CommentFormatter::formatComment( uint token, const ParseSession* sess
   if( !token )
     return QByteArray();
   ///@todo Work directly on lists of IndexedString tokens, rather than QBytearray (faster), and only convert to QByteArray in the end.
-  const Token& commentToken( (*session->token_stream)[token] );
+  const Token commentToken( session->token_stream->token(token) );
   return KDevelop::formatComment( stringFromContents(session->contentsVector(), commentToken.position, commentToken.size ) );
 }
 
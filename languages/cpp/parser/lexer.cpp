@@ -21,29 +21,60 @@
 #include "tokens.h"
 #include "control.h"
 #include "parsesession.h"
+#include "memorypool.h"
 #include "rpp/pp-scanner.h"
 
+#include <QSet>
+#include <QtAlgorithms>
+
 #include <cctype>
+#include <cstring>
 #include <util/kdevvarlengtharray.h>
 
 #include <kdebug.h>
 #include <klocalizedstring.h>
 
+void TokenStream::reserve(uint size)
+{
+  if (size <= static_cast<uint>(m_capacity))
+    return;
+
+  quint16* kinds = session->mempool->allocate<quint16>(size);
+  uint* positions = session->mempool->allocate<uint>(size);
+  uint* sizes = session->mempool->allocate<uint>(size);
+  if (m_count) {
+    memcpy(kinds, m_kinds, m_count * sizeof(quint16));
+    memcpy(positions, m_positions, m_count * sizeof(uint));
+    memcpy(sizes, m_sizes, m_count * sizeof(uint));
+  }
+  m_kinds = kinds;
+  m_positions = positions;
+  m_sizes = sizes;
+  m_capacity = size;
+}
+
 void TokenStream::splitRightShift(uint index)
 {
   Q_ASSERT(kind(index) == Token_rightshift);
+  Q_ASSERT(tokenSize(index) == 2);
+
+  // make room for the new token behind the current one
+  if (m_count == m_capacity)
+    reserve(m_capacity * 2);
+  const uint tail = m_count - index - 1;
+  memmove(m_kinds + index + 2, m_kinds + index + 1, tail * sizeof(quint16));
+  memmove(m_positions + index + 2, m_positions + index + 1, tail * sizeof(uint));
+  memmove(m_sizes + index + 2, m_sizes + index + 1, tail * sizeof(uint));
+  ++m_count;
 
   // change kind of current token and adapt size
-  Token &current_token = (*this)[index];
-  Q_ASSERT(current_token.size == 2);
-  current_token.size = 1;
-  current_token.kind = '>';
+  m_sizes[index] = 1;
+  m_kinds[index] = '>';
 
   // copy to next token (i.e. the new one) and adapt position
-  Token next_token = current_token;
-  next_token.position += 1;
-
-  insert(index+1, next_token);
+  m_kinds[index + 1] = '>';
+  m_positions[index + 1] = m_positions[index] + 1;
+  m_sizes[index + 1] = 1;
 }
 
 KDevelop::IndexedString TokenStream::symbol(const Token& t) const
@@ -153,13 +184,14 @@ void Lexer::skipComment()
   return;
 }
 
-const uint index_size = 200;
+namespace {
+
+typedef QList<QPair<uint, TOKEN_KIND> > KeywordList;
 
-KDevVarLengthArray<KDevVarLengthArray<QPair<uint, TOKEN_KIND>, 10 >, index_size > createIndicesForTokens(CPPLanguageFeatures features) {
-  KDevVarLengthArray<KDevVarLengthArray<QPair<uint, TOKEN_KIND>, 10 >, index_size > ret;
-  ret.resize(index_size);
-  #define ADD_TOKEN(string) ret[KDevelop::IndexedString(#string).index() % index_size].append(qMakePair(KDevelop::IndexedString(#string).index(), Token_ ## string));
-  #define ADD_TOKEN2(string, tok) ret[KDevelop::IndexedString(#string).index() % index_size].append(qMakePair(KDevelop::IndexedString(#string).index(), Token_ ## tok));
+KeywordList keywordIndices(CPPLanguageFeatures features) {
+  KeywordList ret;
+  #define ADD_TOKEN(string) ret.append(qMakePair(KDevelop::IndexedString(#string).index(), Token_ ## string));
+  #define ADD_TOKEN2(string, tok) ret.append(qMakePair(KDevelop::IndexedString(#string).index(), Token_ ## tok));
   ADD_TOKEN(__typeof);
   ADD_TOKEN2(__typeof__, __typeof);
   ADD_TOKEN(__alignof__);
@@ -274,10 +306,92 @@ KDevVarLengthArray<KDevVarLengthArray<QPair<uint, TOKEN_KIND>, 10 >, index_size
     ADD_TOKEN2(__thread, thread_local);
     ADD_TOKEN2(__thread__, thread_local);
   }
+  #undef ADD_TOKEN
+  #undef ADD_TOKEN2
 
   return ret;
 }
 
+/**
+ * A perfect hash table that maps the IndexedString indices of the keywords to their token kinds.
+ *
+ * The indices are only known at runtime, so on construction the smallest power-of-two table size and
+ * a multiplier are searched for which no two keywords share a slot. Classifying an identifier then
+ * takes one multiplication, one shift and one comparison.
+ */
+class KeywordTable
+{
+public:
+  explicit KeywordTable(CPPLanguageFeatures features)
+  {
+    KeywordList keywords;
+    QSet<uint> seen;
+    foreach(const KeywordList::value_type& keyword, keywordIndices(features)) {
+      if(!seen.contains(keyword.first)) {
+        seen.insert(keyword.first);
+        keywords.append(keyword);
+      }
+    }
+
+    uint bits = 1;
+    while((1u << bits) < 2u * keywords.size())
+      ++bits;
+
+    // deterministic sequence of odd multipliers, so the table is the same in every run
+    uint candidate = 0x9E3779B1u;
+    for(;; ++bits) {
+      Q_ASSERT(bits < 24);
+      for(int attempt = 0; attempt < 1000; ++attempt) {
+        candidate = candidate * 1664525u + 1013904223u;
+        m_multiplier = candidate | 1;
+        m_shift = 32 - bits;
+        if(tryFill(keywords, bits))
+          return;
+      }
+    }
+  }
+
+  /// @return the kind of the keyword with the given IndexedString index, or Token_identifier
+  inline TOKEN_KIND lookup(uint index) const
+  {
+    const Entry& entry = m_entries[slot(index)];
+    return entry.index == index ? entry.kind : Token_identifier;
+  }
+
+private:
+  struct Entry
+  {
+    uint index;
+    TOKEN_KIND kind;
+  };
+
+  inline uint slot(uint index) const
+  {
+    return (index * m_multiplier) >> m_shift;
+  }
+
+  bool tryFill(const KeywordList& keywords, uint bits)
+  {
+    // empty slots can only match the index of the empty string, which never is a keyword
+    const Entry empty = { 0, Token_identifier };
+    m_entries.fill(empty, 1 << bits);
+    foreach(const KeywordList::value_type& keyword, keywords) {
+      Entry& entry = m_entries[slot(keyword.first)];
+      if(entry.kind != Token_identifier)
+        return false;
+      entry.index = keyword.first;
+      entry.kind = keyword.second;
+    }
+    return true;
+  }
+
+  QVector<Entry> m_entries;
+  uint m_multiplier;
+  uint m_shift;
+};
+
+}
+
 scan_fun_ptr Lexer::s_scan_table[256];
 bool Lexer::s_initialized = false;
 
@@ -285,7 +399,10 @@ Lexer::Lexer(Control *c)
   : session(0),
     control(c),
     m_leaveSize(false),
-    m_languageFeatures(DEFAULT_CPP_LANGUAGE_FEATURES)
+    m_languageFeatures(DEFAULT_CPP_LANGUAGE_FEATURES),
+    m_lexedContents(0),
+    m_reuseSuffixFrom(0),
+    m_reuseSuffixOffset(0)
 {
 }
 
@@ -316,16 +433,23 @@ void Lexer::tokenize(ParseSession* _session)
   while(endCursor-1 >= session->contents() && (*(endCursor-1)) == 0)
     --endCursor;
 
+  m_reuseSuffixFrom = 0;
+  if(m_lexedContents && !m_lexedContents->isEmpty())
+    reusePrefix();
+
   while (cursor < endCursor) {
     Q_ASSERT(static_cast<uint>(stream->size()) == index);
 
+    if(m_reuseSuffixFrom && cursor.current >= m_reuseSuffixFrom && tryReuseSuffix())
+      break;
+
     size_t previousIndex = index;
 
     {
     Token token{cursor.offsetIn(session->contents()), 0, Token_EOF};
     stream->append(token);
     }
-    Token* current_token = &(session->token_stream->last());
+    const uint current_token = stream->size() - 1;
 
     if(cursor.isChar()) {
       (this->*s_scan_table[((uchar)*cursor)])();
@@ -361,10 +485,10 @@ void Lexer::tokenize(ParseSession* _session)
 
 
     if(!m_leaveSize)
-      current_token->size = cursor.offsetIn( session->contents() ) - current_token->position;
+      stream->setTokenSize(current_token, cursor.offsetIn( session->contents() ) - stream->position(current_token));
     
-    Q_ASSERT(m_leaveSize || (cursor.current == session->contents() + current_token->position + current_token->size));
-    Q_ASSERT(current_token->position + current_token->size <= (uint)session->contentsVector().size());
+    Q_ASSERT(m_leaveSize || (cursor.current == session->contents() + stream->position(current_token) + stream->tokenSize(current_token)));
+    Q_ASSERT(stream->position(current_token) + stream->tokenSize(current_token) <= (uint)session->contentsVector().size());
     Q_ASSERT(previousIndex == index-1 || previousIndex == index); //Never parse more than 1 token, because that won't be initialized correctly
 
     m_leaveSize = false;
@@ -383,7 +507,133 @@ void Lexer::tokenize(ParseSession* _session)
   stream->append(eof);
   }
 
-  stream->squeeze();
+  if(m_lexedContents)
+    storeLexedContents();
+}
+
+void LexedContents::clear()
+{
+  m_contents.clear();
+  m_kinds.clear();
+  m_positions.clear();
+  m_sizes.clear();
+}
+
+uint LexedContents::memoryUsage() const
+{
+  return m_contents.size() * sizeof(uint) + m_kinds.size() * (sizeof(quint16) + 2 * sizeof(uint));
+}
+
+namespace {
+//How far lexing a token may look at the contents behind it, e.g. for ">>=" or "..."
+const int lexerLookAhead = 4;
+}
+
+void Lexer::reusePrefix()
+{
+  const LexedContents& lexed(*m_lexedContents);
+  const uint* contents = session->contents();
+  const int oldSize = lexed.m_contents.size();
+  const int newSize = endCursor - contents;
+  const int commonSize = qMin(oldSize, newSize);
+
+  int prefix = 0;
+  while(prefix < commonSize && lexed.m_contents[prefix] == contents[prefix])
+    ++prefix;
+
+  int suffix = 0;
+  while(suffix < commonSize - prefix && lexed.m_contents[oldSize - 1 - suffix] == contents[newSize - 1 - suffix])
+    ++suffix;
+
+  //The first token is the artificial EOF token, the last one the real EOF token
+  const int tokenCount = lexed.m_kinds.size() - 1;
+
+  //Reuse the tokens that end far enough in front of the first change, so lexing them could not have looked at it.
+  //The last reused token must not be a comment, since following comments may be merged into it, and lexing must not
+  //continue at zeroes that were left behind by merged identifiers.
+  int reused = 0;
+  const uint limit = qMax(prefix - lexerLookAhead, 0);
+  while(reused + 1 < tokenCount && lexed.m_positions[reused + 1] + lexed.m_sizes[reused + 1] <= limit)
+    ++reused;
+  while(reused > 0 && (lexed.m_kinds[reused] == Token_comment || contents[lexed.m_positions[reused] + lexed.m_sizes[reused]] == 0))
+    --reused;
+
+  TokenStream* stream = session->token_stream;
+  for(int a = 1; a <= reused; ++a) {
+    Token token;
+    token.kind = lexed.m_kinds[a];
+    token.position = lexed.m_positions[a];
+    token.size = lexed.m_sizes[a];
+    stream->append(token);
+  }
+  index = stream->size();
+  if(reused > 0) {
+    cursor.current = session->contents() + lexed.m_positions[reused] + lexed.m_sizes[reused];
+    m_firstInLine = false;
+  }
+
+  //Behind the last change, lexing may continue with the previous tokens as soon as both start a token at the same place
+  if(suffix > lexerLookAhead) {
+    m_reuseSuffixFrom = endCursor - suffix + lexerLookAhead;
+    m_reuseSuffixOffset = newSize - oldSize;
+  }
+}
+
+bool Lexer::tryReuseSuffix()
+{
+  const LexedContents& lexed(*m_lexedContents);
+  const uint position = cursor.offsetIn(session->contents()) - m_reuseSuffixOffset;
+
+  const QVector<uint>::const_iterator begin = lexed.m_positions.constBegin() + 1;
+  const QVector<uint>::const_iterator end = lexed.m_positions.constEnd() - 1;
+  const QVector<uint>::const_iterator it = qLowerBound(begin, end, position);
+  if(it == end || *it != position)
+    return false;
+
+  //Comments are merged depending on what was in front of them, all other tokens only depend on the following contents
+  const int first = it - lexed.m_positions.constBegin();
+  if(lexed.m_kinds[first] == Token_comment)
+    return false;
+
+  TokenStream* stream = session->token_stream;
+  const int tokenCount = lexed.m_kinds.size() - 1;
+  for(int a = first; a < tokenCount; ++a) {
+    Token token;
+    token.kind = lexed.m_kinds[a];
+    token.position = lexed.m_positions[a] + m_reuseSuffixOffset;
+    token.size = lexed.m_sizes[a];
+    stream->append(token);
+  }
+  index = stream->size();
+  cursor.current = session->contents() + lexed.m_positions[tokenCount] + m_reuseSuffixOffset;
+  return true;
+}
+
+void Lexer::storeLexedContents()
+{
+  if(control->hasProblem(KDevelop::ProblemData::Lexer)) {
+    //The problems of reused tokens would get lost
+    m_lexedContents->clear();
+    return;
+  }
+
+  LexedContents& lexed(*m_lexedContents);
+  const uint* contents = session->contents();
+  lexed.m_contents = PreprocessedContents();
+  lexed.m_contents.reserve(endCursor - contents);
+  for(const uint* it = contents; it < endCursor; ++it)
+    lexed.m_contents.append(*it);
+
+  const TokenStream* stream = session->token_stream;
+  const int count = stream->size();
+  lexed.m_kinds.resize(count);
+  lexed.m_positions.resize(count);
+  lexed.m_sizes.resize(count);
+  for(int a = 0; a < count; ++a) {
+    lexed.m_kinds[a] = stream->kind(a);
+    lexed.m_positions[a] = stream->position(a);
+    lexed.m_sizes[a] = stream->tokenSize(a);
+  }
 }
 
 void Lexer::initialize_scan_table()
@@ -486,7 +736,7 @@ void Lexer::scan_char_constant()
       ++cursor;
     }
 
-  (*session->token_stream)[index++].kind = Token_char_literal;
+  session->token_stream->setKind(index++, Token_char_literal);
 }
 
 void Lexer::scan_string_constant()
@@ -521,7 +771,7 @@ void Lexer::scan_string_constant()
       ++cursor;
     }
 
-  (*session->token_stream)[index++].kind = Token_string_literal;
+  session->token_stream->setKind(index++, Token_string_literal);
 }
 
 void Lexer::scan_raw_string_constant()
@@ -529,7 +779,7 @@ void Lexer::scan_raw_string_constant()
   Q_ASSERT(*cursor == '"');
   ++cursor;
 
-  (*session->token_stream)[index++].kind = Token_string_literal;
+  session->token_stream->setKind(index++, Token_string_literal);
 
   // find delimiter
   KDevVarLengthArray<uint, 16> delim;
@@ -652,23 +902,19 @@ void Lexer::scan_identifier_or_keyword()
     ++nextCursor;
   }
   
-  uint bucket = (*cursor.current) % index_size;
-
-  //A very simple lookup table: First level contains all pairs grouped by with (index % index_size), then there is a simple list
-  static const KDevVarLengthArray<KDevVarLengthArray<QPair<uint, TOKEN_KIND>, 10 >, index_size > indicesForTokens = createIndicesForTokens(languageFeatures());
-  for(int a = 0; a < indicesForTokens[bucket].size(); ++a) {
-    if(indicesForTokens[bucket][a].first == *cursor.current) {
-      (*session->token_stream)[index++].kind = indicesForTokens[bucket][a].second;
-      ++cursor;
-      return;
-    }
+  static const KeywordTable keywords(languageFeatures());
+  const TOKEN_KIND keyword = keywords.lookup(*cursor.current);
+  if(keyword != Token_identifier) {
+    session->token_stream->setKind(index++, keyword);
+    ++cursor;
+    return;
   }
 
   if(*cursor.current != 0) // If the index is zero, then the string is empty. Never create empty identifier tokens.
   {
     m_leaveSize = true; //Since we may have skipped input tokens while mergin, we have to make sure that the size stays 1(the merged tokens will be empty)
-    (*session->token_stream)[index].size = 1;
-    (*session->token_stream)[index++].kind = Token_identifier;
+    session->token_stream->setTokenSize(index, 1);
+    session->token_stream->setKind(index++, Token_identifier);
   }
   
   cursor = nextCursor;
@@ -687,7 +933,7 @@ void Lexer::scan_int_constant()
   while (cursor < endCursor &&  (isalnum(*cursor) || *cursor == '.'))
     ++cursor;
 
-  (*session->token_stream)[index++].kind = Token_number_literal;
+  session->token_stream->setKind(index++, Token_number_literal);
 }
 
 void Lexer::scan_not()
@@ -702,11 +948,11 @@ void Lexer::scan_not()
   if (*cursor == '=')
     {
       ++cursor;
-      (*session->token_stream)[index++].kind = Token_not_eq;
+      session->token_stream->setKind(index++, Token_not_eq);
     }
   else
     {
-      (*session->token_stream)[index++].kind = '!';
+      session->token_stream->setKind(index++, '!');
     }
 }
 
@@ -722,11 +968,11 @@ void Lexer::scan_remainder()
   if (*cursor == '=')
     {
       ++cursor;
-      (*session->token_stream)[index++].kind = Token_remainder_eq;
+      session->token_stream->setKind(index++, Token_remainder_eq);
     }
   else
     {
-      (*session->token_stream)[index++].kind = '%';
+      session->token_stream->setKind(index++, '%');
     }
 }
 
@@ -742,29 +988,29 @@ void Lexer::scan_and()
   if (*cursor == '=')
     {
       ++cursor;
-      (*session->token_stream)[index++].kind = Token_and_eq;
+      session->token_stream->setKind(index++, Token_and_eq);
     }
   else if (*cursor == '&')
     {
       ++cursor;
-      (*session->token_stream)[index++].kind = Token_and;
+      session->token_stream->setKind(index++, Token_and);
     }
   else
     {
-      (*session->token_stream)[index++].kind = '&';
+      session->token_stream->setKind(index++, '&');
     }
 }
 
 void Lexer::scan_left_paren()
 {
   ++cursor;
-  (*session->token_stream)[index++].kind = '(';
+  session->token_stream->setKind(index++, '(');
 }
 
 void Lexer::scan_right_paren()
 {
   ++cursor;
-  (*session->token_stream)[index++].kind = ')';
+  session->token_stream->setKind(index++, ')');
 }
 
 void Lexer::scan_star()
@@ -779,11 +1025,11 @@ void Lexer::scan_star()
   if (*cursor == '=')
     {
       ++cursor;
-      (*session->token_stream)[index++].kind = Token_star_eq;
+      session->token_stream->setKind(index++, Token_star_eq);
     }
   else
     {
-      (*session->token_stream)[index++].kind = '*';
+      session->token_stream->setKind(index++, '*');
     }
 }
 
@@ -799,23 +1045,23 @@ void Lexer::scan_plus()
   if (*cursor == '=')
     {
       ++cursor;
-      (*session->token_stream)[index++].kind = Token_plus_eq;
+      session->token_stream->setKind(index++, Token_plus_eq);
     }
   else if (*cursor == '+')
     {
       ++cursor;
-      (*session->token_stream)[index++].kind = Token_incr;
+      session->token_stream->setKind(index++, Token_incr);
     }
   else
     {
-      (*session->token_stream)[index++].kind = '+';
+      session->token_stream->setKind(index++, '+');
     }
 }
 
 void Lexer::scan_comma()
 {
   ++cursor;
-  (*session->token_stream)[index++].kind = ',';
+  session->token_stream->setKind(index++, ',');
 }
 
 void Lexer::scan_minus()
@@ -831,21 +1077,21 @@ void Lexer::scan_minus()
   if (*cursor == '=')
     {
       ++cursor;
-      (*session->token_stream)[index++].kind = Token_minus_eq;
+      session->token_stream->setKind(index++, Token_minus_eq);
     }
   else if (*cursor == '-')
     {
       ++cursor;
-      (*session->token_stream)[index++].kind = Token_decr;
+      session->token_stream->setKind(index++, Token_decr);
     }
   else if (*cursor == '>')
     {
       ++cursor;
-      (*session->token_stream)[index++].kind = Token_arrow;
+      session->token_stream->setKind(index++, Token_arrow);
     }
   else
     {
-      (*session->token_stream)[index++].kind = '-';
+      session->token_stream->setKind(index++, '-');
     }
 }
 
@@ -860,15 +1106,15 @@ void Lexer::scan_dot()
   if (*cursor == '.' && *(cursor + 1) == '.')
     {
       cursor += 2;
-      (*session->token_stream)[index++].kind = Token_ellipsis;
+      session->token_stream->setKind(index++, Token_ellipsis);
     }
   else if (*cursor == '.' && *(cursor + 1) == '*')
     {
       cursor += 2;
-      (*session->token_stream)[index++].kind = Token_ptrmem;
+      session->token_stream->setKind(index++, Token_ptrmem);
     }
   else
-    (*session->token_stream)[index++].kind = '.';
+    session->token_stream->setKind(index++, '.');
 }
 
 void Lexer::scan_divide()
@@ -883,7 +1129,7 @@ void Lexer::scan_divide()
   if (*cursor == '=')
     {
       ++cursor;
-      (*session->token_stream)[index++].kind = Token_div_eq;
+      session->token_stream->setKind(index++, Token_div_eq);
     }
   else if( *cursor == '*' || *cursor == '/' )
     {
@@ -893,7 +1139,7 @@ void Lexer::scan_divide()
       skipComment();
       if( cursor != commentBegin ) {
         ///Store the comment
-        if(!m_canMergeComment || (*session->token_stream)[index-1].kind != Token_comment) {
+        if(!m_canMergeComment || session->token_stream->kind(index-1) != Token_comment) {
 
           //Only allow appending to comments that are behind a newline, because else they may belong to the item on their left side.
           //If index is 1, this comment is the first token, which should be the translation-unit comment. So do not merge following comments.
@@ -902,18 +1148,18 @@ void Lexer::scan_divide()
           else
             m_canMergeComment = false;
           
-          (*session->token_stream)[index++].kind = Token_comment;
-          (*session->token_stream)[index-1].size = (size_t)(cursor - commentBegin);
-          (*session->token_stream)[index-1].position = commentBegin.offsetIn( session->contents() );
+          session->token_stream->setKind(index++, Token_comment);
+          session->token_stream->setTokenSize(index-1, (size_t)(cursor - commentBegin));
+          session->token_stream->setPosition(index-1, commentBegin.offsetIn( session->contents() ));
         }else{
           //Merge with previous comment
-          (*session->token_stream)[index-1].size = cursor.offsetIn(session->contents()) - (*session->token_stream)[index-1].position;
+          session->token_stream->setTokenSize(index-1, cursor.offsetIn(session->contents()) - session->token_stream->position(index-1));
         }
       }
     }
   else
     {
-      (*session->token_stream)[index++].kind = '/';
+      session->token_stream->setKind(index++, '/');
     }
 }
 
@@ -923,18 +1169,18 @@ void Lexer::scan_colon()
   if (*cursor == ':')
     {
       ++cursor;
-      (*session->token_stream)[index++].kind = Token_scope;
+      session->token_stream->setKind(index++, Token_scope);
     }
   else
     {
-      (*session->token_stream)[index++].kind = ':';
+      session->token_stream->setKind(index++, ':');
     }
 }
 
 void Lexer::scan_semicolon()
 {
   ++cursor;
-  (*session->token_stream)[index++].kind = ';';
+  session->token_stream->setKind(index++, ';');
 }
 
 void Lexer::scan_less()
@@ -950,7 +1196,7 @@ void Lexer::scan_less()
   if (*cursor == '=')
     {
       ++cursor;
-      (*session->token_stream)[index++].kind = Token_leq;
+      session->token_stream->setKind(index++, Token_leq);
     }
   else if (*cursor == '<')
     {
@@ -958,16 +1204,16 @@ void Lexer::scan_less()
       if (*cursor == '=')
       {
         ++cursor;
-        (*session->token_stream)[index++].kind = Token_leftshift_eq;
+        session->token_stream->setKind(index++, Token_leftshift_eq);
       }
       else
       {
-        (*session->token_stream)[index++].kind = Token_leftshift;
+        session->token_stream->setKind(index++, Token_leftshift);
       }
     }
   else
     {
-      (*session->token_stream)[index++].kind = '<';
+      session->token_stream->setKind(index++, '<');
     }
 }
 
@@ -982,11 +1228,11 @@ void Lexer::scan_equal()
   if (*cursor == '=')
     {
       ++cursor;
-      (*session->token_stream)[index++].kind = Token_eq;
+      session->token_stream->setKind(index++, Token_eq);
     }
   else
     {
-      (*session->token_stream)[index++].kind = '=';
+      session->token_stream->setKind(index++, '=');
     }
 }
 
@@ -1003,7 +1249,7 @@ void Lexer::scan_greater()
   if (*cursor == '=')
     {
       ++cursor;
-      (*session->token_stream)[index++].kind = Token_geq;
+      session->token_stream->setKind(index++, Token_geq);
     }
   else if (*cursor == '>')
     {
@@ -1011,35 +1257,35 @@ void Lexer::scan_greater()
       if (*cursor == '=')
 	{
 	  ++cursor;
-	  (*session->token_stream)[index++].kind = Token_rightshift_eq;
+	  session->token_stream->setKind(index++, Token_rightshift_eq);
 	}
       else
 	{
-	  (*session->token_stream)[index++].kind = Token_rightshift;
+	  session->token_stream->setKind(index++, Token_rightshift);
 	}
     }
   else
     {
-      (*session->token_stream)[index++].kind = '>';
+      session->token_stream->setKind(index++, '>');
     }
 }
 
 void Lexer::scan_question()
 {
   ++cursor;
-  (*session->token_stream)[index++].kind = '?';
+  session->token_stream->setKind(index++, '?');
 }
 
 void Lexer::scan_left_bracket()
 {
   ++cursor;
-  (*session->token_stream)[index++].kind = '[';
+  session->token_stream->setKind(index++, '[');
 }
 
 void Lexer::scan_right_bracket()
 {
   ++cursor;
-  (*session->token_stream)[index++].kind = ']';
+  session->token_stream->setKind(index++, ']');
 }
 
 void Lexer::scan_xor()
@@ -1053,18 +1299,18 @@ void Lexer::scan_xor()
   if (*cursor == '=')
     {
       ++cursor;
-      (*session->token_stream)[index++].kind = Token_xor_eq;
+      session->token_stream->setKind(index++, Token_xor_eq);
     }
   else
     {
-      (*session->token_stream)[index++].kind = '^';
+      session->token_stream->setKind(index++, '^');
     }
 }
 
 void Lexer::scan_left_brace()
 {
   ++cursor;
-  (*session->token_stream)[index++].kind = '{';
+  session->token_stream->setKind(index++, '{');
 }
 
 void Lexer::scan_or()
@@ -1078,35 +1324,35 @@ void Lexer::scan_or()
   if (*cursor == '=')
     {
       ++cursor;
-      (*session->token_stream)[index++].kind = Token_or_eq;
+      session->token_stream->setKind(index++, Token_or_eq);
     }
   else if (*cursor == '|')
     {
       ++cursor;
-      (*session->token_stream)[index++].kind = Token_or;
+      session->token_stream->setKind(index++, Token_or);
     }
   else
     {
-    (*session->token_stream)[index++].kind = '|';
+    session->token_stream->setKind(index++, '|');
   }
 }
 
 void Lexer::scan_right_brace()
 {
   ++cursor;
-  (*session->token_stream)[index++].kind = '}';
+  session->token_stream->setKind(index++, '}');
 }
 
 void Lexer::scan_tilde()
 {
   ++cursor;
-  (*session->token_stream)[index++].kind = '~';
+  session->token_stream->setKind(index++, '~');
 }
 
 void Lexer::scan_EOF()
 {
   ++cursor;
-  (*session->token_stream)[index++].kind = Token_EOF;
+  session->token_stream->setKind(index++, Token_EOF);
 }
 
 void Lexer::scan_invalid_input()
@@ -24,6 +24,7 @@
 #include "languagefeatures.h"
 #include <cppparserexport.h>
 #include <QtCore/QString>
+#include <QtCore/QVector>
 #include <cstdlib>
 #include <language/duchain/indexedstring.h>
 
@@ -35,6 +36,7 @@ class Control;
 class ParseSession;
 
 typedef void (Lexer::*scan_fun_ptr)();
+typedef QVector<unsigned int> PreprocessedContents;
 
 /**Token.*/
 class KDEVCPPPARSER_EXPORT Token
@@ -56,18 +58,21 @@ public:
 Q_DECLARE_TYPEINFO(Token, Q_PRIMITIVE_TYPE);
 
 /**Stream of tokens found by lexer.
-Internally works like an array of @ref Token continuosly allocated.
-All tokens are destructed when this stream is deleted.
+
+The tokens are stored as a struct of arrays that is allocated from the memory
+pool of the session: The kinds, which are looked at by the parser most often,
+are stored densely in their own array, so one cache line holds the kinds of 32
+tokens. Positions and sizes are stored in separate arrays. When the arrays have
+to grow, the previous ones stay in the memory pool until the session is destroyed.
+
+@ref token() assembles a @ref Token from the arrays, so references to tokens
+are not stable, and tokens have to be modified through the setters.
 
 The stream has a "cursor" which is simply an integer which defines
 the offset (index) of the token currently "observed" from the beginning of
 the stream.
-
-TODO: reuse some pool / container class for the token array
-NOTE: token_count is actually the *size* of the token pool
-      the last actually used token is lastToken
 */
-class KDEVCPPPARSER_EXPORT TokenStream : public QVector<Token>
+class KDEVCPPPARSER_EXPORT TokenStream
 {
 private:
   TokenStream(const TokenStream &);
@@ -78,13 +83,59 @@ public:
   inline TokenStream(ParseSession* _session, uint size = 1024)
     : session(_session)
     , index(0)
+    , m_count(0)
+    , m_capacity(0)
+    , m_kinds(0)
+    , m_positions(0)
+    , m_sizes(0)
   {
     reserve(size);
   }
 
+  /**@return the number of tokens in the stream.*/
+  inline int size() const
+  { return m_count; }
+
+  inline int count() const
+  { return m_count; }
+
+  inline bool isEmpty() const
+  { return m_count == 0; }
+
+  /**Makes room for at least @p size tokens.*/
+  void reserve(uint size);
+
+  /**Appends @p token at the end of the stream.*/
+  inline void append(const Token& token)
+  {
+    if (m_count == m_capacity)
+      reserve(qMax(m_capacity * 2, 16));
+    m_kinds[m_count] = token.kind;
+    m_positions[m_count] = token.position;
+    m_sizes[m_count] = token.size;
+    ++m_count;
+  }
+
+  /**Removes the last token from the stream.*/
+  inline void pop_back()
+  {
+    Q_ASSERT(m_count > 0);
+    --m_count;
+  }
+
   /**@return the token at position @p index.*/
-  inline const Token &token(int index) const
-  { return at(index); }
+  inline Token token(int index) const
+  {
+    Q_ASSERT(index >= 0 && index < m_count);
+    Token ret;
+    ret.position = m_positions[index];
+    ret.size = m_sizes[index];
+    ret.kind = m_kinds[index];
+    return ret;
+  }
+
+  inline Token at(int index) const
+  { return token(index); }
 
   /**@return the "cursor" - the offset (index) of the token
   currently "observed" from the beginning of the stream.*/
@@ -102,15 +153,28 @@ public:
 
   /**@return the kind of the next (LA) token in the stream.*/
   inline quint16 lookAhead(uint i = 0) const
-  { return at(index + i).kind; }
+  { return kind(index + i); }
 
   /**@return the kind of the current token in the stream.*/
   inline quint16 kind(uint i) const
-  { return at(i).kind; }
+  { Q_ASSERT(i < static_cast<uint>(m_count)); return m_kinds[i]; }
 
   /**@return the position of the current token in the c++ source buffer.*/
   inline uint position(uint i) const
-  { return at(i).position; }
+  { Q_ASSERT(i < static_cast<uint>(m_count)); return m_positions[i]; }
+
+  /**@return the size of the token @p i in the preprocessed buffer. Do not confuse this with symbolLength.*/
+  inline uint tokenSize(uint i) const
+  { Q_ASSERT(i < static_cast<uint>(m_count)); return m_sizes[i]; }
+
+  inline void setKind(uint i, quint16 kind)
+  { Q_ASSERT(i < static_cast<uint>(m_count)); m_kinds[i] = kind; }
+
+  inline void setPosition(uint i, uint position)
+  { Q_ASSERT(i < static_cast<uint>(m_count)); m_positions[i] = position; }
+
+  inline void setTokenSize(uint i, uint size)
+  { Q_ASSERT(i < static_cast<uint>(m_count)); m_sizes[i] = size; }
 
   /**
    * @return The symbol associated to the token.
@@ -168,10 +232,44 @@ public:
 private:
   ParseSession* session;
   uint index;
+  int m_count;
+  int m_capacity;
+  quint16* m_kinds;
+  uint* m_positions;
+  uint* m_sizes;
+};
+
+/**
+ * The tokens of a lexed document, kept to lex the next revision of it incrementally.
+ *
+ * Only the part of the contents that differs from the previous revision is lexed again,
+ * the tokens in front of it are reused, and the tokens behind it are reused with their
+ * position shifted. Results of lexing that reported problems are not kept.
+ *
+ * @see Lexer::setLexedContents()
+ */
+class KDEVCPPPARSER_EXPORT LexedContents
+{
+public:
+  inline bool isEmpty() const
+  { return m_contents.isEmpty(); }
+
+  void clear();
+
+  /**@return the approximate memory usage in bytes.*/
+  uint memoryUsage() const;
+
+private:
+  friend class Lexer;
+  ///The contents as they were after lexing, without trailing zeroes
+  PreprocessedContents m_contents;
+  QVector<quint16> m_kinds;
+  QVector<uint> m_positions;
+  QVector<uint> m_sizes;
 };
 
 /**C++ Lexer.*/
-class Lexer
+class KDEVCPPPARSER_EXPORT Lexer
 {
 public:
   /**
@@ -189,6 +287,13 @@ public:
   CPPLanguageFeatures languageFeatures() const { return m_languageFeatures; }
   void setLanguageFeatures(CPPLanguageFeatures features) { m_languageFeatures = features; }
 
+  /**
+   * Lex incrementally: If @p lexed contains the result of lexing a previous revision of the document,
+   * tokenize() only lexes the part of the contents that changed, and afterwards stores its own result into @p lexed.
+   * Pass zero to always lex everything, which is the default.
+   */
+  void setLexedContents(LexedContents* lexed) { m_lexedContents = lexed; }
+
   ParseSession* session;
 
 private:
@@ -207,23 +312,6 @@ private:
   void scan_invalid_input();
   void scan_preprocessor();
 
-  // keywords
-  void scanKeyword0();
-  void scanKeyword2();
-  void scanKeyword3();
-  void scanKeyword4();
-  void scanKeyword5();
-  void scanKeyword6();
-  void scanKeyword7();
-  void scanKeyword8();
-  void scanKeyword9();
-  void scanKeyword10();
-  void scanKeyword11();
-  void scanKeyword12();
-  void scanKeyword13();
-  void scanKeyword14();
-  void scanKeyword16();
-
   // operators
   void scan_not();
   void scan_remainder();
@@ -251,6 +339,12 @@ private:
   void scan_tilde();
   void scan_EOF();
 
+  ///Appends the tokens in front of the first change from m_lexedContents, and moves the cursor behind them
+  void reusePrefix();
+  ///Appends the remaining tokens from m_lexedContents if lexing is in sync with them again at the cursor
+  bool tryReuseSuffix();
+  void storeLexedContents();
+
   KDevelop::ProblemPointer createProblem() const;
 
 private:
@@ -319,6 +413,10 @@ private:
   bool m_canMergeComment; //Whether we may append new comments to the last encountered one
   bool m_firstInLine;   //Whether the next token is the first one in a line
   CPPLanguageFeatures m_languageFeatures;
+
+  LexedContents* m_lexedContents;
+  const uint* m_reuseSuffixFrom; //Starting at this position, tokens from m_lexedContents may be reused
+  int m_reuseSuffixOffset; //Difference of the positions of the reused tokens
   
   ///scan table contains pointers to the methods to scan for various token types
   static scan_fun_ptr s_scan_table[];
@@ -20,25 +20,84 @@
 
 #include "memorypool.h"
 
+#include <QAtomicInt>
 #include <QThreadStorage>
 
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+/**
+ * The process-wide statistics, only updated when blocks change hands.
+ *
+ * The counters are statically initialized, since the thread local caches
+ * may be destroyed after the static objects.
+ */
+QBasicAtomicInt liveBlockCount = Q_BASIC_ATOMIC_INITIALIZER(0);
+QBasicAtomicInt cachedBlockCount = Q_BASIC_ATOMIC_INITIALIZER(0);
+QBasicAtomicInt oversizedAllocationCount = Q_BASIC_ATOMIC_INITIALIZER(0);
+QBasicAtomicInt oversizedByteCount = Q_BASIC_ATOMIC_INITIALIZER(0);
+QBasicAtomicInt largestPoolSize = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+void updateStatistics(int liveBlocks, int cachedBlocks)
+{
+  if (liveBlocks)
+    liveBlockCount.fetchAndAddRelaxed(liveBlocks);
+  if (cachedBlocks)
+    cachedBlockCount.fetchAndAddRelaxed(cachedBlocks);
+}
+
+void updateOversizedStatistics(int allocations, int bytes)
+{
+  oversizedAllocationCount.fetchAndAddRelaxed(allocations);
+  oversizedByteCount.fetchAndAddRelaxed(bytes);
+}
+
+void updateLargestPoolSize(size_t size)
+{
+  const int clamped = static_cast<int>(qMin<size_t>(size, INT_MAX));
+  int largest = largestPoolSize;
+  while (clamped > largest && !largestPoolSize.testAndSetRelaxed(largest, clamped))
+    largest = largestPoolSize;
+}
+}
+
 /**
  * This class handles the thread local caching of memory blocks.
  *
  * The cache optimizes the repeated allocations required when we construct
  * many pools for small operations. This is done e.g. in the ExpressionParser.
+ *
+ * The number of cached blocks follows the peak usage of the destroyed pools:
+ * It grows immediately when a pool used more blocks, so the next ParseSession
+ * of that size is served from the cache, and shrinks slowly while the pools
+ * use less.
  */
 struct MemoryPoolCache
 {
   MemoryPoolCache()
+  : targetSize(MemoryPool::MIN_CACHE_SIZE)
   {
-    freeBlocks.reserve(MemoryPool::MAX_CACHE_SIZE);
+    freeBlocks.reserve(MemoryPool::MIN_CACHE_SIZE);
   }
   ~MemoryPoolCache()
   {
+    updateStatistics(0, -freeBlocks.size());
     qDeleteAll(freeBlocks);
   }
+
+  void adaptTo(int usedBlocks)
+  {
+    if (usedBlocks >= targetSize) {
+      targetSize = qMin<int>(usedBlocks, MemoryPool::MAX_CACHE_SIZE);
+    } else {
+      targetSize = qMax<int>(targetSize - (targetSize - usedBlocks) / 8, MemoryPool::MIN_CACHE_SIZE);
+    }
+  }
+
   QVector<MemoryPool::Block*> freeBlocks;
+  int targetSize;
 };
 
 /**
@@ -52,16 +111,29 @@ struct MemoryPoolCache
  */
 static QThreadStorage< MemoryPoolCache* > threadLocalCache;
 
+MemoryPool::Statistics::Statistics()
+: bytesAllocated(0)
+, liveBlocks(0)
+, cachedBlocks(0)
+, oversizedAllocations(0)
+, highWaterMark(0)
+{
+}
+
 MemoryPool::MemoryPool()
 : m_currentBlock(-1)
 , m_currentIndex(BLOCK_SIZE)
+, m_oversizedBytes(0)
 {
   // preallocate some space for the potentially used blocks
-  m_blocks.reserve(MAX_CACHE_SIZE);
+  m_blocks.reserve(MIN_CACHE_SIZE);
 }
 
 MemoryPool::~MemoryPool()
 {
+  updateLargestPoolSize(size());
+  clear();
+
   ///TODO: Once we can depend on Qt 4.8+ directly store a MemoryPoolCache
   ///      and not a pointer to it. This obsoletes the manual construction.
   MemoryPoolCache* cache = threadLocalCache.localData();
@@ -70,18 +142,47 @@ MemoryPool::~MemoryPool()
     cache = new MemoryPoolCache;
     threadLocalCache.setLocalData(cache);
   }
-  for(int i = 0; i <= m_currentBlock; ++i) {
-    Block* block = m_blocks.at(i);
-    if (cache->freeBlocks.size() < MAX_CACHE_SIZE) {
-      // cache block for reuse by another thread local allocator
-      // this requires a 'prestine' state, i.e. memset to zero
-      memset(block->data, 0, i == m_currentBlock ? m_currentIndex : static_cast<size_t>(BLOCK_SIZE));
+
+  cache->adaptTo(m_blocks.size());
+
+  int cached = 0;
+  foreach (Block* block, m_blocks) {
+    if (cache->freeBlocks.size() < cache->targetSize) {
+      // cache block for reuse by another thread local allocator,
+      // clear() already brought it into a 'prestine' state
       cache->freeBlocks.append(block);
+      ++cached;
     } else {
       // otherwise we can discard this block
       delete block;
     }
   }
+
+  // when the cache shrinks, release the blocks that are not needed anymore
+  while (cache->freeBlocks.size() > cache->targetSize) {
+    delete cache->freeBlocks.last();
+    cache->freeBlocks.pop_back();
+    --cached;
+  }
+
+  updateStatistics(-m_blocks.size(), cached);
+}
+
+void MemoryPool::clear()
+{
+  for(int i = 0; i <= m_currentBlock; ++i) {
+    // blocks must be in a 'prestine' state for reuse, i.e. memset to zero
+    memset(m_blocks.at(i)->data, 0, i == m_currentBlock ? m_currentIndex : static_cast<size_t>(BLOCK_SIZE));
+  }
+
+  if (!m_oversized.isEmpty()) {
+    updateOversizedStatistics(-m_oversized.size(), -static_cast<int>(m_oversizedBytes));
+    foreach (void* chunk, m_oversized) {
+      free(chunk);
+    }
+    m_oversized.clear();
+    m_oversizedBytes = 0;
+  }
 }
 
 void MemoryPool::allocateBlock()
@@ -92,10 +193,33 @@ void MemoryPool::allocateBlock()
     // reuse cached memory block
     m_blocks.append(cache->freeBlocks.last());
     cache->freeBlocks.pop_back();
+    updateStatistics(1, -1);
   } else {
     // allocate new memory block
     Block* block = new Block;
     memset(block->data, 0, BLOCK_SIZE);
     m_blocks.append(block);
+    updateStatistics(1, 0);
   }
 }
+
+void* MemoryPool::allocateOversized(size_t bytes)
+{
+  void* chunk = calloc(1, bytes);
+  Q_CHECK_PTR(chunk);
+  m_oversized.append(chunk);
+  m_oversizedBytes += bytes;
+  updateOversizedStatistics(1, static_cast<int>(bytes));
+  return chunk;
+}
+
+MemoryPool::Statistics MemoryPool::statistics()
+{
+  Statistics ret;
+  ret.liveBlocks = liveBlockCount;
+  ret.cachedBlocks = cachedBlockCount;
+  ret.oversizedAllocations = oversizedAllocationCount;
+  ret.bytesAllocated = quint64(ret.liveBlocks) * BLOCK_SIZE + quint64(int(oversizedByteCount));
+  ret.highWaterMark = quint64(int(largestPoolSize));
+  return ret;
+}
@@ -32,12 +32,16 @@
  * memory pool is destroyed.
  *
  * Even then, free blocks are cached on a thread-local basis and kept around
- * until the thread exits. Up to MAX_CACHE_SIZE blocks are cached at any time.
+ * until the thread exits. The number of cached blocks adapts to the peak usage
+ * of the pools that were recently destroyed in that thread, between
+ * MIN_CACHE_SIZE and MAX_CACHE_SIZE blocks.
  * This way it is very performant to repeatedly create this allocator
- * and use it for small numbers of allocations.
+ * and use it for small numbers of allocations, as well as for the
+ * big allocations of a ParseSession.
  *
  * If the size of an element being allocated extends the amount of free
- * memory left in the block then a new block is allocated.
+ * memory left in the block then a new block is allocated. Allocations that
+ * are larger than a block get their own chunk of memory, which is not cached.
  *
  * NOTE: Neither the elements constructor or destructor is being called. The
  *       allocated memory blocks are memset to 0 though. You need to call
@@ -56,14 +60,16 @@ public:
    *
    * @return pointer to first of @p n allocated objects of type @p T.
    *
-   * @Warning Ensure you do not allocate more than the size of a block.
-   * @sa BLOCK_SIZE
+   * @note Allocations larger than BLOCK_SIZE are supported, but they are
+   *       slower since they are not served from the blocks.
    */
   template<typename T>
   T* allocate(size_t n = 1)
   {
     const size_t bytes = n * sizeof(T);
-    Q_ASSERT(bytes <= BLOCK_SIZE);
+    if (bytes > BLOCK_SIZE) {
+      return reinterpret_cast<T*>(allocateOversized(bytes));
+    }
 
     if (BLOCK_SIZE < m_currentIndex + bytes) {
       // current block is full, use next one
@@ -87,9 +93,41 @@ public:
    */
   size_t size() const
   {
-    return m_currentBlock * BLOCK_SIZE + m_currentIndex;
+    return m_currentBlock * BLOCK_SIZE + m_currentIndex + m_oversizedBytes;
+  }
+
+  /**
+   * @return the number of blocks owned by this pool.
+   */
+  int blockCount() const
+  {
+    return m_blocks.size();
   }
 
+  /**
+   * Memory usage of all memory pools in the process.
+   */
+  struct Statistics
+  {
+    Statistics();
+
+    /// Number of bytes in blocks and oversized allocations owned by pools
+    quint64 bytesAllocated;
+    /// Number of blocks owned by pools
+    int liveBlocks;
+    /// Number of free blocks in the thread-local caches
+    int cachedBlocks;
+    /// Number of oversized allocations owned by pools
+    int oversizedAllocations;
+    /// The largest size of any pool that was destroyed so far
+    quint64 highWaterMark;
+  };
+
+  /**
+   * @return the current memory usage of all pools, for debugging and tuning.
+   */
+  static Statistics statistics();
+
   /**
    * Construct an object of type @p T with the values of @p value
    * at the position of @p p.
@@ -117,10 +155,15 @@ public:
      */
     BLOCK_SIZE = 1 << 16, // 64K
     /**
-     * Maximum number of free memory blocks that are cached
+     * Number of free memory blocks that are cached at least
      * until the thread exists.
      */
-    MAX_CACHE_SIZE = 32 // * BLOCK_SIZE = approx. 2MB
+    MIN_CACHE_SIZE = 32, // * BLOCK_SIZE = approx. 2MB
+    /**
+     * Maximum number of free memory blocks that are cached
+     * until the thread exists, if the pools of that thread need them.
+     */
+    MAX_CACHE_SIZE = 256 // * BLOCK_SIZE = approx. 16MB
   };
 private:
   Q_DISABLE_COPY(MemoryPool)
@@ -131,6 +174,17 @@ private:
    */
   void allocateBlock();
 
+  /**
+   * Allocate a zeroed chunk of @p bytes memory that is owned by this pool
+   * but does not belong to a block.
+   */
+  void* allocateOversized(size_t bytes);
+
+  /**
+   * Free the oversized allocations and zero the used blocks.
+   */
+  void clear();
+
   /**
    * A continous block of memory.
    */
@@ -143,6 +197,8 @@ private:
   QVector<Block*> m_blocks;
   int m_currentBlock;
   size_t m_currentIndex;
+  QVector<void*> m_oversized;
+  size_t m_oversizedBytes;
 
   friend struct MemoryPoolCache;
 };
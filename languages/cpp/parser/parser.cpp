@@ -100,6 +100,7 @@ Parser::Parser(Control *c)
   , _M_last_parsed_comment(0)
   , _M_hadMismatchingCompoundTokens(false)
   , m_primaryExpressionWithTemplateParamsNeedsFunctionCall(true)
+  , m_skipFunctionBodies(false)
 {
 }
 
@@ -141,14 +142,14 @@ Comment Parser::comment() {
 }
 
 void Parser::preparseLineComments( int tokenNumber ) {
-  const Token& token( (*session->token_stream)[tokenNumber] );
+  const Token token( session->token_stream->token(tokenNumber) );
   KDevelop::CursorInRevision tokenPosition = KDevelop::CursorInRevision::invalid();
 
   for( int a = 0; a < 40; a++ ) {
       if( !session->token_stream->lookAhead(a) ) break;
       if( session->token_stream->lookAhead(a) == Token_comment ) {
         //Make sure the token's line is before the searched token's line
-        const Token& commentToken( (*session->token_stream)[session->token_stream->cursor() + a] );
+        const Token commentToken( session->token_stream->token(session->token_stream->cursor() + a) );
 
         if( !tokenPosition.isValid() ) //Get the token line. Only on-demand, because it's not cheap.
           tokenPosition = session->positionAt(token.position);
@@ -168,7 +169,7 @@ void Parser::preparseLineComments( int tokenNumber ) {
 }
 
 int Parser::lineFromTokenNumber( uint tokenNumber ) const {
-  const Token& token( (*session->token_stream)[tokenNumber] );
+  const Token token( session->token_stream->token(tokenNumber) );
   return session->positionAt( token.position ).line;
 }
 
@@ -181,7 +182,7 @@ void Parser::processComment( int offset, int line ) {
 
   _M_last_parsed_comment = tokenNumber;
 
-  const Token& commentToken( (*session->token_stream)[tokenNumber] );
+  const Token commentToken( session->token_stream->token(tokenNumber) );
   Q_ASSERT(commentToken.kind == Token_comment);
   if( line == -1 ) {
     KDevelop::CursorInRevision position = session->positionAt( commentToken.position );
@@ -4148,9 +4149,43 @@ bool Parser::parseFunctionBody(StatementAST *&node)
   if (session->token_stream->lookAhead() == Token_try)
     return parseTryBlockStatement(node);
 
+  if (m_skipFunctionBodies && skipFunctionBody(node))
+    return true;
+
   return parseCompoundStatement(node);
 }
 
+bool Parser::skipFunctionBody(StatementAST *&node)
+{
+  uint start = session->token_stream->cursor();
+
+  if (session->token_stream->lookAhead() != '{')
+    return false;
+
+  uint end = start;
+  int depth = 0;
+  for (;; ++end)
+    {
+      const quint16 kind = session->token_stream->kind(end);
+      if (kind == Token_EOF)
+        return false; // unbalanced, let parseCompoundStatement report the problems
+      else if (kind == '{')
+        ++depth;
+      else if (kind == '}' && --depth == 0)
+        break;
+    }
+
+  rewind(end);
+  clearComment();
+  advance();
+
+  CompoundStatementAST *ast = CreateNode<CompoundStatementAST>(session->mempool);
+  UPDATE_POS(ast, start, _M_last_valid_token+1);
+  node = ast;
+
+  return true;
+}
+
 bool Parser::parseTypeSpecifierOrClassSpec(TypeSpecifierAST *&node)
 {
   if (parseClassSpecifier(node))
@@ -92,6 +92,17 @@ public:
   void fixupInitializerFromParameter(InitDeclaratorAST* node, ParseSession* session);
   CPPLanguageFeatures languageFeatures() const { return lexer.languageFeatures(); }
   void setLanguageFeatures(CPPLanguageFeatures features) { lexer.setLanguageFeatures(features);}
+  ///@see Lexer::setLexedContents()
+  void setLexedContents(LexedContents* lexed) { lexer.setLexedContents(lexed); }
+
+  /**
+   * If this is true, function bodies are not parsed, but skipped by matching their braces,
+   * and represented by empty compound statements. This is enough for building the publically
+   * visible declarations, and much faster for big files.
+   *
+   * Syntax errors within skipped bodies are not reported. Only unbalanced bodies are parsed normally.
+   */
+  void setSkipFunctionBodies(bool skip) { m_skipFunctionBodies = skip; }
 
 private:
   /**Convenience method to report problems. Constructs the problem
@@ -152,6 +163,8 @@ public:
   bool parseForStatement(StatementAST *&node);
   bool parseRangeBasedFor(ForRangeDeclarationAst *&node);
   bool parseFunctionBody(StatementAST *&node);
+  ///Skips the compound statement at the cursor, @see setSkipFunctionBodies
+  bool skipFunctionBody(StatementAST *&node);
   bool parseFunctionSpecifier(const ListNode<uint> *&node);
   bool parseIfStatement(StatementAST *&node);
   bool parseInclusiveOrExpression(ExpressionAST *&node,
@@ -294,6 +307,7 @@ private:
   
   bool _M_hadMismatchingCompoundTokens;
   bool m_primaryExpressionWithTemplateParamsNeedsFunctionCall;
+  bool m_skipFunctionBodies;
 
   // keeps track of tokens where a syntax error has been found
   // so that the same error is not reported twice for a token
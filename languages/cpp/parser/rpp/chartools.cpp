@@ -21,7 +21,6 @@
 #include "chartools.h"
 #include <QString>
 #include <QVector>
-#include <util/kdevvarlengtharray.h>
 #include <language/duchain/indexedstring.h>
 #include <kdebug.h>
 
@@ -75,53 +74,72 @@ PreprocessedContents convertFromByteArray(const QByteArray& array) {
   return to;
 }
 
+namespace {
+enum CharacterClass {
+  OtherCharacter = 0,
+  IdentifierCharacter = 1, // may continue an identifier: a-z, A-Z, 0-9, '_', '$'
+  IdentifierStart = 2      // may start an identifier: a-z, A-Z, '_'
+};
+
+///Classification table for all 256 byte values, so the hot loops below only do one lookup per byte.
+///Non-ASCII bytes are never part of an identifier, see bug 328285.
+struct CharacterClassTable {
+  CharacterClassTable() {
+    for(int c = 0; c < 256; ++c) {
+      classes[c] = OtherCharacter;
+      if(c < 128 && isValidMacroIdentifierToken((char)c))
+        classes[c] |= IdentifierCharacter;
+      if(c < 128 && (isLetter((char)c) || c == '_'))
+        classes[c] |= IdentifierStart;
+    }
+  }
+  unsigned char classes[256];
+};
+
+const CharacterClassTable characterClasses;
+
+inline unsigned char characterClass(char c) {
+  return characterClasses.classes[static_cast<uchar>(c)];
+}
+}
+
 PreprocessedContents tokenizeFromByteArray(const QByteArray& array) {
+  return tokenizeFromBuffer(array.constData(), array.size());
+}
+
+PreprocessedContents tokenizeFromBuffer(const char* data, int size) {
   PreprocessedContents to;
   ///testing indicates that 9/10 is about the optimal value
-  to.reserve(array.size()/10);//assuming that about every 10 chars is a token.
-  const char* data = array.constData();
-  const char* dataEnd = data + array.size();
-  //unsigned int* target = to.data();
-  
-  KDevVarLengthArray<char, 100> identifier;
-  
-  KDevelop::IndexedString::RunningHash hash;
+  to.reserve(size/10);//assuming that about every 10 chars is a token.
+  const char* dataEnd = data + size;
 
-  bool tokenizing = false;
-  
   while(data < dataEnd) {
-    
-    if(!tokenizing) {
-      if(isLetter(*data) || *data == '_')
-        tokenizing = true;
-    }
-    
-    if(tokenizing) {
-      if(isValidMacroIdentifierToken(*data)) {
-        hash.append(*data);
-        identifier.append(*data);
-      }else{
-        //End of token
-        to.append( KDevelop::IndexedString::indexForString(identifier.constData(), identifier.size(), hash.hash) );
-        //kDebug() << "word" << "\"" + KDevelop::IndexedString(to.back()).str() + "\"";
-        hash.clear();
-        identifier.clear();
-        tokenizing = false;
-      }
+    if(characterClass(*data) & IdentifierStart) {
+      // Find the end of the identifier first, then intern it in one go
+      const char* identifierEnd = data + 1;
+      while(identifierEnd < dataEnd && (characterClass(*identifierEnd) & IdentifierCharacter))
+        ++identifierEnd;
+
+      KDevelop::IndexedString::RunningHash hash;
+      for(const char* c = data; c < identifierEnd; ++c)
+        hash.append(*c);
+      to.append( KDevelop::IndexedString::indexForString(data, identifierEnd - data, hash.hash) );
+      data = identifierEnd;
+    } else {
+      // Widen the whole run of non-identifier characters at once. The run
+      // may include digits and '$', which only continue an identifier.
+      const char* runEnd = data + 1;
+      while(runEnd < dataEnd && !(characterClass(*runEnd) & IdentifierStart))
+        ++runEnd;
+
+      const int offset = to.size();
+      to.resize(offset + (runEnd - data));
+      unsigned int* target = to.data() + offset;
+      for(; data < runEnd; ++data, ++target)
+        *target = indexFromCharacter(*data);
     }
-    
-    if(!tokenizing)
-      to.append( indexFromCharacter(*data) );
-    ++data;
   }
-  
-  if(tokenizing)
-    to.append( KDevelop::IndexedString::indexForString(identifier.constData(), identifier.size(), hash.hash) );
-  
-  
-/*  kDebug() << QString::fromUtf8(stringFromContents(to));
-  kDebug() << QString::fromUtf8(array);
-  Q_ASSERT(stringFromContents(to) == array);*/
-  to.squeeze(); 
+
+  to.squeeze();
   return to;
 }
@@ -118,4 +118,8 @@ KDEVCPPRPP_EXPORT PreprocessedContents convertFromByteArray(const QByteArray& ar
 ///Converts the byte array to a vector of fake-indices containing the text
 ///This also tokenizes the given array when possible
 KDEVCPPRPP_EXPORT PreprocessedContents tokenizeFromByteArray(const QByteArray& array);
+
+///Same as tokenizeFromByteArray(const QByteArray&), but works on a raw buffer of @p size bytes,
+///so it can be fed directly from a memory-mapped file without copying it into a QByteArray first.
+KDEVCPPRPP_EXPORT PreprocessedContents tokenizeFromBuffer(const char* data, int size);
 #endif
@@ -75,23 +75,32 @@ PreprocessedContents pp::processFile(const QString& fileName)
     }
 
     PreprocessedContents result;
-    processFileInternal(fileName, file.readAll(), result);
+    // Map the file instead of copying it, it is only read once while tokenizing
+    const qint64 size = file.size();
+    if (uchar* data = size ? file.map(0, size) : 0) {
+        processFileInternal(fileName, reinterpret_cast<const char*>(data), size, result);
+        file.unmap(data);
+    } else {
+        const QByteArray contents = file.readAll();
+        processFileInternal(fileName, contents.constData(), contents.size(), result);
+    }
     return result;
 }
 
 PreprocessedContents pp::processFile(const QString& fileName, const QByteArray& data)
 {
     PreprocessedContents result;
-    processFileInternal(fileName, data, result);
+    processFileInternal(fileName, data.constData(), data.size(), result);
     return result;
 }
 
-void pp::processFileInternal(const QString& fileName, const QByteArray& fileContents, PreprocessedContents& result)
+void pp::processFileInternal(const QString& fileName, const char* fileContents, int size, PreprocessedContents& result)
 {
     m_files.push(KDevelop::IndexedString(fileName));
-    // Guestimate as to how much expansion will occur
-    result.reserve(int(fileContents.length() * 1.2));
-    PreprocessedContents contents = tokenizeFromByteArray(fileContents);
+    PreprocessedContents contents = tokenizeFromBuffer(fileContents, size);
+    // Guestimate as to how much expansion will occur, based on the tokenized
+    // size since identifiers only take a single index each
+    result.reserve(int(contents.size() * 1.2));
     {
       Stream is(&contents);
       Stream rs(&result, m_environment->locationTable());
@@ -1280,3 +1289,8 @@ void rpp::pp::problemEncountered(const KDevelop::ProblemPointer & problem)
 {
   m_problems.append(problem);
 }
+
+QVector<rpp::MacroExpansionRecording*>& rpp::pp::macroExpansionRecordings()
+{
+  return m_macroExpansionRecordings;
+}
@@ -41,6 +41,7 @@ namespace rpp {
 
 class Preprocessor;
 class Environment;
+class MacroExpansionRecording;
 
 struct Value
 {
@@ -129,6 +130,7 @@ class KDEVCPPRPP_EXPORT pp
   QStack<KDevelop::IndexedString> m_files;
   Preprocessor* m_preprocessor;
   QList<KDevelop::ProblemPointer> m_problems;
+  QVector<MacroExpansionRecording*> m_macroExpansionRecordings;
 
   enum { MAX_LEVEL = 512 };
   int _M_skipping[MAX_LEVEL];
@@ -203,9 +205,12 @@ public:
 
   //Returns a hash-value computed from all until currently open branching-conditions and their decisions(like #ifdef's)
   uint branchingHash() const;
+
+  ///The macro-expansions that are currently recorded for the MacroExpansionCache, the innermost one last
+  QVector<MacroExpansionRecording*>& macroExpansionRecordings();
   
 private:
-  void processFileInternal(const QString& fileName, const QByteArray& fileContent, PreprocessedContents& result);
+  void processFileInternal(const QString& fileName, const char* fileContents, int size, PreprocessedContents& result);
 
   int skipping() const;
   bool test_if_level();
@@ -102,6 +102,11 @@ void LocationTable::anchor(std::size_t offset, Anchor anchor, const Preprocessed
   m_currentOffset = OffsetTable::ConstIterator(m_offsetTable.insert(offset, anchor));
 }
 
+const LocationTable::OffsetTable& LocationTable::anchors() const
+{
+  return m_offsetTable;
+}
+
 LocationTable::AnchorInTable LocationTable::anchorForOffset(std::size_t offset, bool collapseIfMacroExpansion) const
 {
   // Look nearby for a match first
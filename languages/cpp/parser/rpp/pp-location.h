@@ -76,8 +76,12 @@ class KDEVCPPRPP_EXPORT LocationTable
     * */
     void splitByAnchors(const PreprocessedContents& text, const Anchor& textStartPosition, QList<PreprocessedContents>& strings, QList<Anchor>& anchors) const;
 
-  private:
     typedef QMap<std::size_t, Anchor> OffsetTable;
+
+    ///Returns all anchors of this table, keyed by their offset
+    const OffsetTable& anchors() const;
+
+  private:
     OffsetTable m_offsetTable;
     mutable OffsetTable::ConstIterator m_currentOffset;
     //cache for positionAt
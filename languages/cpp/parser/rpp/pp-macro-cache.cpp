@@ -0,0 +1,193 @@
+/*
+  Copyright 2014 KDevelop developers
+
+  Permission to use, copy, modify, distribute, and sell this software and its
+  documentation for any purpose is hereby granted without fee, provided that
+  the above copyright notice appear in all copies and that both that
+  copyright notice and this permission notice appear in supporting
+  documentation.
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+  KDEVELOP TEAM BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+  AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "pp-macro-cache.h"
+
+#include <language/duchain/indexedstring.h>
+
+#include "pp-macro.h"
+
+using namespace rpp;
+
+MacroExpansionRecording::MacroExpansionRecording(const Stream* output, int start, int depth)
+  : m_output(output)
+  , m_start(start)
+  , m_depth(depth)
+  , m_maxDepth(depth)
+  , m_valid(true)
+{
+}
+
+void MacroExpansionRecording::usedMacro(const KDevelop::IndexedString& name, const pp_macro* macro)
+{
+  if(!m_valid || m_hidden.contains(name.index()) || m_dependencies.contains(name.index()))
+    return;
+  m_dependencies.insert(name.index(), macroState(macro));
+}
+
+void MacroExpansionRecording::hidMacro(const KDevelop::IndexedString& name)
+{
+  if(!m_hidden.contains(name.index()))
+    m_hidden.append(name.index());
+}
+
+void MacroExpansionRecording::accessedOutput(const Stream* output, int offset)
+{
+  if(m_output && output == m_output && offset < m_start)
+    m_valid = false;
+}
+
+void MacroExpansionRecording::reachedDepth(int depth)
+{
+  m_maxDepth = qMax(m_maxDepth, depth);
+}
+
+void MacroExpansionRecording::invalidate()
+{
+  m_valid = false;
+}
+
+bool MacroExpansionRecording::isValid() const
+{
+  return m_valid;
+}
+
+uint MacroExpansionRecording::macroState(const pp_macro* macro)
+{
+  //completeHash() covers the definition as well as the defined, hidden and function_like flags
+  return macro ? macro->completeHash() | 1 : 0;
+}
+
+const QHash<uint, uint>& MacroExpansionRecording::dependencies() const
+{
+  return m_dependencies;
+}
+
+int MacroExpansionRecording::relativeDepth() const
+{
+  return m_maxDepth - m_depth;
+}
+
+MacroExpansionCache::MacroExpansionCache()
+  : m_enabled(true)
+{
+}
+
+MacroExpansionCache& MacroExpansionCache::self()
+{
+  static MacroExpansionCache cache;
+  return cache;
+}
+
+uint MacroExpansionCache::hashKey(const pp_macro& macro, const PreprocessedContents& arguments)
+{
+  uint hash = macro.completeHash();
+  const uint* data = arguments.constData();
+  for(int a = 0; a < arguments.size(); ++a)
+    hash = hash * 31 + data[a];
+  return hash;
+}
+
+bool MacroExpansionCache::find(const pp_macro& macro, const PreprocessedContents& arguments, Entry& entry)
+{
+  if(!m_enabled)
+    return false;
+
+  const uint key = hashKey(macro, arguments);
+  QMutexLocker lock(&m_mutex);
+  QHash<uint, Entry>::const_iterator it = m_entries.constFind(key);
+  if(it == m_entries.constEnd() || it->name != macro.name.index() || it->macroHash != macro.completeHash() || it->arguments != arguments) {
+    ++m_statistics.misses;
+    return false;
+  }
+  entry = *it;
+  return true;
+}
+
+void MacroExpansionCache::verified(bool matched)
+{
+  QMutexLocker lock(&m_mutex);
+  if(matched)
+    ++m_statistics.hits;
+  else
+    ++m_statistics.rejections;
+}
+
+void MacroExpansionCache::insert(const pp_macro& macro, const PreprocessedContents& arguments, const MacroExpansionRecording& recording, const PreprocessedContents& expansion)
+{
+  if(!m_enabled || !recording.isValid() || expansion.size() + arguments.size() > MaxContentsSize / 64)
+    return;
+
+  Entry entry;
+  entry.name = macro.name.index();
+  entry.macroHash = macro.completeHash();
+  entry.arguments = arguments;
+  entry.expansion = expansion;
+  entry.depth = recording.relativeDepth();
+  entry.dependencies.reserve(recording.dependencies().size());
+  for(QHash<uint, uint>::const_iterator it = recording.dependencies().constBegin(); it != recording.dependencies().constEnd(); ++it)
+    entry.dependencies.append(qMakePair(it.key(), it.value()));
+
+  const uint key = hashKey(macro, arguments);
+  const uint size = entry.expansion.size() + entry.arguments.size();
+
+  QMutexLocker lock(&m_mutex);
+  QHash<uint, Entry>::iterator it = m_entries.find(key);
+  if(it != m_entries.end()) {
+    m_statistics.contentsSize -= it->expansion.size() + it->arguments.size();
+    m_entries.erase(it);
+  }
+  //Bounded by the number of entries and by the size of their contents. A dropped expansion is simply
+  //recorded again the next time the macro is expanded, so the first entries of the hash make room.
+  while(!m_entries.isEmpty() && (m_entries.size() >= MaxEntries || m_statistics.contentsSize + size > MaxContentsSize)) {
+    QHash<uint, Entry>::iterator victim = m_entries.begin();
+    m_statistics.contentsSize -= victim->expansion.size() + victim->arguments.size();
+    m_entries.erase(victim);
+    ++m_statistics.evictions;
+  }
+  m_entries.insert(key, entry);
+  m_statistics.contentsSize += size;
+  ++m_statistics.insertions;
+}
+
+void MacroExpansionCache::clear()
+{
+  QMutexLocker lock(&m_mutex);
+  m_entries.clear();
+  m_statistics = Statistics();
+}
+
+void MacroExpansionCache::setEnabled(bool enabled)
+{
+  m_enabled = enabled;
+}
+
+bool MacroExpansionCache::isEnabled() const
+{
+  return m_enabled;
+}
+
+MacroExpansionCache::Statistics MacroExpansionCache::statistics() const
+{
+  QMutexLocker lock(&m_mutex);
+  Statistics ret = m_statistics;
+  ret.entries = m_entries.size();
+  return ret;
+}
@@ -0,0 +1,169 @@
+/*
+  Copyright 2014 KDevelop developers
+
+  Permission to use, copy, modify, distribute, and sell this software and its
+  documentation for any purpose is hereby granted without fee, provided that
+  the above copyright notice appear in all copies and that both that
+  copyright notice and this permission notice appear in supporting
+  documentation.
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+  KDEVELOP TEAM BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+  AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef PP_MACRO_CACHE_H
+#define PP_MACRO_CACHE_H
+
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QPair>
+#include <QtCore/QVector>
+
+#include <cppparserexport.h>
+
+typedef QVector<unsigned int> PreprocessedContents;
+
+namespace KDevelop {
+  class IndexedString;
+}
+
+namespace rpp {
+
+class Stream;
+class pp_macro;
+
+/**
+ * Collects everything a macro-expansion depends on while it is computed, so its result
+ * can be stored in the MacroExpansionCache.
+ *
+ * Recordings are nested the same way as the expansions themselves: everything that is noted
+ * while an inner expansion is recorded is also noted for all outer ones.
+ * */
+class KDEVCPPRPP_EXPORT MacroExpansionRecording
+{
+public:
+  ///@param output The stream the expansion is written to, or zero if the expansion is computed in a separate buffer.
+  ///              Reading the output in front of @p start makes the expansion depend on its surrounding, and invalidates the recording.
+  ///@param depth The current macro-expansion depth
+  MacroExpansionRecording(const Stream* output, int start, int depth);
+
+  ///Notes that the macro @p name was looked up, and @p macro was found.
+  void usedMacro(const KDevelop::IndexedString& name, const pp_macro* macro);
+
+  ///Notes that the macro @p name was hidden by an expansion within this recording.
+  ///Lookups of it are not dependencies of the recorded expansion.
+  void hidMacro(const KDevelop::IndexedString& name);
+
+  ///Notes that the output has been read or modified at @p offset.
+  void accessedOutput(const Stream* output, int offset);
+
+  ///Notes that a function-like macro has been expanded with depth @p depth
+  void reachedDepth(int depth);
+
+  ///Marks the recorded expansion as not reproducible
+  void invalidate();
+
+  bool isValid() const;
+
+  ///The state of a macro as used in the dependencies, zero if it is not defined
+  static uint macroState(const pp_macro* macro);
+
+  ///Name-indices of all used macros, mapped to their state
+  const QHash<uint, uint>& dependencies() const;
+
+  ///The maximum depth reached relative to the depth the recording was started at
+  int relativeDepth() const;
+
+private:
+  const Stream* m_output;
+  int m_start;
+  int m_depth;
+  int m_maxDepth;
+  bool m_valid;
+  QHash<uint, uint> m_dependencies;
+  QVector<uint> m_hidden;
+};
+
+/**
+ * A cache for macro-expansions that is shared by all preprocessor-threads.
+ *
+ * An expansion is identified by the complete hash of the expanded macro and the text of its
+ * arguments, and is only re-used if all macros it depended on have the same state as when it
+ * was recorded. Expanding macros that are used often, like the Qt and Boost.Preprocessor ones,
+ * can so be reduced to a few lookups.
+ * */
+class KDEVCPPRPP_EXPORT MacroExpansionCache
+{
+public:
+  enum {
+    MaxEntries = 16384,
+    ///Maximum summed size of the stored expansions
+    MaxContentsSize = 4 * 1024 * 1024
+  };
+
+  struct Entry {
+    Entry() : name(0), macroHash(0), depth(0) {
+    }
+    uint name;
+    uint macroHash;
+    ///Sizes and contents of all the argument texts, in their unexpanded and expanded form
+    PreprocessedContents arguments;
+    QVector<QPair<uint, uint> > dependencies;
+    PreprocessedContents expansion;
+    int depth;
+  };
+
+  struct Statistics {
+    Statistics() : hits(0), misses(0), rejections(0), insertions(0), evictions(0), entries(0), contentsSize(0) {
+    }
+    uint hits;
+    uint misses;
+    ///Candidates that were found, but depended on a different macro state
+    uint rejections;
+    uint insertions;
+    uint evictions;
+    uint entries;
+    uint contentsSize;
+  };
+
+  static MacroExpansionCache& self();
+
+  ///Fills @p entry with a candidate for the given expansion. Returns false if there is none.
+  ///The dependencies of the candidate still have to be verified by the caller.
+  bool find(const pp_macro& macro, const PreprocessedContents& arguments, Entry& entry);
+
+  ///Stores the expansion of @p macro with @p arguments, if @p recording is valid.
+  void insert(const pp_macro& macro, const PreprocessedContents& arguments, const MacroExpansionRecording& recording, const PreprocessedContents& expansion);
+
+  ///Reports whether the dependencies of a candidate returned by find() matched the current macro state
+  void verified(bool matched);
+
+  void clear();
+
+  ///While disabled, find() never returns a candidate, and nothing is stored.
+  ///Should only be changed while nothing is being preprocessed.
+  void setEnabled(bool enabled);
+  bool isEnabled() const;
+
+  Statistics statistics() const;
+
+private:
+  MacroExpansionCache();
+  static uint hashKey(const pp_macro& macro, const PreprocessedContents& arguments);
+
+  mutable QMutex m_mutex;
+  QHash<uint, Entry> m_entries;
+  Statistics m_statistics;
+  bool m_enabled;
+};
+
+}
+
+#endif // PP_MACRO_CACHE_H
@@ -35,6 +35,7 @@
 #include "pp-engine.h"
 #include "pp-environment.h"
 #include "pp-location.h"
+#include "pp-macro-cache.h"
 #include "preprocessor.h"
 #include "chartools.h"
 
@@ -79,6 +80,22 @@ void trim(QVector<uint>& array) {
 
 using namespace rpp;              
 
+//Serializes the actual parameters of a function-like macro, so they can be used to identify its expansion in the MacroExpansionCache
+static PreprocessedContents cacheArguments(const QList<pp_actual>& actuals) {
+  PreprocessedContents ret;
+  ret.append(actuals.size());
+  foreach(const pp_actual& actual, actuals) {
+    ret.append(actual.sourceText.size());
+    ret += actual.sourceText;
+    ret.append(actual.text.size());
+    foreach(const PreprocessedContents& text, actual.text) {
+      ret.append(text.size());
+      ret += text;
+    }
+  }
+  return ret;
+}
+
 pp_frame::pp_frame(pp_macro* __expandingMacro, const QList<pp_actual>& __actuals)
   : depth(0)
   , expandingMacro(__expandingMacro)
@@ -101,6 +118,7 @@ pp_actual pp_macro_expander::resolve_formal(const IndexedString& name, Stream& i
     problem->setFinalLocation(KDevelop::DocumentRange(IndexedString(m_engine->currentFileNameString()), RangeInRevision(input.originalInputPosition(), 0).castToSimpleRange()));
     problem->setDescription(i18n("Macro error"));
     m_engine->problemEncountered(problem);
+    invalidateRecordings();
     return pp_actual();
   }
   
@@ -115,6 +133,7 @@ pp_actual pp_macro_expander::resolve_formal(const IndexedString& name, Stream& i
         problem->setDescription(i18n("Call to macro %1 missing argument number %2", name.str(), index));
         problem->setExplanation(i18n("Formals: %1", joinIndexVector(formals, formalsSize, ", ")));
         m_engine->problemEncountered(problem);
+        invalidateRecordings();
       }
     }
   }
@@ -168,11 +187,13 @@ struct EnableMacroExpansion {
 //A helper class that temporary hides a macro in the environment
 class MacroHider {
   public:
-  MacroHider(pp_macro* macro, Environment* environment) : m_macro(macro), m_environment(environment) {
+  MacroHider(pp_macro* macro, pp* engine) : m_macro(macro), m_environment(engine->environment()) {
     
     m_hideMacro.name = macro->name;
     m_hideMacro.hidden = true;
-    environment->insertMacro(&m_hideMacro);
+    m_environment->insertMacro(&m_hideMacro);
+    foreach(MacroExpansionRecording* recording, engine->macroExpansionRecordings())
+      recording->hidMacro(macro->name);
   }
   ~MacroHider() {
     m_environment->insertMacro(m_macro);
@@ -183,6 +204,72 @@ class MacroHider {
     Environment* m_environment;
 };
 
+//Records the dependencies of a macro-expansion while it is alive, if @p active is true
+class RecordingScope {
+  public:
+  RecordingScope(pp* engine, bool active, const Stream* output, int start, int depth) : m_engine(engine), m_active(active), m_recording(output, start, depth) {
+    if(m_active)
+      m_engine->macroExpansionRecordings().append(&m_recording);
+  }
+  ~RecordingScope() {
+    if(m_active) {
+      Q_ASSERT(m_engine->macroExpansionRecordings().last() == &m_recording);
+      m_engine->macroExpansionRecordings().pop_back();
+    }
+  }
+  ///Puts the recorded expansion into the cache, if it can be reproduced
+  void store(const pp_macro& macro, const PreprocessedContents& arguments, const PreprocessedContents& expansion) {
+    //The state whether the next macro is hidden has to be the same as when the recording was started
+    if(m_active && !m_engine->hideNextMacro())
+      MacroExpansionCache::self().insert(macro, arguments, m_recording, expansion);
+  }
+  private:
+    pp* m_engine;
+    bool m_active;
+    MacroExpansionRecording m_recording;
+};
+
+pp_macro* pp_macro_expander::retrieveMacro(const IndexedString& name) const
+{
+  pp_macro* macro = m_engine->environment()->retrieveMacro(name, false);
+  foreach(MacroExpansionRecording* recording, m_engine->macroExpansionRecordings())
+    recording->usedMacro(name, macro);
+  return macro;
+}
+
+bool pp_macro_expander::findCachedExpansion(const pp_macro& macro, const PreprocessedContents& arguments, int depth, PreprocessedContents& expansion) const
+{
+  MacroExpansionCache::Entry entry;
+  if(!MacroExpansionCache::self().find(macro, arguments, entry))
+    return false;
+
+  bool matched = depth + entry.depth < maxMacroExpansionDepth;
+  //Retrieve the dependencies through the environment, so it notes their use just like during a real expansion
+  for(int a = 0; matched && a < entry.dependencies.size(); ++a)
+    matched = MacroExpansionRecording::macroState(retrieveMacro(IndexedString::fromIndex(entry.dependencies[a].first))) == entry.dependencies[a].second;
+
+  MacroExpansionCache::self().verified(matched);
+  if(!matched)
+    return false;
+
+  foreach(MacroExpansionRecording* recording, m_engine->macroExpansionRecordings())
+    recording->reachedDepth(depth + entry.depth);
+  expansion = entry.expansion;
+  return true;
+}
+
+void pp_macro_expander::accessedOutput(const Stream& output, int offset) const
+{
+  foreach(MacroExpansionRecording* recording, m_engine->macroExpansionRecordings())
+    recording->accessedOutput(&output, offset);
+}
+
+void pp_macro_expander::invalidateRecordings() const
+{
+  foreach(MacroExpansionRecording* recording, m_engine->macroExpansionRecordings())
+    recording->invalidate();
+}
+
 void pp_macro_expander::operator()(Stream& input, Stream& output, bool substitute, LocationTable* table)
 {
   skip_blanks(input, output);
@@ -230,6 +317,7 @@ void pp_macro_expander::operator()(Stream& input, Stream& output, bool substitut
             while(output.offset() > 0 && isSpace(previous.index()))
               previous = IndexedString::fromIndex(output.popLastOutput());   
           }
+          accessedOutput(output, output.offset() - 1);
           output.appendString(output.currentOutputAnchor(), previous);
           // OK to put the merged tokens into stream separately, because the stream in character-based
           Anchor nextStart = input.inputPosition();
@@ -360,7 +448,7 @@ void pp_macro_expander::operator()(Stream& input, Stream& output, bool substitut
 
         // TODO handle inbuilt "defined" etc functions
 
-        pp_macro* macro = m_engine->environment()->retrieveMacro(name, false);
+        pp_macro* macro = retrieveMacro(name);
         
         if (!macro || !macro->defined || macro->hidden || macro->function_like || m_engine->hideNextMacro())
         {
@@ -374,6 +462,9 @@ void pp_macro_expander::operator()(Stream& input, Stream& output, bool substitut
         static const IndexedString timeIndex = IndexedString("__TIME__");
         // TODO C99 only!
         static const IndexedString funcIndex = IndexedString("__func__");
+          if (name == lineIndex || name == fileIndex || name == dateIndex || name == timeIndex)
+            invalidateRecordings(); //The expansion depends on more than the macros
+
           if (name == lineIndex)
             output.appendString(inputPosition, convertFromByteArray(QString::number(input.inputPosition().line).toUtf8()));
           else if (name == fileIndex)
@@ -408,16 +499,22 @@ void pp_macro_expander::operator()(Stream& input, Stream& output, bool substitut
 
           if (macro->definitionSize()) {
             //Hide the expanded macro to prevent endless expansion
-            MacroHider hideMacro(macro, m_engine->environment());
+            MacroHider hideMacro(macro, m_engine);
             
-            pp_macro_expander expand_macro(m_engine);
-            ///@todo UGLY conversion
-            Stream ms((uint*)macro->definition(), macro->definitionSize(), Anchor(input.inputPosition(), true));
-            ms.setOriginalInputPosition(input.originalInputPosition());
+            //The expansion is computed separately and collapsed to the current position, so it only depends on the macros
+            const bool cacheable = MacroExpansionCache::self().isEnabled();
             PreprocessedContents expanded;
-            {
-              Stream es(&expanded);
-              expand_macro(ms, es);
+            if (!cacheable || !findCachedExpansion(*macro, PreprocessedContents(), 0, expanded)) {
+              RecordingScope recording(m_engine, cacheable, 0, 0, 0);
+              pp_macro_expander expand_macro(m_engine);
+              ///@todo UGLY conversion
+              Stream ms((uint*)macro->definition(), macro->definitionSize(), Anchor(input.inputPosition(), true));
+              ms.setOriginalInputPosition(input.originalInputPosition());
+              {
+                Stream es(&expanded);
+                expand_macro(ms, es);
+              }
+              recording.store(*macro, PreprocessedContents(), expanded);
             }
 
             if (!expanded.isEmpty())
@@ -441,7 +538,8 @@ void pp_macro_expander::operator()(Stream& input, Stream& output, bool substitut
           previous = IndexedString::fromIndex(output.peekLastOutput(stepsBack));
           ++stepsBack;
         }
-        pp_macro* macro = m_engine->environment()->retrieveMacro(previous, false);
+        accessedOutput(output, output.offset() - stepsBack - (isSpace(previous.index()) ? 1 : 0));
+        pp_macro* macro = retrieveMacro(previous);
         if(!macro || !macro->function_like || !macro->defined || macro->hidden) {
           output << input;
           ++input;
@@ -528,30 +626,50 @@ void pp_macro_expander::operator()(Stream& input, Stream& output, bool substitut
         if(m_frame)
           frame.depth = m_frame->depth + 1;
         
+        foreach(MacroExpansionRecording* recording, m_engine->macroExpansionRecordings())
+          recording->reachedDepth(frame.depth);
+
         if(frame.depth >= maxMacroExpansionDepth) 
         {
           kDebug() << "reached maximum macro-expansion depth while expanding" << macro->name.str();
+          invalidateRecordings();
           RETURN_IF_INPUT_BROKEN
           
           output << input;
           ++input;
         }else{
-          pp_macro_expander expand_macro(m_engine, &frame);
-          
           //Hide the expanded macro to prevent endless expansion
-          MacroHider hideMacro(macro, m_engine->environment());
+          MacroHider hideMacro(macro, m_engine);
           
-          ///@todo UGLY conversion
-          Stream ms((uint*)macro->definition(), macro->definitionSize(), Anchor(input.inputPosition(), true));
+          //Within the expansion of another macro all positions are collapsed, so the expansion
+          //only depends on the macros and the arguments, and can be taken from the cache.
+          const bool cacheable = MacroExpansionCache::self().isEnabled() && input.inputPosition().collapsed && !m_engine->hideNextMacro();
+          PreprocessedContents arguments;
+          if (cacheable)
+            arguments = cacheArguments(actuals);
+
+          PreprocessedContents cached;
+          if (cacheable && findCachedExpansion(*macro, arguments, frame.depth, cached)) {
+            output.appendString(Anchor(input.inputPosition(), true), cached);
+          } else {
+            const int start = output.offset();
+            RecordingScope recording(m_engine, cacheable, &output, start, frame.depth);
+            pp_macro_expander expand_macro(m_engine, &frame);
+            
+            ///@todo UGLY conversion
+            Stream ms((uint*)macro->definition(), macro->definitionSize(), Anchor(input.inputPosition(), true));
 
-          PreprocessedContents expansion_text;
-          rpp::LocationTable table;
-          Stream expansion_stream(&expansion_text, Anchor(input.inputPosition(), true), &table);
-          expand_macro(ms, expansion_stream, true);
+            PreprocessedContents expansion_text;
+            rpp::LocationTable table;
+            Stream expansion_stream(&expansion_text, Anchor(input.inputPosition(), true), &table);
+            expand_macro(ms, expansion_stream, true);
 
-          Stream ns(&expansion_text, Anchor(input.inputPosition(), true));
-          ns.setOriginalInputPosition(input.originalInputPosition());
-          expand_macro(ns, output, false, &table);
+            Stream ns(&expansion_text, Anchor(input.inputPosition(), true));
+            ns.setOriginalInputPosition(input.originalInputPosition());
+            expand_macro(ns, output, false, &table);
+            if (cacheable && output.offset() >= start)
+              recording.store(*macro, arguments, output.source()->mid(start, output.offset() - start));
+          }
           output << ' '; //Prevent implicit token merging
         }
       } else {
@@ -103,6 +103,19 @@ private:
   /// @ref expander is a reusable macro expander
   void skip_actual_parameter(rpp::Stream& input, rpp::pp_macro& macro, QList< rpp::pp_actual >& actuals, rpp::pp_macro_expander& expander);
 
+  /// Retrieves the macro @ref name from the environment, and notes it as dependency of all recorded expansions
+  pp_macro* retrieveMacro(const KDevelop::IndexedString& name) const;
+
+  /// Looks up the expansion of @ref macro with the given @ref arguments in the MacroExpansionCache,
+  /// and verifies that the macros it depends on are unchanged. @ref depth is the current expansion depth.
+  bool findCachedExpansion(const pp_macro& macro, const PreprocessedContents& arguments, int depth, PreprocessedContents& expansion) const;
+
+  /// Notes for all recorded expansions that @ref output was accessed at @ref offset
+  void accessedOutput(const Stream& output, int offset) const;
+
+  /// Marks all recorded expansions as not reproducible, for example because they used __LINE__
+  void invalidateRecordings() const;
+
   pp* m_engine;
   pp_frame* m_frame;
 
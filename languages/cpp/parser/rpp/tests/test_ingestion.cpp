@@ -0,0 +1,286 @@
+/*
+  Copyright 2014 KDevelop developers
+
+  Permission to use, copy, modify, distribute, and sell this software and its
+  documentation for any purpose is hereby granted without fee, provided that
+  the above copyright notice appear in all copies and that both that
+  copyright notice and this permission notice appear in supporting
+  documentation.
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+  KDEVELOP TEAM BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+  AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "test_ingestion.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QTemporaryFile>
+
+#include <limits>
+
+#include <qtest_kde.h>
+
+#include <tests/testcore.h>
+#include <tests/autotestshell.h>
+#include <language/duchain/indexedstring.h>
+
+#include "chartools.h"
+#include <util/kdevvarlengtharray.h>
+
+QTEST_KDEMAIN(TestIngestion, NoGUI);
+
+using namespace KDevelop;
+
+// Set KDEV_PP_BENCHMARK_DIR to a directory of headers, e.g. /usr/include/qt4/QtCore,
+// to benchmark the ingestion of a real-world header set.
+static const char* benchmarkDirVariable = "KDEV_PP_BENCHMARK_DIR";
+
+static QTemporaryFile* generatedFile = 0;
+
+// The tokenizer as it was before it worked on raw buffers, to compare the results with
+static PreprocessedContents referenceTokenize(const QByteArray& array)
+{
+  PreprocessedContents to;
+  const char* data = array.constData();
+  const char* dataEnd = data + array.size();
+
+  KDevVarLengthArray<char, 100> identifier;
+  KDevelop::IndexedString::RunningHash hash;
+  bool tokenizing = false;
+
+  while(data < dataEnd) {
+    if(!tokenizing) {
+      if(isLetter(*data) || *data == '_')
+        tokenizing = true;
+    }
+
+    if(tokenizing) {
+      if(isValidMacroIdentifierToken(*data)) {
+        hash.append(*data);
+        identifier.append(*data);
+      }else{
+        to.append( KDevelop::IndexedString::indexForString(identifier.constData(), identifier.size(), hash.hash) );
+        hash.clear();
+        identifier.clear();
+        tokenizing = false;
+      }
+    }
+
+    if(!tokenizing)
+      to.append( indexFromCharacter(*data) );
+    ++data;
+  }
+
+  if(tokenizing)
+    to.append( KDevelop::IndexedString::indexForString(identifier.constData(), identifier.size(), hash.hash) );
+  return to;
+}
+
+// Returns the peak resident set size of the process in bytes, or -1 if it is unknown
+static qint64 peakResidentSize()
+{
+  QFile status("/proc/self/status");
+  if(!status.open(QIODevice::ReadOnly))
+    return -1;
+  foreach(const QByteArray& line, status.readAll().split('\n')) {
+    if(line.startsWith("VmHWM:"))
+      return line.mid(6).trimmed().split(' ').first().toLongLong() * 1024;
+  }
+  return -1;
+}
+
+// Skips files that can't be mapped and tokenized in one piece: mapping zero bytes fails, and the
+// tokenizer takes an int size. Returns the size of @p file otherwise.
+static qint64 mappableSize(const QFile& file)
+{
+  const qint64 size = file.size();
+  if(size <= 0 || size > std::numeric_limits<int>::max())
+    return -1;
+  return size;
+}
+
+// Resets the peak resident set size of the process to the current resident set size
+static bool resetPeakResidentSize()
+{
+  QFile clearRefs("/proc/self/clear_refs");
+  return clearRefs.open(QIODevice::WriteOnly) && clearRefs.write("5") == 1;
+}
+
+void TestIngestion::initTestCase()
+{
+  AutoTestShell::init();
+  TestCore::initialize(Core::NoUi);
+
+  // A large generated header as fallback input for the benchmarks
+  generatedFile = new QTemporaryFile;
+  QVERIFY(generatedFile->open());
+  for(int i = 0; i < 20000; ++i) {
+    generatedFile->write(QString("/* comment %1 */\nclass Class%1 : public Base { int m_member%1; };\n"
+                                 "#define MACRO_%1(x) ((x) + 0x%1)\nconst char* str%1 = \"string %1\";\n").arg(i).toUtf8());
+  }
+  generatedFile->close();
+}
+
+void TestIngestion::cleanupTestCase()
+{
+  delete generatedFile;
+  generatedFile = 0;
+  TestCore::shutdown();
+}
+
+void TestIngestion::testTokenize()
+{
+  QFETCH(QByteArray, code);
+  QFETCH(int, identifiers);
+
+  const PreprocessedContents contents = tokenizeFromBuffer(code.constData(), code.size());
+  QCOMPARE(contents, referenceTokenize(code));
+  QCOMPARE(tokenizeFromByteArray(code), contents);
+  QCOMPARE(stringFromContents(contents), code);
+
+  int foundIdentifiers = 0;
+  foreach(uint index, contents) {
+    if(!isCharacter(index))
+      ++foundIdentifiers;
+  }
+  QCOMPARE(foundIdentifiers, identifiers);
+}
+
+void TestIngestion::testTokenize_data()
+{
+  QTest::addColumn<QByteArray>("code");
+  QTest::addColumn<int>("identifiers");
+
+  QTest::newRow("empty") << QByteArray() << 0;
+  QTest::newRow("identifier") << QByteArray("foo") << 1;
+  QTest::newRow("dollar") << QByteArray("a$b $c") << 2;
+  QTest::newRow("numbers") << QByteArray("0x1f 12 a1") << 2;
+  QTest::newRow("non-ascii") << QByteArray("int \xc3\xa4x = 1;") << 2;
+  QTest::newRow("mixed") << QByteArray("#define A(x) x##_y /* c */ \"s\"\n") << 7;
+  QTest::newRow("underscore-start") << QByteArray("_a __b _1 1_") << 4;
+  QTest::newRow("dollar-start") << QByteArray("$a$ b$") << 2;
+  QTest::newRow("identifier-at-end") << QByteArray("x+yz") << 2;
+  QTest::newRow("high-bytes") << QByteArray("\xff\x80a\xe9b") << 2;
+  QTest::newRow("whitespace-only") << QByteArray(" \t\n\r ") << 0;
+  QTest::newRow("long") << QByteArray(300, 'q') << 1;
+}
+
+void TestIngestion::addBenchmarkFiles()
+{
+  QTest::addColumn<QString>("fileName");
+
+  const QByteArray dir = qgetenv(benchmarkDirVariable);
+  if(dir.isEmpty()) {
+    QTest::newRow("generated") << generatedFile->fileName();
+    return;
+  }
+  QDirIterator it(QString::fromLocal8Bit(dir), QDir::Files, QDirIterator::Subdirectories);
+  while(it.hasNext()) {
+    const QString file = it.next();
+    QTest::newRow(qPrintable(file)) << file;
+  }
+}
+
+void TestIngestion::benchReadAll()
+{
+  QFETCH(QString, fileName);
+  QFile file(fileName);
+  QVERIFY(file.open(QIODevice::ReadOnly));
+
+  QBENCHMARK {
+    file.seek(0);
+    const QByteArray data = file.readAll();
+    const PreprocessedContents contents = tokenizeFromByteArray(data);
+    Q_UNUSED(contents);
+  }
+}
+
+void TestIngestion::benchReadAll_data()
+{
+  addBenchmarkFiles();
+}
+
+void TestIngestion::benchMapped()
+{
+  QFETCH(QString, fileName);
+  QFile file(fileName);
+  QVERIFY(file.open(QIODevice::ReadOnly));
+  const qint64 size = mappableSize(file);
+  if(size < 0)
+    QSKIP("The file is empty or too large to be mapped", SkipSingle);
+
+  QBENCHMARK {
+    uchar* data = file.map(0, size);
+    QVERIFY(data);
+    const PreprocessedContents contents = tokenizeFromBuffer(reinterpret_cast<const char*>(data), int(size));
+    Q_UNUSED(contents);
+    file.unmap(data);
+  }
+}
+
+void TestIngestion::benchMapped_data()
+{
+  addBenchmarkFiles();
+}
+
+void TestIngestion::benchPeakMemory()
+{
+  QFETCH(QString, fileName);
+  QFETCH(bool, mapped);
+  QFile file(fileName);
+  QVERIFY(file.open(QIODevice::ReadOnly));
+
+  if(!resetPeakResidentSize())
+    QSKIP("The peak resident set size can't be reset on this system", SkipSingle);
+  const qint64 before = peakResidentSize();
+  QVERIFY(before >= 0);
+
+  if(mapped) {
+    const qint64 size = mappableSize(file);
+    if(size < 0)
+      QSKIP("The file is empty or too large to be mapped", SkipSingle);
+    uchar* data = file.map(0, size);
+    QVERIFY(data);
+    const PreprocessedContents contents = tokenizeFromBuffer(reinterpret_cast<const char*>(data), int(size));
+    file.unmap(data);
+    QVERIFY(!contents.isEmpty());
+  } else {
+    const QByteArray data = file.readAll();
+    const PreprocessedContents contents = tokenizeFromByteArray(data);
+    QVERIFY(!contents.isEmpty() || data.isEmpty());
+  }
+
+  // Reported as the growth of the peak resident set size while ingesting the file once
+  QTest::setBenchmarkResult(peakResidentSize() - before, QTest::BytesAllocated);
+}
+
+void TestIngestion::benchPeakMemory_data()
+{
+  QTest::addColumn<QString>("fileName");
+  QTest::addColumn<bool>("mapped");
+
+  QStringList files;
+  const QByteArray dir = qgetenv(benchmarkDirVariable);
+  if(dir.isEmpty()) {
+    files << generatedFile->fileName();
+  } else {
+    QDirIterator it(QString::fromLocal8Bit(dir), QDir::Files, QDirIterator::Subdirectories);
+    while(it.hasNext())
+      files << it.next();
+  }
+  foreach(const QString& file, files) {
+    QTest::newRow(qPrintable(file + " read-all")) << file << false;
+    QTest::newRow(qPrintable(file + " mapped")) << file << true;
+  }
+}
+
+#include "test_ingestion.moc"
@@ -0,0 +1,203 @@
+/*
+  Copyright 2014 KDevelop developers
+
+  Permission to use, copy, modify, distribute, and sell this software and its
+  documentation for any purpose is hereby granted without fee, provided that
+  the above copyright notice appear in all copies and that both that
+  copyright notice and this permission notice appear in supporting
+  documentation.
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+  KDEVELOP TEAM BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+  AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "test_macroexpansion.h"
+
+#include <QFile>
+
+#include <qtest_kde.h>
+
+#include <tests/testcore.h>
+#include <tests/autotestshell.h>
+
+#include "pp-engine.h"
+#include "pp-macro-cache.h"
+#include "preprocessor.h"
+#include "chartools.h"
+
+QTEST_KDEMAIN(TestMacroExpansion, NoGUI);
+
+using namespace KDevelop;
+using namespace rpp;
+
+// Set KDEV_PP_MACRO_BENCHMARK_FILE to a macro-heavy source file, e.g. one that includes
+// the Boost.Preprocessor headers in their preprocessed form, to benchmark it instead of the generated code.
+static const char* benchmarkFileVariable = "KDEV_PP_MACRO_BENCHMARK_FILE";
+
+enum {
+  MaxRepetitions = 32
+};
+
+static QByteArray preprocess(const QByteArray& code)
+{
+  Preprocessor preprocessor;
+  pp engine(&preprocessor);
+  return stringFromContents(engine.processFile("anonymous", code));
+}
+
+// A subset of Boost.Preprocessor, written in the same style: every repetition is spelled
+// out as a separate macro, and selected by concatenating a prefix with a number.
+static QByteArray boostPPLibrary()
+{
+  QByteArray code =
+    "#define PP_CAT(a, b) PP_CAT_I(a, b)\n"
+    "#define PP_CAT_I(a, b) a ## b\n"
+    "#define PP_EMPTY()\n"
+    "#define PP_COMMA() ,\n"
+    "#define PP_IIF(bit, t, f) PP_CAT(PP_IIF_, bit)(t, f)\n"
+    "#define PP_IIF_0(t, f) f\n"
+    "#define PP_IIF_1(t, f) t\n"
+    "#define PP_BOOL(x) PP_CAT(PP_BOOL_, x)\n"
+    "#define PP_IF(cond, t, f) PP_IIF(PP_BOOL(cond), t, f)\n"
+    "#define PP_COMMA_IF(cond) PP_IF(cond, PP_COMMA, PP_EMPTY)()\n"
+    "#define PP_INC(x) PP_CAT(PP_INC_, x)\n"
+    "#define PP_REPEAT(count, macro, data) PP_CAT(PP_REPEAT_, count)(macro, data)\n"
+    "#define PP_REPEAT_0(macro, data)\n"
+    "#define PP_ENUM_PARAMS(count, param) PP_CAT(PP_ENUM_PARAMS_, count)(param)\n"
+    "#define PP_ENUM_PARAMS_0(param)\n";
+
+  for(int n = 0; n <= MaxRepetitions; ++n) {
+    code += QString("#define PP_BOOL_%1 %2\n").arg(n).arg(n ? 1 : 0).toUtf8();
+    code += QString("#define PP_INC_%1 %2\n").arg(n).arg(n + 1).toUtf8();
+  }
+  for(int n = 1; n <= MaxRepetitions; ++n) {
+    code += QString("#define PP_REPEAT_%1(macro, data) PP_REPEAT_%2(macro, data) macro(%2, data)\n").arg(n).arg(n - 1).toUtf8();
+    code += QString("#define PP_ENUM_PARAMS_%1(param) PP_ENUM_PARAMS_%2(param) PP_COMMA_IF(%2) param ## %2\n").arg(n).arg(n - 1).toUtf8();
+  }
+
+  code += "#define DECLARE_FUNCTION(n, name) template<PP_ENUM_PARAMS(PP_INC(n), class T)> void PP_CAT(name, n)(PP_ENUM_PARAMS(PP_INC(n), T));\n"
+          "#define OBJECT public: static const QMetaObject staticMetaObject; virtual const QMetaObject* metaObject() const; private:\n";
+  return code;
+}
+
+static QByteArray boostPPCode(int classes, int repetitions)
+{
+  QByteArray code = boostPPLibrary();
+  for(int i = 0; i < classes; ++i)
+    code += QString("class Class%1 {\n  OBJECT\n  PP_REPEAT(%2, DECLARE_FUNCTION, function)\n};\n").arg(i).arg(repetitions).toUtf8();
+  return code;
+}
+
+void TestMacroExpansion::initTestCase()
+{
+  AutoTestShell::init();
+  TestCore::initialize(Core::NoUi);
+}
+
+void TestMacroExpansion::cleanupTestCase()
+{
+  MacroExpansionCache::self().setEnabled(true);
+  MacroExpansionCache::self().clear();
+  TestCore::shutdown();
+}
+
+void TestMacroExpansion::testCachedExpansion()
+{
+  QFETCH(QByteArray, code);
+
+  MacroExpansionCache::self().setEnabled(false);
+  const QByteArray expected = preprocess(code);
+
+  MacroExpansionCache::self().setEnabled(true);
+  MacroExpansionCache::self().clear();
+  // The first run fills the cache, the second one uses it
+  QCOMPARE(preprocess(code), expected);
+  QCOMPARE(preprocess(code), expected);
+}
+
+void TestMacroExpansion::testCachedExpansion_data()
+{
+  QTest::addColumn<QByteArray>("code");
+
+  QTest::newRow("nested") << QByteArray("#define A(x) B(x) + B(x)\n#define B(x) (x * 2)\n#define C A(1) A(2) A(1)\nC C\n");
+  QTest::newRow("redefinition") << QByteArray("#define F(x) G(x)\n#define G(x) x\n#define H F(1) F(1)\nH\n#undef G\n#define G(x) -x\nH\n");
+  QTest::newRow("line") << QByteArray("#define L __LINE__\n#define M(x) L x\n#define N M(1) M(1)\nN\nN\n");
+  QTest::newRow("recursion") << QByteArray("#define R(x) R(x) + x\n#define S R(1) R(1)\nS S\n");
+  QTest::newRow("paren") << QByteArray("#define ID(x) x\n#define LP (\n#define CALL ID LP 1)\n#define TWICE(x) CALL CALL x\nTWICE(1) TWICE(1)\n");
+  QTest::newRow("paste") << QByteArray("#define CAT(a, b) a ## b\n#define CAT2(a, b) CAT(a, b)\n#define X CAT2(foo, bar) CAT2(foo, bar)\nX X\n");
+  QTest::newRow("stringify") << QByteArray("#define STR(x) #x\n#define XSTR(x) STR(x)\n#define V XSTR(a + b) XSTR(a + b)\nV V\n");
+  QTest::newRow("defined") << QByteArray("#define D(x) defined x\n#define E D(X) D(X)\n#if E\n#endif\nE E\n");
+  QTest::newRow("boost-pp") << boostPPCode(4, 8);
+}
+
+void TestMacroExpansion::testCacheStatistics()
+{
+  const QByteArray code = boostPPCode(4, 8);
+  MacroExpansionCache::self().setEnabled(true);
+  MacroExpansionCache::self().clear();
+
+  preprocess(code);
+  const MacroExpansionCache::Statistics first = MacroExpansionCache::self().statistics();
+  QVERIFY(first.insertions > 0);
+  QVERIFY(first.entries > 0);
+  // The classes use the same macros with the same arguments
+  QVERIFY(first.hits > 0);
+
+  preprocess(code);
+  const MacroExpansionCache::Statistics second = MacroExpansionCache::self().statistics();
+  QVERIFY(second.hits > first.hits);
+  QCOMPARE(second.rejections, first.rejections);
+}
+
+void TestMacroExpansion::benchBoostPP()
+{
+  QFETCH(bool, cached);
+  QFETCH(bool, warm);
+
+  QByteArray code;
+  const QByteArray fileName = qgetenv(benchmarkFileVariable);
+  if(!fileName.isEmpty()) {
+    QFile file(QString::fromLocal8Bit(fileName));
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    code = file.readAll();
+  } else {
+    code = boostPPCode(200, 16);
+  }
+
+  MacroExpansionCache::self().setEnabled(cached);
+  MacroExpansionCache::self().clear();
+  if(warm)
+    preprocess(code);
+
+  QByteArray result;
+  QBENCHMARK {
+    if(!warm)
+      MacroExpansionCache::self().clear();
+    result = preprocess(code);
+  }
+  QVERIFY(!result.isEmpty());
+
+  const MacroExpansionCache::Statistics statistics = MacroExpansionCache::self().statistics();
+  qDebug() << "hits:" << statistics.hits << "misses:" << statistics.misses << "rejections:" << statistics.rejections
+           << "entries:" << statistics.entries << "evictions:" << statistics.evictions;
+  MacroExpansionCache::self().setEnabled(true);
+}
+
+void TestMacroExpansion::benchBoostPP_data()
+{
+  QTest::addColumn<bool>("cached");
+  QTest::addColumn<bool>("warm");
+
+  QTest::newRow("uncached") << false << false;
+  QTest::newRow("cold-cache") << true << false;
+  QTest::newRow("warm-cache") << true << true;
+}
+
+#include "test_macroexpansion.moc"
@@ -271,8 +271,8 @@ private:
       QVERIFY(cursor < lastSession->token_stream->size());
       QVERIFY(cursor < lastGeneratedSession->token_stream->size());
 
-      const Token& t1 = lastSession->token_stream->token( cursor );
-      const Token& t2 = lastGeneratedSession->token_stream->token( cursor );
+      const Token t1 = lastSession->token_stream->token( cursor );
+      const Token t2 = lastGeneratedSession->token_stream->token( cursor );
 
       QCOMPARE(ComparableToken(t1, lastSession), ComparableToken(t2, lastGeneratedSession));
       if (t1.kind == Token_EOF)
@@ -0,0 +1,222 @@
+/* This file is part of KDevelop
+
+   Copyright 2014 KDevelop developers
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2 as published by the Free Software Foundation.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "test_lexer.h"
+
+#include <QtTest/QtTest>
+#include <QDirIterator>
+#include <QElapsedTimer>
+
+#include "lexer.h"
+#include "tokens.h"
+#include "control.h"
+#include "parsesession.h"
+#include "rpp/chartools.h"
+
+#include "testconfig.h"
+
+#include <tests/autotestshell.h>
+#include <tests/testcore.h>
+
+QTEST_MAIN(TestLexer)
+
+using namespace KDevelop;
+
+// Set KDEV_LEXER_BENCHMARK_DIR to a directory of headers, e.g. /usr/include/c++,
+// to benchmark the lexer on the concatenation of a real-world header set.
+static const char* benchmarkDirVariable = "KDEV_LEXER_BENCHMARK_DIR";
+
+static void tokenize(ParseSession* session, const PreprocessedContents& contents, LexedContents* lexed = 0)
+{
+  Control control;
+  Lexer lexer(&control);
+  lexer.setLexedContents(lexed);
+  session->setContentsAndGenerateLocationTable(contents);
+  session->token_stream = new TokenStream(session);
+  lexer.tokenize(session);
+}
+
+void TestLexer::initTestCase()
+{
+  AutoTestShell::init();
+  TestCore::initialize(Core::NoUi);
+}
+
+void TestLexer::cleanupTestCase()
+{
+  TestCore::shutdown();
+}
+
+void TestLexer::testKeywords_data()
+{
+  QTest::addColumn<QByteArray>("code");
+  QTest::addColumn<int>("kind");
+
+  QTest::newRow("class") << QByteArray("class") << int(Token_class);
+  QTest::newRow("while") << QByteArray("while") << int(Token_while);
+  QTest::newRow("using") << QByteArray("using") << int(Token_using);
+  QTest::newRow("__typeof__") << QByteArray("__typeof__") << int(Token___typeof);
+  QTest::newRow("__asm__") << QByteArray("__asm__") << int(Token_asm);
+  QTest::newRow("reinterpret_cast") << QByteArray("reinterpret_cast") << int(Token_reinterpret_cast);
+  QTest::newRow("nullptr") << QByteArray("nullptr") << int(Token_nullptr);
+  QTest::newRow("__thread") << QByteArray("__thread") << int(Token_thread_local);
+  QTest::newRow("Q_OBJECT") << QByteArray("Q_OBJECT") << int(Token_Q_OBJECT);
+  QTest::newRow("identifier") << QByteArray("classes") << int(Token_identifier);
+  QTest::newRow("prefix") << QByteArray("whil") << int(Token_identifier);
+  QTest::newRow("case") << QByteArray("Class") << int(Token_identifier);
+}
+
+void TestLexer::testKeywords()
+{
+  QFETCH(QByteArray, code);
+  QFETCH(int, kind);
+
+  ParseSession session;
+  tokenize(&session, tokenizeFromByteArray(code));
+  // the first token is the artificial EOF, the last one the real EOF
+  QCOMPARE(session.token_stream->size(), 3);
+  QCOMPARE(int(session.token_stream->kind(1)), kind);
+  QCOMPARE(session.token_stream->symbolString(1), QString::fromUtf8(code));
+}
+
+void TestLexer::testIncremental_data()
+{
+  QTest::addColumn<QByteArray>("oldCode");
+  QTest::addColumn<QByteArray>("newCode");
+
+  const QByteArray code("// comment\n// merged comment\nclass A {\n  int foo(int a) { return a >> 2; }\n  /* member */ int m;\n};\n"
+                        "void bar() { A a; a.m += 5; const char* s = \"string\"; }\n");
+  QTest::newRow("unchanged") << code << code;
+  QTest::newRow("insert") << code << QByteArray(code).replace("return a", "return a + a");
+  QTest::newRow("remove") << code << QByteArray(code).replace("  /* member */ int m;\n", "");
+  QTest::newRow("change operator") << code << QByteArray(code).replace("a >> 2", "a >>= 2");
+  QTest::newRow("begin") << code << "int x;\n" + code;
+  QTest::newRow("end") << code << code + "int x;\n";
+  QTest::newRow("merge comment") << code << QByteArray(code).replace("class A", "// another comment\nclass A");
+  QTest::newRow("open comment") << code << QByteArray(code).replace("int foo", "/* int foo");
+  QTest::newRow("open string") << code << QByteArray(code).replace("s = \"", "s = \"\"\"");
+  QTest::newRow("empty") << code << QByteArray();
+}
+
+void TestLexer::testIncremental()
+{
+  QFETCH(QByteArray, oldCode);
+  QFETCH(QByteArray, newCode);
+
+  LexedContents lexed;
+  ParseSession oldSession;
+  tokenize(&oldSession, tokenizeFromByteArray(oldCode), &lexed);
+  QVERIFY(!lexed.isEmpty());
+
+  ParseSession incrementalSession;
+  tokenize(&incrementalSession, tokenizeFromByteArray(newCode), &lexed);
+
+  ParseSession session;
+  tokenize(&session, tokenizeFromByteArray(newCode));
+
+  const TokenStream* expected = session.token_stream;
+  const TokenStream* actual = incrementalSession.token_stream;
+  QCOMPARE(actual->size(), expected->size());
+  for (int i = 0; i < expected->size(); ++i) {
+    QCOMPARE(actual->kind(i), expected->kind(i));
+    QCOMPARE(actual->position(i), expected->position(i));
+    QCOMPARE(actual->tokenSize(i), expected->tokenSize(i));
+  }
+}
+
+void TestLexer::benchLexer_data()
+{
+  QTest::addColumn<QByteArray>("corpus");
+
+  const QByteArray dir = qgetenv(benchmarkDirVariable);
+  if (dir.isEmpty()) {
+    QFile file(TEST_FILE);
+    QVERIFY(file.open(QFile::ReadOnly));
+    QByteArray corpus;
+    const QByteArray contents = file.readAll();
+    for (int i = 0; i < 50; ++i) {
+      corpus += contents;
+    }
+    QTest::newRow("test_parser.cpp") << corpus;
+    return;
+  }
+
+  QByteArray corpus;
+  QDirIterator it(QString::fromLocal8Bit(dir), QDir::Files, QDirIterator::Subdirectories);
+  while (it.hasNext()) {
+    QFile file(it.next());
+    if (file.open(QFile::ReadOnly)) {
+      corpus += file.readAll();
+      corpus += '\n';
+    }
+  }
+  QTest::newRow(dir.constData()) << corpus;
+}
+
+void TestLexer::benchLexer()
+{
+  QFETCH(QByteArray, corpus);
+  const PreprocessedContents contents = tokenizeFromByteArray(corpus);
+
+  QElapsedTimer timer;
+  qint64 elapsed = 0;
+  int runs = 0;
+  QBENCHMARK {
+    ParseSession session;
+    timer.start();
+    tokenize(&session, contents);
+    elapsed += timer.elapsed();
+    ++runs;
+  }
+
+  if (elapsed) {
+    qDebug() << "lexed" << corpus.size() << "bytes with" << (double(corpus.size()) * runs / (1024 * 1024)) / (elapsed / 1000.0) << "MB/s";
+  }
+}
+
+void TestLexer::benchIncrementalLexer_data()
+{
+  benchLexer_data();
+}
+
+void TestLexer::benchIncrementalLexer()
+{
+  QFETCH(QByteArray, corpus);
+  const PreprocessedContents contents = tokenizeFromByteArray(corpus);
+
+  // Like a keystroke in the middle of the document
+  QByteArray edited = corpus;
+  edited.insert(edited.size() / 2, "\nint edited;\n");
+  const PreprocessedContents editedContents = tokenizeFromByteArray(edited);
+
+  LexedContents lexed;
+  {
+    ParseSession session;
+    tokenize(&session, contents, &lexed);
+  }
+
+  bool toggle = false;
+  QBENCHMARK {
+    ParseSession session;
+    tokenize(&session, toggle ? contents : editedContents, &lexed);
+    toggle = !toggle;
+  }
+}
+
+#include "test_lexer.moc"
@@ -0,0 +1,45 @@
+/* This file is part of KDevelop
+
+   Copyright 2014 KDevelop developers
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2 as published by the Free Software Foundation.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef TEST_LEXER_H
+#define TEST_LEXER_H
+
+#include <QObject>
+
+class TestLexer : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void initTestCase();
+  void cleanupTestCase();
+
+  void testKeywords_data();
+  void testKeywords();
+
+  void testIncremental_data();
+  void testIncremental();
+
+  void benchLexer_data();
+  void benchLexer();
+  void benchIncrementalLexer_data();
+  void benchIncrementalLexer();
+};
+
+#endif // TEST_LEXER_H
@@ -228,6 +228,76 @@ void TestParser::testParseMethod()
   QVERIFY(hasKind(ast, AST::Kind_FunctionDefinition));
 }
 
+void TestParser::testSkipFunctionBodies()
+{
+  QByteArray code("class A { int inlineBody() { return 1; } };\n"
+                  "int A::method(int a) { if (a) { for (;;) { } } return [](){ return 2; }(); }\n"
+                  "void A::other() try { } catch (...) { }\n"
+                  "int after;");
+  control = Control();
+  Parser parser(&control);
+  parser.setSkipFunctionBodies(true);
+  lastSession = new ParseSession();
+  rpp::Preprocessor preprocessor;
+  rpp::pp pp(&preprocessor);
+  lastSession->setContentsAndGenerateLocationTable(pp.processFile("anonymous", code));
+  TranslationUnitAST* ast = parser.parse(lastSession);
+
+  QVERIFY(ast);
+  QVERIFY(control.problems().isEmpty());
+  QCOMPARE(ast->declarations->count(), 4);
+  QVERIFY(hasKind(ast, AST::Kind_FunctionDefinition));
+  QVERIFY(hasKind(ast, AST::Kind_CompoundStatement));
+  //the contents of the bodies are skipped
+  QVERIFY(!hasKind(ast, AST::Kind_IfStatement));
+  QVERIFY(!hasKind(ast, AST::Kind_ReturnStatement));
+  QVERIFY(!hasKind(ast, AST::Kind_LambdaExpression));
+  //function-try-blocks are still parsed
+  QVERIFY(hasKind(ast, AST::Kind_TryBlockStatement));
+}
+
+void TestParser::testSkipFunctionBodiesProblems()
+{
+  QByteArray code("int f() { int a = ; return a; }\n"
+                  "int g() { return 1; }\n"
+                  "class B { int x int y; };\n");
+
+  //Without skipping, the syntax-errors in the body and in the class are reported
+  TranslationUnitAST* ast = parse(code);
+  QVERIFY(ast);
+  QList<int> lines;
+  foreach(const KDevelop::ProblemPointer& problem, control.problems())
+    lines << problem->finalLocation().start.line;
+  QVERIFY(lines.contains(0));
+  QVERIFY(lines.contains(2));
+
+  //The skipped bodies are only brace-matched, so errors within them are not reported, but all others are
+  control = Control();
+  Parser parser(&control);
+  parser.setSkipFunctionBodies(true);
+  lastSession = new ParseSession();
+  rpp::Preprocessor preprocessor;
+  rpp::pp pp(&preprocessor);
+  lastSession->setContentsAndGenerateLocationTable(pp.processFile("anonymous", code));
+  ast = parser.parse(lastSession);
+  QVERIFY(ast);
+  lines.clear();
+  foreach(const KDevelop::ProblemPointer& problem, control.problems())
+    lines << problem->finalLocation().start.line;
+  QVERIFY(!lines.contains(0));
+  QVERIFY(lines.contains(2));
+
+  //Unbalanced bodies are parsed normally, so their errors are reported
+  control = Control();
+  Parser unbalancedParser(&control);
+  unbalancedParser.setSkipFunctionBodies(true);
+  lastSession = new ParseSession();
+  lastSession->setContentsAndGenerateLocationTable(pp.processFile("anonymous", QByteArray("int f() { int a = ; {\n")));
+  ast = unbalancedParser.parse(lastSession);
+  QVERIFY(ast);
+  QVERIFY(!control.problems().isEmpty());
+}
+
 void TestParser::testForStatements()
 {
   QByteArray method("void TestParser::A::t() { for (int i = 0; i < 10; i++) { ; }}");
@@ -961,6 +1031,71 @@ void TestParser::testTernaryEmptyExpression()
   QVERIFY(ast);
 }
 
+///Generates a large translation unit with classes, templates and function bodies
+static QByteArray generatedUnit()
+{
+  QByteArray ret;
+  for (int i = 0; i < 2000; ++i) {
+    const QByteArray n = QByteArray::number(i);
+    ret += "template<typename T> struct Base" + n + " { T value; virtual ~Base" + n + "() {} };\n"
+           "class Class" + n + " : public Base" + n + "<int> {\n"
+           "public:\n"
+           "  int compute(int a, int b) const { if (a < b && value > 0) { return a * b + value; } return a >> 2; }\n"
+           "  Base" + n + "<Class" + n + "*>* next;\n"
+           "};\n"
+           "int function" + n + "(Class" + n + "& c) { for (int i = 0; i < 10; ++i) c.value += c.compute(i, " + n + "); return c.value; }\n";
+  }
+  return ret;
+}
+
+void TestParser::benchParse_data()
+{
+  QTest::addColumn<QByteArray>("contents");
+
+  QFile file(TEST_FILE);
+  QVERIFY(file.open(QFile::ReadOnly));
+  QTest::newRow("test_parser.cpp") << file.readAll();
+  QTest::newRow("generated") << generatedUnit();
+}
+
+void TestParser::benchParse()
+{
+  QFETCH(QByteArray, contents);
+
+  rpp::Preprocessor preprocessor;
+  rpp::pp pp(&preprocessor);
+  const PreprocessedContents preprocessed = pp.processFile("anonymous", contents);
+
+  QBENCHMARK {
+    Parser parser(&control);
+    ParseSession session;
+    session.setContentsAndGenerateLocationTable(preprocessed);
+    QVERIFY(parser.parse(&session));
+  }
+}
+
+void TestParser::benchTokenKinds_data()
+{
+  benchParse_data();
+}
+
+void TestParser::benchTokenKinds()
+{
+  QFETCH(QByteArray, contents);
+  QVERIFY(parse(contents));
+  const TokenStream* stream = lastSession->token_stream;
+
+  //Like the lookahead-loops of the parser, only the kinds are read
+  int matches = 0;
+  QBENCHMARK {
+    for (int i = 0; i < stream->size(); ++i) {
+      if (stream->kind(i) == Token_identifier || stream->kind(i) == '<')
+        ++matches;
+    }
+  }
+  QVERIFY(matches > 0);
+}
+
 TranslationUnitAST* TestParser::parse(const QByteArray &unit, CPPLanguageFeatures features)
 {
   control = Control(); // Clear the problems
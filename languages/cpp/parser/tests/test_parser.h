@@ -47,6 +47,8 @@ private slots:
   void testParserFail();
   void testPartialParseFail();
   void testParseMethod();
+  void testSkipFunctionBodies();
+  void testSkipFunctionBodiesProblems();
   void testForStatements();
   void testIfStatements();
 
@@ -139,6 +141,11 @@ private slots:
   void testReferenceBindings();
   //END C++2011 Support
 
+  void benchParse_data();
+  void benchParse();
+  void benchTokenKinds_data();
+  void benchTokenKinds();
+
 protected:
   /**
    * dump @p node and print problems of @c control
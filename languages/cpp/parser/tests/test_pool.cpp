@@ -89,6 +89,48 @@ void TestPool::testWastedMemoryDueToBlockAllocation()
     QCOMPARE(p2[0], 11);
 }
 
+void TestPool::testOversizedAllocation()
+{
+    MemoryPool pool;
+    int *small = pool.allocate<int>();
+    *small = 10;
+    const int count = MemoryPool::BLOCK_SIZE / sizeof(int) * 3;
+    int *p = pool.allocate<int>(count);
+    //oversized memory is zeroed like the blocks
+    QCOMPARE(p[0], 0);
+    QCOMPARE(p[count - 1], 0);
+    p[count - 1] = 11;
+    QCOMPARE(pool.size(), sizeof(int) + count * sizeof(int));
+    //the current block is still used for small allocations
+    int *small2 = pool.allocate<int>();
+    QCOMPARE(small2, small + 1);
+    QCOMPARE(*small, 10);
+    QCOMPARE(p[count - 1], 11);
+}
+
+void TestPool::testStatistics()
+{
+    const MemoryPool::Statistics before = MemoryPool::statistics();
+    {
+        MemoryPool pool;
+        pool.allocate<char>(MemoryPool::BLOCK_SIZE);
+        pool.allocate<char>(MemoryPool::BLOCK_SIZE);
+        pool.allocate<char>(MemoryPool::BLOCK_SIZE + 1);
+
+        const MemoryPool::Statistics during = MemoryPool::statistics();
+        QCOMPARE(during.liveBlocks, before.liveBlocks + 2);
+        QCOMPARE(during.oversizedAllocations, before.oversizedAllocations + 1);
+        QCOMPARE(during.bytesAllocated, before.bytesAllocated + 3 * MemoryPool::BLOCK_SIZE + 1);
+    }
+    const MemoryPool::Statistics after = MemoryPool::statistics();
+    QCOMPARE(after.liveBlocks, before.liveBlocks);
+    QCOMPARE(after.oversizedAllocations, before.oversizedAllocations);
+    QCOMPARE(after.bytesAllocated, before.bytesAllocated);
+    //the blocks of small pools are cached for the next pool of this thread
+    QVERIFY(after.cachedBlocks >= 2);
+    QVERIFY(after.highWaterMark >= quint64(3 * MemoryPool::BLOCK_SIZE + 1));
+}
+
 void TestPool::benchManyAllocations()
 {
   MemoryPool pool;
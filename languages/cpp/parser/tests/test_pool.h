@@ -27,6 +27,9 @@ private slots:
 
     void testWastedMemoryDueToBlockAllocation();
 
+    void testOversizedAllocation();
+    void testStatistics();
+
     void benchManyPools();
     void benchManyAllocations();
 };
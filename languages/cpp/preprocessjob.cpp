@@ -52,8 +52,11 @@
 #include "parser/rpp/pp-engine.h"
 #include "parser/rpp/pp-macro.h"
 #include "parser/rpp/preprocessor.h"
+#include "parser/rpp/chartools.h"
 #include "environmentmanager.h"
 #include "cpppreprocessenvironment.h"
+#include "preprocessedcontentscache.h"
+#include "includesymbolindex.h"
 
 #include "cppdebughelper.h"
 #include "codegen/unresolvedincludeassistant.h"
@@ -79,6 +82,10 @@ PreprocessJob::PreprocessJob(CPPParseJob * parent)
     , m_firstEnvironmentFile( new Cpp::EnvironmentFile( parent->document(), 0 ) )
     , m_success(true)
     , m_headerSectionEnded(false)
+    , m_hadIncludes(false)
+    , m_cacheable(true)
+    , m_headerSectionBranchingHash(0)
+    , m_createHeaderSectionSnapshot(false)
     , m_pp(0)
 {
 }
@@ -246,9 +253,61 @@ void PreprocessJob::run()
             sourceNeeded(include, IncludeLocal, -1, false);
         }
     }
-    PreprocessedContents result = preprocessor.processFile(parentJob()->document().str(), m_contents);
 
-    if(Cpp::EnvironmentManager::self()->matchingLevel() <= Cpp::EnvironmentManager::Naive && !m_headerSectionEnded && !m_firstEnvironmentFile->headerGuard().isEmpty()) {
+    //Files included through the include-paths are processed every time, so they are not part of the cached contents
+    const int autoIncludedFiles = parentJob()->includedFiles().size();
+    const QList<IndexedString>& includePaths = parentJob()->masterJob()->indexedIncludePaths();
+
+    PreprocessedContents result;
+    rpp::LocationTable* cachedLocationTable = 0;
+
+    if(updatingEnvironmentFile) {
+      const Path::List& includePathUrls = parentJob()->includePathUrls();
+      KDevelop::DUChainReadLocker readLock(KDevelop::DUChain::lock());
+      Cpp::EnvironmentFilePointer cachedEnvironmentFile(dynamic_cast<Cpp::EnvironmentFile*>(updatingEnvironmentFile.data()));
+      IncludeFileList cachedIncludedFiles;
+      if(cachedEnvironmentFile) {
+        //The environment-file must not be restricted to the identity of the proxy-context while matching its macros
+        const bool hadRestriction = m_currentEnvironment->identityOffsetRestrictionEnabled();
+        const uint restriction = m_currentEnvironment->identityOffsetRestriction();
+        m_currentEnvironment->disableIdentityOffsetRestriction();
+        cachedLocationTable = Cpp::PreprocessedContentsCache::self().load(parentJob()->document(), *cachedEnvironmentFile,
+                                                                          *m_currentEnvironment, includePaths, m_contents, result,
+                                                                          cachedIncludedFiles, m_headerSectionBranchingHash);
+        if(hadRestriction)
+          m_currentEnvironment->setIdentityOffsetRestriction(restriction);
+      }
+      if(cachedLocationTable && !includedFilesUpToDate(cachedIncludedFiles, includePathUrls)) {
+        ifDebug( kDebug(9007) << "cached preprocessed contents are outdated for" << parentJob()->document().str(); )
+        delete cachedLocationTable;
+        cachedLocationTable = 0;
+        result.clear();
+      }
+      if(cachedLocationTable) {
+        kDebug(9007) << "PreprocessJob: took preprocessed contents from the cache for" << parentJob()->document().str()
+                     << "with" << cachedIncludedFiles.size() << "included files";
+        //Reproduce the side-effects preprocessing would have had on the environment and the imports
+        foreach(const LineContextPair& included, cachedIncludedFiles)
+          parentJob()->addIncludedFile(included.context, included.sourceLine);
+        m_currentEnvironment->merge(cachedEnvironmentFile.data(), true);
+        m_firstEnvironmentFile->setHeaderGuard(cachedEnvironmentFile->headerGuard());
+        m_firstEnvironmentFile->setContentStartLine(cachedEnvironmentFile->contentStartLine());
+        if(m_secondEnvironmentFile)
+          m_secondEnvironmentFile->setContentStartLine(cachedEnvironmentFile->contentStartLine());
+      }
+    }
+
+    if(!cachedLocationTable) {
+      //Snapshots of the header-section are only used for top-level files, since included files are usually
+      //processed only once, and they only work with simplified matching, where header- and content-section are separated.
+      m_createHeaderSectionSnapshot = m_secondEnvironmentFile && !parentJob()->parentPreprocessor() && !m_hadIncludes;
+      if(m_createHeaderSectionSnapshot)
+        result = preprocessor.processFile(parentJob()->document().str(), useHeaderSectionSnapshot());
+      else
+        result = preprocessor.processFile(parentJob()->document().str(), m_contents);
+    }
+
+    if(!cachedLocationTable && Cpp::EnvironmentManager::self()->matchingLevel() <= Cpp::EnvironmentManager::Naive && !m_headerSectionEnded && !m_firstEnvironmentFile->headerGuard().isEmpty()) {
       if(macroNamesAtBeginning.contains(m_firstEnvironmentFile->headerGuard())) {
         //Remove the header-guard, and re-preprocess, since we don't do real environment-management(We don't allow empty versions)
         // We also have to clear the location-table here, because it already contains 'wrong' contents from the previous preprocessing
@@ -261,8 +320,19 @@ void PreprocessJob::run()
     
     if(!m_headerSectionEnded) {
       ifDebug( kDebug(9007) << parentJob()->document().str() << ": header-section was not ended"; )
+      if(!cachedLocationTable)
+        m_headerSectionBranchingHash = preprocessor.branchingHash();
       headerSectionEndedInternal(0);
     }
+
+    if(cachedLocationTable && m_secondEnvironmentFile) {
+      //The content-part was not recorded separately, so take it over from the content-context we have cached
+      KDevelop::DUChainReadLocker readLock(KDevelop::DUChain::lock());
+      KDevelop::TopDUContext* content = DUChainUtils::contentContextFromProxyContext(updatingEnvironmentFile->topContext());
+      Cpp::EnvironmentFile* contentEnvironmentFile = content ? dynamic_cast<Cpp::EnvironmentFile*>(content->parsingEnvironmentFile().data()) : 0;
+      if(contentEnvironmentFile && contentEnvironmentFile != m_secondEnvironmentFile.data())
+        m_secondEnvironmentFile->merge(*contentEnvironmentFile);
+    }
     
     m_currentEnvironment->finishEnvironment(m_currentEnvironment->environmentFile() == m_updatingEnvironmentFile);
     
@@ -271,7 +341,8 @@ void PreprocessJob::run()
       parentJob()->addPreprocessorProblem(p);
     }
 
-    parentJob()->parseSession()->setContents( result, m_currentEnvironment->takeLocationTable() );
+    rpp::LocationTable* locationTable = cachedLocationTable ? cachedLocationTable : m_currentEnvironment->takeLocationTable();
+    parentJob()->parseSession()->setContents( result, locationTable );
     parentJob()->parseSession()->setUrl( parentJob()->document() );
 
     
@@ -295,6 +366,19 @@ void PreprocessJob::run()
         m_firstEnvironmentFile->merge(*m_secondEnvironmentFile);
         parentJob()->setContentEnvironmentFile(m_secondEnvironmentFile.data());
     }
+
+    //Only complete results are cached, not the ones truncated behind the header-section or with a blanked out
+    //header-section. Files with missing or delayed includes are not cached, since their output is incomplete.
+    if(m_cacheable && !cachedLocationTable && !m_headerSectionSnapshot && !parentJob()->keepDuchain()
+       && preprocessor.problems().isEmpty())
+    {
+      KDevelop::DUChainReadLocker readLock(KDevelop::DUChain::lock());
+      if(m_firstEnvironmentFile->missingIncludeFiles().isEmpty()) {
+        Cpp::PreprocessedContentsCache::self().store(parentJob()->document(), *m_firstEnvironmentFile, includePaths, m_contents,
+                                                     result, *locationTable, parentJob()->includedFiles().mid(autoIncludedFiles),
+                                                     m_headerSectionBranchingHash);
+      }
+    }
     
     if( PreprocessJob* parentPreprocessor = parentJob()->parentPreprocessor() ) {
         //If we are included from another preprocessor, give it back the modified macros,
@@ -324,10 +408,13 @@ void PreprocessJob::headerSectionEndedInternal(rpp::Stream* stream)
     bool closeStream = false;
     m_headerSectionEnded = true;
 
-    ifDebug( kDebug(9007) << parentJob()->document().str() << "PreprocessJob::headerSectionEnded, " << parentJob()->includedFiles().count() << " included in header-section" << "upcoming identity-offset:" << m_pp->branchingHash()*19; )
+    if( stream )
+      m_headerSectionBranchingHash = m_pp->branchingHash();
+
+    ifDebug( kDebug(9007) << parentJob()->document().str() << "PreprocessJob::headerSectionEnded, " << parentJob()->includedFiles().count() << " included in header-section" << "upcoming identity-offset:" << m_headerSectionBranchingHash*19; )
     
     if( m_secondEnvironmentFile ) {
-        m_secondEnvironmentFile->setIdentityOffset(m_pp->branchingHash()*19);
+        m_secondEnvironmentFile->setIdentityOffset(m_headerSectionBranchingHash*19);
 
         if( stream ) {
           m_secondEnvironmentFile->setContentStartLine(stream->originalInputPosition().line);
@@ -401,6 +488,9 @@ void PreprocessJob::headerSectionEndedInternal(rpp::Stream* stream)
 
         m_currentEnvironment->finishEnvironment();
 
+        if( stream && m_createHeaderSectionSnapshot )
+          createHeaderSectionSnapshot(*stream);
+
         m_currentEnvironment->setEnvironmentFile(m_secondEnvironmentFile);
     }
 
@@ -410,9 +500,111 @@ void PreprocessJob::headerSectionEndedInternal(rpp::Stream* stream)
     }
 }
 
+QByteArray PreprocessJob::useHeaderSectionSnapshot()
+{
+    const IndexedString localPath(parentJob()->localPath().pathOrUrl());
+    const QList<IndexedString>& includePaths = parentJob()->masterJob()->indexedIncludePaths();
+    const Path::List& includePathUrls = parentJob()->includePathUrls();
+    const TopDUContext::Features slaveMinimumFeatures = parentJob()->slaveMinimumFeatures();
+
+    CppLanguageSupport* cpp = parentJob()->cpp();
+    if(!cpp || parentJob()->masterJob()->needUpdateEverything() || (slaveMinimumFeatures & TopDUContext::ForceUpdate))
+      return m_contents;
+
+    KDevelop::DUChainReadLocker readLock(KDevelop::DUChain::lock());
+
+    //The macros that affected the header-section must be the same as back then, also when the matching-level ignores them
+    const bool hadRestriction = m_currentEnvironment->identityOffsetRestrictionEnabled();
+    const uint restriction = m_currentEnvironment->identityOffsetRestriction();
+    m_currentEnvironment->disableIdentityOffsetRestriction();
+    IncludeFileList includedFiles;
+    HeaderSectionSnapshotPointer snapshot = cpp->headerSectionCache()->find(localPath, includePaths, m_contents,
+                                                                           *m_currentEnvironment, includedFiles);
+    if(hadRestriction)
+      m_currentEnvironment->setIdentityOffsetRestriction(restriction);
+    if(!snapshot)
+      return m_contents;
+
+    //All included files must still be up to date
+    if(!includedFilesUpToDate(includedFiles, includePathUrls)) {
+      ifDebug( kDebug(9007) << "header-section snapshot is outdated for" << parentJob()->document().str(); )
+      cpp->headerSectionCache()->remove(snapshot);
+      return m_contents;
+    }
+
+    kDebug(9007) << "PreprocessJob: using header-section snapshot for" << parentJob()->document().str()
+                 << "with" << includedFiles.size() << "included files";
+
+    foreach(const LineContextPair& included, includedFiles)
+      parentJob()->addIncludedFile(included.context, included.sourceLine);
+    m_currentEnvironment->merge(snapshot->environmentFile.data(), true);
+
+    m_headerSectionSnapshot = snapshot;
+    m_createHeaderSectionSnapshot = false;
+    //The included files were not processed through sourceNeeded(..), but they are there
+    m_hadIncludes = true;
+
+    //Blank out the header-section, but keep its lines so the positions in the content-section stay the same
+    QByteArray contents = m_contents;
+    for(int a = 0; a < snapshot->headerText.size(); ++a) {
+      if(contents[a] != '\n')
+        contents[a] = ' ';
+    }
+    return contents;
+}
+
+void PreprocessJob::createHeaderSectionSnapshot(rpp::Stream& stream)
+{
+    CppLanguageSupport* cpp = parentJob()->cpp();
+    if(!cpp || !cpp->headerSectionCache()->isEnabled())
+      return;
+
+    //Conditions that are still open would be lost when the header-section is blanked out
+    if(m_headerSectionBranchingHash != 0 || m_pp->problems().size() || parentJob()->includedFiles().isEmpty()
+       || !m_firstEnvironmentFile->missingIncludeFiles().isEmpty())
+    {
+      return;
+    }
+
+    //Find the offset of the first significant content in the original text
+    const KDevelop::CursorInRevision position = stream.originalInputPosition();
+    int offset = 0;
+    for(int line = 0; line < position.line; ++line) {
+      offset = m_contents.indexOf('\n', offset);
+      if(offset == -1)
+        return;
+      ++offset;
+    }
+    //The content-section must start behind whitespace only, else the header-section could end within a comment
+    for(int column = 0; column < position.column; ++column, ++offset) {
+      if(offset >= m_contents.size() || !isSpace(m_contents[offset]))
+        return;
+    }
+
+    HeaderSectionSnapshotPointer snapshot(new HeaderSectionSnapshot);
+    snapshot->headerText = m_contents.left(offset);
+    snapshot->localPath = IndexedString(parentJob()->localPath().pathOrUrl());
+    snapshot->includePaths = parentJob()->masterJob()->indexedIncludePaths();
+    snapshot->environmentFile = new Cpp::EnvironmentFile(parentJob()->document(), 0);
+    snapshot->environmentFile->merge(*m_firstEnvironmentFile);
+    foreach(const LineContextPair& included, parentJob()->includedFiles()) {
+      if(!included.context || !included.context->parsingEnvironmentFile())
+        return;
+      HeaderSectionSnapshot::Include include;
+      include.context = KDevelop::IndexedTopDUContext(included.context.data());
+      include.url = included.context->url();
+      include.revision = included.context->parsingEnvironmentFile()->modificationRevision();
+      include.sourceLine = included.sourceLine;
+      snapshot->includedFiles << include;
+    }
+
+    cpp->headerSectionCache()->insert(snapshot);
+}
+
 rpp::Stream* PreprocessJob::sourceNeeded(QString& _fileName, IncludeType type, int sourceLine, bool skipCurrentPath)
 {
     Q_UNUSED(type)
+    m_hadIncludes = true;
     if(0){
       uint currentDepth = 0;
       CPPParseJob* job = parentJob();
@@ -488,6 +680,7 @@ rpp::Stream* PreprocessJob::sourceNeeded(QString& _fileName, IncludeType type, i
                 job = job->parentPreprocessor()->parentJob();
                 if(job->document() == indexedFile) {
                   parentJob()->addDelayedImport(CPPParseJob::LineJobPair(job, sourceLine));
+                  m_cacheable = false;
                   return 0;
                 }
               }
@@ -648,11 +841,32 @@ bool PreprocessJob::checkAbort()
     return false;
 }
 
+bool PreprocessJob::includedFilesUpToDate(const IncludeFileList& includedFiles, const Path::List& includePathUrls) const
+{
+  const TopDUContext::Features slaveMinimumFeatures = parentJob()->slaveMinimumFeatures();
+
+  foreach(const LineContextPair& included, includedFiles) {
+    Cpp::EnvironmentFilePointer includedEnvironment;
+    if(included.context)
+      includedEnvironment = dynamic_cast<Cpp::EnvironmentFile*>(included.context->parsingEnvironmentFile().data());
+    if(!includedEnvironment || CppUtils::needsUpdate(includedEnvironment, parentJob()->localPath(), includePathUrls)
+       || !includedEnvironment->featuresSatisfied(slaveMinimumFeatures)
+       || ((slaveMinimumFeatures & TopDUContext::ForceUpdate) && !parentJob()->masterJob()->wasUpdated(included.context.data())))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
 bool PreprocessJob::readContents()
 {
   KDevelop::ProblemPointer p = parentJob()->readContents();
   if(p)
   {
+    //The file was removed or can't be read any more
+    Cpp::PreprocessedContentsCache::self().remove(parentJob()->document());
+    Cpp::IncludeSymbolIndex::self().remove(parentJob()->document());
     parentJob()->addPreprocessorProblem(p);
     return false;
   }
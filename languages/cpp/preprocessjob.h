@@ -26,7 +26,10 @@
 #include <ksharedptr.h>
 #include <threadweaver/Job.h>
 
+#include <util/path.h>
+
 #include "parser/rpp/preprocessor.h"
+#include "headersectioncache.h"
 
 namespace Cpp {
     class EnvironmentFile;
@@ -86,6 +89,13 @@ public:
     static const KDevelop::ParsingEnvironment* standardEnvironment();
 private:
     void headerSectionEndedInternal(rpp::Stream* stream);
+    ///Finds a snapshot of the header-section that can be used for this file, and imports its includes and macros
+    ///@return the contents that still need to be preprocessed, with the header-section blanked out
+    QByteArray useHeaderSectionSnapshot();
+    ///Creates a snapshot of the header-section that ends at the given stream position, if possible
+    void createHeaderSectionSnapshot(rpp::Stream& stream);
+    ///Whether the given included files can be imported as they are, without updating them
+    bool includedFilesUpToDate(const IncludeFileList& includedFiles, const KDevelop::Path::List& includePathUrls) const;
     bool checkAbort();
     bool readContents();
 
@@ -97,6 +107,16 @@ private:
     KSharedPtr<Cpp::EnvironmentFile> m_updatingEnvironmentFile;
     bool m_success;
     bool m_headerSectionEnded;
+    //Whether sourceNeeded(..) was called
+    bool m_hadIncludes;
+    //Whether the result may be put into the PreprocessedContentsCache
+    bool m_cacheable;
+    //The branching-hash of the preprocessor at the point where the header-section ended
+    uint m_headerSectionBranchingHash;
+    //Whether a snapshot of the header-section may be created for this file
+    bool m_createHeaderSectionSnapshot;
+    //The snapshot of the header-section that was used, if any
+    HeaderSectionSnapshotPointer m_headerSectionSnapshot;
     rpp::pp* m_pp;
     QByteArray m_contents;
 
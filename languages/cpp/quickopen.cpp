@@ -24,6 +24,7 @@
 #include <QDir>
 #include <QIcon>
 #include <QSet>
+#include <QVector>
 
 #include <klocale.h>
 #include <kiconloader.h>
@@ -58,13 +59,21 @@ TopDUContextPointer getCurrentTopDUContext() {
 
 void collectImporters( QSet<IndexedString>& importers, DUContext* ctx )
 {
-  if( importers.contains( ctx->url() ) )
-    return;
-  
-  importers.insert( ctx->url() );
-
-  foreach( DUContext* ctx, ctx->importers() )
-    collectImporters( importers, ctx );
+  //Walks the importers with a work-list, as include-graphs can be too deep for recursion
+  QVector<DUContext*> pending;
+  pending << ctx;
+  while( !pending.isEmpty() ) {
+    DUContext* current = pending.back();
+    pending.pop_back();
+    if( importers.contains( current->url() ) )
+      continue;
+
+    importers.insert( current->url() );
+
+    foreach( DUContext* importer, current->importers() )
+      if( !importers.contains( importer->url() ) )
+        pending << importer;
+  }
 }
 
 IncludeFileData::IncludeFileData( const IncludeItem& item, const TopDUContextPointer& includedFrom ) : m_item(item), m_includedFrom(includedFrom) {
@@ -192,7 +192,7 @@ private:
         } else {
           qout << "token stream:" << endl;
           for(int i = 0; i < m_session.token_stream->count(); ++i) {
-            const Token& t = m_session.token_stream->at(i);
+            const Token t = m_session.token_stream->token(i);
             const QString str = m_session.token_stream->symbolString(t);
             Q_ASSERT(t.size || str.isEmpty());
             qout << token_name(t.kind) << ": " << str << endl;
@@ -221,6 +221,11 @@ private:
 
       qout << "contents vector size: " << m_session.contentsVector().size() << endl;
       qout << "mempool size: " << m_session.mempool->size() << endl;
+      qout << "mempool blocks: " << m_session.mempool->blockCount() << endl;
+      const MemoryPool::Statistics stats = MemoryPool::statistics();
+      qout << "all mempools: " << stats.bytesAllocated << " bytes allocated, "
+           << stats.liveBlocks << " live blocks, " << stats.cachedBlocks << " cached blocks, "
+           << stats.oversizedAllocations << " oversized allocations" << endl;
       MemSizeVisitor visitor;
       if (ast) {
         visitor.visit(ast);
@@ -49,6 +49,8 @@
 #include "codecompletion/helpers.h"
 #include "codecompletion/item.h"
 #include "codecompletion/implementationhelperitem.h"
+#include "codecompletion/lookaheadindex.h"
+#include "typeconversion.h"
 #include "cpppreprocessenvironment.h"
 #include <language/duchain/classdeclaration.h>
 #include "cppduchain/missingdeclarationproblem.h"
@@ -2062,6 +2064,74 @@ void TestCppCodeCompletion::testUnnamedNamespace() {
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+///Records the phases reported by a completion-context
+struct CompletionStageRecorder : public Cpp::CodeCompletionContext::StageListener {
+  CompletionStageRecorder() : abortAfter(-1), abort(0) {
+  }
+  virtual void phaseFinished(Cpp::CodeCompletionContext::CompletionPhase phase, qint64 /*elapsedMilliseconds*/,
+                             const QList<CompletionTreeItemPointer>& items, Cpp::CodeCompletionContext* /*context*/) {
+    phases << phase;
+    QStringList names;
+    foreach(const CompletionTreeItemPointer& item, items)
+      if(item->declaration())
+        names << item->declaration()->identifier().toString();
+    itemNames << names;
+    if(abort && phase == abortAfter)
+      *abort = true;
+  }
+  QList<int> phases;
+  QList<QStringList> itemNames;
+  int abortAfter;
+  bool* abort;
+};
+
+void TestCppCodeCompletion::testCompletionStages() {
+  TEST_FILE_PARSE_ONLY
+
+  QByteArray method("int globalVar; void globalFun(); int test(int param) { int localVar; }");
+  TopDUContext* top = parse(method, DumpNone);
+
+  DUChainWriteLocker lock(DUChain::lock());
+  DUContext* body = top->childContexts().last();
+  QCOMPARE(body->localDeclarations().size(), 1);
+
+  {
+    Cpp::CodeCompletionContext::Ptr cptr( new Cpp::CodeCompletionContext(DUContextPointer(body), "; ", QString(), body->range().end) );
+    QVERIFY(cptr->isValid());
+    CompletionStageRecorder recorder;
+    cptr->setStageListener(&recorder);
+    bool abort = false;
+    QList<CompletionTreeItemPointer> items = cptr->completionItems(abort);
+
+    QList<int> expected;
+    expected << Cpp::CodeCompletionContext::LocalItemsPhase << Cpp::CodeCompletionContext::GlobalItemsPhase
+             << Cpp::CodeCompletionContext::LookaheadPhase << Cpp::CodeCompletionContext::MissingIncludePhase
+             << Cpp::CodeCompletionContext::HelperItemsPhase;
+    QCOMPARE(recorder.phases, expected);
+
+    //The local items are shown first, without the global ones
+    QVERIFY(recorder.itemNames[0].contains("localVar"));
+    QVERIFY(!recorder.itemNames[0].contains("globalVar"));
+    QVERIFY(recorder.itemNames[1].contains("localVar"));
+    QVERIFY(recorder.itemNames[1].contains("globalVar"));
+    QVERIFY(recorder.itemNames[1].contains("globalFun"));
+    QCOMPARE(recorder.itemNames.last().size(), items.size());
+  }
+  {
+    //Aborting within a phase stops the computation
+    Cpp::CodeCompletionContext::Ptr cptr( new Cpp::CodeCompletionContext(DUContextPointer(body), "; ", QString(), body->range().end) );
+    CompletionStageRecorder recorder;
+    cptr->setStageListener(&recorder);
+    bool abort = false;
+    recorder.abort = &abort;
+    recorder.abortAfter = Cpp::CodeCompletionContext::LocalItemsPhase;
+    cptr->completionItems(abort);
+    QCOMPARE(recorder.phases, QList<int>() << Cpp::CodeCompletionContext::LocalItemsPhase);
+  }
+
+  release(top);
+}
+
 void TestCppCodeCompletion::testCompletionContext() {
   TEST_FILE_PARSE_ONLY
 
@@ -3796,6 +3866,46 @@ void TestCppCodeCompletion::testLookaheadMatches()
   release(top);
 }
 
+void TestCppCodeCompletion::testLookaheadIndex()
+{
+  QByteArray test = "struct One { enum E { A }; int a; int b; float c; typedef int myInt; void set(int); One* operator->() const; };";
+  TopDUContext* top = parse(test, DumpNone);
+  DUChainWriteLocker lock(DUChain::lock());
+  Declaration* one = top->localDeclarations()[0];
+  QVERIFY(one->internalContext());
+
+  Cpp::LookaheadIndex::self().clear();
+  Cpp::LookaheadIndex::MembersPointer members = Cpp::LookaheadIndex::self().members(one, top);
+  QCOMPARE(Cpp::LookaheadIndex::self().statistics().builds, 1u);
+
+  //The members are grouped by their effective type, the enumeration and typedef are skipped
+  QCOMPARE(members->byType.size(), 4);
+  QList<Declaration*> a = one->internalContext()->findLocalDeclarations(Identifier("a"));
+  QCOMPARE(a.size(), 1);
+  QCOMPARE(members->byType.value(a[0]->indexedType()).size(), 2);
+  QVERIFY(members->arrowOperator.data());
+  QCOMPARE(members->arrowOperator.data()->identifier().toString(), QString("operator->"));
+
+  //The second lookup is answered from the index
+  QCOMPARE(Cpp::LookaheadIndex::self().members(one, top), members);
+  QCOMPARE(Cpp::LookaheadIndex::self().statistics().hits, 1u);
+
+  //A new generation makes the index rebuild the entry
+  Cpp::TypeConversionCache::self().increaseGeneration();
+  QVERIFY(Cpp::LookaheadIndex::self().members(one, top) != members);
+  Cpp::LookaheadIndex::Statistics statistics = Cpp::LookaheadIndex::self().statistics();
+  QCOMPARE(statistics.builds, 2u);
+  QCOMPARE(statistics.entries, 1u);
+
+  //The members are indexed separately for every top-context they are seen from
+  Cpp::LookaheadIndex::self().members(one, 0);
+  statistics = Cpp::LookaheadIndex::self().statistics();
+  QCOMPARE(statistics.builds, 3u);
+  QCOMPARE(statistics.entries, 2u);
+
+  release(top);
+}
+
 void TestCppCodeCompletion::testMemberAccessInstance()
 {
   QByteArray test = "struct foo{}; int main() {}";
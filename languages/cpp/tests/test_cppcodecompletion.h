@@ -89,6 +89,7 @@ private slots:
   void testCompletionContext();
   void testPrivateVariableCompletion();
   void testUnnamedNamespace();
+  void testCompletionStages();
   void testIndirectImports();
   void testSameNamespace();
   void testUpdateChain();
@@ -157,6 +158,7 @@ private slots:
   void testNoQuadrupleColon();
   void testLookaheadMatches_data();
   void testLookaheadMatches();
+  void testLookaheadIndex();
   void testMemberAccessInstance();
   void testNestedInlineNamespace();
   void testDuplicatedNamespace();
@@ -32,7 +32,13 @@
 #include <tests/json/jsonducontexttests.h>
 #include <tests/json/jsontypetests.h>
 #include <interfaces/ilanguagecontroller.h>
+#include <interfaces/ilanguage.h>
+#include <language/interfaces/ilanguagesupport.h>
+#include <QFileInfo>
+#include <QSignalSpy>
+#include <QTemporaryFile>
 #include "cppjsontests.h"
+#include "includegraphscheduler.h"
 
 using namespace KDevelop;
 using namespace Cpp;
@@ -97,4 +103,138 @@ void TestCppFiles::testFiles()
   QVERIFY(validator.testsPassed());
 }
 
+void TestCppFiles::benchReparse_data()
+{
+  testFiles_data();
+}
+
+void TestCppFiles::benchReparse()
+{
+  QFETCH(QString, fileName);
+  IndexedString indexedFileName = IndexedString(fileName);
+  QVERIFY(DUChain::self()->waitForUpdate(indexedFileName, KDevelop::TopDUContext::AllDeclarationsContextsAndUses));
+  //Like after an edit, only the file itself is updated, while its includes are taken from the DUChain
+  QBENCHMARK {
+    ReferencedTopDUContext top = DUChain::self()->waitForUpdate(indexedFileName,
+        TopDUContext::Features(KDevelop::TopDUContext::AllDeclarationsContextsAndUses | TopDUContext::ForceUpdate));
+    QVERIFY(top);
+  }
+}
+
+void TestCppFiles::benchSharedHeaderSection_data()
+{
+  QTest::addColumn<QString>("fileName");
+  QTest::addColumn<bool>("snapshots");
+  const QString testDirPath = CPP_TEST_FILES_DIR;
+  foreach (const QString& file, QDir(testDirPath).entryList(QStringList() << "*.cpp", QDir::Files)) {
+    QTest::newRow(QString(file + " without snapshots").toUtf8()) << QString(testDirPath + "/" + file) << false;
+    QTest::newRow(QString(file + " with snapshots").toUtf8()) << QString(testDirPath + "/" + file) << true;
+  }
+}
+
+void TestCppFiles::benchSharedHeaderSection()
+{
+  QFETCH(QString, fileName);
+  QFETCH(bool, snapshots);
+  QFile file(fileName);
+  QVERIFY(file.open(QIODevice::ReadOnly));
+  const QByteArray contents = file.readAll();
+
+  //Compares the parse-time with and without header-section snapshots in one run
+  QObject* cpp = dynamic_cast<QObject*>(Core::self()->languageController()->language("C++")->languageSupport());
+  QVERIFY(cpp);
+  QVERIFY(QMetaObject::invokeMethod(cpp, "setHeaderSectionSnapshotsEnabled", Q_ARG(bool, snapshots)));
+
+  //Like new translation-units of the same project, every run parses a new file in the same directory
+  //that starts with the same header-section
+  QBENCHMARK {
+    QTemporaryFile copy(QFileInfo(fileName).path() + "/benchXXXXXX.cpp");
+    QVERIFY(copy.open());
+    copy.write(contents);
+    copy.flush();
+    QVERIFY(DUChain::self()->waitForUpdate(IndexedString(copy.fileName()), KDevelop::TopDUContext::AllDeclarationsContextsAndUses));
+  }
+
+  QMetaObject::invokeMethod(cpp, "setHeaderSectionSnapshotsEnabled", Q_ARG(bool, true));
+}
+
+void TestCppFiles::benchParseThreads_data()
+{
+  QTest::addColumn<int>("threads");
+  QTest::addColumn<bool>("prioritized");
+  QTest::newRow("1 thread") << 1 << false;
+  QTest::newRow("2 threads") << 2 << false;
+  QTest::newRow("4 threads") << 4 << false;
+  QTest::newRow("8 threads") << 8 << false;
+  QTest::newRow("1 thread, prioritized") << 1 << true;
+  QTest::newRow("2 threads, prioritized") << 2 << true;
+  QTest::newRow("4 threads, prioritized") << 4 << true;
+  QTest::newRow("8 threads, prioritized") << 8 << true;
+}
+
+void TestCppFiles::benchParseThreads()
+{
+  QFETCH(int, threads);
+  QFETCH(bool, prioritized);
+  const QString testDirPath = CPP_TEST_FILES_DIR;
+  QList<IndexedString> files;
+  foreach (const QString& file, QDir(testDirPath).entryList(QStringList() << "*.cpp" << "*.h", QDir::Files)) {
+    files << IndexedString(testDirPath + "/" + file);
+  }
+
+  //The include-graph is only known once the files were parsed
+  foreach (const IndexedString& file, files) {
+    QVERIFY(DUChain::self()->waitForUpdate(file, TopDUContext::VisibleDeclarationsAndContexts));
+  }
+
+  BackgroundParser* parser = Core::self()->languageController()->backgroundParser();
+  const int oldThreadCount = parser->threadCount();
+  parser->setThreadCount(threads);
+  IncludeGraphScheduler scheduler;
+
+  //Headers are queued too, so the include-graph decides how much the parse-threads can work in parallel
+  QBENCHMARK_ONCE {
+    parser->suspend();
+    foreach (const IndexedString& file, files) {
+      parser->addDocument(file, TopDUContext::Features(TopDUContext::VisibleDeclarationsAndContexts | TopDUContext::ForceUpdate));
+    }
+    if (prioritized) {
+      //Like when a project is opened, the files are parsed in the order of their include-graph
+      QSignalSpy spy(&scheduler, SIGNAL(prioritized()));
+      scheduler.prioritize(files.toSet());
+      QVERIFY(!spy.isEmpty() || QTest::kWaitForSignal(&scheduler, SIGNAL(prioritized()), 10000));
+    }
+    parser->resume();
+    foreach (const IndexedString& file, files) {
+      QVERIFY(DUChain::self()->waitForUpdate(file, TopDUContext::VisibleDeclarationsAndContexts));
+    }
+  }
+
+  parser->setThreadCount(oldThreadCount);
+}
+
+void TestCppFiles::benchParseFeatures_data()
+{
+  QTest::addColumn<int>("features");
+  QTest::newRow("visible declarations") << int(TopDUContext::VisibleDeclarationsAndContexts);
+  QTest::newRow("all declarations and uses") << int(TopDUContext::AllDeclarationsContextsAndUses);
+}
+
+void TestCppFiles::benchParseFeatures()
+{
+  QFETCH(int, features);
+  const QString testDirPath = CPP_TEST_FILES_DIR;
+  QList<IndexedString> files;
+  foreach (const QString& file, QDir(testDirPath).entryList(QStringList() << "*.cpp", QDir::Files)) {
+    files << IndexedString(testDirPath + "/" + file);
+  }
+
+  //With only the visible declarations, function bodies are skipped by the parser and the builders
+  QBENCHMARK {
+    foreach (const IndexedString& file, files) {
+      QVERIFY(DUChain::self()->waitForUpdate(file, TopDUContext::Features(features | TopDUContext::ForceUpdate)));
+    }
+  }
+}
+
 #include "test_cppfiles.moc"
@@ -29,6 +29,14 @@ private slots:
   void cleanupTestCase();
   void testFiles_data();
   void testFiles();
+  void benchReparse_data();
+  void benchReparse();
+  void benchSharedHeaderSection_data();
+  void benchSharedHeaderSection();
+  void benchParseThreads_data();
+  void benchParseThreads();
+  void benchParseFeatures_data();
+  void benchParseFeatures();
 };
 
 #endif //TEST_CPPFILES_H
@@ -0,0 +1,403 @@
+/*
+ * This file is part of KDevelop
+ *
+ * Copyright 2014 KDevelop developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "test_includepaths.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QTest>
+#include <qtest_kde.h>
+#include <KTempDir>
+
+#include <tests/autotestshell.h>
+#include <tests/testcore.h>
+
+#include <language/duchain/duchain.h>
+#include <language/duchain/duchainlock.h>
+#include <language/duchain/indexedstring.h>
+#include <language/util/includeitem.h>
+#include <util/path.h>
+
+#include "includepathsnapshot.h"
+#include "includedirectorycache.h"
+#include "includegraphscheduler.h"
+#include "cpputils.h"
+#include "parser.h"
+#include "control.h"
+#include "parsesession.h"
+#include "rpp/preprocessor.h"
+#include "rpp/pp-engine.h"
+
+using namespace KDevelop;
+
+QTEST_KDEMAIN(TestIncludePaths, NoGUI)
+
+namespace {
+
+const int fileCount = 1000;
+
+///Computes the include-paths of a file and parses it, like a parse-job does
+class ParseRunnable : public QRunnable
+{
+public:
+    ParseRunnable(const QString& file, QAtomicInt* parsed)
+      : m_file(file)
+      , m_parsed(parsed)
+    {}
+
+    void run() override
+    {
+        CppUtils::findIncludePaths(m_file);
+
+        QFile file(m_file);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return;
+        }
+        rpp::Preprocessor preprocessor;
+        rpp::pp pp(&preprocessor);
+        ParseSession session;
+        session.setContentsAndGenerateLocationTable(pp.processFile(m_file, file.readAll()));
+        Control control;
+        Parser parser(&control);
+        if (parser.parse(&session)) {
+            m_parsed->ref();
+        }
+    }
+
+private:
+    QString m_file;
+    QAtomicInt* m_parsed;
+};
+
+///Creates @p pathCount include-directories with @p headerCount headers distributed over them,
+///and returns the include-paths. The headers are named so each one is found in a different path.
+Path::List createIncludePaths(const KTempDir& dir, int pathCount, int headerCount)
+{
+    Path::List paths;
+    QDir base(dir.name());
+    for (int p = 0; p < pathCount; ++p) {
+        const QString name = QString("include%1").arg(p);
+        base.mkpath(name + "/sub");
+        paths << Path(base.absoluteFilePath(name));
+    }
+    for (int h = 0; h < headerCount; ++h) {
+        const QString directory = paths[h % pathCount].toLocalFile();
+        QFile header(directory + QString((h % 3) ? "/header%1.h" : "/sub/header%1.h").arg(h));
+        header.open(QIODevice::WriteOnly);
+    }
+    return paths;
+}
+
+QStringList includeNames(int headerCount)
+{
+    QStringList names;
+    for (int h = 0; h < headerCount; ++h) {
+        names << QString((h % 3) ? "header%1.h" : "sub/header%1.h").arg(h);
+    }
+    //Also resolve some includes that don't exist
+    names << "missing.h" << "sub/missing.h" << "sub" << "nosuchdir/header1.h";
+    return names;
+}
+
+QSet<IndexedString> createFiles(const KTempDir& dir, int count)
+{
+    QSet<IndexedString> files;
+    for (int i = 0; i < count; ++i) {
+        const QString name = dir.name() + QString("file%1.cpp").arg(i);
+        QFile file(name);
+        file.open(QIODevice::WriteOnly);
+        file.write(QString("#include \"header.h\"\nclass C%1 { int m; };\nint f%1(C%1* c) { return c->m + %1; }\n").arg(i).toUtf8());
+        files.insert(IndexedString(name));
+    }
+    return files;
+}
+
+void writeFile(const QString& name, const QByteArray& contents)
+{
+    QFile file(name);
+    file.open(QIODevice::WriteOnly);
+    file.write(contents);
+}
+
+}
+
+void TestIncludePaths::initTestCase()
+{
+    AutoTestShell::init(QStringList() << "kdevcppsupport");
+    TestCore::initialize(Core::NoUi);
+    DUChain::self()->disablePersistentStorage();
+    new IncludePathSnapshots(this);
+}
+
+void TestIncludePaths::cleanupTestCase()
+{
+    delete IncludePathSnapshots::self();
+    TestCore::shutdown();
+}
+
+void TestIncludePaths::testSnapshot()
+{
+    KTempDir dir;
+    const QSet<IndexedString> files = createFiles(dir, 10);
+    IncludePathSnapshots* snapshots = IncludePathSnapshots::self();
+    const uint version = snapshots->version();
+
+    IncludePathComputer::ForegroundResult result;
+    foreach (const IndexedString& file, files) {
+        QVERIFY(!snapshots->lookup(file, result));
+    }
+
+    snapshots->update(files);
+    snapshots->flush();
+    QVERIFY(snapshots->version() > version);
+    foreach (const IndexedString& file, files) {
+        QVERIFY(snapshots->lookup(file, result));
+        QCOMPARE(result.source, file.str());
+
+        //The snapshot gives the same include-paths as computing them in the foreground
+        IncludePathComputer computer(file.str());
+        computer.computeForeground();
+        QCOMPARE(result.paths, computer.foregroundResult().paths);
+        QCOMPARE(result.defines, computer.foregroundResult().defines);
+    }
+}
+
+void TestIncludePaths::testInvalidate()
+{
+    KTempDir dir;
+    const QSet<IndexedString> files = createFiles(dir, 10);
+    IncludePathSnapshots* snapshots = IncludePathSnapshots::self();
+    snapshots->update(files);
+    snapshots->flush();
+
+    const uint version = snapshots->version();
+    snapshots->invalidate(files);
+    QVERIFY(snapshots->version() > version);
+    IncludePathComputer::ForegroundResult result;
+    foreach (const IndexedString& file, files) {
+        QVERIFY(!snapshots->lookup(file, result));
+    }
+
+    //The invalidated files are computed again
+    snapshots->flush();
+    foreach (const IndexedString& file, files) {
+        QVERIFY(snapshots->lookup(file, result));
+    }
+}
+
+void TestIncludePaths::testForegroundBlocked()
+{
+    KTempDir dir;
+    QFile header(dir.name() + "header.h");
+    QVERIFY(header.open(QIODevice::WriteOnly));
+    header.write("#define HEADER\nstruct Header { int a; };\n");
+    header.close();
+
+    const QSet<IndexedString> files = createFiles(dir, fileCount);
+    IncludePathSnapshots* snapshots = IncludePathSnapshots::self();
+    snapshots->update(files);
+    snapshots->flush();
+    const IncludePathSnapshots::Statistics before = snapshots->statistics();
+
+    QAtomicInt parsed(0);
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(QThread::idealThreadCount(), 4));
+    foreach (const IndexedString& file, files) {
+        pool.start(new ParseRunnable(file.str(), &parsed));
+    }
+
+    //Block the foreground thread without processing events, like a busy UI does.
+    //Without the snapshot every worker would wait for the event loop.
+    QElapsedTimer timer;
+    timer.start();
+    while (parsed < fileCount && timer.elapsed() < 60000) {
+        QTest::qSleep(10);
+    }
+    const qint64 elapsed = timer.elapsed();
+    QCOMPARE(int(parsed), fileCount);
+    pool.waitForDone();
+
+    const IncludePathSnapshots::Statistics after = snapshots->statistics();
+    QCOMPARE(after.hits - before.hits, uint(fileCount));
+    qDebug() << "parsed" << fileCount << "files in" << elapsed << "ms while the foreground thread was blocked";
+}
+
+void TestIncludePaths::testDirectoryCache()
+{
+    KTempDir dir;
+    const Path::List paths = createIncludePaths(dir, 10, 100);
+    const Path localPath(dir.name());
+    IncludeDirectoryCache& cache = IncludeDirectoryCache::self();
+
+    //The cache resolves the same files as the file-system
+    foreach (const QString& name, includeNames(100)) {
+        cache.setEnabled(false);
+        const QPair<Path, Path> uncached = CppUtils::findInclude(paths, localPath, name, rpp::Preprocessor::IncludeGlobal, Path(), true);
+        cache.setEnabled(true);
+        const QPair<Path, Path> cached = CppUtils::findInclude(paths, localPath, name, rpp::Preprocessor::IncludeGlobal, Path(), true);
+        QCOMPARE(cached, uncached);
+        //"nosuchdir/header1.h" is found as "header1.h", see the Qt4 hack in findInclude()
+        QCOMPARE(cached.first.isValid(), !name.contains("missing") && name != "sub");
+    }
+
+    //Skipping a path continues the search in the following ones
+    const QPair<Path, Path> skipped = CppUtils::findInclude(paths, localPath, "header1.h", rpp::Preprocessor::IncludeGlobal, paths[1], true);
+    QVERIFY(!skipped.first.isValid());
+
+    //Include-completion lists the cached directories
+    const QList<IncludeItem> items = CppUtils::allFilesInIncludePath(dir.name() + "source.cpp", false, "sub/",
+                                                                     QStringList() << paths[0].toLocalFile(), true, true);
+    QCOMPARE(items.size(), 4);
+    foreach (const IncludeItem& item, items) {
+        QVERIFY(item.name.startsWith("sub/header"));
+        QVERIFY(!item.isDirectory);
+    }
+}
+
+void TestIncludePaths::testDirectoryCacheChanges()
+{
+    KTempDir dir;
+    const Path::List paths = createIncludePaths(dir, 2, 2);
+    IncludeDirectoryCache& cache = IncludeDirectoryCache::self();
+    cache.setEnabled(true);
+
+    const Path created(paths[0], "created.h");
+    QCOMPARE(cache.entryType(created), IncludeDirectoryCache::Missing);
+    QCOMPARE(cache.entryType(paths[0]), IncludeDirectoryCache::Directory);
+
+    //Directories that were modified just before they were listed are listed again for missing files,
+    //so files created right after a failed lookup are found
+    QFile file(created.toLocalFile());
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.close();
+    QCOMPARE(cache.entryType(created), IncludeDirectoryCache::File);
+
+    QVERIFY(file.remove());
+    cache.invalidate(paths[0].toLocalFile());
+    QCOMPARE(cache.entryType(created), IncludeDirectoryCache::Missing);
+}
+
+void TestIncludePaths::testDirectoryCachePrefetch()
+{
+    KTempDir dir;
+    const Path::List paths = createIncludePaths(dir, 20, 40);
+    IncludeDirectoryCache& cache = IncludeDirectoryCache::self();
+    cache.clear();
+    cache.setEnabled(true);
+
+    QStringList directories;
+    foreach (const Path& path, paths) {
+        directories << path.toLocalFile();
+    }
+    cache.prefetch(directories);
+    QCOMPARE(cache.statistics().listings, 20u);
+    QCOMPARE(cache.canonicalPath(directories[3]), QFileInfo(directories[3]).canonicalFilePath());
+
+    //Listing the prefetched directories is answered from the cache
+    const QList<IncludeItem> items = CppUtils::allFilesInIncludePath(dir.name() + "source.cpp", false, QString(),
+                                                                     directories, true);
+    QCOMPARE(cache.statistics().listings, 20u);
+    //Each include-path contains the "sub" directory, and either one or two headers
+    QCOMPARE(items.size(), 20 + 26);
+}
+
+void TestIncludePaths::testIncludeGraphHeights()
+{
+    KTempDir dir;
+    const QString base = dir.name();
+    writeFile(base + "leaf.h", "#ifndef LEAF_H\n#define LEAF_H\nint leaf();\n#endif\n");
+    writeFile(base + "middle.h", "#ifndef MIDDLE_H\n#define MIDDLE_H\n#include \"leaf.h\"\n#endif\n");
+    //The recursion between the two headers is cut where it is found
+    writeFile(base + "first.h", "#ifndef FIRST_H\n#define FIRST_H\n#include \"second.h\"\n#endif\n");
+    writeFile(base + "second.h", "#ifndef SECOND_H\n#define SECOND_H\n#include \"first.h\"\n#endif\n");
+    writeFile(base + "main.cpp", "#include \"middle.h\"\n#include \"leaf.h\"\n#include \"first.h\"\nint main() { return leaf(); }\n");
+    writeFile(base + "alone.cpp", "int alone() { return 0; }\n");
+
+    const IndexedString mainFile(base + "main.cpp");
+    const IndexedString alone(base + "alone.cpp");
+    QVERIFY(DUChain::self()->waitForUpdate(mainFile, TopDUContext::VisibleDeclarationsAndContexts));
+    QVERIFY(DUChain::self()->waitForUpdate(alone, TopDUContext::VisibleDeclarationsAndContexts));
+
+    const IndexedString leaf(base + "leaf.h");
+    const IndexedString middle(base + "middle.h");
+    const IndexedString first(base + "first.h");
+    const IndexedString second(base + "second.h");
+    const IndexedString unknown(base + "unknown.cpp");
+
+    const QHash<IndexedString, int> heights = IncludeGraphScheduler::heights(QSet<IndexedString>() << mainFile << alone << unknown);
+    QCOMPARE(heights.value(leaf, -1), 0);
+    QCOMPARE(heights.value(middle, -1), 1);
+    QCOMPARE(heights.value(second, -1), 0);
+    QCOMPARE(heights.value(first, -1), 1);
+    QCOMPARE(heights.value(mainFile, -1), 2);
+    QCOMPARE(heights.value(alone, -1), 0);
+    //Files that were never parsed include nothing as far as it is known
+    QCOMPARE(heights.value(unknown, -1), 0);
+
+    //Starting the search somewhere else gives the same heights, except for the cut recursion
+    const QHash<IndexedString, int> fromHeader = IncludeGraphScheduler::heights(QSet<IndexedString>() << second);
+    QCOMPARE(fromHeader.value(first, -1), 0);
+    QCOMPARE(fromHeader.value(second, -1), 1);
+    QVERIFY(!fromHeader.contains(mainFile));
+}
+
+void TestIncludePaths::benchFindInclude_data()
+{
+    QTest::addColumn<bool>("cached");
+    QTest::newRow("uncached") << false;
+    QTest::newRow("cached") << true;
+}
+
+void TestIncludePaths::benchFindInclude()
+{
+    QFETCH(bool, cached);
+
+    //The include-paths of a typical project, with a translation-unit of 300 includes
+    KTempDir dir;
+    const Path::List paths = createIncludePaths(dir, 40, 300);
+    const QStringList names = includeNames(300);
+    const Path localPath(dir.name());
+    IncludeDirectoryCache& cache = IncludeDirectoryCache::self();
+    cache.clear();
+    cache.setEnabled(cached);
+
+    QElapsedTimer timer;
+    timer.start();
+    int runs = 0;
+    QBENCHMARK {
+        foreach (const QString& name, names) {
+            CppUtils::findInclude(paths, localPath, name, rpp::Preprocessor::IncludeGlobal, Path(), true);
+        }
+        ++runs;
+    }
+
+    const IncludeDirectoryCache::Statistics statistics = cache.statistics();
+    qDebug() << (cached ? "cached:" : "uncached:") << statistics.fileSystemAccesses / runs << "file-system accesses and"
+             << double(timer.elapsed()) / runs << "ms per translation-unit," << statistics.listings << "listings";
+    cache.setEnabled(true);
+}
+
+#include "test_includepaths.moc"
@@ -0,0 +1,45 @@
+/*
+ * This file is part of KDevelop
+ *
+ * Copyright 2014 KDevelop developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef TEST_INCLUDEPATHS_H
+#define TEST_INCLUDEPATHS_H
+
+#include <QObject>
+
+class TestIncludePaths : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testSnapshot();
+    void testInvalidate();
+    void testForegroundBlocked();
+    void testDirectoryCache();
+    void testDirectoryCacheChanges();
+    void testDirectoryCachePrefetch();
+    void testIncludeGraphHeights();
+    void benchFindInclude_data();
+    void benchFindInclude();
+};
+
+#endif // TEST_INCLUDEPATHS_H
@@ -24,8 +24,13 @@
 #include "cmakemodelitems.h"
 #include "cmakeutils.h"
 #include "cmakemanager.h"
+#include "cmakeevaluationcache.h"
 #include <cmakeparserutils.h>
 #include <project/projectfiltermanager.h>
+#include <language/duchain/duchain.h>
+#include <language/duchain/duchainlock.h>
+#include <language/duchain/topducontext.h>
+#include <language/duchain/declaration.h>
 #include <project/interfaces/iprojectfilter.h>
 
 #include <KUrl>
@@ -147,6 +152,7 @@ Path::List CMakeCommitChangesJob::addProjectData(const CMakeProjectData& data)
     m_projectDataAdded = true;
     Path::List ret;
     m_tests = data.testSuites;
+    m_dependencies = CMakeEvaluationCache::modificationTimes(data.includedFiles);
     
     QSet<QString> alreadyAdded;
     foreach(const Subdirectory& subf, data.subdirectories) {
@@ -168,7 +174,7 @@ Path::List CMakeCommitChangesJob::addProjectData(const CMakeProjectData& data)
 
     m_definitions.unite(data.definitions);
     CMakeParserUtils::addDefinitions(data.properties[DirectoryProperty][dir]["COMPILE_DEFINITIONS"], &m_definitions);
-    CMakeParserUtils::addDefinitions(data.vm["CMAKE_CXX_FLAGS"], &m_definitions, true);
+    CMakeParserUtils::addDefinitions(data.vm.value("CMAKE_CXX_FLAGS"), &m_definitions, true);
 
     foreach(const Target& t, data.targets) {
         const QMap<QString, QStringList>& targetProps = data.properties[TargetProperty][t.name];
@@ -196,6 +202,52 @@ Path::List CMakeCommitChangesJob::addProjectData(const CMakeProjectData& data)
     return ret;
 }
 
+Path::List CMakeCommitChangesJob::addEvaluatedDirectory(const CMakeEvaluatedDirectory& directory)
+{
+    m_projectDataAdded = true;
+    m_subdirectories = directory.subdirectories;
+    m_targets = directory.targets;
+    m_tests = directory.tests;
+    m_directories = directory.includeDirectories;
+    m_definitions = directory.definitions;
+    m_dependencies = directory.dependencies;
+
+    Path::List ret;
+    foreach(const Subdirectory& subf, m_subdirectories) {
+        ret += Path(m_path, subf.name);
+    }
+    return ret;
+}
+
+void CMakeCommitChangesJob::findTargetDeclarations()
+{
+    DUChainReadLocker lock;
+    for(QVector<ProcessedTarget>::iterator it = m_targets.begin(); it != m_targets.end(); ++it) {
+        Target& target = it->target;
+        target.declaration = IndexedDeclaration();
+        TopDUContext* top = DUChain::self()->chainForDocument(IndexedString(target.desc.filePath));
+        if(!top)
+            continue;
+        //Targets defined again replace the earlier ones
+        const QList<Declaration*> declarations = top->findLocalDeclarations(Identifier(target.name));
+        if(!declarations.isEmpty())
+            target.declaration = IndexedDeclaration(declarations.last());
+    }
+}
+
+CMakeEvaluatedDirectory CMakeCommitChangesJob::evaluatedDirectory() const
+{
+    Q_ASSERT(m_projectDataAdded);
+    CMakeEvaluatedDirectory ret;
+    ret.subdirectories = m_subdirectories;
+    ret.targets = m_targets;
+    ret.tests = m_tests;
+    ret.includeDirectories = m_directories;
+    ret.definitions = m_definitions;
+    ret.dependencies = m_dependencies;
+    return ret;
+}
+
 void CMakeCommitChangesJob::start()
 {
     Q_ASSERT(m_project->thread() == QThread::currentThread());
@@ -222,6 +274,12 @@ void CMakeCommitChangesJob::makeChanges()
     Q_ASSERT(m_project->thread() == QThread::currentThread());
     ProjectFolderItem* f = m_parentItem;
     m_manager->addWatcher(m_project, m_path.toLocalFile());
+    //Changes of the CMake files of the project that were read cause the directory to be evaluated again.
+    //They are watched only here, so evaluations that the import throws away don't add watchers.
+    for(QMap<QString, QDateTime>::const_iterator it = m_dependencies.constBegin(); it != m_dependencies.constEnd(); ++it) {
+        if(m_project->path().isParentOf(Path(it.key())))
+            m_manager->addWatcher(m_project, it.key());
+    }
 
     if(!m_projectDataAdded) {
         reloadFiles();
@@ -268,8 +326,12 @@ void CMakeCommitChangesJob::makeChanges()
         }
     }
 
+    //New items are noticed through the project model, but changed compilation data of existing ones is not
+    bool compilationDataChanged = false;
+    CompilationDataAttached previous = *folder;
     folder->setIncludeDirectories(m_directories);
     folder->setDefinitions(m_definitions);
+    compilationDataChanged |= !folder->hasSameCompilationData(previous);
 
     QSet<ProjectTargetItem*> deletableTargets = folder->targetList().toSet();
     foreach ( const ProcessedTarget& pt, m_targets)
@@ -304,8 +366,10 @@ void CMakeCommitChangesJob::makeChanges()
 
         CompilationDataAttached* incAtt = dynamic_cast<CompilationDataAttached*>(targetItem);
         if(incAtt) {
+            previous = *incAtt;
             incAtt->setIncludeDirectories(resolvePaths(m_path, pt.includes));
             incAtt->addDefinitions(pt.defines);
+            compilationDataChanged |= !incAtt->hasSameCompilationData(previous);
         }
         
         Path::List tfiles;
@@ -330,6 +394,8 @@ void CMakeCommitChangesJob::makeChanges()
     qDeleteAll(deletableTargets);
 
     CTestUtils::createTestSuites(m_tests, folder);
+    if(compilationDataChanged)
+        emit includesAndDefinesChanged(folder);
     reloadFiles();
 }
 
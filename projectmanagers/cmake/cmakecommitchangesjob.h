@@ -24,6 +24,7 @@
 #include <KJob>
 #include <cmaketypes.h>
 #include <util/path.h>
+#include <QDateTime>
 
 namespace KDevelop {
     class IProject;
@@ -44,6 +45,21 @@ struct ProcessedTarget
 };
 Q_DECLARE_TYPEINFO(ProcessedTarget, Q_MOVABLE_TYPE);
 
+/**
+ * What the evaluation of the CMakeLists.txt of a directory contributes to the project model,
+ * kept by the CMakeEvaluationCache.
+ */
+struct CMakeEvaluatedDirectory
+{
+    QVector<Subdirectory> subdirectories;
+    QVector<ProcessedTarget> targets;
+    QVector<Test> tests;
+    QStringList includeDirectories;
+    CMakeDefinitions definitions;
+    ///The files that were read by the evaluation, mapped to their modification-times
+    QMap<QString, QDateTime> dependencies;
+};
+
 class CMakeCommitChangesJob : public KJob
 {
 Q_OBJECT
@@ -51,6 +67,15 @@ public:
     explicit CMakeCommitChangesJob(const KDevelop::Path& url, CMakeManager* manager, KDevelop::IProject* project);
 
     KDevelop::Path::List addProjectData(const CMakeProjectData& data);
+    ///Same as addProjectData(), with the result of an earlier evaluation
+    KDevelop::Path::List addEvaluatedDirectory(const CMakeEvaluatedDirectory& directory);
+    ///Finds the declarations of the targets in the du-chain, the evaluations passed to
+    ///addEvaluatedDirectory() only know the names of their targets
+    void findTargetDeclarations();
+    ///Returns the data added by addProjectData() or addEvaluatedDirectory()
+    CMakeEvaluatedDirectory evaluatedDirectory() const;
+    bool hasProjectData() const { return m_projectDataAdded; }
+    KDevelop::Path path() const { return m_path; }
     void setFindParentItem(bool find);
     virtual void start();
 
@@ -60,6 +85,8 @@ public slots:
 
 signals:
     void folderCreated(KDevelop::ProjectFolderItem* item);
+    ///Emitted when the include-directories or definitions of @p item or of its targets changed
+    void includesAndDefinesChanged(KDevelop::ProjectBaseItem* item);
 
 private slots:
     void makeChanges();
@@ -77,6 +104,7 @@ private:
 
     QStringList m_directories;
     CMakeDefinitions m_definitions;
+    QMap<QString, QDateTime> m_dependencies;
     bool m_projectDataAdded;
     KDevelop::ProjectFolderItem* m_parentItem;
     bool m_waiting;
@@ -0,0 +1,383 @@
+/* KDevelop CMake Support
+ *
+ * Copyright 2014 KDevelop developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#include "cmakeevaluationcache.h"
+
+#include <QDataStream>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+
+#include <KDebug>
+#include <KSaveFile>
+
+using namespace KDevelop;
+
+//The operators are found through argument dependent lookup when streaming the containers
+
+static QDataStream& operator<<(QDataStream& out, const CMakeFunctionArgument& arg)
+{
+    return out << arg.value << arg.quoted << arg.line << arg.column;
+}
+
+static QDataStream& operator>>(QDataStream& in, CMakeFunctionArgument& arg)
+{
+    QString value;
+    in >> value;
+    //The value is unescaped already
+    arg = CMakeFunctionArgument(value);
+    in >> arg.quoted >> arg.line >> arg.column;
+    if(arg.value.contains('$'))
+        arg.compiled = CMakeArgumentTemplate::compile(arg.value);
+    return in;
+}
+
+static QDataStream& operator<<(QDataStream& out, const CMakeFunctionDesc& desc)
+{
+    return out << desc.name << desc.arguments << desc.filePath
+               << desc.line << desc.column << desc.endLine << desc.endColumn;
+}
+
+static QDataStream& operator>>(QDataStream& in, CMakeFunctionDesc& desc)
+{
+    return in >> desc.name >> desc.arguments >> desc.filePath
+              >> desc.line >> desc.column >> desc.endLine >> desc.endColumn;
+}
+
+static QDataStream& operator<<(QDataStream& out, const Macro& macro)
+{
+    return out << macro.name << macro.knownArgs << macro.code << macro.isFunction;
+}
+
+static QDataStream& operator>>(QDataStream& in, Macro& macro)
+{
+    return in >> macro.name >> macro.knownArgs >> macro.code >> macro.isFunction;
+}
+
+static QDataStream& operator<<(QDataStream& out, const CacheEntry& entry)
+{
+    return out << entry.value << entry.doc;
+}
+
+static QDataStream& operator>>(QDataStream& in, CacheEntry& entry)
+{
+    return in >> entry.value >> entry.doc;
+}
+
+static QDataStream& operator<<(QDataStream& out, const Subdirectory& subdirectory)
+{
+    return out << subdirectory.name << subdirectory.desc << subdirectory.build_dir;
+}
+
+static QDataStream& operator>>(QDataStream& in, Subdirectory& subdirectory)
+{
+    return in >> subdirectory.name >> subdirectory.desc >> subdirectory.build_dir;
+}
+
+static QDataStream& operator<<(QDataStream& out, const Test& test)
+{
+    return out << test.name << test.executable << test.arguments << test.properties;
+}
+
+static QDataStream& operator>>(QDataStream& in, Test& test)
+{
+    return in >> test.name >> test.executable >> test.arguments >> test.properties;
+}
+
+static QDataStream& operator<<(QDataStream& out, const ProcessedTarget& processed)
+{
+    //The declarations are found again by name once the directories were imported, see
+    //CMakeCommitChangesJob::findTargetDeclarations(), indices into the du-chain are not stored
+    const Target& target = processed.target;
+    out << target.files << qint32(target.type) << target.desc << target.name;
+    return out << processed.includes << processed.defines << processed.outputName << processed.location.pathOrUrl();
+}
+
+static QDataStream& operator>>(QDataStream& in, ProcessedTarget& processed)
+{
+    Target& target = processed.target;
+    qint32 type;
+    in >> target.files >> type >> target.desc >> target.name;
+    target.type = Target::Type(type);
+
+    QString location;
+    in >> processed.includes >> processed.defines >> processed.outputName >> location;
+    processed.location = Path(location);
+    return in;
+}
+
+static QDataStream& operator<<(QDataStream& out, const CMakeEvaluatedDirectory& directory)
+{
+    return out << directory.subdirectories << directory.targets << directory.tests
+               << directory.includeDirectories << directory.definitions << directory.dependencies;
+}
+
+static QDataStream& operator>>(QDataStream& in, CMakeEvaluatedDirectory& directory)
+{
+    return in >> directory.subdirectories >> directory.targets >> directory.tests
+              >> directory.includeDirectories >> directory.definitions >> directory.dependencies;
+}
+
+namespace {
+
+///Returns the modification-time of @p file, or the epoch if it doesn't exist
+QDateTime modificationTime(const QString& file)
+{
+    const QFileInfo info(file);
+    return info.exists() ? info.lastModified() : QDateTime::fromTime_t(0);
+}
+
+void writeProjectData(QDataStream& out, const CMakeProjectData& data)
+{
+    //The scopes are all closed once the project is evaluated, only the visible values matter
+    const QStringList variables = data.vm.keys();
+    out << quint32(variables.size());
+    foreach(const QString& name, variables) {
+        out << name << data.vm.value(name);
+    }
+
+    out << quint32(data.properties.size());
+    for(CMakeProperties::const_iterator it = data.properties.constBegin(); it != data.properties.constEnd(); ++it) {
+        out << qint32(it.key()) << *it;
+    }
+
+    out << data.mm << data.cache << data.definitions << data.modulePath << data.targetAlias;
+}
+
+void readProjectData(QDataStream& in, CMakeProjectData& data)
+{
+    quint32 count;
+    in >> count;
+    for(quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        QString name;
+        QStringList value;
+        in >> name >> value;
+        data.vm.insertGlobal(name, value);
+    }
+
+    in >> count;
+    for(quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        qint32 type;
+        CategoryType category;
+        in >> type >> category;
+        data.properties.insert(PropertyType(type), category);
+    }
+
+    in >> data.mm >> data.cache >> data.definitions >> data.modulePath >> data.targetAlias;
+}
+
+}
+
+CMakeEvaluationCache::CMakeEvaluationCache(const QString& fileName)
+    : m_fileName(fileName)
+    , m_loaded(false)
+    , m_modified(false)
+{
+}
+
+bool CMakeEvaluationCache::restore(const Path& root, const QString& buildDirectory, const QMap<QString, QString>& environment,
+                                   CMakeProjectData* data, Directories* directories)
+{
+    QMutexLocker lock(&m_mutex);
+    load();
+
+    QHash<QString, bool> checked;
+    if(m_directories.isEmpty() || m_buildDirectory != buildDirectory || m_environment != environment
+        || !isUpToDate(m_configuration, checked))
+    {
+        return false;
+    }
+
+    //A directory sees the state left behind by every directory that was evaluated before it: the variables
+    //of its parents, and what earlier siblings and their sub-directories passed on with PARENT_SCOPE, global
+    //properties, cache entries, macros and functions. Only the state after the last directory is kept, so
+    //a changed directory can't be evaluated on its own, and the whole project is evaluated again instead.
+    Directories reusable;
+    QList<Path> pending;
+    pending += root;
+    while(!pending.isEmpty()) {
+        const Path directory = pending.takeFirst();
+        const QString key = directory.toLocalFile();
+        if(reusable.contains(key) || !QFile::exists(Path(directory, "CMakeLists.txt").toLocalFile()))
+            continue;
+        Directories::const_iterator it = m_directories.constFind(key);
+        if(it == m_directories.constEnd() || !isUpToDate(it->dependencies, checked)) {
+            kDebug(9042) << "Evaluating the project again," << key << "changed";
+            return false;
+        }
+
+        reusable.insert(key, *it);
+        foreach(const Subdirectory& subdirectory, it->subdirectories) {
+            pending += Path(directory, subdirectory.name);
+        }
+    }
+
+    if(!reusable.contains(root.toLocalFile()))
+        return false;
+
+    kDebug(9042) << "Re-using the evaluation of" << reusable.size() << "of" << m_directories.size() << "directories";
+    *data = m_data;
+    *directories = reusable;
+    return true;
+}
+
+void CMakeEvaluationCache::setProject(const QString& buildDirectory, const QMap<QString, QString>& environment,
+                                      const ModificationTimes& configuration, const CMakeProjectData& data, const Directories& directories)
+{
+    QMutexLocker lock(&m_mutex);
+    m_loaded = true;
+    m_modified = true;
+    m_buildDirectory = buildDirectory;
+    m_environment = environment;
+    m_configuration = configuration;
+    m_data = data;
+    m_directories = directories;
+}
+
+void CMakeEvaluationCache::updateDirectories(const Path& folder, const CMakeProjectData& data, const Directories& directories)
+{
+    QMutexLocker lock(&m_mutex);
+    load();
+
+    for(Directories::iterator it = m_directories.begin(); it != m_directories.end(); ) {
+        const Path directory(it.key());
+        if(folder == directory || folder.isParentOf(directory))
+            it = m_directories.erase(it);
+        else
+            ++it;
+    }
+    for(Directories::const_iterator it = directories.constBegin(); it != directories.constEnd(); ++it) {
+        m_directories.insert(it.key(), *it);
+    }
+    m_data = data;
+    m_modified = true;
+}
+
+Path::List CMakeEvaluationCache::dependentDirectories(const QString& file)
+{
+    QMutexLocker lock(&m_mutex);
+    load();
+
+    Path::List ret;
+    for(Directories::const_iterator it = m_directories.constBegin(); it != m_directories.constEnd(); ++it) {
+        if(it->dependencies.contains(file))
+            ret += Path(it.key());
+    }
+    return ret;
+}
+
+bool CMakeEvaluationCache::isConfigurationFile(const QString& file)
+{
+    QMutexLocker lock(&m_mutex);
+    load();
+    return m_configuration.contains(file);
+}
+
+bool CMakeEvaluationCache::save()
+{
+    QMutexLocker lock(&m_mutex);
+    if(!m_modified)
+        return true;
+
+    KSaveFile file(m_fileName);
+    if(!file.open()) {
+        kWarning(9042) << "Could not write the CMake evaluation cache" << m_fileName << file.errorString();
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_4_6);
+    out << quint32(Version) << m_buildDirectory << m_environment << m_configuration;
+    writeProjectData(out, m_data);
+    out << m_directories;
+
+    if(out.status() != QDataStream::Ok || !file.finalize()) {
+        kWarning(9042) << "Could not write the CMake evaluation cache" << m_fileName;
+        file.abort();
+        return false;
+    }
+    m_modified = false;
+    return true;
+}
+
+void CMakeEvaluationCache::load()
+{
+    if(m_loaded)
+        return;
+    m_loaded = true;
+
+    QFile file(m_fileName);
+    if(!file.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_4_6);
+    quint32 version;
+    in >> version;
+    if(version != Version) {
+        kDebug(9042) << "Ignoring the CMake evaluation cache" << m_fileName << "of version" << version;
+        return;
+    }
+
+    QString buildDirectory;
+    QMap<QString, QString> environment;
+    ModificationTimes configuration;
+    CMakeProjectData data;
+    Directories directories;
+    in >> buildDirectory >> environment >> configuration;
+    readProjectData(in, data);
+    in >> directories;
+    if(in.status() != QDataStream::Ok) {
+        kWarning(9042) << "The CMake evaluation cache" << m_fileName << "is corrupted";
+        return;
+    }
+
+    m_buildDirectory = buildDirectory;
+    m_environment = environment;
+    m_configuration = configuration;
+    m_data = data;
+    m_directories = directories;
+}
+
+bool CMakeEvaluationCache::isUpToDate(const ModificationTimes& files, QHash<QString, bool>& checked)
+{
+    for(ModificationTimes::const_iterator it = files.constBegin(); it != files.constEnd(); ++it) {
+        QHash<QString, bool>::iterator check = checked.find(it.key());
+        if(check == checked.end()) {
+            //Files that were not settled yet are always assumed to have changed
+            const bool unchanged = it->isValid() && modificationTime(it.key()) == *it;
+            check = checked.insert(it.key(), unchanged);
+        }
+        if(!*check)
+            return false;
+    }
+    return true;
+}
+
+CMakeEvaluationCache::ModificationTimes CMakeEvaluationCache::modificationTimes(const QStringList& files)
+{
+    ModificationTimes ret;
+    const QDateTime settled = QDateTime::currentDateTime().addSecs(-SettleTime);
+    foreach(const QString& file, files) {
+        const QDateTime modified = modificationTime(file);
+        ret.insert(file, modified < settled ? modified : QDateTime());
+    }
+    return ret;
+}
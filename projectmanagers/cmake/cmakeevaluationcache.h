@@ -0,0 +1,114 @@
+/* KDevelop CMake Support
+ *
+ * Copyright 2014 KDevelop developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef CMAKEEVALUATIONCACHE_H
+#define CMAKEEVALUATIONCACHE_H
+
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QDateTime>
+#include <QStringList>
+
+#include <util/path.h>
+
+#include "cmakeprojectdata.h"
+#include "cmakecommitchangesjob.h"
+
+/**
+ * Keeps the evaluated CMakeLists.txt files of a project on disk, so opening the project again
+ * doesn't have to interpret them as long as none of the files they read changed.
+ *
+ * The state left behind by the last evaluation is kept too, reloads of directories of the open project
+ * are evaluated on it. The cache can be used from any thread.
+ */
+class CMakeEvaluationCache
+{
+public:
+    enum {
+        ///Increased whenever the format of the cache-file changes
+        Version = 2,
+        ///Files that were modified less than this many seconds before being read could change unnoticed,
+        ///since the modification-time has only a resolution of seconds
+        SettleTime = 2
+    };
+
+    ///Maps the paths of directories to their evaluation
+    typedef QHash<QString, CMakeEvaluatedDirectory> Directories;
+    ///Maps the paths of files to their modification-times
+    typedef QMap<QString, QDateTime> ModificationTimes;
+
+    ///Creates the cache stored in @p fileName, which is read on first use
+    explicit CMakeEvaluationCache(const QString& fileName);
+
+    /**
+     * Restores the evaluation of the project with the root directory @p root.
+     *
+     * This fails if the project was evaluated with a different @p buildDirectory or @p environment,
+     * or if a file that was read while initializing the project or while evaluating any of its
+     * directories changed. Otherwise @p data is set to the state after the last evaluation, and
+     * @p directories to the evaluations of all directories. The declarations of their targets have
+     * to be found again.
+     */
+    bool restore(const KDevelop::Path& root, const QString& buildDirectory, const QMap<QString, QString>& environment,
+                 CMakeProjectData* data, Directories* directories);
+
+    /**
+     * Replaces the whole cache with the evaluation of a project.
+     * @p configuration are the files that were read while initializing the project.
+     */
+    void setProject(const QString& buildDirectory, const QMap<QString, QString>& environment,
+                    const ModificationTimes& configuration, const CMakeProjectData& data, const Directories& directories);
+
+    ///Replaces the directories below @p folder with @p directories, after @p folder was evaluated again
+    void updateDirectories(const KDevelop::Path& folder, const CMakeProjectData& data, const Directories& directories);
+
+    ///Returns the directories whose evaluation read @p file
+    KDevelop::Path::List dependentDirectories(const QString& file);
+    ///Whether @p file was read while initializing the project, before evaluating any directory
+    bool isConfigurationFile(const QString& file);
+
+    ///Writes the cache to disk if it changed
+    bool save();
+
+    /**
+     * Returns the modification-times of @p files. The ones that are not settled yet are invalid,
+     * the ones that don't exist are mapped to the epoch.
+     */
+    static ModificationTimes modificationTimes(const QStringList& files);
+
+private:
+    void load();
+    ///Whether none of the @p files changed, the result of each check is put into @p checked
+    static bool isUpToDate(const ModificationTimes& files, QHash<QString, bool>& checked);
+
+    QMutex m_mutex;
+    const QString m_fileName;
+    bool m_loaded;
+    bool m_modified;
+
+    QString m_buildDirectory;
+    QMap<QString, QString> m_environment;
+    ModificationTimes m_configuration;
+    CMakeProjectData m_data;
+    Directories m_directories;
+};
+
+#endif // CMAKEEVALUATIONCACHE_H
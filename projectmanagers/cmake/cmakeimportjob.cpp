@@ -21,6 +21,7 @@
 #include "cmakeimportjob.h"
 #include "cmakeutils.h"
 #include <cmakeparserutils.h>
+#include <cmakefindcache.h>
 #include "cmakecommitchangesjob.h"
 #include "cmakemanager.h"
 #include "cmakeprojectdata.h"
@@ -30,14 +31,169 @@
 #include <language/duchain/duchain.h>
 #include <language/duchain/duchainlock.h>
 #include <language/duchain/parsingenvironment.h>
+#include <language/duchain/topducontext.h>
 #include <interfaces/iproject.h>
 #include <util/environmentgrouplist.h>
 #include <KCompositeJob>
 #include <QtConcurrentRun>
 #include <QFutureWatcher>
+#include <QThread>
 
 using namespace KDevelop;
 
+struct CMakeImportJob::SubdirectoryImport
+{
+    SubdirectoryImport() : job(0) {}
+    CMakeProjectData data;
+    QVector<CMakeCommitChangesJob*> jobs;
+    CMakeCommitChangesJob* job;
+    QFuture<void> future;
+};
+
+namespace {
+
+typedef QMap<PropertyType, QSet<QString> > PropertyKeys;
+
+///Returns the keys of the non-global properties that differ between @p before and @p after
+PropertyKeys changedProperties(const CMakeProperties& before, const CMakeProperties& after)
+{
+    PropertyKeys ret;
+    QList<PropertyType> categories = after.keys();
+    foreach(PropertyType type, before.keys()) {
+        if(!after.contains(type))
+            categories += type;
+    }
+    foreach(PropertyType type, categories) {
+        if(type == GlobalProperty)
+            continue;
+        //Unchanged entries are still shared with the previous state, so comparing them is cheap
+        const CategoryType previous = before.value(type);
+        const CategoryType current = after.value(type);
+        QSet<QString> keys;
+        for(CategoryType::const_iterator it = current.constBegin(); it != current.constEnd(); ++it) {
+            CategoryType::const_iterator old = previous.constFind(it.key());
+            if(old == previous.constEnd() || *old != *it)
+                keys += it.key();
+        }
+        for(CategoryType::const_iterator it = previous.constBegin(); it != previous.constEnd(); ++it) {
+            if(!current.contains(it.key()))
+                keys += it.key();
+        }
+        if(!keys.isEmpty())
+            ret[type] = keys;
+    }
+    return ret;
+}
+
+///Whether the state that is visible to all directories is the same in @p a and @p b
+bool sameSharedState(const CMakeProjectData& a, const CMakeProjectData& b)
+{
+    return a.vm == b.vm
+        && a.mm.isSharedWith(b.mm) //macros are only ever added
+        && a.properties.value(GlobalProperty) == b.properties.value(GlobalProperty)
+        && a.definitions == b.definitions
+        && a.targetAlias == b.targetAlias;
+}
+
+/**
+ * Whether a directory that changed the properties @p changed to @p properties could have been
+ * influenced by sibling directories that were evaluated before it and changed @p claimed.
+ */
+bool dependsOnSiblings(const PropertyKeys& changed, const CMakeProperties& properties, const PropertyKeys& claimed)
+{
+    for(PropertyKeys::const_iterator it = changed.constBegin(); it != changed.constEnd(); ++it) {
+        const QSet<QString> siblingKeys = claimed.value(it.key());
+        foreach(const QString& key, *it) {
+            if(siblingKeys.contains(key))
+                return true;
+        }
+    }
+
+    //Targets refer to the targets they link against by name
+    const QSet<QString> siblingTargets = claimed.value(TargetProperty);
+    if(siblingTargets.isEmpty())
+        return false;
+    const CategoryType targets = properties.value(TargetProperty);
+    foreach(const QString& target, changed.value(TargetProperty)) {
+        foreach(const QStringList& values, targets.value(target)) {
+            foreach(const QString& value, values) {
+                if(siblingTargets.contains(value))
+                    return true;
+            }
+        }
+    }
+    return false;
+}
+
+///Whether a directory that read the properties @p read could have read different values, because
+///sibling directories that were evaluated before it changed @p claimed
+bool readsFromSiblings(const PropertyKeys& read, const PropertyKeys& claimed)
+{
+    for(PropertyKeys::const_iterator it = read.constBegin(); it != read.constEnd(); ++it) {
+        if(claimed.value(it.key()).intersect(*it).isEmpty())
+            continue;
+        return true;
+    }
+    return false;
+}
+
+///Lets the contexts import the shared contexts that were evaluated without building them, in the same way
+///as building them would have done, so the shared contexts are imported from the last file that included them
+void importSharedContexts(const QList<QPair<QString, QString> >& imports)
+{
+    typedef QPair<QString, QString> Import;
+    DUChainWriteLocker lock;
+    foreach(const Import& import, imports) {
+        TopDUContext* includer = DUChain::self()->chainForDocument(IndexedString(import.first));
+        TopDUContext* shared = DUChain::self()->chainForDocument(IndexedString(import.second));
+        if(!includer || !shared)
+            continue;
+        foreach(DUContext* importer, shared->importers())
+            importer->removeImportedParentContext(shared);
+        shared->clearImportedParentContexts();
+        shared->addImportedParentContext(includer);
+        includer->addImportedParentContext(shared);
+    }
+}
+
+///Applies the changes of a directory that was evaluated on a copy of @p data
+void adoptResult(CMakeProjectData& data, const CMakeProjectData& result, const PropertyKeys& changed)
+{
+    data.projectName = result.projectName;
+    data.subdirectories = result.subdirectories;
+    data.targets = result.targets;
+    data.testSuites = result.testSuites;
+    data.vm = result.vm;
+    data.mm = result.mm;
+    data.definitions = result.definitions;
+    data.targetAlias = result.targetAlias;
+    if(result.properties.contains(GlobalProperty))
+        data.properties[GlobalProperty] = result.properties.value(GlobalProperty);
+    else
+        data.properties.remove(GlobalProperty);
+    for(PropertyKeys::const_iterator it = result.readProperties.constBegin(); it != result.readProperties.constEnd(); ++it) {
+        data.readProperties[it.key()] += *it;
+    }
+    data.createdContexts += result.createdContexts;
+    data.builtContexts += result.builtContexts;
+    data.sharedImports += result.sharedImports;
+    importSharedContexts(result.sharedImports);
+
+    for(PropertyKeys::const_iterator it = changed.constBegin(); it != changed.constEnd(); ++it) {
+        const CategoryType source = result.properties.value(it.key());
+        CategoryType& category = data.properties[it.key()];
+        foreach(const QString& key, *it) {
+            CategoryType::const_iterator value = source.constFind(key);
+            if(value == source.constEnd())
+                category.remove(key);
+            else
+                category.insert(key, *value);
+        }
+    }
+}
+
+}
+
 class WaitAllJobs : public KCompositeJob
 {
 Q_OBJECT
@@ -84,12 +240,17 @@ CMakeImportJob::CMakeImportJob(ProjectFolderItem* dom, CMakeManager* parent)
     , m_data(parent->projectData(dom->project()))
     , m_manager(parent)
     , m_futureWatcher(new QFutureWatcher<void>)
+    , m_cache(parent->evaluationCache(dom->project()))
 {
     connect(m_futureWatcher, SIGNAL(finished()), SLOT(importFinished()));
 }
 
 void CMakeImportJob::start()
 {
+    //Searches of the previous imports may have found files that are gone by now, or missed new ones.
+    //Partial reloads of single directories search again as well.
+    CMakeFindCache::self().increaseGeneration();
+
     QFuture<void> future = QtConcurrent::run(this, &CMakeImportJob::initialize);
     m_futureWatcher->setFuture(future);
 }
@@ -98,6 +259,8 @@ void CMakeImportJob::importFinished()
 {
     Q_ASSERT(m_project->thread() == QThread::currentThread());
 
+    updateCache();
+
     WaitAllJobs* wjob = new WaitAllJobs(this);
     connect(wjob, SIGNAL(finished(KJob*)), SLOT(waitFinished(KJob*)));
     foreach(KJob* job, m_jobs) {
@@ -108,6 +271,9 @@ void CMakeImportJob::importFinished()
 
 void CMakeImportJob::initialize()
 {
+    const KDevelop::EnvironmentGroupList env( KGlobal::config() );
+    m_environment = env.variables(CMake::currentEnvironment(m_project));
+
     ReferencedTopDUContext ctx;
     ProjectBaseItem* parent = m_dom->parent();
     while (parent && !ctx) {
@@ -115,10 +281,89 @@ void CMakeImportJob::initialize()
         ctx = DUChain::self()->chainForDocument(IndexedString(Path(parent->path(), "CMakeLists.txt").pathOrUrl()));
         parent = parent->parent();
     }
-    if (!ctx) {
+    if (!ctx && !restoreFromCache()) {
         ctx = initializeProject(dynamic_cast<CMakeFolderItem*>(m_dom));
     }
-    importDirectory(m_project, m_dom->path(), ctx);
+    importDirectory(m_project, m_dom->path(), ctx, m_data, m_jobs);
+    discardSpeculativeContexts();
+
+    //The cache only knows the names of the targets
+    foreach(CMakeCommitChangesJob* job, m_jobs) {
+        if (m_cachedDirectories.contains(job->path().toLocalFile()))
+            job->findTargetDeclarations();
+    }
+}
+
+void CMakeImportJob::discardSpeculativeContexts()
+{
+    //The contexts created by evaluations that were thrown away, for files that no committed evaluation read
+    QSet<QString> used;
+    foreach(CMakeCommitChangesJob* job, m_jobs) {
+        used += job->evaluatedDirectory().dependencies.keys().toSet();
+    }
+
+    DUChainWriteLocker lock;
+    foreach(const QString& file, m_data.createdContexts) {
+        if (used.contains(file))
+            continue;
+        TopDUContext* ctx = DUChain::self()->chainForDocument(IndexedString(file));
+        if (!ctx)
+            continue;
+        kDebug(9042) << "Removing the context of" << file << ", it was only read by discarded evaluations";
+        foreach(DUContext* importer, ctx->importers())
+            importer->removeImportedParentContext(ctx);
+        ctx->clearImportedParentContexts();
+        DUChain::self()->removeDocumentChain(ctx);
+    }
+    m_data.createdContexts.clear();
+    m_data.readProperties.clear();
+    m_data.builtContexts.clear();
+    m_data.sharedImports.clear();
+}
+
+bool CMakeImportJob::restoreFromCache()
+{
+    //Only when opening the project, reloads are caused by changes
+    if (m_dom->parent() || !m_data.vm.isEmpty())
+        return false;
+
+    //Partial imports initialize the item of the project from the parent directories
+    const Path base(CMake::projectRoot(m_project));
+    if (base.isParentOf(m_project->path()))
+        return false;
+
+    {
+        //The targets of the re-used directories are declared in their contexts
+        DUChainReadLocker lock;
+        if (!DUChain::self()->chainForDocument(IndexedString(Path(m_dom->path(), "CMakeLists.txt").pathOrUrl())))
+            return false;
+    }
+
+    const QString buildDir = CMake::currentBuildDir(m_project).toLocalFile(KUrl::RemoveTrailingSlash);
+    return m_cache->restore(m_dom->path(), buildDir, m_environment, &m_data, &m_cachedDirectories);
+}
+
+void CMakeImportJob::updateCache()
+{
+    CMakeEvaluationCache::Directories directories;
+    foreach(CMakeCommitChangesJob* job, m_jobs) {
+        if (job->hasProjectData())
+            directories.insert(job->path().toLocalFile(), job->evaluatedDirectory());
+    }
+
+    if (m_dom->parent()) {
+        //Written when the project is closed
+        m_cache->updateDirectories(m_dom->path(), m_data, directories);
+        return;
+    }
+
+    if (m_cachedDirectories.isEmpty()) {
+        const QString buildDir = CMake::currentBuildDir(m_project).toLocalFile(KUrl::RemoveTrailingSlash);
+        m_cache->setProject(buildDir, m_environment, m_configuration, m_data, directories);
+    } else {
+        m_cache->updateDirectories(m_dom->path(), m_data, directories);
+    }
+    m_cache->save();
 }
 
 KDevelop::ReferencedTopDUContext CMakeImportJob::initializeProject(CMakeFolderItem* rootFolder)
@@ -128,13 +373,14 @@ KDevelop::ReferencedTopDUContext CMakeImportJob::initializeProject(CMakeFolderIt
     QPair<VariableMap,QStringList> initials = CMakeParserUtils::initialVariables();
     
     m_data.clear();
-    m_data.modulePath=initials.first["CMAKE_MODULE_PATH"];
+    m_data.modulePath=initials.first.value("CMAKE_MODULE_PATH");
     m_data.vm=initials.first;
     m_data.vm.insertGlobal("CMAKE_SOURCE_DIR", QStringList(base.toLocalFile()));
     m_data.vm.insertGlobal("CMAKE_BINARY_DIR", QStringList(CMake::currentBuildDir(m_project).toLocalFile(KUrl::RemoveTrailingSlash)));
     
     const Path cachefile(m_manager->buildDirectory(m_project->projectItem()), "CMakeCache.txt");
     m_data.cache = CMakeParserUtils::readCache(cachefile);
+    QStringList configuration(cachefile.toLocalFile());
 
     KDevelop::ReferencedTopDUContext buildstrapContext;
     {
@@ -158,7 +404,10 @@ KDevelop::ReferencedTopDUContext CMakeImportJob::initializeProject(CMakeFolderIt
     ReferencedTopDUContext ref=buildstrapContext;
     foreach(const QString& script, initials.second)
     {
-        ref = includeScript(CMakeProjectVisitor::findFile(script, m_data.modulePath, QStringList()), base.toLocalFile(), ref);
+        const QString file = CMakeProjectVisitor::findFile(script, m_data.modulePath, QStringList());
+        m_manager->addWatcher(m_project, file);
+        ref = includeScript(file, base.toLocalFile(), ref, m_data);
+        configuration += m_data.includedFiles;
     }
     
     //Initialize parent parts of the project that don't belong to the tree (because it's a partial import)
@@ -172,11 +421,13 @@ KDevelop::ReferencedTopDUContext CMakeImportJob::initializeProject(CMakeFolderIt
             const Path script(currentDir, "CMakeLists.txt");
             
             QString dir = currentDir.toLocalFile();
-            ref = includeScript(script.toLocalFile(), dir, ref);
+            m_manager->addWatcher(m_project, script.toLocalFile());
+            ref = includeScript(script.toLocalFile(), dir, ref, m_data);
             Q_ASSERT(ref);
+            configuration += m_data.includedFiles;
             includes << m_data.properties[DirectoryProperty][dir]["INCLUDE_DIRECTORIES"];
             CMakeParserUtils::addDefinitions(m_data.properties[DirectoryProperty][dir]["COMPILE_DEFINITIONS"], &m_data.definitions);
-            CMakeParserUtils::addDefinitions(m_data.vm["CMAKE_CXX_FLAGS"], &m_data.definitions, true);
+            CMakeParserUtils::addDefinitions(m_data.vm.value("CMAKE_CXX_FLAGS"), &m_data.definitions, true);
             rootFolder->setDefinitions(m_data.definitions);
             
             foreach(const Subdirectory& s, m_data.subdirectories) {
@@ -189,6 +440,7 @@ KDevelop::ReferencedTopDUContext CMakeImportJob::initializeProject(CMakeFolderIt
         rootFolder->setIncludeDirectories(includes);
         rootFolder->setBuildDir(base.relativePath(m_project->path()));
     }
+    m_configuration = CMakeEvaluationCache::modificationTimes(configuration);
     return ref;
 }
 
@@ -197,29 +449,37 @@ void CMakeImportJob::waitFinished(KJob*)
     emitResult();
 }
 
-KDevelop::ReferencedTopDUContext CMakeImportJob::includeScript(const QString& file, const QString& dir, ReferencedTopDUContext parent)
+KDevelop::ReferencedTopDUContext CMakeImportJob::includeScript(const QString& file, const QString& dir, ReferencedTopDUContext parent,
+                                                               CMakeProjectData& data)
 {
-    m_manager->addWatcher(m_project, file);
-    QString profile = CMake::currentEnvironment(m_project);
-    const KDevelop::EnvironmentGroupList env( KGlobal::config() );
-    return CMakeParserUtils::includeScript( file, parent, &m_data, dir, env.variables(profile));
+    return CMakeParserUtils::includeScript( file, parent, &data, dir, m_environment);
 }
 
-CMakeCommitChangesJob* CMakeImportJob::importDirectory(IProject* project, const Path& path, const KDevelop::ReferencedTopDUContext& parentTop)
+CMakeCommitChangesJob* CMakeImportJob::importDirectory(IProject* project, const Path& path, const KDevelop::ReferencedTopDUContext& parentTop,
+                                                       CMakeProjectData& data, QVector<CMakeCommitChangesJob*>& jobs)
 {
     Q_ASSERT(thread() == m_project->thread());
     Path cmakeListsPath(path, "CMakeLists.txt");
     CMakeCommitChangesJob* commitJob = new CMakeCommitChangesJob(path, m_manager, project);
     commitJob->moveToThread(thread());
-    m_jobs += commitJob;
+    connect(commitJob, SIGNAL(includesAndDefinesChanged(KDevelop::ProjectBaseItem*)),
+            m_manager, SIGNAL(includesAndDefinesChanged(KDevelop::ProjectBaseItem*)));
+    jobs += commitJob;
     if(QFile::exists(cmakeListsPath.toLocalFile()))
     {
-        kDebug(9042) << "Adding cmake: " << cmakeListsPath << " to the model";
-
-        m_data.vm.pushScope();
-        ReferencedTopDUContext ctx = includeScript(cmakeListsPath.toLocalFile(),
-                                                   path.toLocalFile(), parentTop);
-        Path::List folderList = commitJob->addProjectData(m_data);
+        data.vm.pushScope();
+        ReferencedTopDUContext ctx;
+        Path::List folderList;
+        CMakeEvaluationCache::Directories::const_iterator cached = m_cachedDirectories.constFind(path.toLocalFile());
+        if(cached != m_cachedDirectories.constEnd()) {
+            kDebug(9042) << "Adding the cached evaluation of" << cmakeListsPath << "to the model";
+            folderList = commitJob->addEvaluatedDirectory(*cached);
+        } else {
+            kDebug(9042) << "Adding cmake: " << cmakeListsPath << " to the model";
+            ctx = includeScript(cmakeListsPath.toLocalFile(), path.toLocalFile(), parentTop, data);
+            folderList = commitJob->addProjectData(data);
+        }
+        Path::List subdirectories;
         foreach(const Path& folder, folderList) {
             if (!m_manager->filterManager()->isValid(folder, true, project)) {
                 continue;
@@ -229,17 +489,103 @@ CMakeCommitChangesJob* CMakeImportJob::importDirectory(IProject* project, const
                kWarning() << "Unable to open " << newcmakeListsPath.toLocalFile();
                continue;
             }
-            CMakeCommitChangesJob* job = importDirectory(project, folder, ctx);
-            job->setFindParentItem(false);
-            connect(commitJob, SIGNAL(folderCreated(KDevelop::ProjectFolderItem*)),
-                    job, SLOT(folderAvailable(KDevelop::ProjectFolderItem*)));
+            subdirectories += folder;
         }
-        m_data.vm.popScope();
+        importSubdirectories(project, subdirectories, ctx, commitJob, data, jobs);
+        data.vm.popScope();
     }
     
     return commitJob;
 }
 
+void CMakeImportJob::importSubdirectories(IProject* project, const Path::List& folders, const ReferencedTopDUContext& parentTop,
+                                          CMakeCommitChangesJob* parentJob, CMakeProjectData& data, QVector<CMakeCommitChangesJob*>& jobs)
+{
+    //Sibling directories rarely influence each other, so they are evaluated in parallel, each one
+    //on its own copy of the state left behind by the parent directory. The results are merged in
+    //the order of the add_subdirectory calls. A directory that may have seen different state than
+    //in a sequential import is evaluated again on the merged state, like a sequential import would.
+    //Each speculative evaluation only builds the du-chain contexts of the files in its own directory, the
+    //files it shares with others are built by the evaluations that are not speculative.
+    const CMakeProjectData snapshot = data;
+    QVector<SubdirectoryImport> imports;
+    if(folders.size() > 1 && QThread::idealThreadCount() > 1) {
+        QStringList directories;
+        foreach(const Path& folder, folders) {
+            directories += folder.toLocalFile();
+        }
+        imports.resize(folders.size());
+        for(int i = 0; i < folders.size(); ++i) {
+            //The speculative evaluations record what they read and create, and don't run processes
+            CMakeProjectData& speculative = imports[i].data;
+            speculative = snapshot;
+            speculative.speculative = true;
+            speculative.skippedProcesses = false;
+            speculative.readProperties.clear();
+            speculative.createdContexts.clear();
+            speculative.ownedDirectory = directories[i];
+            speculative.siblingDirectories = snapshot.siblingDirectories + directories.mid(0, i) + directories.mid(i + 1);
+            speculative.sharedContexts.clear();
+            speculative.sharedImports.clear();
+            speculative.skippedDeclarations = false;
+            imports[i].future = QtConcurrent::run(this, &CMakeImportJob::importSpeculatively, project, folders[i], parentTop, &imports[i]);
+        }
+    }
+
+    PropertyKeys claimed;
+    for(int i = 0; i < folders.size(); ++i) {
+        CMakeCommitChangesJob* job = 0;
+        PropertyKeys changed;
+        if(!imports.isEmpty()) {
+            //Waiting steals the evaluation if it did not start yet, so this can't starve the thread-pool
+            SubdirectoryImport& import = imports[i];
+            import.future.waitForFinished();
+            changed = changedProperties(snapshot.properties, import.data.properties);
+            if(!import.data.skippedProcesses && sameSharedState(snapshot, data)
+                && !dependsOnSiblings(changed, import.data.properties, claimed)
+                && !readsFromSiblings(import.data.readProperties, claimed)
+                && !import.data.skippedDeclarations && data.builtContexts.contains(import.data.sharedContexts))
+            {
+                adoptResult(data, import.data, changed);
+                jobs += import.jobs;
+                job = import.job;
+            } else {
+                kDebug(9042) << "Evaluating" << folders[i] << "again, it depends on its sibling directories, runs processes or reads unbuilt contexts";
+                foreach(CMakeCommitChangesJob* discarded, import.jobs) {
+                    discarded->deleteLater();
+                }
+                //Removed by discardSpeculativeContexts() once all evaluations are done, unless read again
+                data.createdContexts += import.data.createdContexts;
+                //The evaluation below builds the contexts of all files it reads, so the remaining
+                //speculative evaluations must not be building any of them anymore
+                for(int j = i + 1; j < imports.size(); ++j) {
+                    imports[j].future.waitForFinished();
+                }
+            }
+            import.data = CMakeProjectData();
+        }
+
+        if(!job) {
+            const CMakeProperties before = data.properties;
+            job = importDirectory(project, folders[i], parentTop, data, jobs);
+            changed = changedProperties(before, data.properties);
+        }
+
+        for(PropertyKeys::const_iterator it = changed.constBegin(); it != changed.constEnd(); ++it) {
+            claimed[it.key()] += *it;
+        }
+        job->setFindParentItem(false);
+        connect(parentJob, SIGNAL(folderCreated(KDevelop::ProjectFolderItem*)),
+                job, SLOT(folderAvailable(KDevelop::ProjectFolderItem*)));
+    }
+}
+
+void CMakeImportJob::importSpeculatively(IProject* project, const Path& path, const ReferencedTopDUContext& parentTop,
+                                         SubdirectoryImport* import)
+{
+    import->job = importDirectory(project, path, parentTop, import->data, import->jobs);
+}
+
 IProject* CMakeImportJob::project() const
 {
     Q_ASSERT(!m_futureWatcher->isRunning());
@@ -22,7 +22,9 @@
 #define CMAKEIMPORTJOB_H
 
 #include <KJob>
+#include <util/path.h>
 #include "cmakeprojectdata.h"
+#include "cmakeevaluationcache.h"
 
 template<class T>class QFutureWatcher;
 class CMakeManager;
@@ -30,7 +32,6 @@ class CMakeFolderItem;
 class CMakeCommitChangesJob;
 namespace KDevelop
 {
-    class Path;
     class IProject;
     class ProjectFolderItem;
     class ReferencedTopDUContext;
@@ -51,10 +52,29 @@ class CMakeImportJob : public KJob
         void importFinished();
 
     private:
+        struct SubdirectoryImport;
+
         void initialize();
-        CMakeCommitChangesJob* importDirectory(KDevelop::IProject* project, const KDevelop::Path& path, const KDevelop::ReferencedTopDUContext& parentTop);
+        ///Restores the evaluation of the project from the CMakeEvaluationCache, when opening it
+        bool restoreFromCache();
+        ///Stores the evaluated directories in the CMakeEvaluationCache
+        void updateCache();
+        CMakeCommitChangesJob* importDirectory(KDevelop::IProject* project, const KDevelop::Path& path, const KDevelop::ReferencedTopDUContext& parentTop,
+                                               CMakeProjectData& data, QVector<CMakeCommitChangesJob*>& jobs);
+        /**
+         * Imports the sub-directories @p folders of the directory imported by @p parentJob.
+         * The sub-directories are evaluated in parallel where possible, the result is the same as
+         * if they were imported one after another.
+         */
+        void importSubdirectories(KDevelop::IProject* project, const KDevelop::Path::List& folders, const KDevelop::ReferencedTopDUContext& parentTop,
+                                  CMakeCommitChangesJob* parentJob, CMakeProjectData& data, QVector<CMakeCommitChangesJob*>& jobs);
+        void importSpeculatively(KDevelop::IProject* project, const KDevelop::Path& path, const KDevelop::ReferencedTopDUContext& parentTop,
+                                 SubdirectoryImport* import);
         KDevelop::ReferencedTopDUContext initializeProject(CMakeFolderItem*);
-        KDevelop::ReferencedTopDUContext includeScript(const QString& file, const QString& currentDir, KDevelop::ReferencedTopDUContext parent);
+        KDevelop::ReferencedTopDUContext includeScript(const QString& file, const QString& currentDir, KDevelop::ReferencedTopDUContext parent,
+                                                       CMakeProjectData& data);
+        ///Removes the du-chain contexts that only evaluations read which were thrown away
+        void discardSpeculativeContexts();
 
         KDevelop::IProject* m_project;
         KDevelop::ProjectFolderItem* m_dom;
@@ -62,6 +82,12 @@ class CMakeImportJob : public KJob
         CMakeManager* m_manager;
         QFutureWatcher<void>* m_futureWatcher;
         QVector<CMakeCommitChangesJob*> m_jobs;
+        QMap<QString, QString> m_environment;
+        QSharedPointer<CMakeEvaluationCache> m_cache;
+        ///The directories restored from the cache
+        CMakeEvaluationCache::Directories m_cachedDirectories;
+        ///The files read while initializing the project
+        CMakeEvaluationCache::ModificationTimes m_configuration;
 };
 
 #endif // CMAKEIMPORTJOB_H
@@ -25,7 +25,9 @@
 #include <QDir>
 #include <QThread>
 #include <QFileSystemWatcher>
+#include <QMutexLocker>
 #include <QTimer>
+#include <QCryptographicHash>
 
 #include <KPluginFactory>
 #include <KPluginLoader>
@@ -72,6 +74,7 @@
 #include "cmakeprojectdata.h"
 #include "cmakecommitchangesjob.h"
 #include "cmakeimportjob.h"
+#include "cmakeevaluationcache.h"
 #include "cmakeutils.h"
 
 Q_DECLARE_METATYPE(KDevelop::IProject*);
@@ -198,9 +201,16 @@ KDevelop::ProjectFolderItem* CMakeManager::import( KDevelop::IProject *project )
     w->setObjectName(project->name()+"_ProjectWatcher");
     connect(w, SIGNAL(fileChanged(QString)), SLOT(dirtyFile(QString)));
     connect(w, SIGNAL(directoryChanged(QString)), SLOT(directoryChanged(QString)));
-    m_watchers[project] = w;
+    {
+        QMutexLocker lock(&m_watchersMutex);
+        m_watchers[project] = w;
+    }
     kDebug(9042) << "Added watcher for project " << project << project->name();
     m_filter->add(project);
+
+    const QByteArray projectId = QCryptographicHash::hash(project->projectFile().toLocalFile().toUtf8(), QCryptographicHash::Md5).toHex();
+    const QString evaluationCacheFile = KStandardDirs::locateLocal("cache", "kdevcmake/" + QString::fromLatin1(projectId));
+    m_evaluationCaches[project] = QSharedPointer<CMakeEvaluationCache>(new CMakeEvaluationCache(evaluationCacheFile));
     
     KUrl cachefile=CMake::currentBuildDir(project);
     if( cachefile.isEmpty() ) {
@@ -398,6 +408,10 @@ void CMakeManager::dirtyFile(const QString & dirty)
                 job->start();
             }
         }
+        else if(dirty.endsWith(".cmake"))
+        {
+            reloadDependentDirectories(p, dirty);
+        }
     }
     else if(dirtyFile.fileName()=="CMakeCache.txt")
     {
@@ -414,11 +428,37 @@ void CMakeManager::dirtyFile(const QString & dirty)
         foreach(KDevelop::IProject* project, m_watchers.uniqueKeys())
         {
             if(m_watchers[project]->files().contains(dirty))
-                reload(project->projectItem());
+                reloadDependentDirectories(project, dirty);
         }
     }
 }
 
+void CMakeManager::reloadDependentDirectories(IProject* p, const QString& file)
+{
+    QSharedPointer<CMakeEvaluationCache> cache = m_evaluationCaches.value(p);
+    const Path::List directories = cache->dependentDirectories(file);
+    if(directories.isEmpty() || cache->isConfigurationFile(file)) {
+        reload(p->projectItem());
+        return;
+    }
+
+    //Reloading a directory evaluates its sub-directories as well
+    foreach(const Path& directory, directories) {
+        bool nested = false;
+        foreach(const Path& other, directories) {
+            nested = nested || other.isParentOf(directory);
+        }
+        if(nested)
+            continue;
+
+        QList<ProjectFolderItem*> folders = p->foldersForPath(IndexedString(directory.pathOrUrl()));
+        if(folders.isEmpty())
+            reload(p->projectItem());
+        else
+            reload(folders.first());
+    }
+}
+
 QList< KDevelop::ProjectTargetItem * > CMakeManager::targets(KDevelop::ProjectFolderItem * folder) const
 {
     return folder->targetList();
@@ -835,7 +875,14 @@ QPair<QString, QString> CMakeManager::cacheValue(KDevelop::IProject* project, co
 void CMakeManager::projectClosing(IProject* p)
 {
     delete m_projectsData.take(p); 
-    delete m_watchers.take(p);
+    //Running import jobs keep the cache until they stored their results
+    if(QSharedPointer<CMakeEvaluationCache> cache = m_evaluationCaches.take(p)) {
+        cache->save();
+    }
+    {
+        QMutexLocker lock(&m_watchersMutex);
+        delete m_watchers.take(p);
+    }
 
     m_filter->remove(p);
 
@@ -870,6 +917,8 @@ CMakeFolderItem* CMakeManager::takePending(const Path& path)
 
 void CMakeManager::addWatcher(IProject* p, const QString& path)
 {
+    //Called by the import-jobs, which evaluate several directories at once
+    QMutexLocker lock(&m_watchersMutex);
     if (QFileSystemWatcher* watcher = m_watchers.value(p)) {
         watcher->addPath(path);
     } else {
@@ -889,6 +938,11 @@ CMakeProjectData CMakeManager::projectData(IProject* project)
     return *data;
 }
 
+QSharedPointer<CMakeEvaluationCache> CMakeManager::evaluationCache(IProject* project) const
+{
+    return m_evaluationCaches.value(project);
+}
+
 ProjectFilterManager* CMakeManager::filterManager() const
 {
     return m_filter;
@@ -24,6 +24,8 @@
 
 #include <QList>
 #include <QString>
+#include <QMutex>
+#include <QSharedPointer>
 #include <QtCore/QVariant>
 
 #include <project/interfaces/iprojectfilemanager.h>
@@ -65,6 +67,7 @@ namespace KDevelop
 }
 
 class CMakeFolderItem;
+class CMakeEvaluationCache;
 
 class CMakeManager
     : public KDevelop::IPlugin
@@ -131,12 +134,16 @@ public:
     void addWatcher(KDevelop::IProject* p, const QString& path);
     
     CMakeProjectData projectData(KDevelop::IProject* project);
+    ///Import jobs share the cache, so it stays alive until they are done with it when the project is closed
+    QSharedPointer<CMakeEvaluationCache> evaluationCache(KDevelop::IProject* project) const;
 
     KDevelop::ProjectFilterManager* filterManager() const;
 
 signals:
     void folderRenamed(const KDevelop::Path& oldFolder, KDevelop::ProjectFolderItem* newFolder);
     void fileRenamed(const KDevelop::Path& oldFile, KDevelop::ProjectFileItem* newFile);
+    ///Emitted when the include-directories or definitions of @p item or the targets in it changed
+    void includesAndDefinesChanged(KDevelop::ProjectBaseItem* item);
 
 private slots:
     void dirtyFile(const QString& file);
@@ -154,9 +161,13 @@ private:
     bool renameFileOrFolder(KDevelop::ProjectBaseItem *item, const KDevelop::Path &newUrl);
     void realDirectoryChanged(const QString& dir);
     void deletedWatchedDirectory(KDevelop::IProject* p, const KUrl& dir);
+    ///Evaluates the directories that read @p file again
+    void reloadDependentDirectories(KDevelop::IProject* p, const QString& file);
     
     QHash<KDevelop::IProject*, CMakeProjectData*> m_projectsData;
+    QHash<KDevelop::IProject*, QSharedPointer<CMakeEvaluationCache> > m_evaluationCaches;
     QHash<KDevelop::IProject*, QFileSystemWatcher*> m_watchers;
+    QMutex m_watchersMutex;
     QHash<KDevelop::Path, CMakeFolderItem*> m_pending;
     
     KDevelop::ICodeHighlighting *m_highlight;
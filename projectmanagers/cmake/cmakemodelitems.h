@@ -73,6 +73,9 @@ class KDEVCMAKECOMMON_EXPORT CompilationDataAttached
         CMakeDefinitions definitions(CMakeFolderItem* parent) const;
         void setDefinitions(const CMakeDefinitions& defs) { m_defines=defs; }
         void addDefinitions(const QStringList& vars);
+        ///Whether the include-directories and definitions set on this item equal the ones of @p other
+        bool hasSameCompilationData(const CompilationDataAttached& other) const
+            { return m_includeList == other.m_includeList && m_defines == other.m_defines; }
 
     private:
         CMakeDefinitions m_defines;
@@ -2,6 +2,8 @@
 #define CMAKEPROJECTDATA_H
 
 #include <QStringList>
+#include <QSet>
+#include <QPair>
 #include "cmaketypes.h"
 
 struct CMakeProjectData
@@ -18,6 +20,31 @@ struct CMakeProjectData
     CMakeDefinitions definitions;
     QStringList modulePath;
     QHash<QString,QString> targetAlias;
+    ///The files read by the last evaluated script, starting with the script itself
+    QStringList includedFiles;
+
+    ///Set for evaluations that may be thrown away, see CMakeProjectVisitor::setSpeculative()
+    bool speculative;
+    ///Whether a speculative evaluation skipped running a process
+    bool skippedProcesses;
+    ///The properties read by speculative evaluations, by category
+    QMap<PropertyType, QSet<QString> > readProperties;
+    ///The files whose du-chain contexts were created by speculative evaluations
+    QStringList createdContexts;
+    ///Only the du-chain contexts of the files below this directory, but not below the sibling directories,
+    ///are built. Empty for evaluations that build all contexts, see CMakeProjectVisitor::setOwnedDirectory()
+    QString ownedDirectory;
+    QStringList siblingDirectories;
+    ///The files whose du-chain contexts were built by the evaluations
+    QSet<QString> builtContexts;
+    ///The files that were evaluated without building their contexts, since other evaluations own them
+    QSet<QString> sharedContexts;
+    ///The files that imported the contexts of such files, see CMakeProjectVisitor::sharedImports()
+    QList<QPair<QString, QString> > sharedImports;
+    ///Whether a declaration was missing in the context of a file that was not owned
+    bool skippedDeclarations;
+
+    CMakeProjectData() : speculative(false), skippedProcesses(false), skippedDeclarations(false) {}
     
     void clear() { vm.clear(); mm.clear(); properties.clear(); cache.clear(); targetAlias.clear(); }
 };
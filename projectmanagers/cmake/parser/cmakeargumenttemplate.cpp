@@ -0,0 +1,122 @@
+/* KDevelop CMake Support
+ *
+ * Copyright 2014 KDevelop developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+
+#include "cmakeargumenttemplate.h"
+
+#include <QStack>
+#include <QtAlgorithms>
+
+struct CMakeArgumentTemplate::Reference
+{
+    Reference(int open = -1, int close = -1) : open(open), close(close) {}
+    ///Positions of the braces
+    int open, close;
+
+    bool operator<(const Reference& other) const { return open < other.open; }
+};
+
+CMakeArgumentTemplate::Ptr CMakeArgumentTemplate::compile(const QString& value)
+{
+    //Find the references the same way CMakeProjectVisitor::parseArgument does
+    QStack<int> opened;
+    QVector<Reference> references;
+    bool gotDollar=false;
+    for(int i=value.indexOf('$'); i<value.size() && i>=0; i++)
+    {
+        switch(value[i].unicode())
+        {
+            case '$':
+                gotDollar=true;
+                break;
+            case '{':
+                if(gotDollar)
+                    opened.push(i);
+                gotDollar=false;
+                break;
+            case '}':
+                if(!opened.isEmpty()) {
+                    int open = opened.pop();
+                    references += Reference(open, i);
+                }
+                break;
+        }
+    }
+    if(references.isEmpty() || !opened.isEmpty())
+        return Ptr();
+
+    //The references were found in the order they are closed, nested ones first
+    qSort(references);
+
+    CMakeArgumentTemplate* ret = new CMakeArgumentTemplate;
+    Ptr ptr(ret);
+    int index = 0;
+    if(!compileRange(value, 0, value.size(), references, index, ret))
+        return Ptr();
+    return ptr;
+}
+
+bool CMakeArgumentTemplate::compileRange(const QString& value, int begin, int end,
+                                         const QVector<Reference>& references, int& index, CMakeArgumentTemplate* into)
+{
+    int last = begin;
+    while(index < references.size() && references[index].open < end)
+    {
+        const Reference reference = references[index++];
+        const int dollar = value.lastIndexOf('$', reference.open);
+        if(dollar < last)
+            return false; //the key would overlap the previous reference
+
+        if(dollar > last) {
+            Segment literal;
+            literal.text = value.mid(last, dollar-last);
+            into->m_segments += literal;
+        }
+
+        Segment segment;
+        const QStringRef key = value.midRef(dollar+1, reference.open-dollar-1);
+        if(key.isEmpty())
+            segment.type = Variable;
+        else if(key == QLatin1String("ENV"))
+            segment.type = EnvironmentVariable;
+        else
+            segment.type = UnknownVariable;
+
+        if(index < references.size() && references[index].open < reference.close) {
+            CMakeArgumentTemplate* name = new CMakeArgumentTemplate;
+            segment.name = Ptr(name);
+            if(!compileRange(value, reference.open+1, reference.close, references, index, name))
+                return false;
+        } else {
+            segment.text = value.mid(reference.open+1, reference.close-reference.open-1);
+            if(segment.type == Variable)
+                segment.variable = VariableMap::id(segment.text);
+        }
+        into->m_segments += segment;
+        last = reference.close+1;
+    }
+
+    if(last < end) {
+        Segment literal;
+        literal.text = value.mid(last, end-last);
+        into->m_segments += literal;
+    }
+    return true;
+}
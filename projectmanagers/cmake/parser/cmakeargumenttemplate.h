@@ -0,0 +1,82 @@
+/* KDevelop CMake Support
+ *
+ * Copyright 2014 KDevelop developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+
+#ifndef CMAKEARGUMENTTEMPLATE_H
+#define CMAKEARGUMENTTEMPLATE_H
+
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+#include "cmakeexport.h"
+#include "variablemap.h"
+
+/**
+ * The compiled form of an argument that references variables, like "${PREFIX}/${DIR_${NAME}}".
+ * It is a sequence of literal segments and variable references. The name of a reference
+ * can again contain references, those are stored as a nested template.
+ *
+ * Arguments are compiled once when they are parsed, so the visitor does not have to look
+ * for the references whenever it evaluates them.
+ */
+class KDEVCMAKECOMMON_EXPORT CMakeArgumentTemplate
+{
+    public:
+        typedef QSharedPointer<const CMakeArgumentTemplate> Ptr;
+
+        enum SegmentType {
+            Literal,
+            ///${NAME}
+            Variable,
+            ///$ENV{NAME}
+            EnvironmentVariable,
+            ///Any other $KEY{NAME}, which always evaluates to nothing
+            UnknownVariable
+        };
+
+        struct Segment
+        {
+            Segment() : type(Literal), variable(0) {}
+            SegmentType type;
+            ///The literal text, or the name of the reference if it doesn't contain references itself
+            QString text;
+            ///The name of the reference if it contains references itself
+            Ptr name;
+            ///The interned name of a Variable reference that doesn't contain references itself
+            VariableMap::Id variable;
+        };
+
+        /**
+         * Compiles @p value. Returns a null pointer if @p value doesn't reference variables, or if
+         * its braces don't match up, in that case it has to be evaluated the conventional way.
+         */
+        static Ptr compile(const QString& value);
+
+        const QVector<Segment>& segments() const { return m_segments; }
+
+    private:
+        struct Reference;
+        static bool compileRange(const QString& value, int begin, int end,
+                                 const QVector<Reference>& references, int& index, CMakeArgumentTemplate* into);
+
+        QVector<Segment> m_segments;
+};
+
+#endif
@@ -31,6 +31,7 @@ QMap<QString, CMakeCondition::conditionToken> initNameToToken()
     ret["AND"]=CMakeCondition::AND;
     ret["OR"]=CMakeCondition::OR;
     ret["COMMAND"]=CMakeCondition::COMMAND;
+    ret["TARGET"]=CMakeCondition::TARGET;
     ret["EXISTS"]=CMakeCondition::EXISTS;
     ret["IS_NEWER_THAN"]=CMakeCondition::IS_NEWER_THAN;
     ret["IS_DIRECTORY"]=CMakeCondition::IS_DIRECTORY;
@@ -220,6 +221,11 @@ bool CMakeCondition::evaluateCondition(QStringList::const_iterator itBegin, QStr
                 last=m_vars->contains(*(it2+1));
                 itEnd=it2;
                 break;
+            case TARGET:
+                CHECK_NEXT(it2);
+                last=m_visitor->hasTarget(*(it2+1));
+                itEnd=it2;
+                break;
             case AND:
                 CHECK_PREV(it2);
 //                 qDebug() << "AND" << last;
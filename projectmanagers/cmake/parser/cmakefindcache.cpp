@@ -0,0 +1,124 @@
+/* KDevelop CMake Support
+ *
+ * Copyright 2014 KDevelop developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#include "cmakefindcache.h"
+#include <QFile>
+
+CMakeFindCache::CMakeFindCache()
+    : m_generation(0)
+    , m_enabled(true)
+{
+}
+
+CMakeFindCache& CMakeFindCache::self()
+{
+    static CMakeFindCache cache;
+    return cache;
+}
+
+QString CMakeFindCache::key(const QString& file, const QStringList& folders, const QStringList& suffixes, bool location)
+{
+    return file + '\n' + folders.join(";") + '\n' + suffixes.join(";") + (location ? "\nL" : "\nF");
+}
+
+bool CMakeFindCache::lookup(const QString& key, QString& result)
+{
+    if(!m_enabled)
+        return false;
+
+    QMutexLocker lock(&m_mutex);
+    ++m_statistics.lookups;
+    QHash<QString, Entry>::const_iterator it = m_entries.constFind(key);
+    if(it == m_entries.constEnd())
+        return false;
+
+    ++m_statistics.hits;
+    m_statistics.probesSaved += it->probes;
+    result = it->result;
+    return true;
+}
+
+void CMakeFindCache::insert(const QString& key, const QString& result, uint probes)
+{
+    QMutexLocker lock(&m_mutex);
+    m_statistics.probes += probes;
+    if(!m_enabled)
+        return;
+
+    //Repeating a dropped search only costs its file-system probes again, so any entry can make room
+    if(m_entries.size() >= MaxEntries && !m_entries.contains(key))
+        m_entries.erase(m_entries.begin());
+    Entry entry;
+    entry.result = result;
+    entry.probes = probes;
+    m_entries.insert(key, entry);
+}
+
+bool CMakeFindCache::exists(const QString& path)
+{
+    const QString existsKey = "exists\n" + path;
+    QString result;
+    if(lookup(existsKey, result))
+        return !result.isEmpty();
+
+    const bool ret = QFile::exists(path);
+    insert(existsKey, ret ? path : QString(), 1);
+    return ret;
+}
+
+void CMakeFindCache::increaseGeneration()
+{
+    QMutexLocker lock(&m_mutex);
+    ++m_generation;
+    m_entries.clear();
+}
+
+uint CMakeFindCache::generation() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_generation;
+}
+
+void CMakeFindCache::setEnabled(bool enabled)
+{
+    QMutexLocker lock(&m_mutex);
+    m_enabled = enabled;
+    if(!enabled)
+        m_entries.clear();
+}
+
+bool CMakeFindCache::isEnabled() const
+{
+    return m_enabled;
+}
+
+CMakeFindCache::Statistics CMakeFindCache::statistics() const
+{
+    QMutexLocker lock(&m_mutex);
+    Statistics ret = m_statistics;
+    ret.entries = m_entries.size();
+    return ret;
+}
+
+void CMakeFindCache::resetStatistics()
+{
+    QMutexLocker lock(&m_mutex);
+    m_statistics = Statistics();
+}
@@ -0,0 +1,97 @@
+/* KDevelop CMake Support
+ *
+ * Copyright 2014 KDevelop developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef CMAKEFINDCACHE_H
+#define CMAKEFINDCACHE_H
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include "cmakeexport.h"
+
+/**
+ * Remembers the results of the file-system searches done by find_package, find_path,
+ * find_library, find_file and find_program. The same packages and files are searched
+ * with the same paths by most directories of a project.
+ *
+ * The results are kept until the generation is increased, which is done whenever an
+ * import job starts, also for the reload of a single directory, so every import sees
+ * the changes of the file-system.
+ * The cache is shared by all visitors and is thread-safe.
+ */
+class KDEVCMAKECOMMON_EXPORT CMakeFindCache
+{
+    public:
+        enum { MaxEntries = 16384 };
+
+        struct Statistics
+        {
+            Statistics() : lookups(0), hits(0), probes(0), probesSaved(0), entries(0) {}
+            uint lookups;
+            uint hits;
+            ///File-system probes done for the lookups that were not cached
+            uint probes;
+            ///File-system probes that the hits would have needed
+            uint probesSaved;
+            uint entries;
+        };
+
+        static CMakeFindCache& self();
+
+        ///The key of a search for @p file in @p folders with the sub-directories @p suffixes
+        static QString key(const QString& file, const QStringList& folders, const QStringList& suffixes, bool location);
+
+        ///Returns whether a result is cached for @p key, and stores it in @p result
+        bool lookup(const QString& key, QString& result);
+        ///Remembers the @p result of a search that needed @p probes file-system probes
+        void insert(const QString& key, const QString& result, uint probes);
+
+        ///Cached QFile::exists()
+        bool exists(const QString& path);
+
+        ///Drops all results, the following searches go to the file-system again
+        void increaseGeneration();
+        uint generation() const;
+
+        ///While disabled, nothing is cached
+        void setEnabled(bool enabled);
+        bool isEnabled() const;
+
+        Statistics statistics() const;
+        void resetStatistics();
+
+    private:
+        CMakeFindCache();
+
+        struct Entry
+        {
+            QString result;
+            uint probes;
+        };
+
+        mutable QMutex m_mutex;
+        QHash<QString, Entry> m_entries;
+        Statistics m_statistics;
+        uint m_generation;
+        bool m_enabled;
+};
+
+#endif
@@ -241,6 +241,8 @@ bool CMakeFunctionDesc::operator==(const CMakeFunctionDesc & other) const
 CMakeFunctionArgument::CMakeFunctionArgument(const QString& v, bool q, quint32 l, quint32 c)
     : value(unescapeValue(v)), quoted(q), line(l), column(c)
 {
+    if(value.contains('$'))
+        compiled=CMakeArgumentTemplate::compile(value);
 }
 
 CMakeFunctionArgument::CMakeFunctionArgument(const QString& v)
@@ -33,6 +33,7 @@
 
 // #include "cmakemodelitems.h"
 #include "cmListFileLexer.h"
+#include "cmakeargumenttemplate.h"
 #include <cmakeexport.h>
 #include <language/editor/rangeinrevision.h>
 
@@ -69,6 +70,8 @@ struct CMakeFunctionArgument
     bool quoted;
     quint32 line;
     quint32 column;
+    ///The compiled form of value if it references variables, set for the arguments read from a file
+    CMakeArgumentTemplate::Ptr compiled;
     static const QMap<QChar, QChar> scapings;
 };
 Q_DECLARE_METATYPE( CMakeFunctionArgument )
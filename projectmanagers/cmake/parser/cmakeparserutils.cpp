@@ -190,6 +190,8 @@ namespace CMakeParserUtils
         v.setEnvironmentProfile(env);
         v.setProperties(data->properties);
         v.setDefinitions(data->definitions);
+        v.setSpeculative(data->speculative);
+        v.setOwnedDirectory(data->ownedDirectory, data->siblingDirectories);
         v.walk(f, 0, true);
         
         data->projectName=v.projectName();
@@ -199,6 +201,16 @@ namespace CMakeParserUtils
         data->testSuites=v.testSuites();
         data->targetAlias=v.targetAlias();
         data->definitions=v.definitions();
+        data->includedFiles=QStringList(file) + v.includedFiles();
+        data->skippedProcesses |= v.skippedProcesses();
+        const QMap<PropertyType, QSet<QString> > readProperties = v.readProperties();
+        for(QMap<PropertyType, QSet<QString> >::const_iterator it = readProperties.constBegin(); it != readProperties.constEnd(); ++it)
+            data->readProperties[it.key()] += *it;
+        data->createdContexts += v.createdContexts();
+        data->builtContexts += v.builtContexts();
+        data->sharedContexts += v.sharedContexts();
+        data->sharedImports += v.sharedImports();
+        data->skippedDeclarations |= v.skippedDeclarations();
         
         //printSubdirectories(data->subdirectories);
         
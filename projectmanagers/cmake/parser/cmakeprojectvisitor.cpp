@@ -24,6 +24,7 @@
 #include "astfactory.h"
 #include "cmakeduchaintypes.h"
 #include "cmakeparserutils.h"
+#include "cmakefindcache.h"
 
 #include <language/editor/simplerange.h>
 #include <language/duchain/topducontext.h>
@@ -63,6 +64,7 @@ CMakeProjectVisitor::message_callback CMakeProjectVisitor::s_msgcallback=debugMs
 CMakeProjectVisitor::CMakeProjectVisitor(const QString& root, ReferencedTopDUContext parent)
     : m_root(root), m_vars(0), m_macros(0), m_cache(0)
     , m_topctx(0), m_parentCtx(parent), m_hitBreak(false), m_hitReturn(false)
+    , m_speculative(false), m_skippedProcesses(false), m_readOnly(false), m_skippedDeclarations(false)
 {
 }
 
@@ -136,14 +138,27 @@ QList< CMakeProjectVisitor::IntPair > CMakeProjectVisitor::parseArgument(const Q
 
 QStringList CMakeProjectVisitor::variableValue(const QString& var) const
 {
-    VariableMap::const_iterator it=m_vars->constFind(var);
-    if(it!=m_vars->constEnd())
-        return *it;
-    else {
-        CacheValues::const_iterator it=m_cache->constFind(var);
-        if(it!=m_cache->constEnd())
-            return it->value.split(';');
-    }
+    if(const QStringList* value=m_vars->constFind(var))
+        return *value;
+    return cacheValue(var);
+}
+
+QStringList CMakeProjectVisitor::variableValue(VariableMap::Id id, const QString& var) const
+{
+    if(const QStringList* value=m_vars->constFind(id))
+        return *value;
+    return cacheValue(var);
+}
+
+QStringList CMakeProjectVisitor::cacheValue(const QString& var) const
+{
+    QHash<QString, QStringList>::const_iterator itList=m_cacheLists.constFind(var);
+    if(itList!=m_cacheLists.constEnd())
+        return *itList;
+
+    CacheValues::const_iterator it=m_cache->constFind(var);
+    if(it!=m_cache->constEnd())
+        return *m_cacheLists.insert(var, it->value.split(';'));
     return QStringList();
 }
 
@@ -213,8 +228,67 @@ QStringList CMakeProjectVisitor::value(const QString& exp, const QList<IntPair>&
     return theValue(var, invars.last());
 }
 
+QStringList CMakeProjectVisitor::referenceValue(const CMakeArgumentTemplate::Segment& reference) const
+{
+    QString name;
+    if(reference.name) {
+        //Nested references are expanded as text
+        foreach(const CMakeArgumentTemplate::Segment& segment, reference.name->segments()) {
+            if(segment.type==CMakeArgumentTemplate::Literal)
+                name += segment.text;
+            else
+                name += referenceValue(segment).join(QChar(';'));
+        }
+    } else
+        name = reference.text;
+
+    switch(reference.type)
+    {
+        case CMakeArgumentTemplate::Variable:
+            if(!reference.name)
+                return variableValue(reference.variable, name);
+            return variableValue(name);
+        case CMakeArgumentTemplate::EnvironmentVariable:
+            return envVarDirectories(name);
+        default:
+            kDebug() << "error: I do not understand the key of: " << name;
+            return QStringList();
+    }
+}
+
+QStringList CMakeProjectVisitor::resolveTemplate(const CMakeArgumentTemplate& argument, bool quoted) const
+{
+    QStringList ret;
+    ret += QString();
+    foreach(const CMakeArgumentTemplate::Segment& segment, argument.segments())
+    {
+        if(segment.type==CMakeArgumentTemplate::Literal) {
+            ret.last() += segment.text;
+            continue;
+        }
+
+        //The first element continues the current one, the others are separate elements
+        const QStringList values = referenceValue(segment);
+        QStringList::const_iterator it=values.constBegin(), itEnd=values.constEnd();
+        if(it!=itEnd)
+            ret.last() += *it++;
+        for(; it!=itEnd; ++it)
+            ret += *it;
+    }
+
+    if(quoted) {
+        ret=QStringList(ret.join(QChar(';')));
+    } else if(ret.size()==1 && ret.first().isEmpty()) {
+        ret.clear();
+    }
+    return ret;
+}
+
 QStringList CMakeProjectVisitor::resolveVariable(const CMakeFunctionArgument &exp)
 {
+    if(exp.compiled)
+        return resolveTemplate(*exp.compiled, exp.quoted);
+
     QStringList ret;
     ret += QString();
     QList< IntPair > var = parseArgument(exp.value);
@@ -263,6 +337,20 @@ bool CMakeProjectVisitor::hasMacro(const QString& name) const
     return m_macros->contains(name);
 }
 
+bool CMakeProjectVisitor::hasTarget(const QString& name) const
+{
+    const QString target = m_targetAlias.value(name, name);
+    readProperty(TargetProperty, target);
+    return m_props.value(TargetProperty).contains(target);
+}
+
+void CMakeProjectVisitor::readProperty(PropertyType type, const QString& key) const
+{
+    //Only speculative evaluations are checked for what they read
+    if(m_speculative)
+        m_readProperties[type] += key;
+}
+
 int CMakeProjectVisitor::visit(const CMakeAst *ast)
 {
     kDebug(9042) << "error! function not implemented" << ast->content()[ast->line()].name;
@@ -343,6 +431,7 @@ int CMakeProjectVisitor::visit( const GetTargetPropAst * prop)
     kDebug(9042) << "getting target " << targetName << " prop " << prop->property() << prop->variableName();
     QStringList value;
     
+    readProperty(TargetProperty, m_targetAlias.value(targetName, targetName));
     CategoryType& category = m_props[TargetProperty];
     CategoryType::iterator itTarget = category.find(m_targetAlias.value(targetName, targetName));
     if(itTarget!=category.end()) {
@@ -433,7 +522,9 @@ void CMakeProjectVisitor::defineTarget(const QString& _id, const QStringList& so
     VisitorState p=stackTop();
 
     Declaration *d=0;
-    if(!p.code->at(p.line).arguments.isEmpty()) {
+    if(!isOwned(p.code->at(p.line).filePath)) {
+        m_skippedDeclarations = true;
+    } else if(!p.code->at(p.line).arguments.isEmpty()) {
         DUChainWriteLocker lock(DUChain::lock());
         d= new Declaration(p.code->at(p.line).arguments.first().range(), p.context);
         d->setIdentifier( Identifier(id) );
@@ -566,6 +657,11 @@ QString CMakeProjectVisitor::findFile(const QString &file, const QStringList &fo
     if( file.isEmpty() || QFileInfo(file).isAbsolute() )
          return file;
 
+    const QString cacheKey = CMakeFindCache::key(file, folders, suffixes, location);
+    QString cached;
+    if(CMakeFindCache::self().lookup(cacheKey, cached))
+        return cached;
+
     QStringList suffixFolders, useSuffixes(suffixes);
     useSuffixes.prepend(QString());
     foreach(const QString& apath, folders)
@@ -578,11 +674,13 @@ QString CMakeProjectVisitor::findFile(const QString &file, const QStringList &fo
     suffixFolders.removeDuplicates();
 
     KUrl path;
+    uint probes = 0;
     foreach(const QString& mpath, suffixFolders)
     {
         if(mpath.isEmpty())
             continue;
 
+        ++probes;
         KUrl afile(mpath);
         afile.addPath(file);
         kDebug(9042) << "Trying:" << mpath << '.' << file;
@@ -597,7 +695,9 @@ QString CMakeProjectVisitor::findFile(const QString &file, const QStringList &fo
         }
     }
     //kDebug(9042) << "find file" << file << "into:" << folders << "found at:" << path;
-    return path.toLocalFile(KUrl::RemoveTrailingSlash);
+    const QString ret = path.toLocalFile(KUrl::RemoveTrailingSlash);
+    CMakeFindCache::self().insert(cacheKey, ret, probes);
+    return ret;
 }
 
 int CMakeProjectVisitor::visit(const IncludeAst *inc)
@@ -622,6 +722,7 @@ int CMakeProjectVisitor::visit(const IncludeAst *inc)
         m_vars->insertMulti("CMAKE_CURRENT_LIST_FILE", QStringList(path));
         m_vars->insertMulti("CMAKE_CURRENT_LIST_DIR", QStringList(KUrl(path).directory()));
         CMakeFileContent include = CMakeListsParser::readCMakeFile(path);
+        m_includedFiles += path;
         if ( !include.isEmpty() )
         {
             kDebug(9042) << "including:" << path;
@@ -699,7 +800,7 @@ int CMakeProjectVisitor::visit(const FindPackageAst *pack)
     QSet<QString> handled;
     foreach(const QString& lookup, lookupPaths)
     {
-        if(!QFile::exists(lookup) || handled.contains(lookup)) {
+        if(handled.contains(lookup) || !CMakeFindCache::self().exists(lookup)) {
             continue;
         }
         foreach(const QString& post, postfix)
@@ -769,6 +870,7 @@ int CMakeProjectVisitor::visit(const FindPackageAst *pack)
         m_vars->insert(pack->name()+"_FIND_VERSION_COUNT", QStringList(QString::number(version.size())));
         
         CMakeFileContent package=CMakeListsParser::readCMakeFile( path );
+        m_includedFiles += path;
         if ( !package.isEmpty() )
         {
             path=KUrl(path).pathOrUrl();
@@ -830,6 +932,8 @@ KDevelop::ReferencedTopDUContext CMakeProjectVisitor::createContext(const Indexe
         env->setLanguage(IndexedString("cmake"));
         topctx=new TopDUContext(idxpath, RangeInRevision(0,0, endl, endc), env);
         DUChain::self()->addDocumentChain(topctx);
+        if(m_speculative)
+            m_createdContexts += idxpath.str();
 
         Q_ASSERT(DUChain::self()->chainForDocument(idxpath));
     }
@@ -849,6 +953,28 @@ KDevelop::ReferencedTopDUContext CMakeProjectVisitor::createContext(const Indexe
     return topctx;
 }
 
+KDevelop::ReferencedTopDUContext CMakeProjectVisitor::sharedContext(const IndexedString& idxpath, ReferencedTopDUContext aux)
+{
+    DUChainWriteLocker lock(DUChain::lock());
+    KDevelop::ReferencedTopDUContext topctx=DUChain::self()->chainForDocument(idxpath);
+    if(topctx && aux)
+        aux->addImportedParentContext(topctx);
+    return topctx;
+}
+
+bool CMakeProjectVisitor::isOwned(const QString& file) const
+{
+    if(m_ownedDirectory.isEmpty())
+        return true;
+    if(!file.startsWith(m_ownedDirectory + '/'))
+        return false;
+    foreach(const QString& sibling, m_siblingDirectories) {
+        if(file.startsWith(sibling + '/'))
+            return false;
+    }
+    return true;
+}
+
 bool CMakeProjectVisitor::haveToFind(const QString &varName)
 {
     if(m_vars->contains(varName+"_FOUND"))
@@ -1167,7 +1293,7 @@ void CMakeProjectVisitor::macroDeclaration(const CMakeFunctionDesc& def, const C
     RangeInRevision sr=def.arguments.first().range();
     RangeInRevision endsr=end.arguments.first().range();
     DUChainWriteLocker lock;
-    QList<Declaration*> decls=m_topctx->findDeclarations(identifier);
+    QList<Declaration*> decls=m_topctx ? m_topctx->findDeclarations(identifier) : QList<Declaration*>();
     
     //Only consider declarations in a CMake file
     IndexedString cmakeName("cmake");
@@ -1178,6 +1304,11 @@ void CMakeProjectVisitor::macroDeclaration(const CMakeFunctionDesc& def, const C
             it = decls.erase(it);
     }
 
+    if(m_readOnly) {
+        m_skippedDeclarations |= decls.isEmpty();
+        return;
+    }
+
     int idx;
     if(!decls.isEmpty())
     {
@@ -1262,6 +1393,7 @@ int CMakeProjectVisitor::visit(const MacroCallAst *call)
         }
         else
         {
+            if(!m_readOnly)
             {
                 DUChainWriteLocker lock;
                 QList<Declaration*> decls=m_topctx->findDeclarations(Identifier(call->name().toLower()));
@@ -1337,7 +1469,7 @@ static void usesForArguments(const QStringList& names, const QList<int>& args, c
                              const CMakeFunctionDesc& func)
 {
     //TODO: Should not return here
-    if(args.size()!=names.size())
+    if(!topctx || args.size()!=names.size())
         return;
 
     //We define the uses for the used variable without ${}
@@ -1384,7 +1516,7 @@ int CMakeProjectVisitor::visit(const IfAst *ifast)  //Highly crappy code
             if(inside<=0) {
 //                 Q_ASSERT(!ini.isEmpty());
                 if(!funcDesc.arguments.isEmpty())
-                    usesForArguments(ifast->condition(), ini, m_topctx, funcDesc);
+                    usesForArguments(ifast->condition(), ini, writableContext(), funcDesc);
                 break;
             }
 //                 kDebug(9042) << "found an endif at:" << lines << "but" << inside;
@@ -1419,14 +1551,14 @@ int CMakeProjectVisitor::visit(const IfAst *ifast)  //Highly crappy code
                 if(funcName=="if")
                     ini=cond.variableArguments();
 
-                usesForArguments(condition, cond.variableArguments(), m_topctx, funcDesc);
+                usesForArguments(condition, cond.variableArguments(), writableContext(), funcDesc);
                 kDebug(9042) << ">> " << funcName << condition << result;
             }
             else if(funcName=="else")
             {
                 kDebug(9042) << ">> else";
                 result=true;
-                usesForArguments(ifast->condition(), ini, m_topctx, funcDesc);
+                usesForArguments(ifast->condition(), ini, writableContext(), funcDesc);
             }
 
             if(!visited && result)
@@ -1454,6 +1586,11 @@ int CMakeProjectVisitor::visit(const IfAst *ifast)  //Highly crappy code
 
 int CMakeProjectVisitor::visit(const ExecProgramAst *exec)
 {
+    if(m_speculative) {
+        m_skippedProcesses = true;
+        return 1;
+    }
+
     QString execName = exec->executableName();
     QStringList argsTemp = exec->arguments();
     QStringList args;
@@ -1500,6 +1637,11 @@ int CMakeProjectVisitor::visit(const ExecProgramAst *exec)
 
 int CMakeProjectVisitor::visit(const ExecuteProcessAst *exec)
 {
+    if(m_speculative) {
+        m_skippedProcesses = true;
+        return 1;
+    }
+
     kDebug(9042) << "executing... " << exec->commands();
     QList<KProcess*> procs;
     foreach(const QStringList& _args, exec->commands())
@@ -2208,6 +2350,7 @@ int CMakeProjectVisitor::visit(const GetPropertyAst* getp)
                 catn = getp->typeName();
                 break;
         }
+        readProperty(getp->type(), catn);
         retv = m_props[getp->type()][catn][getp->name()];
     }
     m_vars->insert(getp->outputVariable(), retv);
@@ -2228,6 +2371,7 @@ int CMakeProjectVisitor::visit(const GetDirPropertyAst* getdp)
         dir=u.path();
     }
     
+    readProperty(DirectoryProperty, dir);
     retv=m_props[DirectoryProperty][dir][getdp->propName()];
     m_vars->insert(getdp->outputVariable(), retv);
     
@@ -2251,14 +2395,14 @@ int CMakeProjectVisitor::visit( const WhileAst * whileast)
 {
     CMakeCondition cond(this);
     bool result=cond.condition(whileast->condition());
-    usesForArguments(whileast->condition(), cond.variableArguments(), m_topctx, whileast->content()[whileast->line()]);
+    usesForArguments(whileast->condition(), cond.variableArguments(), writableContext(), whileast->content()[whileast->line()]);
 
     kDebug(9042) << "Visiting While" << whileast->condition() << "?" << result;
     int end = toCommandEnd(whileast);
 
     if(end<whileast->content().size())
     {
-        usesForArguments(whileast->condition(), cond.variableArguments(), m_topctx, whileast->content()[end]);
+        usesForArguments(whileast->condition(), cond.variableArguments(), writableContext(), whileast->content()[end]);
         
         if(result)
         {
@@ -2316,15 +2460,32 @@ int CMakeProjectVisitor::walk(const CMakeFileContent & fc, int line, bool isClea
         return 0;
     
     ReferencedTopDUContext aux=m_topctx;
+    bool auxReadOnly=m_readOnly;
 
     IndexedString url(fc.first().filePath);
     
     if(!m_topctx || m_topctx->url()!=url)
     {
-        kDebug(9042) << "Creating a context for" << url;
-        m_topctx=createContext(url, aux ? aux : m_parentCtx, fc.last().endLine-1, fc.last().endColumn-1, isClean);
-        if(!aux)
+        if(isOwned(url.str())) {
+            kDebug(9042) << "Creating a context for" << url;
+            m_topctx=createContext(url, aux ? aux : m_parentCtx, fc.last().endLine-1, fc.last().endColumn-1, isClean);
+            m_readOnly=false;
+            if(isClean)
+                m_builtContexts += url.str();
+        } else {
+            //Another evaluation builds the context, it is only imported from here
+            kDebug(9042) << "Using the context of" << url;
+            m_topctx=sharedContext(url, auxReadOnly ? ReferencedTopDUContext() : aux);
+            if(aux && !auxReadOnly)
+                m_sharedImports += qMakePair(aux->url().str(), url.str());
+            m_readOnly=true;
+            if(isClean)
+                m_sharedContexts += url.str();
+        }
+        if(!aux) {
             aux=m_topctx;
+            auxReadOnly=m_readOnly;
+        }
     }
     VisitorState p;
     p.code = &fc;
@@ -2345,6 +2506,7 @@ int CMakeProjectVisitor::walk(const CMakeFileContent & fc, int line, bool isClea
         {
             m_backtrace.pop();
             m_topctx=aux;
+            m_readOnly=auxReadOnly;
             
             if(r==Break)
                 m_hitBreak=true;
@@ -2368,7 +2530,7 @@ int CMakeProjectVisitor::walk(const CMakeFileContent & fc, int line, bool isClea
             //FIXME: Should avoid to run?
         }
         
-        if(element->isDeprecated()) {
+        if(element->isDeprecated() && !m_readOnly) {
             kDebug(9032) << "Warning: Using the function: " << func.name << " which is deprecated by cmake.";
             DUChainWriteLocker lock(DUChain::lock());
             KSharedPtr<Problem> p(new Problem);
@@ -2389,6 +2551,8 @@ int CMakeProjectVisitor::walk(const CMakeFileContent & fc, int line, bool isClea
         delete element;
         
         if(line>fc.count()) {
+            if(m_readOnly)
+                break;
             KSharedPtr<Problem> p(new Problem);
             p->setDescription(i18n("Unfinished function. "));
             p->setRange(it->nameRange());
@@ -2403,14 +2567,17 @@ int CMakeProjectVisitor::walk(const CMakeFileContent & fc, int line, bool isClea
     }
     m_backtrace.pop();
     m_topctx=aux;
+    m_readOnly=auxReadOnly;
     kDebug(9042) << "Walk stopped @" << line;
     return line;
 }
 
 void CMakeProjectVisitor::createDefinitions(const CMakeAst *ast)
 {
-    if(!m_topctx)
+    if(!m_topctx) {
+        m_skippedDeclarations |= m_readOnly && !ast->outputArguments().isEmpty();
         return;
+    }
     
     foreach(const CMakeFunctionArgument &arg, ast->outputArguments())
     {
@@ -2421,7 +2588,11 @@ void CMakeProjectVisitor::createDefinitions(const CMakeAst *ast)
         DUChainWriteLocker lock;
         QList<Declaration*> decls=m_topctx->findDeclarations(id);
 
-        if(decls.isEmpty())
+        if(m_readOnly)
+        {
+            m_skippedDeclarations |= decls.isEmpty();
+        }
+        else if(decls.isEmpty())
         {
             Declaration *d = new Declaration(arg.range(), m_topctx);
             d->setIdentifier(id);
@@ -2436,7 +2607,7 @@ void CMakeProjectVisitor::createDefinitions(const CMakeAst *ast)
 
 void CMakeProjectVisitor::createUses(const CMakeFunctionDesc& desc)
 {
-    if(!m_topctx)
+    if(!m_topctx || m_readOnly)
         return;
     foreach(const CMakeFunctionArgument &arg, desc.arguments)
     {
@@ -2464,6 +2635,7 @@ void CMakeProjectVisitor::createUses(const CMakeFunctionDesc& desc)
 void CMakeProjectVisitor::setCacheValues( CacheValues* cache)
 {
     m_cache=cache;
+    m_cacheLists.clear();
 }
 
 void CMakeProjectVisitor::setVariableMap(VariableMap * vars)
@@ -25,9 +25,11 @@
 #include <QStringList>
 #include <QHash>
 #include <QStack>
+#include <QSet>
 
 #include "cmakeastvisitor.h"
 #include "cmaketypes.h"
+#include "cmakeargumenttemplate.h"
 #include <language/duchain/topducontext.h>
 
 class CMakeFunctionDesc;
@@ -107,6 +109,34 @@ class KDEVCMAKECOMMON_EXPORT CMakeProjectVisitor : CMakeAstVisitor
         /** sets the @p profile env variables that will be used to override those in the current system */
         void setEnvironmentProfile(const QMap<QString, QString>& profile) { m_environmentProfile = profile; }
 
+        /**
+         * Marks the evaluation as one that may be thrown away. Processes are not run then, as that
+         * can't be undone, instead skippedProcesses() is set. The properties that are read and the
+         * du-chain contexts that are created are recorded.
+         */
+        void setSpeculative(bool speculative) { m_speculative = speculative; }
+        bool skippedProcesses() const { return m_skippedProcesses; }
+        ///The keys of the properties read by a speculative evaluation, by category. Checking a target counts as reading it.
+        QMap<PropertyType, QSet<QString> > readProperties() const { return m_readProperties; }
+        ///The files whose contexts were created by a speculative evaluation
+        QStringList createdContexts() const { return m_createdContexts; }
+
+        /**
+         * Only the du-chain contexts of the files below @p directory, but not below one of @p siblings, are built,
+         * so evaluations of sibling directories that run at the same time don't build the same context.
+         * The other files are evaluated without changing their contexts, see sharedContexts(). An empty
+         * @p directory allows building all contexts.
+         */
+        void setOwnedDirectory(const QString& directory, const QStringList& siblings) { m_ownedDirectory = directory; m_siblingDirectories = siblings; }
+        ///The files whose contexts were cleaned and built again
+        QSet<QString> builtContexts() const { return m_builtContexts; }
+        ///The files that were evaluated without building their contexts, since the evaluation doesn't own them
+        QSet<QString> sharedContexts() const { return m_sharedContexts; }
+        ///The files that imported the context of such a file, paired with the file, in the order of the imports
+        QList<QPair<QString, QString> > sharedImports() const { return m_sharedImports; }
+        ///Whether a declaration was missing in the context of a file that the evaluation doesn't own
+        bool skippedDeclarations() const { return m_skippedDeclarations; }
+
         const VariableMap* variables() const { return m_vars; }
         const CacheValues* cache() const { return m_cache; }
         CMakeDefinitions definitions() const { return m_defs; }
@@ -116,6 +146,8 @@ class KDEVCMAKECOMMON_EXPORT CMakeProjectVisitor : CMakeAstVisitor
         QVector<Target> targets() const { return m_targetForId.values().toVector(); }
         QStringList resolveDependencies(const QStringList& target) const;
         QVector<Test> testSuites() const { return m_testSuites; }
+        ///The files that were read by include() and find_package() calls
+        QStringList includedFiles() const { return m_includedFiles; }
             
         int walk(const CMakeFileContent& fc, int line, bool isClean=false);
         
@@ -130,6 +162,8 @@ class KDEVCMAKECOMMON_EXPORT CMakeProjectVisitor : CMakeAstVisitor
         QStringList resolveVariable(const CMakeFunctionArgument &exp);
 
         bool hasMacro(const QString& name) const;
+        ///Whether @p name is a target or an alias of one
+        bool hasTarget(const QString& name) const;
 
         struct VisitorState
         {
@@ -166,13 +200,23 @@ class KDEVCMAKECOMMON_EXPORT CMakeProjectVisitor : CMakeAstVisitor
         QStringList envVarDirectories(const QString &varName) const;
         static message_callback s_msgcallback;
         
-        static KDevelop::ReferencedTopDUContext
+        KDevelop::ReferencedTopDUContext
             createContext(const KDevelop::IndexedString& path, KDevelop::ReferencedTopDUContext aux, int endl ,int endc, bool isClean);
+        ///Returns the existing context of a file that is not owned by this evaluation, and lets @p aux import it
+        KDevelop::ReferencedTopDUContext sharedContext(const KDevelop::IndexedString& path, KDevelop::ReferencedTopDUContext aux);
+        bool isOwned(const QString& file) const;
+        ///The context of the walked file, or null if the file is walked without building its context
+        KDevelop::ReferencedTopDUContext writableContext() const { return m_readOnly ? KDevelop::ReferencedTopDUContext() : m_topctx; }
+        void readProperty(PropertyType type, const QString& key) const;
         
         void macroDeclaration(const CMakeFunctionDesc& def, const CMakeFunctionDesc& end, const QStringList& args);
         CMakeFunctionDesc resolveVariables(const CMakeFunctionDesc &exp);
         QStringList value(const QString& exp, const QList<IntPair>& poss, int& desired) const;
         QStringList theValue(const QString& exp, const IntPair& p) const;
+        QStringList variableValue(VariableMap::Id id, const QString& var) const;
+        QStringList cacheValue(const QString& var) const;
+        QStringList resolveTemplate(const CMakeArgumentTemplate& argument, bool quoted) const;
+        QStringList referenceValue(const CMakeArgumentTemplate::Segment& reference) const;
         
         void defineTarget(const QString& id, const QStringList& sources, Target::Type t);
         bool haveToFind(const QString &varName);
@@ -198,6 +242,8 @@ class KDEVCMAKECOMMON_EXPORT CMakeProjectVisitor : CMakeAstVisitor
         VariableMap *m_vars;
         MacroMap *m_macros;
         const CacheValues* m_cache;
+        ///The values of the cache entries that were read, split into lists
+        mutable QHash<QString, QStringList> m_cacheLists;
         CMakeDefinitions m_defs;
         KDevelop::ReferencedTopDUContext m_topctx;
         KDevelop::ReferencedTopDUContext m_parentCtx;
@@ -207,6 +253,20 @@ class KDEVCMAKECOMMON_EXPORT CMakeProjectVisitor : CMakeAstVisitor
         QHash<QString, QString> m_targetAlias;
 
         QVector<Test> m_testSuites;
+        QStringList m_includedFiles;
+
+        bool m_speculative;
+        bool m_skippedProcesses;
+        mutable QMap<PropertyType, QSet<QString> > m_readProperties;
+        QStringList m_createdContexts;
+        QString m_ownedDirectory;
+        QStringList m_siblingDirectories;
+        ///Whether the walked file is not owned by this evaluation
+        bool m_readOnly;
+        QSet<QString> m_builtContexts;
+        QSet<QString> m_sharedContexts;
+        QList<QPair<QString, QString> > m_sharedImports;
+        bool m_skippedDeclarations;
 };
 
 #endif
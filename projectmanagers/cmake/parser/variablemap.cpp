@@ -17,13 +17,122 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
  * 02110-1301, USA.
  */
+ 
 
 #include "variablemap.h"
 #include <QDebug>
+#include <QAtomicInt>
+#include <QReadWriteLock>
+#include <QThreadStorage>
+#include <QVarLengthArray>
+
+namespace {
+
+struct VariableNames
+{
+    QReadWriteLock lock;
+    QHash<QString, VariableMap::Id> ids;
+    QVector<QString> names;
+    ///The count of names, read without the lock to tell whether names were added meanwhile
+    QAtomicInt count;
+};
+
+VariableNames& variableNames()
+{
+    static VariableNames names;
+    return names;
+}
+
+///The names a thread looked up before, so it only needs the lock of VariableNames for new names
+struct ThreadNames
+{
+    ThreadNames() : count(0) {}
+
+    QHash<QString, VariableMap::Id> ids;
+    ///Names that weren't known yet when there were @c count names
+    QSet<QString> unknown;
+    int count;
+};
+
+QThreadStorage<ThreadNames*> s_threadNames;
+
+ThreadNames& threadNames()
+{
+    if(!s_threadNames.hasLocalData())
+        s_threadNames.setLocalData(new ThreadNames);
+    return *s_threadNames.localData();
+}
+
+}
 
 VariableMap::VariableMap()
 {
-    m_scopes.push(QSet<QString>());
+    m_scopes.append(QSet<Id>());
+}
+
+VariableMap::Id VariableMap::id(const QString& varName)
+{
+    Id ret;
+    if(lookupId(varName, &ret))
+        return ret;
+
+    VariableNames& names = variableNames();
+    {
+        QWriteLocker lock(&names.lock);
+        QHash<QString, Id>::const_iterator it = names.ids.constFind(varName);
+        if(it != names.ids.constEnd()) {
+            ret = *it;
+        } else {
+            ret = names.names.size();
+            names.ids.insert(varName, ret);
+            names.names.append(varName);
+            names.count.ref();
+        }
+    }
+    ThreadNames& cached = threadNames();
+    cached.unknown.remove(varName);
+    cached.ids.insert(varName, ret);
+    return ret;
+}
+
+bool VariableMap::lookupId(const QString& varName, Id* id)
+{
+    ThreadNames& cached = threadNames();
+    QHash<QString, Id>::const_iterator it = cached.ids.constFind(varName);
+    if(it != cached.ids.constEnd()) {
+        *id = *it;
+        return true;
+    }
+
+    //A map only contains the variables that were inserted before it was passed to this thread,
+    //so if no name was added since, a name that was unknown still isn't in any map here
+    VariableNames& names = variableNames();
+    const int count = names.count;
+    if(count == cached.count && cached.unknown.contains(varName))
+        return false;
+
+    {
+        QReadLocker lock(&names.lock);
+        it = names.ids.constFind(varName);
+        if(it != names.ids.constEnd()) {
+            *id = *it;
+            cached.ids.insert(varName, *id);
+            return true;
+        }
+    }
+    if(count != cached.count) {
+        cached.unknown.clear();
+        cached.count = count;
+    }
+    cached.unknown.insert(varName);
+    return false;
+}
+
+QString VariableMap::name(Id id)
+{
+    VariableNames& names = variableNames();
+    QReadLocker lock(&names.lock);
+    return names.names.value(id);
 }
 
 QStringList splitVariable(const QStringList& input)
@@ -39,60 +148,262 @@ QStringList splitVariable(const QStringList& input)
     return ret;
 }
 
+const VariableMap::Bindings* VariableMap::bindings(Id id) const
+{
+    Variables::const_iterator it = m_variables.constFind(id);
+    if(it != m_variables.constEnd())
+        return &*it;
+    for(const Layer* layer = m_layer.data(); layer; layer = layer->parent.data()) {
+        it = layer->variables.constFind(id);
+        if(it != layer->variables.constEnd())
+            return &*it;
+    }
+    return 0;
+}
+
+VariableMap::Bindings& VariableMap::changeBindings(Id id)
+{
+    Variables::iterator it = m_variables.find(id);
+    if(it == m_variables.end()) {
+        const Bindings* inherited = bindings(id);
+        it = m_variables.insert(id, inherited ? *inherited : Bindings());
+    }
+    return *it;
+}
+
+bool VariableMap::contains(Id id) const
+{
+    const Bindings* b = bindings(id);
+    return b && !b->isEmpty();
+}
+
+bool VariableMap::contains(const QString& varName) const
+{
+    Id var;
+    return lookupId(varName, &var) && contains(var);
+}
+
+const QStringList* VariableMap::constFind(Id id) const
+{
+    const Bindings* b = bindings(id);
+    return b && !b->isEmpty() ? &b->last() : 0;
+}
+
+const QStringList* VariableMap::constFind(const QString& varName) const
+{
+    Id var;
+    return lookupId(varName, &var) ? constFind(var) : 0;
+}
+
+QStringList VariableMap::value(Id id) const
+{
+    const QStringList* ret = constFind(id);
+    return ret ? *ret : QStringList();
+}
+
+QStringList VariableMap::value(const QString& varName) const
+{
+    const QStringList* ret = constFind(varName);
+    return ret ? *ret : QStringList();
+}
+
 void VariableMap::insert(const QString& varName, const QStringList& value, bool parentScope)
 {
-    QSet< QString >* current;
+    const Id var = id(varName);
+    QSet<Id>* current;
 //     qDebug() << "leeeeeeeeeeeeE" << varName << value << parentScope;
     if(parentScope && m_scopes.size()>1) { //TODO: provide error?
         current = &m_scopes[m_scopes.size()-2];
-        m_scopes.top().remove(varName);
+        m_scopes.last().remove(var);
     } else
-        current = &m_scopes.top();
+        current = &m_scopes.last();
     
+    Bindings& b = changeBindings(var);
     QStringList ret = splitVariable(value);
     
-    if(current->contains(varName))
-        (*this)[varName]=ret;
+    if(current->contains(var) && !b.isEmpty())
+        b.last()=ret;
     else {
-        current->insert(varName);
-        QHash<QString, QStringList>::insertMulti(varName, ret);
+        current->insert(var);
+        b.append(ret);
     }
-    
-//     QHash<QString, QStringList>::insert(varName, ret);
-//     qDebug() << "++++++++" << varName << QHash<QString, QStringList>::value(varName);
 }
 
-QHash<QString, QStringList>::iterator VariableMap::insertMulti(const QString & varName, const QStringList & value)
+void VariableMap::insertMulti(const QString & varName, const QStringList & value)
 {
-    return QHash<QString, QStringList>::insertMulti(varName, splitVariable(value));
+    changeBindings(id(varName)).append(splitVariable(value));
 }
 
 void VariableMap::insertGlobal(const QString& varName, const QStringList& value)
 {
-    QHash<QString, QStringList>::insert(varName, value);
+    Bindings& b = changeBindings(id(varName));
+    if(b.isEmpty())
+        b.append(value);
+    else
+        b.last()=value;
+}
+
+int VariableMap::removeMulti(const QString& varName)
+{
+    Id var;
+    if(!lookupId(varName, &var) || !contains(var))
+        return 0;
+    changeBindings(var).removeLast();
+    return 1;
+}
+
+int VariableMap::remove(const QString& varName)
+{
+    Id var;
+    if(!lookupId(varName, &var) || !contains(var))
+        return 0;
+    Bindings& b = changeBindings(var);
+    const int ret = b.size();
+    b.clear();
+    return ret;
 }
 
 void VariableMap::pushScope()
 {
-    m_scopes.push(QSet<QString>());
+    if(!m_variables.isEmpty()) {
+        if(m_layer && m_layer->depth >= MaxLayers)
+            flatten();
+        freeze();
+    }
+    m_scopes.append(QSet<Id>());
 }
 
 void VariableMap::popScope()
 {
-    QSet<QString> t=m_scopes.pop();
-    foreach(const QString& var, t) {
-//         qDebug() << "removing........" << var << QHash<QString, QStringList>::value(var);
-        take(var);
+    const QSet<Id> scope = m_scopes.last();
+    m_scopes.removeLast();
+    foreach(Id var, scope) {
+        if(contains(var))
+            changeBindings(var).removeLast();
+    }
+
+    //When the layer was frozen by the matching pushScope() and nobody shares it, the
+    //variables are merged back, so calling functions doesn't stack up layers
+    if(m_layer && m_layer->scopes == m_scopes.size() && m_layer->ref == 1) {
+        Layer* layer = m_layer.data();
+        for(Variables::const_iterator it = m_variables.constBegin(); it != m_variables.constEnd(); ++it)
+            layer->variables.insert(it.key(), *it);
+        m_variables = layer->variables;
+        m_layer = layer->parent;
     }
 }
 
-int VariableMap::removeMulti(const QString& varName)
+void VariableMap::freeze()
 {
-    iterator it = find(varName);
-    if(it==end())
-        return 0;
-    else {
-        erase(it);
-        return 1;
+    Layer* layer = new Layer;
+    layer->variables = m_variables;
+    layer->parent = m_layer;
+    layer->depth = m_layer ? m_layer->depth+1 : 1;
+    layer->scopes = m_scopes.size();
+    m_layer = QExplicitlySharedDataPointer<Layer>(layer);
+    m_variables.clear();
+}
+
+void VariableMap::flatten()
+{
+    QVarLengthArray<const Layer*, MaxLayers> layers;
+    for(const Layer* layer = m_layer.data(); layer; layer = layer->parent.data())
+        layers.append(layer);
+
+    Variables all;
+    for(int i = layers.size()-1; i >= 0; --i) {
+        for(Variables::const_iterator it = layers[i]->variables.constBegin(); it != layers[i]->variables.constEnd(); ++it)
+            all.insert(it.key(), *it);
+    }
+    for(Variables::const_iterator it = m_variables.constBegin(); it != m_variables.constEnd(); ++it)
+        all.insert(it.key(), *it);
+
+    //Nothing is left below, so removed variables don't need to be marked anymore
+    for(Variables::iterator it = all.begin(); it != all.end(); ) {
+        if(it->isEmpty())
+            it = all.erase(it);
+        else
+            ++it;
+    }
+    m_variables = all;
+    m_layer.reset();
+}
+
+QSet<VariableMap::Id> VariableMap::definedIds() const
+{
+    QSet<Id> seen, ret;
+    const Variables* variables = &m_variables;
+    const Layer* layer = m_layer.data();
+    while(variables) {
+        for(Variables::const_iterator it = variables->constBegin(); it != variables->constEnd(); ++it) {
+            if(seen.contains(it.key()))
+                continue;
+            seen.insert(it.key());
+            if(!it->isEmpty())
+                ret.insert(it.key());
+        }
+        variables = layer ? &layer->variables : 0;
+        layer = layer ? layer->parent.data() : 0;
+    }
+    return ret;
+}
+
+QStringList VariableMap::keys() const
+{
+    QStringList ret;
+    foreach(Id var, definedIds())
+        ret += name(var);
+    ret.sort();
+    return ret;
+}
+
+int VariableMap::size() const
+{
+    return definedIds().size();
+}
+
+bool VariableMap::isEmpty() const
+{
+    return definedIds().isEmpty();
+}
+
+void VariableMap::clear()
+{
+    m_variables.clear();
+    m_layer.reset();
+    m_scopes.clear();
+    m_scopes.append(QSet<Id>());
+}
+
+int VariableMap::layerCount() const
+{
+    return m_layer ? m_layer->depth : 0;
+}
+
+bool VariableMap::operator==(const VariableMap& other) const
+{
+    //Only the variables above the layers both maps share can differ
+    QSet<const Layer*> layers;
+    for(const Layer* layer = m_layer.data(); layer; layer = layer->parent.data())
+        layers.insert(layer);
+    const Layer* common = 0;
+    for(const Layer* layer = other.m_layer.data(); layer && !common; layer = layer->parent.data()) {
+        if(layers.contains(layer))
+            common = layer;
+    }
+
+    QSet<Id> candidates = m_variables.keys().toSet();
+    candidates.unite(other.m_variables.keys().toSet());
+    for(const Layer* layer = m_layer.data(); layer != common; layer = layer->parent.data())
+        candidates.unite(layer->variables.keys().toSet());
+    for(const Layer* layer = other.m_layer.data(); layer != common; layer = layer->parent.data())
+        candidates.unite(layer->variables.keys().toSet());
+
+    foreach(Id var, candidates) {
+        const Bindings* a = bindings(var);
+        const Bindings* b = other.bindings(var);
+        if((a ? *a : Bindings()) != (b ? *b : Bindings()))
+            return false;
     }
+    return true;
 }
@@ -18,6 +18,7 @@
  * 02110-1301, USA.
  */
  
+
 #ifndef CMAKE_VARIABLEMAP_H
 #define CMAKE_VARIABLEMAP_H
 
@@ -25,25 +26,63 @@
 #include <QStringList>
 #include "cmakeexport.h"
 #include <QSet>
-#include <QStack>
+#include <QSharedData>
+#include <QVector>
 
-class KDEVCMAKECOMMON_EXPORT VariableMap : public QHash<QString, QStringList>
+/**
+ * The variables of a CMake script, together with their scopes.
+ *
+ * Every variable has a stack of bindings, the last one being its value. Variables that are
+ * bound after pushScope() are unbound again by popScope().
+ *
+ * Variable names are interned, so the variables can be looked up by an integer Id. Each thread
+ * remembers the Ids it looked up, so only new names need the lock of the shared name table. Names
+ * are never released, the table holds every distinct name once.
+ *
+ * Whenever a scope is entered, the variables changed so far are frozen into a layer that is never
+ * modified again while it is shared, so copies of the map share all the layers and only store the
+ * variables they change themselves.
+ */
+class KDEVCMAKECOMMON_EXPORT VariableMap
 {
     public:
+        typedef uint Id;
+        ///The count of layers that may be stacked before they are merged
+        enum { MaxLayers = 16 };
+
         VariableMap();
-//         bool contains(const QString& varName) const;
+
+        ///Returns the Id of the variable called @p varName, interning the name if needed. Can be called from any thread.
+        static Id id(const QString& varName);
+        static QString name(Id id);
+
+        bool contains(const QString& varName) const;
+        bool contains(Id id) const;
+        QStringList value(const QString& varName) const;
+        QStringList value(Id id) const;
+        ///Returns the value of the variable, or 0 if it isn't defined
+        const QStringList* constFind(const QString& varName) const;
+        const QStringList* constFind(Id id) const;
+
         void insert(const QString& varName, const QStringList& value, bool parentScope = false);
         
         ///only for very special cases, usually should use insert. bypasses scopes
-        iterator insertMulti(const QString& varName, const QStringList& value);
+        void insertMulti(const QString& varName, const QStringList& value);
         
-//         QStringList value(const QString& varName) const;
-//         QStringList take(const QString& varName);
-//         int remove(const QString& varName);
+        ///Removes the last binding of the variable
         int removeMulti(const QString& varName);
-// 
-//         int size() const { return QHash<QString, QStringList>::size(); }
-//         QStringList keys() const { return QHash<QString, QStringList>::keys(); }
+        ///Removes all bindings of the variable
+        int remove(const QString& varName);
+
+        ///The names of all defined variables
+        QStringList keys() const;
+        int size() const;
+        bool isEmpty() const;
+        void clear();
+
+        bool operator==(const VariableMap& other) const;
+        bool operator!=(const VariableMap& other) const { return !operator==(other); }
+
         static QString regexVar() { return "\\$\\{[A-z0-9\\-._:]+\\}"; }
 #ifdef Q_OS_WIN
         static QString regexEnvVar() { return "\\$ENV\\{[A-z0-9\\-._:]+\\}"; }
@@ -55,8 +94,37 @@ class KDEVCMAKECOMMON_EXPORT VariableMap : public QHash<QString, QStringList>
         
         /** will create a variable without adding a scope on it */
         void insertGlobal(const QString& key, const QStringList& value);
+
+        ///The count of frozen layers, for testing
+        int layerCount() const;
+
     private:
-        QStack<QSet<QString> > m_scopes;
+        typedef QVector<QStringList> Bindings;
+        typedef QHash<Id, Bindings> Variables;
+
+        struct Layer : public QSharedData
+        {
+            Variables variables;
+            QExplicitlySharedDataPointer<Layer> parent;
+            int depth;
+            ///The count of scopes when the layer was frozen
+            int scopes;
+        };
+
+        ///Returns the bindings of @p id, or 0 if it never was bound
+        const Bindings* bindings(Id id) const;
+        ///Returns the bindings of @p id, copied to m_variables so they can be changed
+        Bindings& changeBindings(Id id);
+        ///Finds the Id of @p varName without interning it
+        static bool lookupId(const QString& varName, Id* id);
+        QSet<Id> definedIds() const;
+        void freeze();
+        void flatten();
+
+        ///The variables changed since the last layer was frozen, empty bindings mark removed variables
+        Variables m_variables;
+        QExplicitlySharedDataPointer<Layer> m_layer;
+        QVector<QSet<Id> > m_scopes;
 };
 
 #endif
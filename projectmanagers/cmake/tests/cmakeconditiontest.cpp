@@ -63,6 +63,9 @@ void CMakeConditionTest::testGoodParse()
     v.setVariableMap( &m_vars );
     v.setMacroMap( &m_macros );
     v.setCacheValues( &m_cache );
+    CMakeProperties properties;
+    properties[TargetProperty]["testtarget"]["TYPE"] = QStringList("EXECUTABLE");
+    v.setProperties( properties );
     
     CMakeCondition cond(&v);
     QCOMPARE( cond.condition(expression), result );
@@ -155,6 +158,9 @@ void CMakeConditionTest::testGoodParse_data()
     QTest::newRow( "notfound variable" ) << QStringList("UNFOUNDVAR") << false;
     
     QTest::newRow( "<empty> OR NOT <empty>" ) << QString(" OR NOT ").split(" ") << true;
+
+    QTest::newRow( "target" ) << QString("TARGET testtarget").split(" ") << true;
+    QTest::newRow( "not target" ) << QString("NOT TARGET ONE").split(" ") << true;
 }
 
 void CMakeConditionTest::testBadParse()
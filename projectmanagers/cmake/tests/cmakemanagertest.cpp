@@ -21,6 +21,7 @@
 #include "testhelpers.h"
 #include "cmakemodelitems.h"
 #include <icmakemanager.h>
+#include <cmakeprojectvisitor.h>
 
 #include <qtest.h>
 #include <qtest_kde.h>
@@ -32,6 +33,16 @@
 #include <tests/autotestshell.h>
 #include <tests/testproject.h>
 #include <tests/testcore.h>
+#include <language/duchain/duchain.h>
+#include <language/duchain/duchainlock.h>
+#include <language/duchain/declaration.h>
+#include <language/duchain/topducontext.h>
+
+#include <KTempDir>
+#include <KStandardDirs>
+#include <QCryptographicHash>
+
+#include <utime.h>
 
 QTEST_KDEMAIN(CMakeManagerTest, GUI )
 
@@ -126,6 +137,128 @@ void CMakeManagerTest::testTargetIncludePaths()
     QVERIFY(foundInTarget);
 }
 
+void CMakeManagerTest::testParallelSubdirectories()
+{
+    // the sibling directories are evaluated in parallel, app has to see the target of lib nonetheless
+    IProject* project = loadProject("parallel_subdirectories");
+
+    Path appCpp(project->path(), "app/main.cpp");
+    QList< ProjectBaseItem* > items = project->itemsForPath(IndexedString(appCpp.pathOrUrl()));
+    QCOMPARE(items.size(), 2); // once the plain file, once the target
+
+    bool foundInTarget = false;
+    foreach(ProjectBaseItem* item, items) {
+        if (dynamic_cast<CMakeExecutableTargetItem*>(item->parent())) {
+            foundInTarget = true;
+            Path::List includeDirs = project->buildSystemManager()->includeDirectories(item);
+            QVERIFY(includeDirs.contains(Path(project->path(), "lib/include/")));
+        }
+    }
+    QVERIFY(foundInTarget);
+
+    Path toolCpp(project->path(), "tool/main.cpp");
+    items = project->itemsForPath(IndexedString(toolCpp.pathOrUrl()));
+    QCOMPARE(items.size(), 2);
+    Path::List includeDirs = project->buildSystemManager()->includeDirectories(items.first());
+    QVERIFY(includeDirs.contains(Path(project->path(), "tool/private/")));
+    QVERIFY(!includeDirs.contains(Path(project->path(), "lib/include/")));
+
+    // app and tool include the same module, its context is built by one evaluation only
+    DUChainReadLocker lock;
+    TopDUContext* common = DUChain::self()->chainForDocument(IndexedString(Path(project->path(), "cmake/common.cmake").pathOrUrl()));
+    QVERIFY(common);
+    QCOMPARE(common->findLocalDeclarations(Identifier("add_tool_executable")).size(), 1);
+}
+
+static QMutex s_evaluationsMutex;
+static QSet<QString> s_evaluations;
+
+static void recordEvaluation(const QString& message)
+{
+    QMutexLocker lock(&s_evaluationsMutex);
+    if (message.startsWith("evaluated ")) {
+        s_evaluations += message.mid(10);
+    }
+}
+
+static bool copyDirectory(const QDir& source, const QDir& target)
+{
+    foreach(const QFileInfo& info, source.entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot)) {
+        const QString targetPath = target.absoluteFilePath(info.fileName());
+        if (!info.isDir()) {
+            if (!QFile::copy(info.absoluteFilePath(), targetPath))
+                return false;
+        } else if (info.fileName() != "build") {
+            // the build directory is created by defaultConfigure()
+            if (!target.mkdir(info.fileName()) || !copyDirectory(QDir(info.absoluteFilePath()), QDir(targetPath)))
+                return false;
+        }
+    }
+    return true;
+}
+
+void CMakeManagerTest::testEvaluationCache()
+{
+    // the fixture is modified below, so work on a copy of it
+    KTempDir tempDir;
+    QVERIFY(copyDirectory(QDir(projectPaths("parallel_subdirectories").sourceDir.toLocalFile()), QDir(tempDir.name())));
+    const TestProjectPaths paths = projectPaths(tempDir.name(), "parallel_subdirectories");
+    const QByteArray projectId = QCryptographicHash::hash(paths.projectFile.toLocalFile().toUtf8(), QCryptographicHash::Md5).toHex();
+    QFile::remove(KStandardDirs::locateLocal("cache", "kdevcmake/" + QString::fromLatin1(projectId)));
+
+    const QSet<QString> directories = QSet<QString>() << "parallel_subdirectories" << "lib" << "app" << "tool";
+    CMakeProjectVisitor::setMessageCallback(recordEvaluation);
+    // the second time the project is opened its evaluation is restored from the cache,
+    // the third time a subdirectory changed and the whole project is evaluated again
+    for(int i = 0; i < 3; ++i) {
+        if (i == 2) {
+            const QString toolLists = paths.sourceDir.toLocalFile(KUrl::AddTrailingSlash) + "tool/CMakeLists.txt";
+            QFileInfo info(toolLists);
+            utimbuf times;
+            times.actime = times.modtime = info.lastModified().addSecs(-60).toTime_t();
+            QCOMPARE(utime(QFile::encodeName(toolLists).constData(), &times), 0);
+        }
+        {
+            QMutexLocker lock(&s_evaluationsMutex);
+            s_evaluations.clear();
+        }
+
+        IProject* project = loadProject(paths, "parallel_subdirectories");
+
+        Path appCpp(project->path(), "app/main.cpp");
+        QList< ProjectBaseItem* > items = project->itemsForPath(IndexedString(appCpp.pathOrUrl()));
+        QCOMPARE(items.size(), 2);
+        foreach(ProjectBaseItem* item, items) {
+            if (CMakeExecutableTargetItem* target = dynamic_cast<CMakeExecutableTargetItem*>(item->parent())) {
+                Path::List includeDirs = project->buildSystemManager()->includeDirectories(item);
+                QVERIFY(includeDirs.contains(Path(project->path(), "lib/include/")));
+                DUChainReadLocker lock;
+                QVERIFY(target->declaration().declaration());
+            }
+        }
+
+        // tool uses variables of the root directory
+        Path toolCpp(project->path(), "tool/main.cpp");
+        items = project->itemsForPath(IndexedString(toolCpp.pathOrUrl()));
+        QCOMPARE(items.size(), 2);
+        Path::List includeDirs = project->buildSystemManager()->includeDirectories(items.first());
+        QVERIFY(includeDirs.contains(Path(project->path(), "tool/private/")));
+        QVERIFY(includeDirs.contains(Path(project->path(), "shared/")));
+        QCOMPARE(project->buildSystemManager()->defines(items.first()).value("TOOL_PROJECT"), QString("parallel_subdirectories"));
+
+        {
+            QMutexLocker lock(&s_evaluationsMutex);
+            if (i == 1) {
+                QVERIFY(s_evaluations.isEmpty());
+            } else {
+                QCOMPARE(s_evaluations, directories);
+            }
+        }
+
+        ICore::self()->projectController()->closeProject(project);
+    }
+}
+
 void CMakeManagerTest::testTargetIncludeDirectories()
 {
     IProject* project = loadProject("target_include_directories");
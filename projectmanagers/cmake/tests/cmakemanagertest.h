@@ -43,6 +43,8 @@ private slots:
     void testRelativePaths();
     void testTargetIncludeDirectories();
     void testTargetIncludePaths();
+    void testParallelSubdirectories();
+    void testEvaluationCache();
     void testDefines();
     void testCustomTargetSources();
     void testConditionsInSubdirectoryBasedOnRootVariables();
@@ -31,17 +31,51 @@
 #include <language/duchain/duchain.h>
 #include <cmakecondition.h>
 #include <cmakeparserutils.h>
+#include <cmakefindcache.h>
 #include <tests/autotestshell.h>
 #include <tests/testcore.h>
 #include <astfactory.h>
 #include <cmakeprojectdata.h>
 #include <KTempDir>
 #include <KTemporaryFile>
+#include <QThread>
 
 QTEST_KDEMAIN_CORE(CMakeProjectVisitorTest)
 
 using namespace KDevelop;
 
+namespace {
+
+class VariableInserter : public QThread
+{
+    public:
+        VariableInserter(VariableMap* vm, const QString& name) : m_vm(vm), m_name(name) {}
+        virtual void run() { m_vm->insert(m_name, QStringList("value")); }
+
+    private:
+        VariableMap* m_vm;
+        QString m_name;
+};
+
+class VariableLookups : public QThread
+{
+    public:
+        VariableLookups(const VariableMap* vm, const QStringList& names) : m_vm(vm), m_names(names) {}
+        virtual void run()
+        {
+            for(int i = 0; i < 1000; ++i) {
+                foreach(const QString& name, m_names)
+                    m_vm->constFind(name);
+            }
+        }
+
+    private:
+        const VariableMap* m_vm;
+        QStringList m_names;
+};
+
+}
+
 #undef TRUE //krazy:exclude=captruefalse
 #undef FALSE //krazy:exclude=captruefalse
 
@@ -124,6 +158,101 @@ void CMakeProjectVisitorTest::testVariables()
     }
 }
 
+void CMakeProjectVisitorTest::testVariableMap()
+{
+    VariableMap vm;
+    vm.insert("A", QStringList("a1"));
+    vm.insertGlobal("G", QStringList("g"));
+    vm.pushScope();
+    vm.insert("A", QStringList() << "a2" << "a3");
+    vm.insert("B", QStringList("b"));
+    vm.insert("P", QStringList("p"), true);
+    QCOMPARE(vm.value("A"), QStringList() << "a2" << "a3");
+    QCOMPARE(vm.value(VariableMap::id("A")), QStringList() << "a2" << "a3");
+    QCOMPARE(vm.keys(), QStringList() << "A" << "B" << "G" << "P");
+
+    //copies don't see each other's changes
+    VariableMap copy = vm;
+    copy.insert("B", QStringList("changed"));
+    QCOMPARE(vm.value("B"), QStringList("b"));
+    QCOMPARE(copy.value("B"), QStringList("changed"));
+    QVERIFY(copy != vm);
+
+    vm.popScope();
+    QCOMPARE(vm.value("A"), QStringList("a1"));
+    QVERIFY(!vm.contains("B"));
+    QVERIFY(!vm.constFind("B"));
+    QCOMPARE(vm.value("P"), QStringList("p"));
+    QCOMPARE(vm.value("G"), QStringList("g"));
+    QCOMPARE(copy.value("A"), QStringList() << "a2" << "a3");
+
+    vm.insertMulti("M", QStringList("1"));
+    vm.insertMulti("M", QStringList("2"));
+    QCOMPARE(vm.value("M"), QStringList("2"));
+    QCOMPARE(vm.removeMulti("M"), 1);
+    QCOMPARE(vm.value("M"), QStringList("1"));
+    vm.insertMulti("M", QStringList("2"));
+    QCOMPARE(vm.remove("M"), 2);
+    QVERIFY(!vm.contains("M"));
+    QCOMPARE(vm.removeMulti("M"), 0);
+
+    //a scope that was left again doesn't leave anything behind
+    VariableMap calls = vm;
+    for(int i = 0; i < VariableMap::MaxLayers*2; ++i) {
+        calls.pushScope();
+        calls.insert("ARG", QStringList(QString::number(i)));
+        calls.popScope();
+    }
+    QVERIFY(!calls.contains("ARG"));
+    QVERIFY(calls == vm);
+    QCOMPARE(calls.layerCount(), vm.layerCount());
+
+    //nested scopes that are shared with copies are merged once there are too many
+    VariableMap deep;
+    QList<VariableMap> snapshots;
+    for(int i = 0; i < VariableMap::MaxLayers*2; ++i) {
+        deep.insert(QString("V%1").arg(i), QStringList(QString::number(i)));
+        snapshots += deep;
+        deep.pushScope();
+    }
+    QVERIFY(deep.layerCount() <= VariableMap::MaxLayers);
+    for(int i = 0; i < snapshots.size(); ++i) {
+        QCOMPARE(deep.value(QString("V%1").arg(i)), QStringList(QString::number(i)));
+        QCOMPARE(snapshots[i].size(), i+1);
+    }
+
+    //a name that was unknown here is found once another thread added it
+    VariableMap other;
+    QVERIFY(!other.contains("FROM_OTHER_THREAD"));
+    VariableInserter inserter(&other, "FROM_OTHER_THREAD");
+    inserter.start();
+    QVERIFY(inserter.wait());
+    QCOMPARE(other.value("FROM_OTHER_THREAD"), QStringList("value"));
+}
+
+void CMakeProjectVisitorTest::benchVariableLookups()
+{
+    //the variables are looked up from several threads at once, like when sub-directories are evaluated in parallel
+    VariableMap vm;
+    QStringList names;
+    for(int i = 0; i < 200; ++i) {
+        names += QString("VARIABLE_%1").arg(i);
+        vm.insert(names.last(), QStringList(QString::number(i)));
+        vm.pushScope();
+    }
+    names += "UNDEFINED";
+
+    QBENCHMARK {
+        QList<QSharedPointer<VariableLookups> > threads;
+        for(int i = 0; i < QThread::idealThreadCount(); ++i) {
+            threads += QSharedPointer<VariableLookups>(new VariableLookups(&vm, names));
+            threads.last()->start();
+        }
+        foreach(const QSharedPointer<VariableLookups>& thread, threads)
+            thread->wait();
+    }
+}
+
 typedef QPair<QString, QString> StringPair;
 Q_DECLARE_METATYPE(QList<StringPair>)
 
@@ -560,6 +689,102 @@ void CMakeProjectVisitorTest::testRun()
     }
 }
 
+void CMakeProjectVisitorTest::testResolveVariable_data()
+{
+    QTest::addColumn<QString>("input");
+    QTest::addColumn<bool>("quoted");
+    QTest::addColumn<QStringList>("result");
+
+    QTest::newRow("variable") << "${list}" << false << (QStringList() << "a" << "b");
+    QTest::newRow("quoted variable") << "${list}" << true << QStringList("a;b");
+    QTest::newRow("surrounded") << "x${list}y" << false << (QStringList() << "xa" << "by");
+    QTest::newRow("two") << "${list}${one}" << false << (QStringList() << "a" << "bONE");
+    QTest::newRow("undefined") << "${undefined}" << false << QStringList();
+    QTest::newRow("quoted undefined") << "${undefined}" << true << QStringList(QString());
+    QTest::newRow("undefined surrounded") << "x${undefined}y" << false << QStringList("xy");
+    QTest::newRow("nested") << "${${one}}" << false << QStringList("nested");
+    QTest::newRow("nested list") << "-${x${list}x}-" << false << QStringList("-nested list-");
+    QTest::newRow("cache") << "${cached}/" << false << (QStringList() << "c" << "d/");
+    QTest::newRow("environment") << "$ENV{KDEV_CMAKE_UNDEFINED_VARIABLE}x" << false << QStringList("x");
+    QTest::newRow("unknown key") << "$KEY{one}x" << false << QStringList("x");
+    QTest::newRow("dollars") << "$$${one}$" << false << QStringList("$$ONE$");
+    QTest::newRow("mess") << "{}{}{}}}}{{{{}${one}" << false << QStringList("{}{}{}}}}{{{{}ONE");
+    QTest::newRow("not closed") << "aaaa${one" << false << QStringList("aaaa${one");
+}
+
+void CMakeProjectVisitorTest::testResolveVariable()
+{
+    QFETCH(QString, input);
+    QFETCH(bool, quoted);
+    QFETCH(QStringList, result);
+
+    VariableMap vm;
+    vm.insert("list", QStringList() << "a" << "b");
+    vm.insert("one", QStringList("ONE"));
+    vm.insert("ONE", QStringList("nested"));
+    vm.insert("xa;bx", QStringList("nested list"));
+    CacheValues cache;
+    cache["cached"]=CacheEntry("c;d");
+
+    CMakeProjectVisitor v(QString(), fakeContext);
+    v.setVariableMap(&vm);
+    v.setCacheValues(&cache);
+
+    //compiled when read from a file
+    CMakeFunctionArgument compiled(input, quoted, 1, 1);
+    QCOMPARE(compiled.value, input);
+    QCOMPARE(v.resolveVariable(compiled), result);
+
+    //evaluated directly otherwise
+    CMakeFunctionArgument plain(input);
+    plain.quoted=quoted;
+    QVERIFY(!plain.compiled);
+    QCOMPARE(v.resolveVariable(plain), result);
+}
+
+void CMakeProjectVisitorTest::benchResolveVariables_data()
+{
+    testRun_data();
+}
+
+void CMakeProjectVisitorTest::benchResolveVariables()
+{
+    QFETCH(QString, input);
+    QFETCH(QList<StringPair>, cache);
+
+    QSharedPointer<KTemporaryFile> file = prepareVisitoTestScript(input);
+    QVERIFY(!file.isNull());
+    CMakeFileContent code=CMakeListsParser::readCMakeFile(file->fileName());
+
+    MacroMap mm;
+    VariableMap vm;
+    CacheValues val;
+    foreach(const StringPair& v, cache)
+        val[v.first]=v.second;
+
+    vm.insert("CMAKE_SOURCE_DIR", QStringList("./"));
+    vm.insert("CMAKE_CURRENT_SOURCE_DIR", QStringList("./"));
+
+    CMakeProjectVisitor v(file->fileName(), fakeContext);
+    v.setVariableMap(&vm);
+    v.setMacroMap(&mm);
+    v.setCacheValues( &val );
+    v.walk(code, 0);
+
+    QList<CMakeFunctionArgument> arguments;
+    foreach(const CMakeFunctionDesc& desc, code) {
+        foreach(const CMakeFunctionArgument& arg, desc.arguments) {
+            if(arg.value.contains('$'))
+                arguments += arg;
+        }
+    }
+
+    QBENCHMARK {
+        foreach(const CMakeFunctionArgument& arg, arguments)
+            v.resolveVariable(arg);
+    }
+}
+
 void CMakeProjectVisitorTest::testFinder_data()
 {
     QTest::addColumn<QString>("module");
@@ -640,6 +865,43 @@ void CMakeProjectVisitorTest::testFinder()
     QVERIFY(found);
 }
 
+void CMakeProjectVisitorTest::testFindCache()
+{
+    KTempDir dir;
+    QDir(dir.name()).mkpath("a/include");
+    QDir(dir.name()).mkpath("b/include");
+    QFile header(dir.name()+"b/include/found.h");
+    QVERIFY(header.open(QIODevice::WriteOnly));
+    header.close();
+
+    CMakeFindCache& cache = CMakeFindCache::self();
+    cache.increaseGeneration();
+    cache.resetStatistics();
+
+    const QStringList folders = QStringList() << dir.name()+"a" << dir.name()+"b";
+    const QStringList suffixes("include");
+    QCOMPARE(CMakeProjectVisitor::findFile("found.h", folders, suffixes, true), dir.name()+"b/include");
+    QCOMPARE(cache.statistics().hits, 0u);
+    const uint probes = cache.statistics().probes;
+    QVERIFY(probes > 0);
+
+    //The same search is answered from the cache, without touching the file-system
+    QCOMPARE(CMakeProjectVisitor::findFile("found.h", folders, suffixes, true), dir.name()+"b/include");
+    QCOMPARE(cache.statistics().hits, 1u);
+    QCOMPARE(cache.statistics().probesSaved, probes);
+    QCOMPARE(cache.statistics().probes, probes);
+    //Other arguments make up another search
+    QCOMPARE(CMakeProjectVisitor::findFile("found.h", folders, suffixes, false), dir.name()+"b/include/found.h");
+    QCOMPARE(cache.statistics().hits, 1u);
+
+    //Results are kept until the next generation
+    QVERIFY(QFile::remove(dir.name()+"b/include/found.h"));
+    QCOMPARE(CMakeProjectVisitor::findFile("found.h", folders, suffixes, true), dir.name()+"b/include");
+    cache.increaseGeneration();
+    QVERIFY(CMakeProjectVisitor::findFile("found.h", folders, suffixes, true).isEmpty());
+    QCOMPARE(cache.statistics().entries, 1u);
+}
+
 void CMakeProjectVisitorTest::testGlobs_data()
 {
     // This test case covers some usages of file(GLOB ...) and file(GLOB_RECURSE ...) in the way
@@ -865,9 +1127,9 @@ void CMakeProjectVisitorTest::testGlobs()
     v.setCacheValues( &val );
     v.walk(code, 0);
 
-    VariableMap::const_iterator it = v.variables()->constFind("RESULT");
-    QVERIFY2(it != v.variables()->constEnd(), "RESULT variable doesn't exist");
-    QStringList filesFound = it.value();
+    const QStringList* result = v.variables()->constFind("RESULT");
+    QVERIFY2(result, "RESULT variable doesn't exist");
+    QStringList filesFound = *result;
     QDir baseDir(dir.name());
     for (int i = 0; i < filesFound.size(); i++)
     {
@@ -44,12 +44,22 @@ private slots:
     void testVariables();
     void testVariables_data();
 
+    void testVariableMap();
+    void benchVariableLookups();
+
     void testRun();
     void testRun_data();
 
+    void testResolveVariable();
+    void testResolveVariable_data();
+
+    void benchResolveVariables();
+    void benchResolveVariables_data();
+
     void testFinder_init();
     void testFinder();
     void testFinder_data();
+    void testFindCache();
 
     void testGlobs();
     void testGlobs_data();
@@ -0,0 +1,3 @@
+macro(add_tool_executable name)
+    add_executable(${name} ${ARGN})
+endmacro()
@@ -0,0 +1,6 @@
+#ifndef LIB_H
+#define LIB_H
+
+int lib();
+
+#endif
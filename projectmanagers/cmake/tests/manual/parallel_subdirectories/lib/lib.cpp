@@ -0,0 +1,6 @@
+#include "lib.h"
+
+int lib()
+{
+    return 42;
+}
@@ -0,0 +1,6 @@
+#ifndef SHARED_H
+#define SHARED_H
+
+#define SHARED_RESULT 0
+
+#endif
@@ -0,0 +1,7 @@
+#include <tool.h>
+#include <shared.h>
+
+int main()
+{
+    return TOOL_RESULT + SHARED_RESULT;
+}
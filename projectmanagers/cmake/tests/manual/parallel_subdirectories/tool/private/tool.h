@@ -0,0 +1,6 @@
+#ifndef TOOL_H
+#define TOOL_H
+
+#define TOOL_RESULT 0
+
+#endif
@@ -114,9 +114,8 @@ void defaultConfigure(const TestProjectPaths& paths)
     config.sync();
 }
 
-KDevelop::IProject* loadProject(const QString& name, const QString& relative = QString())
+KDevelop::IProject* loadProject(const TestProjectPaths& paths, const QString& name)
 {
-    const TestProjectPaths paths = projectPaths(name+relative, name);
     defaultConfigure(paths);
 
     KDevelop::ICore::self()->projectController()->openProject(paths.projectFile);
@@ -136,4 +135,9 @@ KDevelop::IProject* loadProject(const QString& name, const QString& relative = Q
     return project;
 }
 
+KDevelop::IProject* loadProject(const QString& name, const QString& relative = QString())
+{
+    return loadProject(projectPaths(name+relative, name), name);
+}
+
 #endif